@@ -0,0 +1,41 @@
+#include "FrameItem.h"
+#include <QQuickWindow>
+#include <QSGSimpleTextureNode>
+#include <algorithm>
+
+FrameItem::FrameItem(QQuickItem* parent)
+    : QQuickItem(parent)
+    , palette(Palette::RGBA8888)
+    , image(FRAME_WIDTH, FRAME_HEIGHT, QImage::Format_RGBA8888)
+{
+    setFlag(ItemHasContents, true);
+    image.fill(Qt::black);
+}
+
+QSGNode* FrameItem::updatePaintNode(QSGNode* oldNode, UpdatePaintNodeData*)
+{
+    auto* node = static_cast<QSGSimpleTextureNode*>(oldNode);
+    bool newFrame = source != nullptr && source->Update();
+    if (node == nullptr)
+    {
+        node = new QSGSimpleTextureNode();
+        node->setOwnsTexture(true);
+        node->setFiltering(QSGTexture::Nearest);
+        newFrame = true;
+    }
+    if (newFrame)
+    {
+        if (source != nullptr)
+        {
+            palette.ConvertFrame(source->GetReadBuffer(), image.bits(), image.bytesPerLine());
+        }
+        // The previous texture is deleted by the node
+        node->setTexture(window()->createTextureFromImage(image));
+    }
+
+    // Largest rectangle with the aspect ratio of the frame
+    double scale = std::min(width() / FRAME_WIDTH, height() / FRAME_HEIGHT);
+    QSizeF size(FRAME_WIDTH * scale, FRAME_HEIGHT * scale);
+    node->setRect(QRectF(QPointF((width() - size.width()) / 2, (height() - size.height()) / 2), size));
+    return node;
+}
@@ -0,0 +1,36 @@
+#ifndef FRAMEITEM_H
+#define FRAMEITEM_H
+
+#include "NESpp/Palette.h"
+#include "TripleBuffer.h"
+#include <QImage>
+#include <QQuickItem>
+
+/*
+ * Shows the frames published by the emulation thread. When
+ * the scene graph is synchronized the latest frame, if there
+ * is a new one, is taken from the triple buffer and its pixels
+ * are converted straight into the image the texture is made
+ * from; the emulation thread is never waited for.
+ */
+
+class FrameItem : public QQuickItem
+{
+    Q_OBJECT
+
+public:
+    FrameItem(QQuickItem* parent = nullptr);
+
+    // Must be set before the item is shown
+    void SetSource(TripleBuffer<FrameBuffer>* frames) { source = frames; }
+
+protected:
+    QSGNode* updatePaintNode(QSGNode* oldNode, UpdatePaintNodeData* data) override;
+
+private:
+    TripleBuffer<FrameBuffer>* source = nullptr;
+    Palette palette;
+    QImage image;
+};
+
+#endif // FRAMEITEM_H
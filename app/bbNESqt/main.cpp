@@ -1,9 +1,39 @@
+#include "FrameItem.h"
+#include "NESpp/EmulationThread.h"
+#include "NESpp/Emulator.h"
 #include <QtGui>
 #include <QtQml>
 
 int main(int argc, char** argv)
 {
     QGuiApplication app(argc, argv);
+    qmlRegisterType<FrameItem>("bbNES", 1, 0, "FrameItem");
     QQmlApplicationEngine engine(QUrl("qrc:/main.qml"));
+    FrameItem* screen = engine.rootObjects().isEmpty() ? nullptr
+                                                       : engine.rootObjects().first()->findChild<FrameItem*>("screen");
+    if (screen == nullptr)
+    {
+        return -1;
+    }
+
+    Emulator emulator;
+    if (argc > 1 && !emulator.LoadGame(argv[1]))
+    {
+        qWarning() << "Can't load" << argv[1];
+    }
+    TripleBuffer<FrameBuffer> frames;
+    screen->SetSource(&frames);
+
+    // The emulator draws directly into the buffer that is published next
+    emulator.SetFrameBuffer(frames.GetWriteBuffer());
+    EmulationThread emulation(emulator);
+    emulation.SetFrameCallback([&]() {
+        frames.Publish();
+        emulator.SetFrameBuffer(frames.GetWriteBuffer());
+        // Queued, so that the UI thread is never waited for
+        QMetaObject::invokeMethod(screen, &QQuickItem::update, Qt::QueuedConnection);
+    });
+    emulation.Start();
+
     return app.exec();
 }
@@ -1,13 +1,17 @@
 import QtQuick
+import QtQuick.Window
+import bbNES
 
-Rectangle{
+Window {
     id: root
-    width: 200
-    height: 100
-    color: "red"
+    width: 512
+    height: 480
+    color: "black"
     visible: true
-    Text{
-        anchors.centerIn: parent
-        text: "Hello, world!"
+    title: "bbNES"
+
+    FrameItem {
+        objectName: "screen"
+        anchors.fill: parent
     }
 }
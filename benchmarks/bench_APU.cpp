@@ -0,0 +1,48 @@
+#include "NESpp/Debugger.h"
+#include "NESpp/Emulator.h"
+#include "benchmark/benchmark.h"
+
+/*
+ * Whole frames with the pulses, the triangle and the noise playing
+ * and the rendering disabled, with the sound synthesized (mode:0)
+ * or only the timing of the APU emulated (mode:1). The CPU only
+ * runs an idle loop.
+ */
+
+namespace
+{
+void BM_AudioFrame(benchmark::State& state)
+{
+    Emulator emulator;
+    Debugger debugger(emulator);
+    emulator.SetAudioMode(state.range(0) ? APU::TURBO : APU::FULL);
+    emulator.SetRenderMode(PPU::SCANLINE);
+
+    uint8_t program[]{
+        0xA9, 0x0F, 0x8D, 0x15, 0x40, // 0700: all the channels but the DMC enabled
+        0xA9, 0xBF, 0x8D, 0x00, 0x40, // 0705: pulses: 50% duty, halted, volume 15
+        0x8D, 0x04, 0x40,             // 070A:
+        0x8D, 0x0C, 0x40,             // 070D: noise: halted, volume 15
+        0xA9, 0xFF, 0x8D, 0x08, 0x40, // 0710: triangle: halted
+        0xA9, 0xF9, 0x8D, 0x02, 0x40, // 0715: periods
+        0x8D, 0x06, 0x40,             // 071A:
+        0x8D, 0x0A, 0x40,             // 071D:
+        0xA9, 0x04, 0x8D, 0x0E, 0x40, // 0720:
+        0xA9, 0x08, 0x8D, 0x03, 0x40, // 0725: lengths
+        0x8D, 0x07, 0x40,             // 072A:
+        0x8D, 0x0B, 0x40,             // 072D:
+        0x8D, 0x0F, 0x40,             // 0730:
+        0x4C, 0x33, 0x07,             // 0733: JMP $0733
+    };
+    debugger.LoadInstrFromArray(program, sizeof(program));
+    debugger.SetPC(0x0700);
+
+    for (auto _ : state)
+    {
+        emulator.RunFrame();
+    }
+    state.counters["frames"] = benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate);
+}
+} // namespace
+
+BENCHMARK(BM_AudioFrame)->ArgName("mode")->Arg(0)->Arg(1);
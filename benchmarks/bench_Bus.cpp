@@ -0,0 +1,62 @@
+#include "NES.h"
+#include "benchmark/benchmark.h"
+#include "mappers/NROM.h"
+#include <memory>
+
+namespace
+{
+void BM_BusReadRAM(benchmark::State& state)
+{
+    NES nes;
+    uint16_t address = 0;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(nes.Read(address));
+        address = (address + 1) & 0x1FFF;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_BusReadCartridge(benchmark::State& state)
+{
+    NES nes;
+    uint16_t address = 0x8000;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(nes.Read(address));
+        address = (address + 1) | 0x8000;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_BusWriteRAM(benchmark::State& state)
+{
+    NES nes;
+    uint16_t address = 0;
+    for (auto _ : state)
+    {
+        nes.Write(address, (uint8_t)address);
+        address = (address + 1) & 0x1FFF;
+    }
+    benchmark::ClobberMemory();
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_MapperTranslationNROM(benchmark::State& state)
+{
+    // Called through the base class like the cartridge does
+    std::unique_ptr<Mapper> mapper = std::make_unique<NROM>(state.range(0), 1);
+    uint16_t address = 0;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(mapper->GetAddressPRG(address));
+        address = (address + 1) & 0x7FFF;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+} // namespace
+
+BENCHMARK(BM_BusReadRAM);
+BENCHMARK(BM_BusReadCartridge);
+BENCHMARK(BM_BusWriteRAM);
+BENCHMARK(BM_MapperTranslationNROM)->Arg(1)->Arg(2);
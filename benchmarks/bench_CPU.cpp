@@ -0,0 +1,187 @@
+#include "NESpp/Debugger.h"
+#include "NESpp/Emulator.h"
+#include "PerfCounters.h"
+#include "TestROM.h"
+#include "benchmark/benchmark.h"
+#include <vector>
+
+/*
+ * Opcode dispatch cost for each addressing mode: the
+ * same instruction is repeated to fill a block of RAM
+ * that is then run through the debugger, so every
+ * iteration executes exactly INSTRUCTIONS_PER_BLOCK
+ * instructions plus the illegal opcode that stops it.
+ */
+
+namespace
+{
+const size_t INSTRUCTIONS_PER_BLOCK = 128;
+const uint16_t PROGRAM_START = 0x0200;
+
+std::vector<uint8_t> RepeatInstruction(std::vector<uint8_t> instruction)
+{
+    std::vector<uint8_t> program;
+    for (size_t i = 0; i < INSTRUCTIONS_PER_BLOCK; i++)
+    {
+        program.insert(program.end(), instruction.begin(), instruction.end());
+    }
+    program.push_back(0xFF);
+    return program;
+}
+
+// Chain of JMP ($xxxx), each pointer leads to the next jump
+std::vector<uint8_t> IndirectJumpChain(uint16_t pointerTable)
+{
+    std::vector<uint8_t> program;
+    for (size_t i = 0; i < INSTRUCTIONS_PER_BLOCK; i++)
+    {
+        uint16_t pointer = pointerTable + 2 * i;
+        program.insert(program.end(), {0x6C, (uint8_t)(pointer & 0xFF), (uint8_t)(pointer >> 8)});
+    }
+    program.push_back(0xFF);
+    return program;
+}
+
+void BM_Dispatch(benchmark::State& state, std::vector<uint8_t> program)
+{
+    Emulator emulator;
+    Debugger debugger(emulator);
+    debugger.LoadInstrFromArray(program.data(), program.size(), PROGRAM_START);
+
+    // Zero page pointer at $10 for the indirect modes
+    uint8_t zeroPage[]{0x00, 0x03};
+    debugger.LoadInstrFromArray(zeroPage, 2, 0x0010);
+    // Pointer table for JMP ($xxxx)
+    std::vector<uint8_t> pointers;
+    for (size_t i = 1; i <= INSTRUCTIONS_PER_BLOCK; i++)
+    {
+        uint16_t target = PROGRAM_START + 3 * i;
+        pointers.push_back(target & 0xFF);
+        pointers.push_back(target >> 8);
+    }
+    debugger.LoadInstrFromArray(pointers.data(), pointers.size(), 0x0500);
+
+    uint64_t cycles = 0;
+    for (auto _ : state)
+    {
+        debugger.SetPC(PROGRAM_START);
+        uint64_t start = debugger.GetCpuState().cycleCount;
+        debugger.Continue();
+        cycles += debugger.GetCpuState().cycleCount - start;
+    }
+    state.SetItemsProcessed(state.iterations() * INSTRUCTIONS_PER_BLOCK);
+    state.counters["emulated_cycles"] = benchmark::Counter(cycles, benchmark::Counter::kIsRate);
+}
+
+// Read-modify-write instructions on RAM with the exact
+// (profile:0) and the fast (profile:1) accuracy profile
+void BM_ReadModifyWrite(benchmark::State& state)
+{
+    Emulator emulator;
+    Debugger debugger(emulator);
+    debugger.SetAccuracyProfile(state.range(0) ? CPU::FAST : CPU::EXACT);
+    // INC $10 ; ASL $0780 ; ROR $10,X ; DEC $0780,X
+    std::vector<uint8_t> program = RepeatInstruction({0xE6, 0x10, 0x0E, 0x80, 0x07, 0x76, 0x10, 0xDE, 0x80, 0x07});
+    debugger.LoadInstrFromArray(program.data(), program.size(), PROGRAM_START);
+    for (auto _ : state)
+    {
+        debugger.SetPC(PROGRAM_START);
+        debugger.Continue();
+    }
+    state.SetItemsProcessed(state.iterations() * INSTRUCTIONS_PER_BLOCK * 4);
+}
+/*
+ * Loop of 38 instructions with 36 different opcodes, counting its
+ * iterations in 0x00 and 0x01, run for whole frames. When they are
+ * drawn by the dot renderer, the PPU goes through its own data between
+ * two instructions, so the handlers don't stay in the L1 cache. Without
+ * drawing, the time is mostly spent in the CPU.
+ */
+const std::vector<uint8_t> MIX_PROGRAM{
+    0x78, 0xA2, 0x00,             // SEI ; LDX #0
+    0xE6, 0x00, 0xD0, 0x02,       // loop: INC $00 ; BNE +2
+    0xE6, 0x01,                   // INC $01
+    0xA9, 0x12, 0x65, 0x10,       // LDA #$12 ; ADC $10
+    0x85, 0x11, 0xA6, 0x11, 0xE8, // STA $11 ; LDX $11 ; INX
+    0x8E, 0x00, 0x03, 0xA0, 0x03, // STX $0300 ; LDY #$03
+    0x39, 0x00, 0x03, 0x11, 0x20, // AND $0300,Y ; ORA ($20),Y
+    0x55, 0x12, 0x0A, 0x26, 0x13, // EOR $12,X ; ASL A ; ROL $13
+    0x4E, 0x01, 0x03, 0x76, 0x14, // LSR $0301 ; ROR $14,X
+    0xC9, 0x40, 0xE4, 0x15,       // CMP #$40 ; CPX $15
+    0xC0, 0x02, 0xED, 0x02, 0x03, // CPY #$02 ; SBC $0302
+    0x24, 0x16, 0xE6, 0x17,       // BIT $16 ; INC $17
+    0xDE, 0x04, 0x03, 0x88,       // DEC $0304,X ; DEY
+    0xA8, 0x8A, 0x48, 0x68,       // TAY ; TXA ; PHA ; PLA
+    0x08, 0x28, 0x18, 0x38, 0xB8, // PHP ; PLP ; CLC ; SEC ; CLV
+    0x20, 0x49, 0x80, 0xEA,       // JSR sub ; NOP
+    0xD0, 0x00, 0x4C, 0x03, 0x80, // BNE +0 ; JMP loop
+    0x60,                         // sub: RTS
+};
+const uint64_t MIX_INSTRUCTIONS = 38;
+
+void BM_InstructionMix(benchmark::State& state)
+{
+    std::filesystem::path rom = WriteTestROM(MIX_PROGRAM, "nespp_bench_mix.nes");
+    Emulator emulator;
+    Debugger debugger(emulator);
+    emulator.LoadGame(rom.string());
+    std::filesystem::remove(rom);
+    const std::array<uint8_t, 2048>& RAM = debugger.GetMemoryState();
+    PerfCounters counters;
+    PerfCounters::Values values;
+    uint64_t misses = 0, instructions = 0;
+
+    for (auto _ : state)
+    {
+        uint16_t iterations = RAM[0x00] | (RAM[0x01] << 8);
+        counters.Start();
+        emulator.RunFrame(state.range(0) != 0);
+        counters.Stop();
+        values = counters.Read();
+        misses += values.count[PerfCounters::L1D_READ_MISSES];
+        instructions += (uint16_t)((RAM[0x00] | (RAM[0x01] << 8)) - iterations) * MIX_INSTRUCTIONS;
+    }
+    state.SetItemsProcessed(instructions);
+    if (values.available[PerfCounters::L1D_READ_MISSES])
+    {
+        state.counters["L1D misses/instruction"] = (double)misses / instructions;
+    }
+}
+} // namespace
+
+// INX
+BENCHMARK_CAPTURE(BM_Dispatch, Implied, RepeatInstruction({0xE8}));
+// ASL A
+BENCHMARK_CAPTURE(BM_Dispatch, Accumulator, RepeatInstruction({0x0A}));
+// LDA #$10
+BENCHMARK_CAPTURE(BM_Dispatch, Immediate, RepeatInstruction({0xA9, 0x10}));
+// LDA $10
+BENCHMARK_CAPTURE(BM_Dispatch, ZeroPage, RepeatInstruction({0xA5, 0x10}));
+// LDA $10,X
+BENCHMARK_CAPTURE(BM_Dispatch, ZeroPageX, RepeatInstruction({0xB5, 0x10}));
+// LDX $10,Y
+BENCHMARK_CAPTURE(BM_Dispatch, ZeroPageY, RepeatInstruction({0xB6, 0x10}));
+// LDA $0300
+BENCHMARK_CAPTURE(BM_Dispatch, Absolute, RepeatInstruction({0xAD, 0x00, 0x03}));
+// LDA $0300,X
+BENCHMARK_CAPTURE(BM_Dispatch, AbsoluteX, RepeatInstruction({0xBD, 0x00, 0x03}));
+// LDA $0300,Y
+BENCHMARK_CAPTURE(BM_Dispatch, AbsoluteY, RepeatInstruction({0xB9, 0x00, 0x03}));
+// LDA ($10,X)
+BENCHMARK_CAPTURE(BM_Dispatch, IndexedIndirect, RepeatInstruction({0xA1, 0x10}));
+// LDA ($10),Y
+BENCHMARK_CAPTURE(BM_Dispatch, IndirectIndexed, RepeatInstruction({0xB1, 0x10}));
+// BNE +0 (always taken)
+BENCHMARK_CAPTURE(BM_Dispatch, Relative, RepeatInstruction({0xD0, 0x00}));
+// JMP ($xxxx)
+BENCHMARK_CAPTURE(BM_Dispatch, Indirect, IndirectJumpChain(0x0500));
+// STA $0300
+BENCHMARK_CAPTURE(BM_Dispatch, AbsoluteWrite, RepeatInstruction({0x8D, 0x00, 0x03}));
+// INC $10
+BENCHMARK_CAPTURE(BM_Dispatch, ZeroPageReadModifyWrite, RepeatInstruction({0xE6, 0x10}));
+// PHA
+BENCHMARK_CAPTURE(BM_Dispatch, StackPush, RepeatInstruction({0x48}));
+
+BENCHMARK(BM_ReadModifyWrite)->ArgName("profile")->Arg(0)->Arg(1);
+
+BENCHMARK(BM_InstructionMix)->ArgName("draw")->Arg(1)->Arg(0);
@@ -0,0 +1,123 @@
+#include "NESpp/Debugger.h"
+#include "NESpp/Emulator.h"
+#include "TestROM.h"
+#include "benchmark/benchmark.h"
+#include <filesystem>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace
+{
+// One instruction for every addressing mode, repeated
+const uint8_t MIXED_INSTRUCTIONS[]{
+    0xE8,             // INX
+    0x0A,             // ASL A
+    0xA9, 0x10,       // LDA #$10
+    0xA5, 0x10,       // LDA $10
+    0xB5, 0x10,       // LDA $10,X
+    0xB6, 0x10,       // LDX $10,Y
+    0xAD, 0x00, 0x03, // LDA $0300
+    0xBD, 0x00, 0x03, // LDA $0300,X
+    0xB9, 0x00, 0x03, // LDA $0300,Y
+    0xA1, 0x10,       // LDA ($10,X)
+    0xB1, 0x10,       // LDA ($10),Y
+    0xD0, 0x00,       // BNE +0
+    0x6C, 0x00, 0x05, // JMP ($0500)
+};
+const size_t MIXED_INSTRUCTIONS_LENGTH[]{1, 1, 2, 2, 2, 2, 3, 3, 3, 2, 2, 2, 3};
+const size_t MIXED_INSTRUCTIONS_NUMBER = std::size(MIXED_INSTRUCTIONS_LENGTH);
+const size_t REPETITIONS = 16;
+
+void BM_Disassembly(benchmark::State& state)
+{
+    Emulator emulator;
+    Debugger debugger(emulator);
+    std::vector<uint8_t> program;
+    for (size_t i = 0; i < REPETITIONS; i++)
+    {
+        program.insert(program.end(), std::begin(MIXED_INSTRUCTIONS), std::end(MIXED_INSTRUCTIONS));
+    }
+    debugger.LoadInstrFromArray(program.data(), program.size(), 0x0200);
+
+    std::vector<std::string> output(MIXED_INSTRUCTIONS_NUMBER * REPETITIONS);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(debugger.Disassembly(output.data(), 0x0200, program.size()));
+    }
+    state.SetItemsProcessed(state.iterations() * output.size());
+}
+
+void BM_FormatTraceLine(benchmark::State& state)
+{
+    Emulator emulator;
+    Debugger debugger(emulator);
+    debugger.LoadInstrFromArray(MIXED_INSTRUCTIONS, sizeof(MIXED_INSTRUCTIONS), 0x0200);
+
+    // Cycles through the instructions without executing them
+    std::vector<uint16_t> addresses;
+    uint16_t address = 0x0200;
+    for (size_t length : MIXED_INSTRUCTIONS_LENGTH)
+    {
+        addresses.push_back(address);
+        address += length;
+    }
+    size_t next = 0;
+    for (auto _ : state)
+    {
+        debugger.SetPC(addresses[next]);
+        benchmark::DoNotOptimize(debugger.FormatTraceLine());
+        next = (next + 1) % addresses.size();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Nested subroutines called in a loop, interrupted by the NMI, ending on BRK;
+// the stack pointer is reset to its power on value on every run
+const std::vector<uint8_t> CALLS_PROGRAM{
+    0xA2, 0xFD,       // 8000: LDX #$FD
+    0x9A,             // 8002: TXS
+    0xA2, 0x00,       // 8003: LDX #$00
+    0xA9, 0x80,       // 8005: LDA #$80
+    0x8D, 0x00, 0x20, // 8007: STA $2000
+    0xA0, 0x08,       // 800A: LDY #$08
+    0x20, 0x17, 0x80, // 800C: loop: JSR $8017
+    0xCA,             // 800F: DEX
+    0xD0, 0xFA,       // 8010: BNE loop
+    0x88,             // 8012: DEY
+    0xD0, 0xF7,       // 8013: BNE loop
+    0x00, 0x00,       // 8015: BRK
+    0x20, 0x1B, 0x80, // 8017: JSR $801B
+    0x60,             // 801A: RTS
+    0xE8, 0xCA, 0x60, // 801B: INX ; DEX ; RTS
+    0xE6, 0x10,       // 801E: NMI: INC $10
+    0x40,             // 8020: RTI
+};
+
+// The same program run with and without the profiler, whose
+// overhead should stay below 2x
+void BM_ProfiledRun(benchmark::State& state)
+{
+    Emulator emulator;
+    Debugger debugger(emulator);
+    std::filesystem::path rom = WriteTestROM(CALLS_PROGRAM, "nespp_bench_profiler.nes", {}, 0x801E);
+    debugger.LoadROM(rom.string());
+    std::filesystem::remove(rom);
+    if (state.range(0))
+    {
+        debugger.StartProfiling();
+    }
+    uint64_t startingCycle = debugger.GetClock().GetCpuCycles();
+
+    for (auto _ : state)
+    {
+        debugger.SetPC(0x8000);
+        debugger.Continue();
+    }
+    state.SetItemsProcessed(debugger.GetClock().GetCpuCycles() - startingCycle);
+}
+} // namespace
+
+BENCHMARK(BM_Disassembly);
+BENCHMARK(BM_FormatTraceLine);
+BENCHMARK(BM_ProfiledRun)->ArgName("profile")->Arg(0)->Arg(1);
@@ -0,0 +1,43 @@
+#include "NESpp/Emulator.h"
+#include "TestROM.h"
+#include "benchmark/benchmark.h"
+#include <vector>
+
+/*
+ * Whole frames of a game that waits for the VBlank polling PPUSTATUS,
+ * then for the NMI polling a counter in RAM, with the iterations of
+ * these loops executed (skip:0) or skipped (skip:1). The frames are
+ * not drawn, so that the time is mostly spent in the CPU.
+ */
+
+namespace
+{
+const std::vector<uint8_t> WAITING_PROGRAM{
+    0x2C, 0x02, 0x20, 0x10, 0xFB, // 8000: wait: BIT $2002 ; BPL wait
+    0xA9, 0x80, 0x8D, 0x00, 0x20, // 8005: PPUCTRL: NMI enabled
+    0xA5, 0x10, 0xC5, 0x10,       // 800A: frame: LDA $10 ; nmi: CMP $10
+    0xF0, 0xFC,                   // 800E: BEQ nmi
+    0x2C, 0x02, 0x20, 0x10, 0xFB, // 8010: vblank: BIT $2002 ; BPL vblank
+    0x4C, 0x0A, 0x80,             // 8015: JMP frame
+    0xE6, 0x10, 0x40,             // 8018: NMI: INC $10 ; RTI
+};
+
+void BM_IdleFrame(benchmark::State& state)
+{
+    std::filesystem::path rom = WriteTestROM(WAITING_PROGRAM, "nespp_bench_idle.nes", {}, 0x8018);
+    Emulator emulator;
+    emulator.LoadGame(rom.string());
+    std::filesystem::remove(rom);
+    emulator.SetRenderMode(PPU::SCANLINE);
+    emulator.SetAudioMode(APU::TURBO);
+    emulator.SetIdleLoopSkipping(state.range(0) != 0);
+
+    for (auto _ : state)
+    {
+        emulator.RunFrame(false);
+    }
+    state.counters["frames"] = benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate);
+}
+} // namespace
+
+BENCHMARK(BM_IdleFrame)->ArgName("skip")->Arg(0)->Arg(1);
@@ -0,0 +1,69 @@
+#include "Cartridge.h"
+#include "NESpp/Debugger.h"
+#include "NESpp/Emulator.h"
+#include "benchmark/benchmark.h"
+#include <array>
+#include <vector>
+
+/*
+ * Whole frames with the background and the 64 sprites enabled,
+ * drawn by the dot renderer (mode:0) and by the scanline renderer
+ * (mode:1), or emulated without drawing (draw:0). The CPU only runs
+ * an idle loop, so the registers are never accessed during a frame.
+ * Decoding the tiles of 8KiB of CHR ROM, as done when a ROM is loaded.
+ */
+
+namespace
+{
+void BM_RenderFrame(benchmark::State& state)
+{
+    Emulator emulator;
+    Debugger debugger(emulator);
+    emulator.SetRenderMode(state.range(0) ? PPU::SCANLINE : PPU::DOT);
+
+    std::array<uint8_t, 256> sprites;
+    for (size_t i = 0; i < 64; i++)
+    {
+        sprites[i * 4] = i * 3;
+        sprites[i * 4 + 1] = i;
+        sprites[i * 4 + 2] = i & 0x03;
+        sprites[i * 4 + 3] = i * 4;
+    }
+    debugger.LoadInstrFromArray(sprites.data(), sprites.size(), 0x0200);
+
+    uint8_t program[]{
+        0xA9, 0x02,       // 0700: LDA #$02
+        0x8D, 0x14, 0x40, // 0702: STA $4014
+        0xA9, 0x1E,       // 0705: LDA #$1E
+        0x8D, 0x01, 0x20, // 0707: STA $2001
+        0x4C, 0x0A, 0x07, // 070A: JMP $070A
+    };
+    debugger.LoadInstrFromArray(program, sizeof(program));
+    debugger.SetPC(0x0700);
+
+    for (auto _ : state)
+    {
+        emulator.RunFrame(state.range(1) != 0);
+    }
+    state.counters["frames"] = benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate);
+}
+
+void BM_DecodeTiles(benchmark::State& state)
+{
+    std::vector<uint8_t> tiles(8192);
+    for (size_t i = 0; i < tiles.size(); i++)
+    {
+        tiles[i] = i * 37;
+    }
+    std::vector<uint8_t> pixels(tiles.size() * 4);
+    for (auto _ : state)
+    {
+        Cartridge::DecodeTiles(tiles.data(), tiles.size() / 16, pixels.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * tiles.size() / 16);
+}
+} // namespace
+
+BENCHMARK(BM_RenderFrame)->ArgNames({"mode", "draw"})->Args({0, 1})->Args({1, 1})->Args({0, 0});
+BENCHMARK(BM_DecodeTiles);
@@ -0,0 +1,34 @@
+#include "NESpp/Palette.h"
+#include "benchmark/benchmark.h"
+#include <vector>
+
+/*
+ * Conversion of a whole frame to each host format, with and
+ * without SIMD; the frame contains every possible pixel value.
+ */
+
+namespace
+{
+void BM_ConvertFrame(benchmark::State& state, Palette::Format format)
+{
+    Palette palette(format);
+    palette.EnableSIMD(state.range(0));
+    FrameBuffer frame;
+    for (size_t i = 0; i < frame.size(); i++)
+    {
+        frame[i] = (i * 7) % 512;
+    }
+    size_t pitch = FRAME_WIDTH * palette.GetBytesPerPixel();
+    std::vector<uint8_t> surface(pitch * FRAME_HEIGHT);
+    for (auto _ : state)
+    {
+        palette.ConvertFrame(frame, surface.data(), pitch);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * frame.size());
+}
+} // namespace
+
+BENCHMARK_CAPTURE(BM_ConvertFrame, RGBA8888, Palette::RGBA8888)->ArgName("simd")->Arg(0)->Arg(1);
+BENCHMARK_CAPTURE(BM_ConvertFrame, BGRA8888, Palette::BGRA8888)->ArgName("simd")->Arg(0)->Arg(1);
+BENCHMARK_CAPTURE(BM_ConvertFrame, RGB565, Palette::RGB565)->ArgName("simd")->Arg(0)->Arg(1);
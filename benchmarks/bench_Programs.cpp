@@ -0,0 +1,84 @@
+#include "NESpp/Debugger.h"
+#include "NESpp/Emulator.h"
+#include "benchmark/benchmark.h"
+#include <vector>
+
+/*
+ * Macrobenchmarks: small fixed programs that loop forever,
+ * each iteration runs exactly one frame worth of CPU cycles
+ * (ExecuteInstrFromArray stops at CYCLES_PER_FRAME).
+ * Each one runs with the plain interpreter and with the
+ * block cache (block_cache:0 and block_cache:1).
+ */
+
+namespace
+{
+void BM_Program(benchmark::State& state, std::vector<uint8_t> program)
+{
+    Emulator emulator;
+    Debugger debugger(emulator);
+    debugger.EnableBlockCache(state.range(0) != 0);
+    uint64_t cycles = 0;
+    for (auto _ : state)
+    {
+        Debugger::CpuState cpuState = debugger.ExecuteInstrFromArray(program.data(), program.size());
+        cycles += cpuState.cycleCount;
+    }
+    state.counters["frames"] = benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate);
+    state.counters["emulated_cycles"] = benchmark::Counter(cycles, benchmark::Counter::kIsRate);
+}
+} // namespace
+
+// Clears two pages of RAM
+BENCHMARK_CAPTURE(BM_Program, ClearMemory,
+                  std::vector<uint8_t>{
+                      0xA9, 0x00,       // 0700: LDA #$00
+                      0xA2, 0x00,       // 0702: LDX #$00
+                      0x9D, 0x00, 0x02, // 0704: STA $0200,X
+                      0x9D, 0x00, 0x03, // 0707: STA $0300,X
+                      0xE8,             // 070A: INX
+                      0xD0, 0xF7,       // 070B: BNE $0704
+                      0x4C, 0x00, 0x07, // 070D: JMP $0700
+                  })->ArgName("block_cache")->Arg(0)->Arg(1);
+
+// Adds up a page of RAM
+BENCHMARK_CAPTURE(BM_Program, Checksum,
+                  std::vector<uint8_t>{
+                      0xA0, 0x00,       // 0700: LDY #$00
+                      0xA9, 0x00,       // 0702: LDA #$00
+                      0x18,             // 0704: CLC
+                      0x79, 0x00, 0x02, // 0705: ADC $0200,Y
+                      0xC8,             // 0708: INY
+                      0xD0, 0xFA,       // 0709: BNE $0705
+                      0x85, 0x10,       // 070B: STA $10
+                      0x4C, 0x00, 0x07, // 070D: JMP $0700
+                  })->ArgName("block_cache")->Arg(0)->Arg(1);
+
+// 8x8 bit shift and add multiplication, heavy on flags
+BENCHMARK_CAPTURE(BM_Program, Multiply,
+                  std::vector<uint8_t>{
+                      0xA9, 0xD7,       // 0700: LDA #$D7
+                      0x85, 0x10,       // 0702: STA $10
+                      0xA9, 0x5B,       // 0704: LDA #$5B
+                      0x85, 0x11,       // 0706: STA $11
+                      0xA9, 0x00,       // 0708: LDA #$00
+                      0xA2, 0x08,       // 070A: LDX #$08
+                      0x46, 0x11,       // 070C: LSR $11
+                      0x90, 0x03,       // 070E: BCC $0713
+                      0x18,             // 0710: CLC
+                      0x65, 0x10,       // 0711: ADC $10
+                      0x6A,             // 0713: ROR A
+                      0x66, 0x12,       // 0714: ROR $12
+                      0xCA,             // 0716: DEX
+                      0xD0, 0xF3,       // 0717: BNE $070C
+                      0x4C, 0x00, 0x07, // 0719: JMP $0700
+                  })->ArgName("block_cache")->Arg(0)->Arg(1);
+
+// Subroutine calls
+BENCHMARK_CAPTURE(BM_Program, Subroutines,
+                  std::vector<uint8_t>{
+                      0x20, 0x06, 0x07, // 0700: JSR $0706
+                      0x4C, 0x00, 0x07, // 0703: JMP $0700
+                      0xE8,             // 0706: INX
+                      0x60,             // 0707: RTS
+                  })->ArgName("block_cache")->Arg(0)->Arg(1);
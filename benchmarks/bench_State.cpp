@@ -0,0 +1,53 @@
+#include "NESpp/Emulator.h"
+#include "TestROM.h"
+#include "benchmark/benchmark.h"
+#include <memory>
+#include <vector>
+
+/*
+ * Saving and restoring the whole state of the console, as done by the
+ * rollback sessions every frame, and hashing and comparing saved states,
+ * as done when checking that two machines are in sync.
+ */
+
+namespace
+{
+void BM_SaveLoadState(benchmark::State& state)
+{
+    std::filesystem::path rom = WriteTestROM({0x4C, 0x00, 0x80}, "nespp_bench_state.nes");
+    Emulator emulator;
+    emulator.LoadGame(rom.string());
+    std::filesystem::remove(rom);
+    emulator.RunFrame();
+    auto saved = std::make_unique<NES::State>();
+
+    for (auto _ : state)
+    {
+        emulator.SaveState(*saved);
+        emulator.LoadState(*saved);
+    }
+    state.SetBytesProcessed(state.iterations() * sizeof(NES::State) * 2);
+}
+
+void BM_CompareStates(benchmark::State& state)
+{
+    std::filesystem::path rom = WriteTestROM({0x4C, 0x00, 0x80}, "nespp_bench_state.nes");
+    Emulator emulator;
+    emulator.LoadGame(rom.string());
+    std::filesystem::remove(rom);
+    emulator.RunFrame();
+    auto first = std::make_unique<NES::State>();
+    emulator.SaveState(*first);
+    auto second = std::make_unique<NES::State>(*first);
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(NES::GetStateHash(*first));
+        benchmark::DoNotOptimize(NES::FindStateDifference(*first, *second));
+    }
+    state.SetBytesProcessed(state.iterations() * sizeof(NES::State) * 3);
+}
+} // namespace
+
+BENCHMARK(BM_SaveLoadState);
+BENCHMARK(BM_CompareStates);
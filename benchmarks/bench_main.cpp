@@ -0,0 +1,28 @@
+#include "benchmark/benchmark.h"
+
+/*
+ * Run with --benchmark_out=<file> --benchmark_out_format=json
+ * (or build the benchmark_json target) to get results that
+ * can be compared across commits, e.g. with compare.py from
+ * the Google Benchmark tools.
+ */
+
+int main(int argc, char** argv)
+{
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    {
+        return 1;
+    }
+    benchmark::AddCustomContext("nespp_commit", NESPP_GIT_COMMIT);
+    // Build configurations that change the CPU core, to
+    // compare results of different builds of the same commit
+#ifdef NESPP_LAZY_FLAGS
+    benchmark::AddCustomContext("nespp_flags", "lazy");
+#else
+    benchmark::AddCustomContext("nespp_flags", "eager");
+#endif
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,107 @@
+#ifndef CAPTURESINK_H
+#define CAPTURESINK_H
+
+#include "APU.h"
+#include "FrameBuffer.h"
+#include "MasterClock.h"
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Records the pictures and the sound of the emulated frames: the
+ * video to a YUV4MPEG2 (Y4M) file, in 4:4:4 so that every pixel
+ * keeps its color, and the audio to a 16 bit mono WAV file.
+ * The emulation thread only copies each frame and its samples into
+ * a bounded queue; the conversion and the disk I/O are done by a
+ * writer thread. When the queue is full, the policy decides:
+ * - BLOCK: waits until the writer has made room, nothing is lost
+ *   and the emulation is slowed down to the speed of the disk
+ * - DROP_NEWEST: the frame being pushed is discarded
+ * - DROP_OLDEST: the oldest frame in the queue is discarded
+ * Frames are dropped together with their samples, so that the
+ * video and the audio stay in sync.
+ */
+
+class CaptureSink
+{
+public:
+    enum Policy
+    {
+        BLOCK,
+        DROP_NEWEST,
+        DROP_OLDEST
+    };
+
+    // An empty path disables the stream. The frame rate is the one of the
+    // region. Throws std::runtime_error if a file can't be created
+    CaptureSink(const std::filesystem::path& videoPath, const std::filesystem::path& audioPath,
+                MasterClock::Region region = MasterClock::NTSC, Policy policy = DROP_NEWEST, size_t capacity = 8);
+    // Closes the files, without reporting errors
+    ~CaptureSink();
+    CaptureSink(const CaptureSink&) = delete;
+    CaptureSink& operator=(const CaptureSink&) = delete;
+
+    // Queues a frame and the samples produced with it, false if it was
+    // dropped. Frames are pushed by a single thread, the emulation one
+    bool Push(const FrameBuffer& frame, const std::vector<int16_t>& samples);
+
+    // Writes the queued frames, completes the files and stops the writer.
+    // Throws std::runtime_error if anything couldn't be written
+    void Close();
+
+    // Frames waiting to be written: producers can slow down, or skip
+    // frames themselves, before the queue is full
+    size_t GetQueuedFrames() const;
+
+    struct Stats
+    {
+        uint64_t framesPushed;
+        uint64_t framesWritten;
+        uint64_t framesDropped;
+        uint64_t samplesWritten;
+    };
+    Stats GetStats() const;
+
+private:
+    struct Entry
+    {
+        FrameBuffer pixels;
+        std::vector<int16_t> samples;
+    };
+
+    void Run();
+    void WriteVideo(const FrameBuffer& pixels);
+    void WriteAudio(const std::vector<int16_t>& samples);
+    // Sizes in the WAV header, known once the file is complete
+    void CompleteAudio();
+
+    Policy policy;
+    size_t capacity;
+
+    std::ofstream video, audio;
+    // Y, U and V of the 512 possible pixels
+    std::array<std::array<uint8_t, 3>, 512> colors;
+    std::vector<uint8_t> planes;
+    uint64_t audioBytes = 0;
+
+    std::thread writer;
+    mutable std::mutex mutex;
+    std::condition_variable signal;
+    bool closing = false;
+    std::deque<std::unique_ptr<Entry>> queue;
+    // Entries already written, reused to avoid allocating every frame
+    std::vector<std::unique_ptr<Entry>> pool;
+    Stats stats{};
+    std::string error;
+};
+
+#endif // CAPTURESINK_H
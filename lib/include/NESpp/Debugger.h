@@ -2,6 +2,7 @@
 #define DEBUGGER_H
 
 #include "EmulatorCore.h"
+#include <functional>
 #include <vector>
 
 /*
@@ -28,11 +29,88 @@ public:
 
     void SetPC(uint16_t address);
 
+    // The master clock keeps counting across resets and program loads
+    const MasterClock& GetClock() const;
+    void SetRegion(MasterClock::Region region);
+
+    // Runs the CPU from the cache of pre-decoded basic blocks,
+    // which is bypassed while there are breakpoints
+    void EnableBlockCache(bool enable);
+
+    // Dummy accesses to RAM and ROM are skipped by the FAST profile,
+    // which write breakpoints can observe
+    void SetAccuracyProfile(CPU::AccuracyProfile profile);
+
+    // Cycles of idle loops skipped by RunFrame, see IdleLoops.h
+    uint64_t GetSkippedIdleCycles() const;
+
     bool LoadROM(const std::string& pathToROM);
 
-    // Dumps log of executed instructions at the given path
+    // Dumps log of executed instructions at the given path,
+    // stops at BRK, illegal opcodes or when a breakpoint triggers
     void RunWithTrace(const std::filesystem::path& output = "emulatorLog.txt");
 
+    // Disassembly and CPU state for the instruction about to be executed,
+    // formatted as a line of the trace log
+    std::string FormatTraceLine();
+
+    // Breakpoints trigger on execution, reads and/or writes (a mask of
+    // Breakpoints::AccessType) of any address in [start, end]. An optional
+    // condition such as "A==0x10 && X>3" turns them into conditional
+    // watchpoints. Returns an id that can be used to remove the breakpoint
+    int AddBreakpoint(uint8_t type, uint16_t start, uint16_t end, const std::string& condition = "");
+    int AddBreakpoint(uint8_t type, uint16_t address, const std::string& condition = "");
+    bool RemoveBreakpoint(int id);
+    void ClearBreakpoints();
+
+    // Executes a single instruction, returns true if a breakpoint triggered
+    bool Step();
+
+    // Runs until a breakpoint triggers or a BRK or illegal opcode is
+    // executed. Returns true if execution was stopped by a breakpoint
+    bool Continue();
+
+    // Describes the breakpoint that stopped the last Step, Continue or RunWithTrace
+    Breakpoints::Hit GetLastBreakpointHit() const;
+
+    // While profiling, every instruction executed through Step, Continue
+    // or RunWithTrace is counted per PC and per PRG bank, and its cycles
+    // are attributed to the subroutines on the JSR/RTS call stack.
+    // Starting again discards the previous results
+    void StartProfiling();
+    void StopProfiling();
+    // Null if the profiler is not running
+    const Profiler* GetProfiler() const;
+
+    // Writes the <number> hottest instructions and subroutines and the time spent in each bank
+    void WriteProfilerReport(const std::filesystem::path& output = "profile.txt", size_t number = 20);
+    // Writes the call stacks in the folded format used by flamegraph.pl
+    void WriteFoldedStacks(const std::filesystem::path& output = "profile.folded");
+
+    struct PerfReport
+    {
+        PerfCounters::Values host;
+        uint64_t emulatedCycles;
+        // Bus and instruction counters are only available
+        // when built with NESpp_ENABLE_INSTRUMENTATION
+        bool busCountersEnabled;
+        BusCounters bus;
+    };
+
+    // Runs the CPU at full speed like CPU::Run (until BRK or an illegal
+    // opcode) while reading the host hardware performance counters
+    PerfReport RunInstrumented();
+
+    // Emulates a whole frame like Emulator::RunFrame, the way games are
+    // run, while reading the counters: one report per frame
+    PerfReport RunFrameInstrumented(bool draw = true);
+
+    // Same as ExecuteInstrFromArray (runs at most one frame), measured
+    PerfReport ExecuteInstrumented(const uint8_t* instructions, size_t number, uint16_t startingLocation = 0x0700);
+
+    // Summary of a report, with the host cost of each emulated cycle
+    static std::string FormatPerfReport(const PerfReport& report);
+
     // Outputs the disassembled instructions in outputArray and returns their number
     size_t Disassembly(std::string* outputArray, uint16_t startingAddress, size_t number);
 
@@ -41,17 +119,66 @@ public:
         uint8_t SP, A, X, Y;
         BitMappedRegister<CPU::CpuStatusFlags> PS;
         uint16_t PC;
-        uint32_t cycleCount;
+        // CPU cycles since power on
+        uint64_t cycleCount;
     };
     CpuState GetCpuState() const;
 
     // Loads and directly executes the whole sequence of instructions in the given array
+    // (at most one frame), the returned cycleCount is the number of cycles it took
     CpuState ExecuteInstrFromArray(const uint8_t* instructions, size_t number, uint16_t startingLocation = 0x0700);
 
     const std::array<uint8_t, 2048>& GetMemoryState() const;
+    // FNV-1a hash of the RAM
+    uint64_t GetMemoryHash() const;
+    // Any range of the address space, read without side effects
+    std::vector<uint8_t> GetMemoryRange(uint16_t address, size_t length) const;
+    const std::array<uint8_t, 256>& GetOAM() const;
     const std::vector<uint8_t>& GetPRG_ROM() const;
 
+    // How often RunLockstep compares the two emulators
+    enum LockstepGranularity
+    {
+        INSTRUCTION,
+        FRAME
+    };
+
+    struct LockstepResult
+    {
+        bool diverged;
+        // Instructions executed by this debugger
+        uint64_t instructions;
+        // Last instruction executed before the comparison that failed
+        uint16_t PC;
+        std::string disassembly;
+        CpuState state, referenceState;
+        bool memoryDiverged;
+        // First RAM address with different contents
+        uint16_t address;
+    };
+
+    // Runs this emulator and the reference one side by side, comparing
+    // CPU state and RAM hash after every instruction or every frame (of
+    // this emulator), until they diverge, BRK or an illegal opcode is
+    // executed or the given number of instructions is reached.
+    // Both must be loaded with the same program and state beforehand,
+    // usually with a different execution engine (e.g. the block cache).
+    // When a step runs several instructions at once (compiled code),
+    // the other emulator is stepped until they reach the same cycle
+    LockstepResult RunLockstep(Debugger& reference, uint64_t maxInstructions,
+                               LockstepGranularity granularity = INSTRUCTION);
+    static std::string FormatLockstepResult(const LockstepResult& result);
+
 private:
+    bool BreakpointTriggered() const;
+
+    // Executes the next instruction, feeding the profiler if it's running
+    void StepInstruction();
+
+    // Runs the given function between reads of all the counters,
+    // the function returns the number of emulated cycles
+    PerfReport Measure(const std::function<uint64_t()>& run);
+
     std::vector<CPU::Instruction> instructions;
 };
 
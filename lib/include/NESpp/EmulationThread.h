@@ -0,0 +1,110 @@
+#ifndef EMULATIONTHREAD_H
+#define EMULATIONTHREAD_H
+
+#include "EmulatorCore.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/*
+ * Runs the emulator on its own thread, one frame at a time, at
+ * the frame rate of the console (60.0988 Hz on NTSC). Frames can
+ * be paced by the wall clock, by the display (the frontend calls
+ * NotifyVSync on each refresh) or by the audio device (the frontend
+ * reports the audio it consumed and the thread keeps a given amount
+ * queued). The speed can be lowered for slow motion, or pacing can
+ * be ignored altogether to fast forward.
+ * Everything but the frame callback is called from other threads;
+ * the callback runs on the emulation thread after each frame, and
+ * is where frontends publish the frame.
+ */
+
+class EmulationThread : public EmulatorCore
+{
+public:
+    enum Pacing
+    {
+        WALL_CLOCK,
+        VSYNC,
+        AUDIO
+    };
+
+    EmulationThread(const EmulatorCore& other);
+    ~EmulationThread();
+    EmulationThread(const EmulationThread&) = delete;
+    EmulationThread& operator=(const EmulationThread&) = delete;
+
+    // Can only be changed while the thread is not running
+    void SetFrameCallback(std::function<void()> callback);
+
+    void Start();
+    // Returns after the frame being emulated, if any, is complete
+    void Stop();
+    bool IsRunning() const { return thread.joinable(); }
+
+    void SetPacing(Pacing mode);
+    // Relative to the console, below 1 for slow motion; throws
+    // std::invalid_argument unless it is positive
+    void SetSpeed(double speed);
+    // Runs frames back to back, ignoring the pacing
+    void SetFastForward(bool enable);
+
+    // VSYNC pacing: a frame is emulated for each display refresh
+    void NotifyVSync();
+    // AUDIO pacing: each frame produces its duration of audio, frames are
+    // emulated as long as less than <latency> seconds of it are queued
+    void NotifyAudioConsumed(double seconds);
+    void SetAudioLatency(double latency);
+
+    // Applied at the start of the next frame
+    void SetButtons(size_t port, uint8_t pressed) { buttons[port] = pressed; }
+
+    struct Timing
+    {
+        uint64_t frames;
+        // Seconds, the period is the time between the start of two paced frames
+        double targetPeriod;
+        double meanPeriod;
+        // Standard deviation of the period
+        double jitter;
+        double maxDeviation;
+        // Time spent emulating, on average
+        double meanFrameTime;
+    };
+    Timing GetTiming() const;
+    void ResetTiming();
+
+private:
+    void Run();
+    // Waits until the pacing allows another frame, false if stopping
+    bool WaitForFrame(std::unique_lock<std::mutex>& lock, std::chrono::steady_clock::time_point deadline);
+    // Intervals are only recorded between paced frames, with their expected length
+    void RecordFrame(double frameTime, double interval, double expected);
+
+    std::thread thread;
+    mutable std::mutex mutex;
+    std::condition_variable signal;
+    bool stopping = false;
+
+    std::function<void()> frameCallback;
+    Pacing pacing = WALL_CLOCK;
+    double speed = 1.0;
+    bool fastForward = false;
+    // Display refreshes not used yet, fractional with slow motion
+    double vsyncCredit = 0;
+    double audioQueued = 0;
+    double audioLatency = 0.05;
+
+    std::array<std::atomic<uint8_t>, 2> buttons{};
+
+    Timing timing{};
+    uint64_t intervals = 0;
+    // Sum of the squared differences from the mean period (Welford)
+    double periodSquares = 0;
+};
+
+#endif // EMULATIONTHREAD_H
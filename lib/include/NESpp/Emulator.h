@@ -1,6 +1,7 @@
 #ifndef EMULATOR_H
 #define EMULATOR_H
 
+#include "CaptureSink.h"
 #include "EmulatorCore.h"
 
 /*
@@ -16,6 +17,59 @@ public:
     ~Emulator() = default;
 
     void Start() { core->ResetRAM(); }
+
+    bool LoadGame(const std::string& pathToROM) { return core->LoadGame(pathToROM); }
+
+    // Buttons pressed on the controller in the given port (0 or 1),
+    // as a mask of Controller::Button values
+    void SetButtons(size_t port, uint8_t buttons) { core->GetController(port).SetButtons(buttons); }
+
+    // Frames that are not drawn run faster, headless clients can
+    // draw only the ones they look at
+    void RunFrame(bool draw = true)
+    {
+        core->RunFrame(draw);
+        if (capture)
+        {
+            capture->Push(core->GetFrameBuffer(), core->GetAudioSamples());
+        }
+    }
+
+    // Every frame emulated from now on is recorded by the sink, which
+    // must outlive the capture; nullptr stops capturing. Frames that are
+    // not drawn repeat the last picture
+    void SetCaptureSink(CaptureSink* sink) { capture = sink; }
+
+    // The scanline renderer is faster, the dot renderer is the reference
+    void SetRenderMode(PPU::RenderMode mode) { core->SetRenderMode(mode); }
+
+    // FAST skips the dummy accesses to RAM and ROM (see CPU.h),
+    // EXACT is the reference
+    void SetAccuracyProfile(CPU::AccuracyProfile profile) { core->SetAccuracyProfile(profile); }
+
+    // TURBO skips the synthesis of the sound, for headless clients: the
+    // games run the same, only the samples are missing
+    void SetAudioMode(APU::AudioMode mode) { core->SetAudioMode(mode); }
+
+    // Iterations of the loops waiting for the VBlank or an interrupt are
+    // skipped, with the same result; disabling it helps verifying that
+    void SetIdleLoopSkipping(bool enable) { core->SetIdleLoopSkipping(enable); }
+
+    // Snapshot of everything the game can change, a plain block
+    // of bytes (see NES::State) restored as it was saved
+    void SaveState(NES::State& state) { core->SaveState(state); }
+    void LoadState(const NES::State& state) { core->LoadState(state); }
+
+    // Mono samples at APU::SAMPLE_RATE produced by the last frame
+    const std::vector<int16_t>& GetAudioSamples() const { return core->GetAudioSamples(); }
+
+    // Pixels of the last frame, to be converted with a Palette
+    const FrameBuffer& GetFrameBuffer() const { return core->GetFrameBuffer(); }
+    // The following frames are drawn into the given buffer
+    void SetFrameBuffer(FrameBuffer& target) { core->SetFrameBuffer(target); }
+
+private:
+    CaptureSink* capture = nullptr;
 };
 
 #endif // EMULATOR_H
\ No newline at end of file
@@ -0,0 +1,78 @@
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include "EmulatorCore.h"
+#include <array>
+#include <filesystem>
+#include <vector>
+
+/*
+ * Deterministic recording and playback of the input of the
+ * controllers, one entry per frame. A movie always starts
+ * from a power on of the console (with the RAM filled from
+ * a seed) with the game that was loaded when it was recorded.
+ * Every <checkpointInterval> frames the hash of the RAM and of
+ * the picture is saved, so that playback can tell where it
+ * stopped matching the recording. Playback has no pacing: frames
+ * are emulated back to back, as fast as the host allows, and only
+ * the frames of the checkpoints are drawn.
+ */
+
+class Movie : public EmulatorCore
+{
+public:
+    // The movie drives the given emulator core, which must
+    // already have the game loaded
+    Movie(const EmulatorCore& other);
+    ~Movie() = default;
+
+    // Discards the current movie, powers on the console
+    // and starts recording from the first frame
+    void StartRecording(uint32_t seed = 0, uint32_t checkpointInterval = 60);
+
+    // Emulates a frame with the given buttons pressed on the two
+    // controllers (masks of Controller::Button) and records it
+    void RecordFrame(uint8_t port1, uint8_t port2 = 0);
+
+    struct PlaybackResult
+    {
+        bool desynced;
+        uint64_t framesPlayed;
+        // First checkpoint that didn't match the recording
+        uint64_t frame;
+        uint64_t expectedHash, hash;
+    };
+
+    // Powers on the console and plays back the whole movie, stopping at
+    // the first checkpoint that doesn't match. Throws std::runtime_error
+    // if the loaded game isn't the one the movie was recorded with
+    PlaybackResult Play();
+
+    uint64_t GetFrameCount() const { return input.size(); }
+
+    // Both throw std::runtime_error when the file can't be accessed
+    // or, when loading, if it isn't a valid movie
+    void Save(const std::filesystem::path& path) const;
+    void Load(const std::filesystem::path& path);
+
+private:
+    struct Checkpoint
+    {
+        // Frames emulated when the hash was taken
+        uint64_t frame;
+        uint64_t hash;
+    };
+
+    void PowerOn();
+    uint64_t GetCheckpointHash() const;
+
+    uint32_t seed = 0;
+    uint32_t checkpointInterval = 60;
+    MasterClock::Region region = MasterClock::NTSC;
+    // Identifies the game the movie was recorded with
+    uint64_t romHash = 0;
+    std::vector<std::array<uint8_t, 2>> input;
+    std::vector<Checkpoint> checkpoints;
+};
+
+#endif // MOVIE_H
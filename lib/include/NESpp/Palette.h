@@ -0,0 +1,53 @@
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#include "FrameBuffer.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Converts the pixels of the frame buffer (palette indices and
+ * emphasis bits) to one of the formats used by frontends, with
+ * a lookup table of all the 512 possible values. On x86-64 hosts
+ * with AVX2 eight pixels are converted at a time with gathers
+ * from the table. Formats are named by the order of their bytes
+ * in memory: RGBA8888 is QImage::Format_RGBA8888, BGRA8888 is
+ * QImage::Format_ARGB32 on little endian hosts and RGB565 pixels
+ * are 16 bit values in host byte order.
+ */
+
+class Palette
+{
+public:
+    enum Format
+    {
+        RGBA8888,
+        BGRA8888,
+        RGB565
+    };
+
+    Palette(Format format = BGRA8888);
+    ~Palette() = default;
+
+    Format GetFormat() const { return format; }
+    size_t GetBytesPerPixel() const { return (format == RGB565) ? 2 : 4; }
+
+    // Converts <count> pixels to <output>
+    void Convert(const uint16_t* pixels, size_t count, void* output) const;
+
+    // Converts a whole frame to a surface whose rows start <pitch> bytes apart
+    void ConvertFrame(const FrameBuffer& frame, void* surface, size_t pitch) const;
+
+    // SIMD conversion is enabled by default when supported
+    static bool IsSIMDSupported();
+    void EnableSIMD(bool enable) { simd = enable && IsSIMDSupported(); }
+
+private:
+    Format format;
+    bool simd;
+    // Pixels in the output format, RGB565 ones in the lower 16 bits
+    std::array<uint32_t, 512> table;
+};
+
+#endif // PALETTE_H
@@ -0,0 +1,82 @@
+#ifndef ROLLBACKSESSION_H
+#define ROLLBACKSESSION_H
+
+#include "EmulatorCore.h"
+#include "Transport.h"
+#include <array>
+#include <vector>
+
+/*
+ * Two player session over a network with rollback: the local
+ * input is applied immediately and the input of the remote
+ * player, while it hasn't arrived yet, is predicted to be the
+ * same as the last one received. When an input arrives that
+ * doesn't match the prediction, the state saved at the start
+ * of that frame is restored and all the frames from there on
+ * are emulated again, within the same call to AdvanceFrame.
+ * The state is saved at the start of every frame, up to
+ * MAX_ROLLBACK frames back: the session doesn't advance past
+ * that many frames without confirmed remote input.
+ * Both players must load the same game before starting the
+ * session, which powers on the console.
+ */
+
+class RollbackSession : public EmulatorCore
+{
+public:
+    static const uint32_t MAX_ROLLBACK = 8;
+
+    // The local player uses the controller in the given port (0 or 1),
+    // the remote player the other one
+    RollbackSession(const EmulatorCore& other, Transport& transport, size_t localPort);
+    ~RollbackSession() = default;
+
+    // Emulates the next frame with the given local buttons (a mask
+    // of Controller::Button), rolling back first if a prediction
+    // turned out wrong. Returns false without emulating anything if
+    // the remote player is too far behind
+    bool AdvanceFrame(uint8_t localInput);
+
+    // Next frame to emulate
+    uint64_t GetFrame() const { return frame; }
+    // Number of frames from the start for which the remote input is known
+    uint64_t GetConfirmedFrames() const { return confirmedFrames; }
+
+    struct Stats
+    {
+        // Of the last call to AdvanceFrame
+        uint32_t resimulatedFrames;
+        uint64_t resimulationNanoseconds;
+        // Since the start of the session
+        uint64_t rollbacks;
+        uint64_t totalResimulatedFrames;
+        uint64_t totalResimulationNanoseconds;
+        uint32_t maxResimulatedFrames;
+    };
+    const Stats& GetStats() const { return stats; }
+
+private:
+    void ReceiveInputs();
+    void SendInputs();
+    // Saves the state and emulates the given frame with the best known inputs
+    void RunFrame(uint64_t emulated, bool draw = true);
+
+    Transport& transport;
+    size_t localPort;
+    uint64_t frame = 0;
+    uint64_t confirmedFrames = 0;
+    // First frame emulated with a wrong prediction, if not past the current frame
+    uint64_t rollbackFrame = UINT64_MAX;
+
+    // Indexed by frame, remote inputs not confirmed yet are predictions
+    std::vector<uint8_t> localInputs;
+    std::vector<uint8_t> remoteInputs;
+    std::vector<bool> confirmed;
+
+    // State at the start of each of the last frames, indexed by frame modulo size
+    std::array<NES::State, MAX_ROLLBACK + 1> states;
+
+    Stats stats{};
+};
+
+#endif // ROLLBACKSESSION_H
@@ -0,0 +1,84 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+
+/*
+ * Transports carry the input of the local player to the remote
+ * one in a RollbackSession. They are unreliable by design: a
+ * packet repeats the most recent inputs, so that a lost packet
+ * is covered by the next ones, and old or duplicate packets are
+ * simply ignored by the session.
+ */
+
+struct InputPacket
+{
+    static const size_t MAX_INPUTS = 16;
+
+    // Frame of the last input, the others are for the frames before it
+    uint32_t frame;
+    uint8_t count;
+    std::array<uint8_t, MAX_INPUTS> inputs;
+};
+
+class Transport
+{
+public:
+    virtual ~Transport() = default;
+
+    virtual void Send(const InputPacket& packet) = 0;
+
+    // Never blocks, returns false if no packet has arrived
+    virtual bool Receive(InputPacket& packet) = 0;
+};
+
+// Connects two sessions in the same process, mostly for testing
+class LoopbackTransport : public Transport
+{
+public:
+    LoopbackTransport() = default;
+    LoopbackTransport(const LoopbackTransport&) = delete;
+    LoopbackTransport& operator=(const LoopbackTransport&) = delete;
+
+    // What is sent by one of the transports is received by the other
+    static void Connect(LoopbackTransport& first, LoopbackTransport& second);
+
+    void Send(const InputPacket& packet) override;
+    bool Receive(InputPacket& packet) override;
+
+private:
+    LoopbackTransport* peer = nullptr;
+    // Sessions may run in different threads
+    std::mutex mutex;
+    std::deque<InputPacket> packets;
+};
+
+// Sends the packets as UDP datagrams, on Unix-like systems only
+class UdpTransport : public Transport
+{
+public:
+    // Binds a socket to the given port (0 picks any free one) on all
+    // interfaces, throws std::runtime_error if it's not possible
+    explicit UdpTransport(uint16_t localPort = 0);
+    ~UdpTransport();
+    UdpTransport(const UdpTransport&) = delete;
+    UdpTransport& operator=(const UdpTransport&) = delete;
+
+    uint16_t GetLocalPort() const;
+
+    // Sets the address of the remote player (an IPv4 address),
+    // the packets from any other address are discarded
+    void Connect(const std::string& address, uint16_t port);
+
+    void Send(const InputPacket& packet) override;
+    bool Receive(InputPacket& packet) override;
+
+private:
+    int descriptor = -1;
+};
+
+#endif // TRANSPORT_H
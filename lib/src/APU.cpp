@@ -0,0 +1,594 @@
+#include "APU.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+// CPU cycles of the frame counter steps after the start of the sequence,
+// and length of the sequence; the fifth step of the 5-step sequence
+// does nothing and is left out
+struct FrameSequence
+{
+    uint32_t steps[4];
+    uint32_t length;
+};
+const FrameSequence NTSC_SEQUENCES[2]{{{7457, 14913, 22371, 29829}, 29830}, {{7457, 14913, 22371, 37281}, 37282}};
+const FrameSequence PAL_SEQUENCES[2]{{{8313, 16627, 24939, 33253}, 33254}, {{8313, 16627, 24939, 41565}, 41566}};
+
+const uint8_t LENGTHS[32]{10, 254, 20, 2,  40, 4,  80, 6,  160, 8,  60, 10, 14, 12, 26, 14,
+                          12, 16,  24, 18, 48, 20, 96, 22, 192, 24, 72, 26, 16, 28, 32, 30};
+
+const uint8_t DUTY_CYCLES[4][8]{
+    {0, 1, 0, 0, 0, 0, 0, 0}, {0, 1, 1, 0, 0, 0, 0, 0}, {0, 1, 1, 1, 1, 0, 0, 0}, {1, 0, 0, 1, 1, 1, 1, 1}};
+
+const uint8_t TRIANGLE_SEQUENCE[32]{15, 14, 13, 12, 11, 10, 9,  8,  7,  6,  5,  4,  3,  2,  1,  0,
+                                    0,  1,  2,  3,  4,  5,  6,  7,  8,  9,  10, 11, 12, 13, 14, 15};
+
+// Periods in CPU cycles
+const uint16_t NOISE_PERIODS_NTSC[16]{4, 8, 16, 32, 64, 96, 128, 160, 202, 254, 380, 508, 762, 1016, 2034, 4068};
+const uint16_t NOISE_PERIODS_PAL[16]{4, 8, 14, 30, 60, 88, 118, 148, 188, 236, 354, 472, 708, 944, 1890, 3778};
+const uint16_t DMC_PERIODS_NTSC[16]{428, 380, 340, 320, 286, 254, 226, 214, 190, 160, 142, 128, 106, 84, 72, 54};
+const uint16_t DMC_PERIODS_PAL[16]{398, 354, 316, 298, 276, 236, 210, 198, 176, 148, 132, 118, 98, 78, 66, 50};
+
+// The CPU is halted for the DMC fetches, the actual delay depends on
+// the cycle the fetch happens on, this is the most common one
+const uint32_t DMC_FETCH_CYCLES = 4;
+
+// Non linear mixer of the channel outputs, indexed by the sum of the
+// pulses and by 3 * triangle + 2 * noise + DMC
+struct MixerTables
+{
+    std::array<float, 31> pulse;
+    std::array<float, 203> tnd;
+    MixerTables()
+    {
+        pulse[0] = tnd[0] = 0;
+        for (size_t i = 1; i < pulse.size(); i++)
+        {
+            pulse[i] = 95.52 / (8128.0 / i + 100);
+        }
+        for (size_t i = 1; i < tnd.size(); i++)
+        {
+            tnd[i] = 163.67 / (24329.0 / i + 100);
+        }
+    }
+};
+const MixerTables MIXER;
+
+bool UsesPalTables(const MasterClock& clock)
+{
+    return clock.GetRegion() == MasterClock::PAL;
+}
+
+uint8_t GetVolume(const APU::Envelope& envelope)
+{
+    return envelope.constant ? envelope.volume : envelope.decay;
+}
+} // namespace
+
+APU::APU(Cartridge& cart, const MasterClock& clock)
+    : cart(cart), clock(clock)
+{
+    Reset();
+}
+
+void APU::Reset()
+{
+    std::memset(&state, 0, sizeof(state));
+    state.cycles = clock.GetCpuCycles();
+    state.frameStart = state.cycles;
+    state.noise.shift = 1;
+    state.noise.period = NOISE_PERIODS_NTSC[0];
+    state.dmc.period = UsesPalTables(clock) ? DMC_PERIODS_PAL[0] : DMC_PERIODS_NTSC[0];
+    state.dmc.nextClock = state.cycles + state.dmc.period;
+    state.dmc.bitsRemaining = 8;
+    state.dmc.silence = true;
+    samples.clear();
+}
+
+void APU::Run(uint64_t target)
+{
+    while (state.cycles < target)
+    {
+        uint64_t frameStep = GetFrameStepCycle();
+        uint64_t next = std::min({target, frameStep, state.dmc.nextClock});
+        if (audioMode == FULL)
+        {
+            Synthesize(next);
+        }
+        state.cycles = next;
+        if (next == frameStep)
+        {
+            ClockFrameCounter();
+        }
+        if (next == state.dmc.nextClock)
+        {
+            ClockDmc();
+        }
+    }
+}
+
+void APU::Synthesize(uint64_t target)
+{
+    const auto& timing = clock.GetTiming();
+    const double samplesPerCycle = SAMPLE_RATE * timing.cpuDivider / timing.masterFrequency;
+    Triangle& triangle = state.triangle;
+    Noise& noise = state.noise;
+
+    // The outputs only change when the timers are clocked
+    uint8_t pulseOutputs[2], triangleOutput = TRIANGLE_SEQUENCE[triangle.sequence], noiseOutput;
+    auto updatePulse = [&](int i) {
+        const Pulse& pulse = state.pulses[i];
+        bool muted = pulse.length == 0 || pulse.period < 8 || GetSweepTarget(pulse, i == 0) > 0x07FF;
+        pulseOutputs[i] = (muted || !DUTY_CYCLES[pulse.duty][pulse.sequence]) ? 0 : GetVolume(pulse.envelope);
+    };
+    auto updateNoise = [&]() {
+        noiseOutput = (noise.length == 0 || (noise.shift & 1)) ? 0 : GetVolume(noise.envelope);
+    };
+    updatePulse(0);
+    updatePulse(1);
+    updateNoise();
+
+    for (uint64_t cycle = state.cycles; cycle < target; cycle++)
+    {
+        // Cycles where no timer is clocked and no sample is completed are
+        // all mixed at once; the pulses and the noise are clocked on odd cycles
+        const uint64_t odd = ~cycle & 1;
+        uint64_t idle = std::min({target - cycle, (uint64_t)triangle.timer, odd + 2 * state.pulses[0].timer,
+                                  odd + 2 * state.pulses[1].timer, odd + 2 * noise.timer});
+        double untilSample = std::ceil((1.0 - state.samplePhase) / samplesPerCycle) - 1;
+        idle = std::min(idle, (uint64_t)std::max(untilSample, 0.0));
+        if (idle > 0)
+        {
+            float level = MIXER.pulse[pulseOutputs[0] + pulseOutputs[1]] +
+                          MIXER.tnd[3 * triangleOutput + 2 * noiseOutput + state.dmc.output];
+            state.sampleSum += level * idle;
+            state.sampleCycles += idle;
+            state.samplePhase += samplesPerCycle * idle;
+            triangle.timer -= idle;
+            uint16_t apuCycles = (idle + (cycle & 1)) / 2;
+            state.pulses[0].timer -= apuCycles;
+            state.pulses[1].timer -= apuCycles;
+            noise.timer -= apuCycles;
+            cycle += idle;
+            if (cycle == target)
+            {
+                break;
+            }
+        }
+
+        // The triangle is clocked on every CPU cycle, the other
+        // channels on every APU cycle, which is two CPU cycles
+        if (triangle.timer == 0)
+        {
+            triangle.timer = triangle.period;
+            if (triangle.length > 0 && triangle.linearCounter > 0)
+            {
+                triangle.sequence = (triangle.sequence + 1) & 31;
+                triangleOutput = TRIANGLE_SEQUENCE[triangle.sequence];
+            }
+        }
+        else
+        {
+            triangle.timer--;
+        }
+        if (cycle & 1)
+        {
+            for (int i = 0; i < 2; i++)
+            {
+                Pulse& pulse = state.pulses[i];
+                if (pulse.timer == 0)
+                {
+                    pulse.timer = pulse.period;
+                    pulse.sequence = (pulse.sequence + 1) & 7;
+                    updatePulse(i);
+                }
+                else
+                {
+                    pulse.timer--;
+                }
+            }
+            if (noise.timer == 0)
+            {
+                noise.timer = noise.period / 2 - 1;
+                uint16_t feedback = (noise.shift ^ (noise.shift >> (noise.shortMode ? 6 : 1))) & 1;
+                noise.shift = (noise.shift >> 1) | (feedback << 14);
+                updateNoise();
+            }
+            else
+            {
+                noise.timer--;
+            }
+        }
+
+        state.sampleSum += MIXER.pulse[pulseOutputs[0] + pulseOutputs[1]] +
+                           MIXER.tnd[3 * triangleOutput + 2 * noiseOutput + state.dmc.output];
+        state.sampleCycles++;
+        state.samplePhase += samplesPerCycle;
+        if (state.samplePhase >= 1.0)
+        {
+            state.samplePhase -= 1.0;
+            float level = state.sampleSum / state.sampleCycles;
+            samples.push_back(std::min(level, 1.0f) * 32767);
+            state.sampleSum = 0;
+            state.sampleCycles = 0;
+        }
+    }
+}
+
+uint64_t APU::GetFrameStepCycle() const
+{
+    const FrameSequence& sequence = (UsesPalTables(clock) ? PAL_SEQUENCES : NTSC_SEQUENCES)[state.fiveStep];
+    return state.frameStart + sequence.steps[state.frameStep];
+}
+
+void APU::ClockFrameCounter()
+{
+    ClockQuarterFrame();
+    if (state.frameStep & 1)
+    {
+        ClockHalfFrame();
+    }
+    if (state.frameStep == 3)
+    {
+        if (!state.fiveStep && !state.irqInhibit)
+        {
+            state.frameIrq = true;
+        }
+        const FrameSequence& sequence = (UsesPalTables(clock) ? PAL_SEQUENCES : NTSC_SEQUENCES)[state.fiveStep];
+        state.frameStart += sequence.length;
+        state.frameStep = 0;
+    }
+    else
+    {
+        state.frameStep++;
+    }
+}
+
+void APU::ClockQuarterFrame()
+{
+    ClockEnvelope(state.pulses[0].envelope);
+    ClockEnvelope(state.pulses[1].envelope);
+    ClockEnvelope(state.noise.envelope);
+    Triangle& triangle = state.triangle;
+    if (triangle.linearReload)
+    {
+        triangle.linearCounter = triangle.linearPeriod;
+    }
+    else if (triangle.linearCounter > 0)
+    {
+        triangle.linearCounter--;
+    }
+    if (!triangle.control)
+    {
+        triangle.linearReload = false;
+    }
+}
+
+void APU::ClockHalfFrame()
+{
+    // The halt flag of the length counters is the loop flag of the envelopes
+    for (Pulse& pulse : state.pulses)
+    {
+        if (pulse.length > 0 && !pulse.envelope.loop)
+        {
+            pulse.length--;
+        }
+    }
+    if (state.triangle.length > 0 && !state.triangle.control)
+    {
+        state.triangle.length--;
+    }
+    if (state.noise.length > 0 && !state.noise.envelope.loop)
+    {
+        state.noise.length--;
+    }
+    ClockSweep(state.pulses[0], true);
+    ClockSweep(state.pulses[1], false);
+}
+
+void APU::ClockEnvelope(Envelope& envelope)
+{
+    if (envelope.start)
+    {
+        envelope.start = false;
+        envelope.decay = 15;
+        envelope.divider = envelope.volume;
+    }
+    else if (envelope.divider > 0)
+    {
+        envelope.divider--;
+    }
+    else
+    {
+        envelope.divider = envelope.volume;
+        if (envelope.decay > 0)
+        {
+            envelope.decay--;
+        }
+        else if (envelope.loop)
+        {
+            envelope.decay = 15;
+        }
+    }
+}
+
+uint16_t APU::GetSweepTarget(const Pulse& pulse, bool onesComplement)
+{
+    uint16_t change = pulse.period >> pulse.sweepShift;
+    if (!pulse.sweepNegate)
+    {
+        return pulse.period + change;
+    }
+    // The first pulse channel subtracts one more
+    change += onesComplement;
+    return (change > pulse.period) ? 0 : pulse.period - change;
+}
+
+void APU::ClockSweep(Pulse& pulse, bool onesComplement)
+{
+    uint16_t target = GetSweepTarget(pulse, onesComplement);
+    if (pulse.sweepDivider == 0 && pulse.sweepEnabled && pulse.sweepShift > 0 && pulse.period >= 8 &&
+        target <= 0x07FF)
+    {
+        pulse.period = target;
+    }
+    if (pulse.sweepDivider == 0 || pulse.sweepReload)
+    {
+        pulse.sweepDivider = pulse.sweepPeriod;
+        pulse.sweepReload = false;
+    }
+    else
+    {
+        pulse.sweepDivider--;
+    }
+}
+
+void APU::ClockDmc()
+{
+    DMC& dmc = state.dmc;
+    if (!dmc.silence)
+    {
+        if (dmc.shifter & 1)
+        {
+            dmc.output += (dmc.output <= 125) ? 2 : 0;
+        }
+        else
+        {
+            dmc.output -= (dmc.output >= 2) ? 2 : 0;
+        }
+    }
+    dmc.shifter >>= 1;
+    if (--dmc.bitsRemaining == 0)
+    {
+        dmc.bitsRemaining = 8;
+        dmc.silence = !dmc.bufferFull;
+        if (dmc.bufferFull)
+        {
+            dmc.shifter = dmc.buffer;
+            dmc.bufferFull = false;
+            FetchSample();
+        }
+    }
+    dmc.nextClock += dmc.period;
+}
+
+void APU::FetchSample()
+{
+    DMC& dmc = state.dmc;
+    if (dmc.bytesRemaining == 0)
+    {
+        return;
+    }
+    // Samples are always in the cartridge, from 0x8000 to 0xFFFF
+    dmc.buffer = cart.ReadFromPRG(dmc.address - 0x8000);
+    dmc.bufferFull = true;
+    state.stolenCycles += DMC_FETCH_CYCLES;
+    dmc.address = (dmc.address == 0xFFFF) ? 0x8000 : dmc.address + 1;
+    if (--dmc.bytesRemaining == 0)
+    {
+        if (dmc.loop)
+        {
+            RestartSample();
+        }
+        else if (dmc.irqEnabled)
+        {
+            state.dmcIrq = true;
+        }
+    }
+}
+
+void APU::RestartSample()
+{
+    state.dmc.address = state.dmc.sampleAddress;
+    state.dmc.bytesRemaining = state.dmc.sampleLength;
+}
+
+uint64_t APU::GetNextEventCycle() const
+{
+    if (state.stolenCycles > 0)
+    {
+        return state.cycles;
+    }
+    uint64_t next = NO_EVENT;
+    if (!state.fiveStep && !state.irqInhibit && !state.frameIrq)
+    {
+        const FrameSequence& sequence = (UsesPalTables(clock) ? PAL_SEQUENCES : NTSC_SEQUENCES)[0];
+        next = state.frameStart + sequence.steps[3];
+    }
+    const DMC& dmc = state.dmc;
+    if (dmc.bytesRemaining > 0 && dmc.bufferFull)
+    {
+        // The buffer is emptied, and the next byte fetched, when the
+        // output unit starts a new cycle
+        next = std::min(next, dmc.nextClock + (uint64_t)(dmc.bitsRemaining - 1) * dmc.period);
+    }
+    return next;
+}
+
+uint32_t APU::TakeStolenCycles()
+{
+    uint32_t cycles = state.stolenCycles;
+    state.stolenCycles = 0;
+    return cycles;
+}
+
+uint8_t APU::ReadStatus()
+{
+    uint8_t data = (state.pulses[0].length > 0 ? 0x01 : 0) | (state.pulses[1].length > 0 ? 0x02 : 0) |
+                   (state.triangle.length > 0 ? 0x04 : 0) | (state.noise.length > 0 ? 0x08 : 0) |
+                   (state.dmc.bytesRemaining > 0 ? 0x10 : 0) | (state.frameIrq ? 0x40 : 0) |
+                   (state.dmcIrq ? 0x80 : 0);
+    state.frameIrq = false;
+    return data;
+}
+
+void APU::WriteRegister(uint16_t address, uint8_t data)
+{
+    const bool pal = UsesPalTables(clock);
+    switch (address)
+    {
+    case 0x4000:
+    case 0x4004: {
+        Pulse& pulse = state.pulses[(address >> 2) & 1];
+        pulse.duty = data >> 6;
+        pulse.envelope.loop = data & 0x20;
+        pulse.envelope.constant = data & 0x10;
+        pulse.envelope.volume = data & 0x0F;
+        break;
+    }
+    case 0x4001:
+    case 0x4005: {
+        Pulse& pulse = state.pulses[(address >> 2) & 1];
+        pulse.sweepEnabled = data & 0x80;
+        pulse.sweepPeriod = (data >> 4) & 0x07;
+        pulse.sweepNegate = data & 0x08;
+        pulse.sweepShift = data & 0x07;
+        pulse.sweepReload = true;
+        break;
+    }
+    case 0x4002:
+    case 0x4006: {
+        Pulse& pulse = state.pulses[(address >> 2) & 1];
+        pulse.period = (pulse.period & 0x0700) | data;
+        break;
+    }
+    case 0x4003:
+    case 0x4007: {
+        Pulse& pulse = state.pulses[(address >> 2) & 1];
+        pulse.period = (pulse.period & 0x00FF) | ((data & 0x07) << 8);
+        if (pulse.enabled)
+        {
+            pulse.length = LENGTHS[data >> 3];
+        }
+        pulse.sequence = 0;
+        pulse.envelope.start = true;
+        break;
+    }
+    case 0x4008: {
+        state.triangle.control = data & 0x80;
+        state.triangle.linearPeriod = data & 0x7F;
+        break;
+    }
+    case 0x400A: {
+        state.triangle.period = (state.triangle.period & 0x0700) | data;
+        break;
+    }
+    case 0x400B: {
+        state.triangle.period = (state.triangle.period & 0x00FF) | ((data & 0x07) << 8);
+        if (state.triangle.enabled)
+        {
+            state.triangle.length = LENGTHS[data >> 3];
+        }
+        state.triangle.linearReload = true;
+        break;
+    }
+    case 0x400C: {
+        state.noise.envelope.loop = data & 0x20;
+        state.noise.envelope.constant = data & 0x10;
+        state.noise.envelope.volume = data & 0x0F;
+        break;
+    }
+    case 0x400E: {
+        state.noise.shortMode = data & 0x80;
+        state.noise.period = (pal ? NOISE_PERIODS_PAL : NOISE_PERIODS_NTSC)[data & 0x0F];
+        break;
+    }
+    case 0x400F: {
+        if (state.noise.enabled)
+        {
+            state.noise.length = LENGTHS[data >> 3];
+        }
+        state.noise.envelope.start = true;
+        break;
+    }
+    case 0x4010: {
+        state.dmc.irqEnabled = data & 0x80;
+        state.dmc.loop = data & 0x40;
+        state.dmc.period = (pal ? DMC_PERIODS_PAL : DMC_PERIODS_NTSC)[data & 0x0F];
+        if (!state.dmc.irqEnabled)
+        {
+            state.dmcIrq = false;
+        }
+        break;
+    }
+    case 0x4011: {
+        state.dmc.output = data & 0x7F;
+        break;
+    }
+    case 0x4012: {
+        state.dmc.sampleAddress = 0xC000 | (data << 6);
+        break;
+    }
+    case 0x4013: {
+        state.dmc.sampleLength = (data << 4) + 1;
+        break;
+    }
+    case 0x4015: {
+        Pulse* pulses = state.pulses.data();
+        pulses[0].enabled = data & 0x01;
+        pulses[1].enabled = data & 0x02;
+        state.triangle.enabled = data & 0x04;
+        state.noise.enabled = data & 0x08;
+        pulses[0].length = pulses[0].enabled ? pulses[0].length : 0;
+        pulses[1].length = pulses[1].enabled ? pulses[1].length : 0;
+        state.triangle.length = state.triangle.enabled ? state.triangle.length : 0;
+        state.noise.length = state.noise.enabled ? state.noise.length : 0;
+        state.dmcIrq = false;
+        if (!(data & 0x10))
+        {
+            state.dmc.bytesRemaining = 0;
+        }
+        else if (state.dmc.bytesRemaining == 0)
+        {
+            RestartSample();
+            if (!state.dmc.bufferFull)
+            {
+                FetchSample();
+            }
+        }
+        break;
+    }
+    case 0x4017: {
+        state.fiveStep = data & 0x80;
+        state.irqInhibit = data & 0x40;
+        if (state.irqInhibit)
+        {
+            state.frameIrq = false;
+        }
+        // The sequence restarts 3 or 4 cycles later, depending on the
+        // alignment with the APU cycles, the 5-step one clocks the
+        // length counters, envelopes and sweeps right away
+        state.frameStart = state.cycles + ((state.cycles & 1) ? 4 : 3);
+        state.frameStep = 0;
+        if (state.fiveStep)
+        {
+            ClockQuarterFrame();
+            ClockHalfFrame();
+        }
+        break;
+    }
+    default: break;
+    }
+}
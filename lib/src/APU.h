@@ -0,0 +1,183 @@
+#ifndef APU_H
+#define APU_H
+
+#include "Cartridge.h"
+#include "MasterClock.h"
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/*
+ * NES APU, integrated in the CPU chip, with two pulse channels,
+ * a triangle, a noise generator and a delta modulation channel
+ * (DMC) that plays samples read from the cartridge.
+ * Like the PPU, the APU is caught up with the master clock only
+ * when something can observe it: when the CPU accesses its
+ * registers, when a frame is completed and when one of its events
+ * happens. The events are known in advance: the frame IRQ and the
+ * DMC fetches, which halt the CPU and can raise the DMC IRQ.
+ * Two modes keep the same state visible to the game:
+ * - FULL: the channels are clocked on every cycle, mixed and
+ *   averaged into SAMPLE_RATE samples
+ * - TURBO: the channel timers are not clocked and no sample is
+ *   produced; the frame counter, the length counters, envelopes,
+ *   sweeps and the whole DMC are still emulated, so the status
+ *   register, the IRQs and the CPU cycles taken by the DMC are
+ *   exactly the same as in FULL mode.
+ */
+
+class APU
+{
+public:
+    enum AudioMode
+    {
+        FULL,
+        TURBO
+    };
+
+    struct Envelope
+    {
+        bool start, loop, constant;
+        uint8_t volume, divider, decay;
+    };
+
+    struct Pulse
+    {
+        bool enabled;
+        uint8_t length;
+        Envelope envelope;
+        uint8_t duty, sequence;
+        uint16_t period, timer;
+        bool sweepEnabled, sweepNegate, sweepReload;
+        uint8_t sweepPeriod, sweepShift, sweepDivider;
+    };
+
+    struct Triangle
+    {
+        bool enabled, control, linearReload;
+        uint8_t length, linearPeriod, linearCounter, sequence;
+        uint16_t period, timer;
+    };
+
+    struct Noise
+    {
+        bool enabled, shortMode;
+        uint8_t length;
+        Envelope envelope;
+        uint16_t period, timer, shift;
+    };
+
+    struct DMC
+    {
+        bool irqEnabled, loop;
+        uint16_t period;
+        // CPU cycle of the next clock of the output unit
+        uint64_t nextClock;
+        uint16_t sampleAddress, sampleLength, address, bytesRemaining;
+        uint8_t buffer, shifter, bitsRemaining, output;
+        bool bufferFull, silence;
+    };
+
+    // Everything that changes while the APU runs
+    struct State
+    {
+        // CPU cycles emulated since power on
+        uint64_t cycles;
+
+        // Frame counter: the sequence restarts every 4 or 5 steps
+        bool fiveStep, irqInhibit;
+        uint8_t frameStep;
+        uint64_t frameStart;
+
+        bool frameIrq, dmcIrq;
+
+        std::array<Pulse, 2> pulses;
+        Triangle triangle;
+        Noise noise;
+        DMC dmc;
+
+        // CPU cycles taken by DMC fetches and not yet added to the clock
+        uint32_t stolenCycles;
+
+        // Output being averaged into the next sample
+        float sampleSum;
+        uint32_t sampleCycles;
+        double samplePhase;
+    };
+
+    static const uint64_t NO_EVENT = UINT64_MAX;
+    static const uint32_t SAMPLE_RATE = 48000;
+
+    APU(Cartridge& cart, const MasterClock& clock);
+    ~APU() = default;
+
+    // Clears the state and aligns the APU with the clock
+    void Reset();
+
+    void SetAudioMode(AudioMode mode) { audioMode = mode; }
+    AudioMode GetAudioMode() const { return audioMode; }
+
+    // Emulates the APU up to the current time of the master clock
+    inline void Sync()
+    {
+        uint64_t target = clock.GetCpuCycles();
+        if (target > state.cycles)
+        {
+            Run(target);
+        }
+    }
+
+    // Registers at 0x4000-0x4013, 0x4015 and 0x4017, the APU must
+    // have been synchronized
+    uint8_t ReadStatus();
+    void WriteRegister(uint16_t address, uint8_t data);
+
+    // Level of the IRQ line, up to date once the events have been run
+    bool IsIrqAsserted() const { return state.frameIrq || state.dmcIrq; }
+
+    // CPU cycle of the next event, NO_EVENT if nothing is going to happen
+    uint64_t GetNextEventCycle() const;
+
+    // CPU cycles the CPU has to be halted for the DMC fetches done so far
+    uint32_t TakeStolenCycles();
+
+    // Mono samples produced since they were last cleared, only in FULL mode
+    const std::vector<int16_t>& GetSamples() const { return samples; }
+    void ClearSamples() { samples.clear(); }
+
+    const State& GetState() const { return state; }
+    void SetState(const State& newState) { std::memcpy(&state, &newState, sizeof(state)); }
+
+private:
+    Cartridge& cart;
+    const MasterClock& clock;
+
+    State state;
+    AudioMode audioMode = FULL;
+
+    std::vector<int16_t> samples;
+
+    void Run(uint64_t target);
+
+    // Clocks the channel timers and mixes their output from
+    // the current cycle up to the given one
+    void Synthesize(uint64_t target);
+
+    // Frame counter
+    uint64_t GetFrameStepCycle() const;
+    void ClockFrameCounter();
+    void ClockQuarterFrame();
+    void ClockHalfFrame();
+
+    static void ClockEnvelope(Envelope& envelope);
+    void ClockSweep(Pulse& pulse, bool onesComplement);
+    static uint16_t GetSweepTarget(const Pulse& pulse, bool onesComplement);
+
+    // DMC output unit and memory reader
+    void ClockDmc();
+    void FetchSample();
+    void RestartSample();
+};
+
+#endif // APU_H
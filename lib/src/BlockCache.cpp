@@ -0,0 +1,155 @@
+#include "BlockCache.h"
+#include "NES.h"
+
+BlockCache::BlockCache(const CPU& cpu, const NES& bus)
+    : cpu(cpu), bus(bus), breakpoints(bus.breakpoints)
+#ifdef NESPP_JIT
+    , profiler(bus.profiler)
+#endif
+{
+}
+
+void BlockCache::Clear()
+{
+    blocks.clear();
+    codePages = dirtyPages = 0;
+    block = nullptr;
+    current = last = nullptr;
+#ifdef NESPP_JIT
+    recompiler.Reset();
+#endif
+}
+
+const BlockCache::Instruction* BlockCache::Enter(uint16_t PC)
+{
+    Block* previous = block;
+    block = nullptr;
+    current = last = nullptr;
+    if (breakpoints || (PC >= 0x2000 && PC < 0x8000))
+    {
+        return nullptr;
+    }
+    if (dirtyPages != 0)
+    {
+        RemoveDirtyBlocks();
+        previous = nullptr;
+    }
+
+    uint32_t key = ((uint32_t)bus.GetCodeBank(PC) << 16) | PC;
+    if (previous != nullptr)
+    {
+        for (const auto& [successorKey, successor] : previous->successors)
+        {
+            if (successorKey == key && successor != nullptr)
+            {
+                block = successor;
+                break;
+            }
+        }
+    }
+    if (block == nullptr)
+    {
+        auto found = blocks.find(key);
+        if (found == blocks.end())
+        {
+            found = blocks.emplace(key, Decode(PC)).first;
+            if (PC < 0x2000)
+            {
+                codePages |= 1 << ((PC & 0x07FF) >> 8);
+            }
+        }
+        block = &found->second;
+        if (previous != nullptr)
+        {
+            previous->successors[previous->nextSuccessor] = {key, block};
+            previous->nextSuccessor ^= 1;
+        }
+    }
+
+    if (block->instructions.empty())
+    {
+        block = nullptr;
+        return nullptr;
+    }
+#ifdef NESPP_JIT
+    // Only code in PRG ROM is compiled, it can't be modified
+    if (key >> 16 != 0 && block->entries < HOT_BLOCK_THRESHOLD && ++block->entries == HOT_BLOCK_THRESHOLD)
+    {
+        Compile(*block);
+    }
+#endif
+    current = block->instructions.data();
+    last = current + block->instructions.size();
+    return current++;
+}
+
+BlockCache::Block BlockCache::Decode(uint16_t PC) const
+{
+    // Decoding must not have side effects
+    auto read = [this](uint16_t address) { return bus.Peek(address); };
+
+    Block decodedBlock;
+    uint32_t address = PC;
+    uint32_t pageEnd = (address & 0xFF00) + 0x0100;
+    while (true)
+    {
+        uint8_t opcode = read(address);
+        const CPU::Instruction& decoded = CPU::instructions[opcode];
+        CPU::InstructionPtr handler = cpu.handlers[opcode];
+        // Operands in the next page wouldn't be invalidated with this block
+        if (address + decoded.bytes > pageEnd)
+        {
+            break;
+        }
+        Instruction instruction{handler, (uint16_t)address, opcode, {0, 0}};
+        for (int i = 1; i < decoded.bytes; i++)
+        {
+            instruction.operands[i - 1] = read(address + i);
+        }
+        decodedBlock.instructions.push_back(instruction);
+        address += decoded.bytes;
+
+        // Anything that can change PC ends the block
+        bool jump = opcode == 0x00 || opcode == 0x20 || opcode == 0x40 || opcode == 0x4C || opcode == 0x60 ||
+                    opcode == 0x6C;
+        if (decoded.mode == CPU::REL || jump || handler == &CPU::Illegal || address == pageEnd)
+        {
+            break;
+        }
+    }
+    return decodedBlock;
+}
+
+#ifdef NESPP_JIT
+void BlockCache::Compile(Block& block)
+{
+    std::vector<Recompiler::Instruction> instructions;
+    for (const Instruction& instruction : block.instructions)
+    {
+        instructions.push_back({instruction.opcode, instruction.operands[0]});
+    }
+    block.code = recompiler.Compile(instructions, CPU::instructions);
+}
+#endif
+
+void BlockCache::RemoveDirtyBlocks()
+{
+    for (auto entry = blocks.begin(); entry != blocks.end();)
+    {
+        uint16_t PC = entry->first & 0xFFFF;
+        if (PC < 0x2000 && (dirtyPages & (1 << ((PC & 0x07FF) >> 8))) != 0)
+        {
+            entry = blocks.erase(entry);
+        }
+        else
+        {
+            ++entry;
+        }
+    }
+    dirtyPages = 0;
+    // Links to the removed blocks would be left dangling
+    for (auto& [key, cached] : blocks)
+    {
+        cached.successors = {};
+    }
+}
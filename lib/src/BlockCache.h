@@ -0,0 +1,155 @@
+#ifndef BLOCKCACHE_H
+#define BLOCKCACHE_H
+
+#include "Breakpoints.h"
+#include "CPU.h"
+#include "Profiler.h"
+#include "Recompiler.h"
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*
+ * Cache of pre-decoded basic blocks used by the CPU to skip
+ * the opcode table lookup and the operand fetches through the
+ * bus. A block is a straight run of instructions ending with
+ * the first branch, jump, subroutine call or return (or at the
+ * end of a 256 byte page), decoded into the handler to call and
+ * the operand bytes of each instruction.
+ * Blocks are keyed by PC and by the bank mapped at that address,
+ * so that bank switching doesn't need any invalidation. Code in
+ * RAM is tracked per page and writes to a page containing code
+ * discard all its blocks before the next one is entered.
+ * Only RAM and PRG ROM are cached: code running from MMIO or
+ * PRG RAM, or while breakpoints are defined, goes through the
+ * normal interpreter.
+ * The instructions still tick the bus once for each operand
+ * they fetch, so the timing is exactly the same as without
+ * the cache.
+ * When built with NESpp_ENABLE_JIT, blocks in PRG ROM that are
+ * entered HOT_BLOCK_THRESHOLD times are also passed to the
+ * Recompiler, and the CPU runs the native code instead of the
+ * instructions it covers whenever the block is entered (unless
+ * the debugger is profiling, which needs every instruction).
+ */
+
+class BlockCache
+{
+public:
+    BlockCache(const CPU& cpu, const class NES& bus);
+    ~BlockCache() = default;
+
+    struct Instruction
+    {
+        CPU::InstructionPtr ptr;
+        uint16_t PC;
+        uint8_t opcode;
+        std::array<uint8_t, 2> operands;
+    };
+
+    // Returns the instruction at PC, continuing the block being executed
+    // if possible, or null if the instruction must not be cached
+    inline const Instruction* Next(uint16_t PC)
+    {
+        if (current != last && current->PC == PC && !breakpoints)
+        {
+            return current++;
+        }
+        return Enter(PC);
+    }
+
+    // Called by the bus on every write to RAM
+    inline void InvalidateRAM(uint16_t address)
+    {
+        uint8_t page = 1 << ((address & 0x07FF) >> 8);
+        if ((codePages & page) != 0)
+        {
+            // The blocks are only removed when the next block is entered,
+            // since the instruction doing the write might be in one of them
+            dirtyPages |= page;
+            codePages &= ~page;
+            block = nullptr;
+            current = last = nullptr;
+        }
+    }
+
+    // Called when the whole RAM is replaced, the blocks in PRG ROM are kept
+    inline void InvalidateAllRAM()
+    {
+        dirtyPages |= codePages;
+        codePages = 0;
+        block = nullptr;
+        current = last = nullptr;
+    }
+
+    void Clear();
+
+#ifdef NESPP_JIT
+    // Native code to run when the given instruction, just returned
+    // by Next, is the first one of its block
+    inline const CompiledCode* GetCompiledCode(const Instruction* instruction) const
+    {
+        if (instruction == block->instructions.data() && block->code.function != nullptr && !profiler)
+        {
+            return &block->code;
+        }
+        return nullptr;
+    }
+
+    // Moves past the instructions executed by the native code
+    void Skip(size_t instructions) { current += instructions; }
+#endif
+
+    size_t GetBlockCount() const { return blocks.size(); }
+
+private:
+    struct Block
+    {
+        std::vector<Instruction> instructions;
+        // The last blocks executed after this one (usually the target
+        // and the fall through of the final branch), checked before
+        // looking up the next block in the map
+        std::array<std::pair<uint32_t, Block*>, 2> successors{};
+        size_t nextSuccessor = 0;
+#ifdef NESPP_JIT
+        uint32_t entries = 0;
+        CompiledCode code;
+#endif
+    };
+
+#ifdef NESPP_JIT
+    static const uint32_t HOT_BLOCK_THRESHOLD = 16;
+    void Compile(Block& block);
+#endif
+
+    const Instruction* Enter(uint16_t PC);
+    Block Decode(uint16_t PC) const;
+    void RemoveDirtyBlocks();
+
+    const CPU& cpu;
+    const NES& bus;
+    // Those of the bus, the cache is bypassed while there are any
+    const std::unique_ptr<Breakpoints>& breakpoints;
+
+#ifdef NESPP_JIT
+    const std::unique_ptr<Profiler>& profiler;
+    Recompiler recompiler;
+#endif
+
+    // Bank in the upper 16 bits, PC in the lower ones
+    std::unordered_map<uint32_t, Block> blocks;
+
+    // One bit for each 256 byte page of RAM
+    uint8_t codePages = 0;
+    uint8_t dirtyPages = 0;
+
+    // Position in the block being executed
+    Block* block = nullptr;
+    const Instruction* current = nullptr;
+    const Instruction* last = nullptr;
+};
+
+#endif // BLOCKCACHE_H
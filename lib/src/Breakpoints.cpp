@@ -0,0 +1,376 @@
+#include "Breakpoints.h"
+#include "CPU.h"
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+
+namespace
+{
+enum Operators
+{
+    LOGICAL_NOT,
+    LOGICAL_OR,
+    LOGICAL_AND,
+    BITWISE_OR,
+    BITWISE_XOR,
+    BITWISE_AND,
+    EQUAL,
+    NOT_EQUAL,
+    LESS,
+    LESS_EQUAL,
+    GREATER,
+    GREATER_EQUAL
+};
+
+enum Registers
+{
+    REG_A,
+    REG_X,
+    REG_Y,
+    REG_SP,
+    REG_PC,
+    REG_PS,
+    REG_ADDRESS,
+    REG_VALUE
+};
+
+int RegisterFromName(std::string name)
+{
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::toupper(c); });
+    if (name == "A") return REG_A;
+    if (name == "X") return REG_X;
+    if (name == "Y") return REG_Y;
+    if (name == "SP") return REG_SP;
+    if (name == "PC") return REG_PC;
+    if (name == "P" || name == "PS") return REG_PS;
+    if (name == "ADDR") return REG_ADDRESS;
+    if (name == "VALUE") return REG_VALUE;
+    throw std::invalid_argument("Unknown identifier in breakpoint condition: " + name);
+}
+} // namespace
+
+Breakpoints::Condition::Condition(const std::string& expression)
+{
+    // Shunting-yard conversion to postfix notation
+    std::vector<Token> operators;
+    bool expectOperand = true;
+    for (const Token& token : Tokenize(expression))
+    {
+        switch (token.type)
+        {
+        case NUMBER:
+        case REGISTER: {
+            if (!expectOperand)
+            {
+                throw std::invalid_argument("Missing operator in breakpoint condition: " + expression);
+            }
+            program.push_back(token);
+            expectOperand = false;
+            break;
+        }
+        case UNARY_OPERATOR:
+        case OPEN_PARENTHESIS: {
+            if (!expectOperand)
+            {
+                throw std::invalid_argument("Missing operator in breakpoint condition: " + expression);
+            }
+            operators.push_back(token);
+            break;
+        }
+        case BINARY_OPERATOR: {
+            if (expectOperand)
+            {
+                throw std::invalid_argument("Missing operand in breakpoint condition: " + expression);
+            }
+            // All binary operators are left associative, unary ones always bind tighter
+            while (!operators.empty() && operators.back().type != OPEN_PARENTHESIS &&
+                   (operators.back().type == UNARY_OPERATOR ||
+                    Precedence(operators.back().id) >= Precedence(token.id)))
+            {
+                program.push_back(operators.back());
+                operators.pop_back();
+            }
+            operators.push_back(token);
+            expectOperand = true;
+            break;
+        }
+        case CLOSE_PARENTHESIS: {
+            if (expectOperand)
+            {
+                throw std::invalid_argument("Missing operand in breakpoint condition: " + expression);
+            }
+            while (!operators.empty() && operators.back().type != OPEN_PARENTHESIS)
+            {
+                program.push_back(operators.back());
+                operators.pop_back();
+            }
+            if (operators.empty())
+            {
+                throw std::invalid_argument("Unbalanced parenthesis in breakpoint condition: " + expression);
+            }
+            operators.pop_back();
+            break;
+        }
+        }
+    }
+    if (expectOperand && !(program.empty() && operators.empty()))
+    {
+        throw std::invalid_argument("Missing operand in breakpoint condition: " + expression);
+    }
+    while (!operators.empty())
+    {
+        if (operators.back().type == OPEN_PARENTHESIS)
+        {
+            throw std::invalid_argument("Unbalanced parenthesis in breakpoint condition: " + expression);
+        }
+        program.push_back(operators.back());
+        operators.pop_back();
+    }
+
+    int depth = 0, maxDepth = 0;
+    for (const Token& token : program)
+    {
+        depth += (token.type == BINARY_OPERATOR) ? -1 : (token.type == UNARY_OPERATOR) ? 0 : 1;
+        maxDepth = std::max(maxDepth, depth);
+    }
+    if (maxDepth > MAX_STACK_DEPTH)
+    {
+        throw std::invalid_argument("Breakpoint condition is too complex: " + expression);
+    }
+}
+
+std::vector<Breakpoints::Condition::Token> Breakpoints::Condition::Tokenize(const std::string& expression)
+{
+    std::vector<Token> tokens;
+    size_t i = 0;
+    while (i < expression.size())
+    {
+        char c = expression[i];
+        char next = (i + 1 < expression.size()) ? expression[i + 1] : '\0';
+        if (std::isspace((unsigned char)c))
+        {
+            i++;
+        }
+        else if (std::isdigit((unsigned char)c) || c == '$')
+        {
+            int base = 10;
+            if (c == '$')
+            {
+                base = 16;
+                i++;
+            }
+            else if (c == '0' && (next == 'x' || next == 'X'))
+            {
+                base = 16;
+                i += 2;
+            }
+            size_t length = 0;
+            while (i + length < expression.size() && std::isxdigit((unsigned char)expression[i + length]))
+            {
+                length++;
+            }
+            if (length == 0)
+            {
+                throw std::invalid_argument("Malformed number in breakpoint condition: " + expression);
+            }
+            size_t parsed = 0;
+            uint32_t value = std::stoul(expression.substr(i, length), &parsed, base);
+            if (parsed != length)
+            {
+                throw std::invalid_argument("Malformed number in breakpoint condition: " + expression);
+            }
+            tokens.push_back({NUMBER, 0, value});
+            i += length;
+        }
+        else if (std::isalpha((unsigned char)c))
+        {
+            size_t length = 0;
+            while (i + length < expression.size() && std::isalpha((unsigned char)expression[i + length]))
+            {
+                length++;
+            }
+            tokens.push_back({REGISTER, RegisterFromName(expression.substr(i, length)), 0});
+            i += length;
+        }
+        else
+        {
+            Token token{BINARY_OPERATOR, 0, 0};
+            int length = 2;
+            switch (c)
+            {
+            case '(': token.type = OPEN_PARENTHESIS; length = 1; break;
+            case ')': token.type = CLOSE_PARENTHESIS; length = 1; break;
+            case '|':
+                if (next == '|') token.id = LOGICAL_OR;
+                else { token.id = BITWISE_OR; length = 1; }
+                break;
+            case '&':
+                if (next == '&') token.id = LOGICAL_AND;
+                else { token.id = BITWISE_AND; length = 1; }
+                break;
+            case '^': token.id = BITWISE_XOR; length = 1; break;
+            case '=':
+                if (next != '=') throw std::invalid_argument("Use == for comparisons in breakpoint condition");
+                token.id = EQUAL;
+                break;
+            case '!':
+                if (next == '=') token.id = NOT_EQUAL;
+                else { token.type = UNARY_OPERATOR; token.id = LOGICAL_NOT; length = 1; }
+                break;
+            case '<':
+                if (next == '=') token.id = LESS_EQUAL;
+                else { token.id = LESS; length = 1; }
+                break;
+            case '>':
+                if (next == '=') token.id = GREATER_EQUAL;
+                else { token.id = GREATER; length = 1; }
+                break;
+            default:
+                throw std::invalid_argument(std::string("Unexpected character in breakpoint condition: ") + c);
+            }
+            tokens.push_back(token);
+            i += length;
+        }
+    }
+    return tokens;
+}
+
+int Breakpoints::Condition::Precedence(int binaryOperator)
+{
+    switch (binaryOperator)
+    {
+    case LOGICAL_OR: return 1;
+    case LOGICAL_AND: return 2;
+    case BITWISE_OR: return 3;
+    case BITWISE_XOR: return 4;
+    case BITWISE_AND: return 5;
+    case EQUAL:
+    case NOT_EQUAL: return 6;
+    default: return 7;
+    }
+}
+
+bool Breakpoints::Condition::Evaluate(const Context& context) const
+{
+    if (program.empty())
+    {
+        return true;
+    }
+    // The parser guarantees that the stack never underflows
+    uint32_t stack[MAX_STACK_DEPTH];
+    int top = -1;
+    for (const Token& token : program)
+    {
+        switch (token.type)
+        {
+        case NUMBER: stack[++top] = token.value; break;
+        case REGISTER: {
+            uint32_t value = 0;
+            switch (token.id)
+            {
+            case REG_A: value = context.A; break;
+            case REG_X: value = context.X; break;
+            case REG_Y: value = context.Y; break;
+            case REG_SP: value = context.SP; break;
+            case REG_PC: value = context.PC; break;
+            case REG_PS: value = context.PS; break;
+            case REG_ADDRESS: value = context.address; break;
+            case REG_VALUE: value = context.value; break;
+            }
+            stack[++top] = value;
+            break;
+        }
+        case UNARY_OPERATOR: stack[top] = !stack[top]; break;
+        case BINARY_OPERATOR: {
+            uint32_t right = stack[top--];
+            uint32_t left = stack[top];
+            switch (token.id)
+            {
+            case LOGICAL_OR: stack[top] = left || right; break;
+            case LOGICAL_AND: stack[top] = left && right; break;
+            case BITWISE_OR: stack[top] = left | right; break;
+            case BITWISE_XOR: stack[top] = left ^ right; break;
+            case BITWISE_AND: stack[top] = left & right; break;
+            case EQUAL: stack[top] = left == right; break;
+            case NOT_EQUAL: stack[top] = left != right; break;
+            case LESS: stack[top] = left < right; break;
+            case LESS_EQUAL: stack[top] = left <= right; break;
+            case GREATER: stack[top] = left > right; break;
+            case GREATER_EQUAL: stack[top] = left >= right; break;
+            }
+            break;
+        }
+        default: break;
+        }
+    }
+    return stack[top] != 0;
+}
+
+int Breakpoints::Add(uint8_t type, uint16_t start, uint16_t end, const std::string& condition)
+{
+    if (end < start)
+    {
+        throw std::invalid_argument("Breakpoint range ends before its start");
+    }
+    breakpoints.push_back({nextId, type, start, end, Condition(condition)});
+    RebuildPageMask();
+    return nextId++;
+}
+
+bool Breakpoints::Remove(int id)
+{
+    auto removed = std::remove_if(breakpoints.begin(), breakpoints.end(),
+                                  [id](const Breakpoint& breakpoint) { return breakpoint.id == id; });
+    if (removed == breakpoints.end())
+    {
+        return false;
+    }
+    breakpoints.erase(removed, breakpoints.end());
+    RebuildPageMask();
+    return true;
+}
+
+void Breakpoints::Clear()
+{
+    breakpoints.clear();
+    RebuildPageMask();
+    triggered = false;
+}
+
+void Breakpoints::Match(AccessType type, uint16_t address, uint8_t value, const CPU& cpu)
+{
+    if (suspended > 0 || triggered)
+    {
+        return;
+    }
+    for (const Breakpoint& breakpoint : breakpoints)
+    {
+        if ((breakpoint.type & type) == 0 || address < breakpoint.start || address > breakpoint.end)
+        {
+            continue;
+        }
+        if (!breakpoint.condition.IsEmpty())
+        {
+            Context context{cpu.PC, cpu.A, cpu.X, cpu.Y, cpu.SP, cpu.GetStatus(), address, value};
+            if (!breakpoint.condition.Evaluate(context))
+            {
+                continue;
+            }
+        }
+        triggered = true;
+        lastHit = {breakpoint.id, type, address, value};
+        return;
+    }
+}
+
+void Breakpoints::RebuildPageMask()
+{
+    pageMask.fill(0);
+    for (const Breakpoint& breakpoint : breakpoints)
+    {
+        for (int page = breakpoint.start >> 8; page <= (breakpoint.end >> 8); page++)
+        {
+            pageMask[page] |= breakpoint.type;
+        }
+    }
+}
@@ -0,0 +1,156 @@
+#ifndef BREAKPOINTS_H
+#define BREAKPOINTS_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * Breakpoint and watchpoint engine used by the Debugger.
+ * The bus only holds a pointer to this object while at least
+ * one breakpoint is defined, so normal execution pays nothing
+ * more than a null pointer check on each memory access.
+ * When debugging is enabled, a per-page bitmap (one byte for
+ * each of the 256 pages of the addressing space) is checked
+ * first and the list of breakpoints is only scanned for
+ * accesses to pages that actually contain one.
+ */
+
+class Breakpoints
+{
+public:
+    Breakpoints() = default;
+    ~Breakpoints() = default;
+
+    // Kind of access that triggers a breakpoint, they can be
+    // combined to watch the same range for different accesses
+    enum AccessType : uint8_t
+    {
+        EXECUTE = 0x01,
+        READ = 0x02,
+        WRITE = 0x04
+    };
+
+    // Values a condition can refer to when it is evaluated
+    struct Context
+    {
+        uint16_t PC;
+        uint8_t A, X, Y, SP, PS;
+        uint16_t address;
+        uint8_t value;
+    };
+
+    /*
+     * Conditions are simple C-like expressions, for example
+     * "A==0x10 && X>3". They can use the CPU registers (A, X,
+     * Y, SP, PC, P), the accessed address and value (ADDR and
+     * VALUE), decimal or hexadecimal (0x or $) numbers, the
+     * usual comparison, logical and bitwise operators and
+     * parentheses. They are compiled once to postfix notation
+     * and evaluated on a small stack.
+     */
+    class Condition
+    {
+    public:
+        // Throws std::invalid_argument if the expression is malformed
+        Condition(const std::string& expression);
+
+        bool Evaluate(const Context& context) const;
+
+        bool IsEmpty() const { return program.empty(); }
+
+    private:
+        enum TokenType : uint8_t
+        {
+            NUMBER,
+            REGISTER,
+            UNARY_OPERATOR,
+            BINARY_OPERATOR,
+            OPEN_PARENTHESIS,
+            CLOSE_PARENTHESIS
+        };
+
+        struct Token
+        {
+            TokenType type;
+            // Operator or register identifier for non numeric tokens
+            int id;
+            uint32_t value;
+        };
+
+        static const int MAX_STACK_DEPTH = 32;
+
+        static std::vector<Token> Tokenize(const std::string& expression);
+        static int Precedence(int binaryOperator);
+
+        std::vector<Token> program;
+    };
+
+    struct Breakpoint
+    {
+        int id;
+        uint8_t type;
+        uint16_t start, end;
+        Condition condition;
+    };
+
+    // Information about the last breakpoint that triggered
+    struct Hit
+    {
+        int id;
+        uint8_t type;
+        uint16_t address;
+        uint8_t value;
+    };
+
+    int Add(uint8_t type, uint16_t start, uint16_t end, const std::string& condition);
+    bool Remove(int id);
+    void Clear();
+    bool IsEmpty() const { return breakpoints.empty(); }
+
+    const std::vector<Breakpoint>& GetList() const { return breakpoints; }
+
+    // Called by the bus on every access while debugging is enabled;
+    // the registers are read from the CPU only if a condition needs them
+    inline void CheckAccess(AccessType type, uint16_t address, uint8_t value, const class CPU& cpu)
+    {
+        if ((pageMask[address >> 8] & type) != 0)
+        {
+            Match(type, address, value, cpu);
+        }
+    }
+
+    // Checked by the debugger before fetching each instruction
+    inline bool CheckExecute(uint16_t address, const class CPU& cpu)
+    {
+        if ((pageMask[address >> 8] & EXECUTE) != 0)
+        {
+            Match(EXECUTE, address, 0, cpu);
+        }
+        return triggered;
+    }
+
+    bool HasTriggered() const { return triggered; }
+    const Hit& GetLastHit() const { return lastHit; }
+    void Acknowledge() { triggered = false; }
+
+    // While suspended no breakpoint can trigger, used by the debugger
+    // to inspect memory without stopping the program
+    void Suspend() { suspended++; }
+    void Resume() { suspended--; }
+
+private:
+    void Match(AccessType type, uint16_t address, uint8_t value, const class CPU& cpu);
+    void RebuildPageMask();
+
+    std::vector<Breakpoint> breakpoints;
+    std::array<uint8_t, 256> pageMask{};
+    int nextId = 1;
+    int suspended = 0;
+
+    bool triggered = false;
+    Hit lastHit{};
+};
+
+#endif // BREAKPOINTS_H
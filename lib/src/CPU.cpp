@@ -1,308 +1,336 @@
 #include "CPU.h"
+#include "BlockCache.h"
 #include "NES.h"
 #include <cstddef>
 #include <cstdint>
-#include <iostream>
-#include <fstream>
 #include <sys/types.h>
 
-CPU::CPU(NES& mainBus)
-    : mainBus(mainBus)
+constexpr std::array<CPU::Opcode, 256> CPU::MakeOpcodes()
 {
-    cycleCount = 0;
-
-    PS.value = 0x24;
-    A = X = Y = 0;
-    // SP value after reset will be 0xFD
-    SP = 0x00;
-
-    /*
-    // TODO: should be done by peripherals themselves
-    Write(0x4017, 0x00);
-    Write(0x4015, 0x00);
-    for (uint16_t lastBits = 0x0000; lastBits <= 0x0013; lastBits++)
-    {
-        uint16_t address = 0x4000 & lastBits;
-        mainBus.Write(address, 0x00);
-    }
-    // TODO: initialize APU registers
-    */
-
+    std::array<Opcode, 256> table{};
     // Fill all opcodes with Illegal dummy instruction to avoid crashes
-    opcodeTable.fill({&CPU::Illegal, "Illegal", IMP, 1, 2});
+    table.fill({&CPU::Illegal, {"Illegal", IMP, 1, 2}});
 
     // ADC
-    opcodeTable[0x69] = {&CPU::ADC<&CPU::Immediate>, "ADC", IMM, 2, 2};
-    opcodeTable[0x65] = {&CPU::ADC<&CPU::ZeroPage>, "ADC", ZP, 2, 3};
-    opcodeTable[0x75] = {&CPU::ADC<&CPU::ZeroPageX>, "ADC", ZPX, 2, 4};
-    opcodeTable[0x6D] = {&CPU::ADC<&CPU::Absolute>, "ADC", ABS, 3, 4};
-    opcodeTable[0x7D] = {&CPU::ADC<&CPU::AbsoluteX>, "ADC", ABSX, 3, 4, true};
-    opcodeTable[0x79] = {&CPU::ADC<&CPU::AbsoluteY>, "ADC", ABSY, 3, 4, true};
-    opcodeTable[0x61] = {&CPU::ADC<&CPU::IndexedIndirect>, "ADC", INDX, 2, 6};
-    opcodeTable[0x71] = {&CPU::ADC<&CPU::IndirectIndexed>, "ADC", INDY, 2, 5, true};
+    table[0x69] = {&CPU::ADC<&CPU::Immediate>, {"ADC", IMM, 2, 2}};
+    table[0x65] = {&CPU::ADC<&CPU::ZeroPage>, {"ADC", ZP, 2, 3}};
+    table[0x75] = {&CPU::ADC<&CPU::ZeroPageX>, {"ADC", ZPX, 2, 4}};
+    table[0x6D] = {&CPU::ADC<&CPU::Absolute>, {"ADC", ABS, 3, 4}};
+    table[0x7D] = {&CPU::ADC<&CPU::AbsoluteX>, {"ADC", ABSX, 3, 4, true}};
+    table[0x79] = {&CPU::ADC<&CPU::AbsoluteY>, {"ADC", ABSY, 3, 4, true}};
+    table[0x61] = {&CPU::ADC<&CPU::IndexedIndirect>, {"ADC", INDX, 2, 6}};
+    table[0x71] = {&CPU::ADC<&CPU::IndirectIndexed>, {"ADC", INDY, 2, 5, true}};
 
     // AND
-    opcodeTable[0x29] = {&CPU::AND<&CPU::Immediate>, "AND", IMM, 2, 2};
-    opcodeTable[0x25] = {&CPU::AND<&CPU::ZeroPage>, "AND", ZP, 2, 3};
-    opcodeTable[0x35] = {&CPU::AND<&CPU::ZeroPageX>, "AND", ZPX, 2, 4};
-    opcodeTable[0x2D] = {&CPU::AND<&CPU::Absolute>, "AND", ABS, 3, 4};
-    opcodeTable[0x3D] = {&CPU::AND<&CPU::AbsoluteX>, "AND", ABSX, 3, 4, true};
-    opcodeTable[0x39] = {&CPU::AND<&CPU::AbsoluteY>, "AND", ABSY, 3, 4, true};
-    opcodeTable[0x21] = {&CPU::AND<&CPU::IndexedIndirect>, "AND", INDX, 2, 6};
-    opcodeTable[0x31] = {&CPU::AND<&CPU::IndirectIndexed>, "AND", INDY, 2, 5, true};
+    table[0x29] = {&CPU::AND<&CPU::Immediate>, {"AND", IMM, 2, 2}};
+    table[0x25] = {&CPU::AND<&CPU::ZeroPage>, {"AND", ZP, 2, 3}};
+    table[0x35] = {&CPU::AND<&CPU::ZeroPageX>, {"AND", ZPX, 2, 4}};
+    table[0x2D] = {&CPU::AND<&CPU::Absolute>, {"AND", ABS, 3, 4}};
+    table[0x3D] = {&CPU::AND<&CPU::AbsoluteX>, {"AND", ABSX, 3, 4, true}};
+    table[0x39] = {&CPU::AND<&CPU::AbsoluteY>, {"AND", ABSY, 3, 4, true}};
+    table[0x21] = {&CPU::AND<&CPU::IndexedIndirect>, {"AND", INDX, 2, 6}};
+    table[0x31] = {&CPU::AND<&CPU::IndirectIndexed>, {"AND", INDY, 2, 5, true}};
 
     // ASL
-    opcodeTable[0x0A] = {&CPU::ASL<&CPU::Accumulator>, "ASL", ACC, 1, 2};
-    opcodeTable[0x06] = {&CPU::ASL<&CPU::ZeroPage>, "ASL", ZP, 2, 5};
-    opcodeTable[0x16] = {&CPU::ASL<&CPU::ZeroPageX>, "ASL", ZPX, 2, 6};
-    opcodeTable[0x0E] = {&CPU::ASL<&CPU::Absolute>, "ASL", ABS, 3, 6};
-    opcodeTable[0x1E] = {&CPU::ASL<&CPU::AbsoluteX>, "ASL", ABSX, 3, 7};
+    table[0x0A] = {&CPU::ASL<&CPU::Accumulator>, {"ASL", ACC, 1, 2}};
+    table[0x06] = {&CPU::ASL<&CPU::ZeroPage>, {"ASL", ZP, 2, 5}};
+    table[0x16] = {&CPU::ASL<&CPU::ZeroPageX>, {"ASL", ZPX, 2, 6}};
+    table[0x0E] = {&CPU::ASL<&CPU::Absolute>, {"ASL", ABS, 3, 6}};
+    table[0x1E] = {&CPU::ASL<&CPU::AbsoluteX>, {"ASL", ABSX, 3, 7}};
 
     // BCC
-    opcodeTable[0x90] = {&CPU::BCC<&CPU::Relative>, "BCC", REL, 2, 2, true};
+    table[0x90] = {&CPU::BCC<&CPU::Relative>, {"BCC", REL, 2, 2, true}};
 
     // BCS
-    opcodeTable[0xB0] = {&CPU::BCS<&CPU::Relative>, "BCS", REL, 2, 2, true};
+    table[0xB0] = {&CPU::BCS<&CPU::Relative>, {"BCS", REL, 2, 2, true}};
 
     // BEQ
-    opcodeTable[0xF0] = {&CPU::BEQ<&CPU::Relative>, "BEQ", REL, 2, 2, true};
+    table[0xF0] = {&CPU::BEQ<&CPU::Relative>, {"BEQ", REL, 2, 2, true}};
 
     // BIT
-    opcodeTable[0x24] = {&CPU::BIT<&CPU::ZeroPage>, "BIT", ZP, 2, 3};
-    opcodeTable[0x2C] = {&CPU::BIT<&CPU::Absolute>, "BIT", ABS, 3, 4};
+    table[0x24] = {&CPU::BIT<&CPU::ZeroPage>, {"BIT", ZP, 2, 3}};
+    table[0x2C] = {&CPU::BIT<&CPU::Absolute>, {"BIT", ABS, 3, 4}};
 
     // BMI
-    opcodeTable[0x30] = {&CPU::BMI<&CPU::Relative>, "BMI", REL, 2, 2, true};
+    table[0x30] = {&CPU::BMI<&CPU::Relative>, {"BMI", REL, 2, 2, true}};
 
     // BNE
-    opcodeTable[0xD0] = {&CPU::BNE<&CPU::Relative>, "BNE", REL, 2, 2, true};
+    table[0xD0] = {&CPU::BNE<&CPU::Relative>, {"BNE", REL, 2, 2, true}};
 
     // BPL
-    opcodeTable[0x10] = {&CPU::BPL<&CPU::Relative>, "BPL", REL, 2, 2, true};
+    table[0x10] = {&CPU::BPL<&CPU::Relative>, {"BPL", REL, 2, 2, true}};
 
     // BRK
-    opcodeTable[0x00] = {&CPU::BRK<&CPU::Implied>, "BRK", IMP, 1, 7};
+    table[0x00] = {&CPU::BRK<&CPU::Implied>, {"BRK", IMP, 1, 7}};
 
     // BVC
-    opcodeTable[0x50] = {&CPU::BVC<&CPU::Relative>, "BVC", REL, 2, 2, true};
+    table[0x50] = {&CPU::BVC<&CPU::Relative>, {"BVC", REL, 2, 2, true}};
 
     // BVS
-    opcodeTable[0x70] = {&CPU::BVS<&CPU::Relative>, "BVS", REL, 2, 2, true};
+    table[0x70] = {&CPU::BVS<&CPU::Relative>, {"BVS", REL, 2, 2, true}};
 
     // CLC
-    opcodeTable[0x18] = {&CPU::CLC<&CPU::Implied>, "CLC", IMP, 1, 2};
+    table[0x18] = {&CPU::CLC<&CPU::Implied>, {"CLC", IMP, 1, 2}};
 
     // CLD
-    opcodeTable[0xD8] = {&CPU::CLD<&CPU::Implied>, "CLD", IMP, 1, 2};
+    table[0xD8] = {&CPU::CLD<&CPU::Implied>, {"CLD", IMP, 1, 2}};
 
     // CLI
-    opcodeTable[0x58] = {&CPU::CLI<&CPU::Implied>, "CLI", IMP, 1, 2};
+    table[0x58] = {&CPU::CLI<&CPU::Implied>, {"CLI", IMP, 1, 2}};
 
     // CLV
-    opcodeTable[0xB8] = {&CPU::CLV<&CPU::Implied>, "CLV", IMP, 1, 2};
+    table[0xB8] = {&CPU::CLV<&CPU::Implied>, {"CLV", IMP, 1, 2}};
 
     // CMP
-    opcodeTable[0xC9] = {&CPU::CMP<&CPU::Immediate>, "CMP", IMM, 2, 2};
-    opcodeTable[0xC5] = {&CPU::CMP<&CPU::ZeroPage>, "CMP", ZP, 2, 3};
-    opcodeTable[0xD5] = {&CPU::CMP<&CPU::ZeroPageX>, "CMP", ZPX, 2, 4};
-    opcodeTable[0xCD] = {&CPU::CMP<&CPU::Absolute>, "CMP", ABS, 3, 4};
-    opcodeTable[0xDD] = {&CPU::CMP<&CPU::AbsoluteX>, "CMP", ABSX, 3, 4, true};
-    opcodeTable[0xD9] = {&CPU::CMP<&CPU::AbsoluteY>, "CMP", ABSY, 3, 4, true};
-    opcodeTable[0xC1] = {&CPU::CMP<&CPU::IndexedIndirect>, "CMP", INDX, 2, 6};
-    opcodeTable[0xD1] = {&CPU::CMP<&CPU::IndirectIndexed>, "CMP", INDY, 2, 5, true};
+    table[0xC9] = {&CPU::CMP<&CPU::Immediate>, {"CMP", IMM, 2, 2}};
+    table[0xC5] = {&CPU::CMP<&CPU::ZeroPage>, {"CMP", ZP, 2, 3}};
+    table[0xD5] = {&CPU::CMP<&CPU::ZeroPageX>, {"CMP", ZPX, 2, 4}};
+    table[0xCD] = {&CPU::CMP<&CPU::Absolute>, {"CMP", ABS, 3, 4}};
+    table[0xDD] = {&CPU::CMP<&CPU::AbsoluteX>, {"CMP", ABSX, 3, 4, true}};
+    table[0xD9] = {&CPU::CMP<&CPU::AbsoluteY>, {"CMP", ABSY, 3, 4, true}};
+    table[0xC1] = {&CPU::CMP<&CPU::IndexedIndirect>, {"CMP", INDX, 2, 6}};
+    table[0xD1] = {&CPU::CMP<&CPU::IndirectIndexed>, {"CMP", INDY, 2, 5, true}};
 
     // CPX
-    opcodeTable[0xE0] = {&CPU::CPX<&CPU::Immediate>, "CPX", IMM, 2, 2};
-    opcodeTable[0xE4] = {&CPU::CPX<&CPU::ZeroPage>, "CPX", ZP, 2, 3};
-    opcodeTable[0xEC] = {&CPU::CPX<&CPU::Absolute>, "CPX", ABS, 3, 4};
+    table[0xE0] = {&CPU::CPX<&CPU::Immediate>, {"CPX", IMM, 2, 2}};
+    table[0xE4] = {&CPU::CPX<&CPU::ZeroPage>, {"CPX", ZP, 2, 3}};
+    table[0xEC] = {&CPU::CPX<&CPU::Absolute>, {"CPX", ABS, 3, 4}};
 
     // CPY
-    opcodeTable[0xC0] = {&CPU::CPY<&CPU::Immediate>, "CPY", IMM, 2, 2};
-    opcodeTable[0xC4] = {&CPU::CPY<&CPU::ZeroPage>, "CPY", ZP, 2, 3};
-    opcodeTable[0xCC] = {&CPU::CPY<&CPU::Absolute>, "CPY", ABS, 3, 4};
+    table[0xC0] = {&CPU::CPY<&CPU::Immediate>, {"CPY", IMM, 2, 2}};
+    table[0xC4] = {&CPU::CPY<&CPU::ZeroPage>, {"CPY", ZP, 2, 3}};
+    table[0xCC] = {&CPU::CPY<&CPU::Absolute>, {"CPY", ABS, 3, 4}};
 
     // DEC
-    opcodeTable[0xC6] = {&CPU::DEC<&CPU::ZeroPage>, "DEC", ZP, 2, 5};
-    opcodeTable[0xD6] = {&CPU::DEC<&CPU::ZeroPageX>, "DEC", ZPX, 2, 6};
-    opcodeTable[0xCE] = {&CPU::DEC<&CPU::Absolute>, "DEC", ABS, 3, 6};
-    opcodeTable[0xDE] = {&CPU::DEC<&CPU::AbsoluteX>, "DEC", ABSX, 3, 7};
+    table[0xC6] = {&CPU::DEC<&CPU::ZeroPage>, {"DEC", ZP, 2, 5}};
+    table[0xD6] = {&CPU::DEC<&CPU::ZeroPageX>, {"DEC", ZPX, 2, 6}};
+    table[0xCE] = {&CPU::DEC<&CPU::Absolute>, {"DEC", ABS, 3, 6}};
+    table[0xDE] = {&CPU::DEC<&CPU::AbsoluteX>, {"DEC", ABSX, 3, 7}};
 
     // DEX
-    opcodeTable[0xCA] = {&CPU::DEX<&CPU::Immediate>, "DEX", IMM, 1, 2};
+    table[0xCA] = {&CPU::DEX<&CPU::Immediate>, {"DEX", IMM, 1, 2}};
 
     // DEY
-    opcodeTable[0x88] = {&CPU::DEY<&CPU::Immediate>, "DEY", IMM, 1, 2};
+    table[0x88] = {&CPU::DEY<&CPU::Immediate>, {"DEY", IMM, 1, 2}};
 
     // EOR
-    opcodeTable[0x49] = {&CPU::EOR<&CPU::Immediate>, "EOR", IMM, 2, 2};
-    opcodeTable[0x45] = {&CPU::EOR<&CPU::ZeroPage>, "EOR", ZP, 2, 3};
-    opcodeTable[0x55] = {&CPU::EOR<&CPU::ZeroPageX>, "EOR", ZPX, 2, 4};
-    opcodeTable[0x4D] = {&CPU::EOR<&CPU::Absolute>, "EOR", ABS, 3, 4};
-    opcodeTable[0x5D] = {&CPU::EOR<&CPU::AbsoluteX>, "EOR", ABSX, 3, 4, true};
-    opcodeTable[0x59] = {&CPU::EOR<&CPU::AbsoluteY>, "EOR", ABSY, 3, 4, true};
-    opcodeTable[0x41] = {&CPU::EOR<&CPU::IndexedIndirect>, "EOR", INDX, 2, 6};
-    opcodeTable[0x51] = {&CPU::EOR<&CPU::IndirectIndexed>, "EOR", INDY, 2, 5, true};
+    table[0x49] = {&CPU::EOR<&CPU::Immediate>, {"EOR", IMM, 2, 2}};
+    table[0x45] = {&CPU::EOR<&CPU::ZeroPage>, {"EOR", ZP, 2, 3}};
+    table[0x55] = {&CPU::EOR<&CPU::ZeroPageX>, {"EOR", ZPX, 2, 4}};
+    table[0x4D] = {&CPU::EOR<&CPU::Absolute>, {"EOR", ABS, 3, 4}};
+    table[0x5D] = {&CPU::EOR<&CPU::AbsoluteX>, {"EOR", ABSX, 3, 4, true}};
+    table[0x59] = {&CPU::EOR<&CPU::AbsoluteY>, {"EOR", ABSY, 3, 4, true}};
+    table[0x41] = {&CPU::EOR<&CPU::IndexedIndirect>, {"EOR", INDX, 2, 6}};
+    table[0x51] = {&CPU::EOR<&CPU::IndirectIndexed>, {"EOR", INDY, 2, 5, true}};
 
     // INC
-    opcodeTable[0xE6] = {&CPU::INC<&CPU::ZeroPage>, "INC", ZP, 2, 5};
-    opcodeTable[0xF6] = {&CPU::INC<&CPU::ZeroPageX>, "INC", ZPX, 2, 6};
-    opcodeTable[0xEE] = {&CPU::INC<&CPU::Absolute>, "INC", ABS, 3, 6};
-    opcodeTable[0xFE] = {&CPU::INC<&CPU::AbsoluteX>, "INC", ABSX, 3, 7};
+    table[0xE6] = {&CPU::INC<&CPU::ZeroPage>, {"INC", ZP, 2, 5}};
+    table[0xF6] = {&CPU::INC<&CPU::ZeroPageX>, {"INC", ZPX, 2, 6}};
+    table[0xEE] = {&CPU::INC<&CPU::Absolute>, {"INC", ABS, 3, 6}};
+    table[0xFE] = {&CPU::INC<&CPU::AbsoluteX>, {"INC", ABSX, 3, 7}};
 
     // INX
-    opcodeTable[0xE8] = {&CPU::INX<&CPU::Immediate>, "INX", IMM, 1, 2};
+    table[0xE8] = {&CPU::INX<&CPU::Immediate>, {"INX", IMM, 1, 2}};
 
     // INY
-    opcodeTable[0xC8] = {&CPU::INY<&CPU::Immediate>, "INY", IMM, 1, 2};
+    table[0xC8] = {&CPU::INY<&CPU::Immediate>, {"INY", IMM, 1, 2}};
 
     // JMP
-    opcodeTable[0x4C] = {&CPU::JMP<&CPU::Absolute>, "JMP", ABS, 3, 3};
-    opcodeTable[0x6C] = {&CPU::JMP<&CPU::Indirect>, "JMP", IND, 3, 5};
+    table[0x4C] = {&CPU::JMP<&CPU::Absolute>, {"JMP", ABS, 3, 3}};
+    table[0x6C] = {&CPU::JMP<&CPU::Indirect>, {"JMP", IND, 3, 5}};
 
     // JSR
-    opcodeTable[0x20] = {&CPU::JSR<&CPU::Absolute>, "JSR", ABS, 3, 6};
+    table[0x20] = {&CPU::JSR<&CPU::Absolute>, {"JSR", ABS, 3, 6}};
 
     // LDA
-    opcodeTable[0xA9] = {&CPU::LDA<&CPU::Immediate>, "LDA", IMM, 2, 2};
-    opcodeTable[0xA5] = {&CPU::LDA<&CPU::ZeroPage>, "LDA", ZP, 2, 3};
-    opcodeTable[0xB5] = {&CPU::LDA<&CPU::ZeroPageX>, "LDA", ZPX, 2, 4};
-    opcodeTable[0xAD] = {&CPU::LDA<&CPU::Absolute>, "LDA", ABS, 3, 4};
-    opcodeTable[0xBD] = {&CPU::LDA<&CPU::AbsoluteX>, "LDA", ABSX, 3, 4, true};
-    opcodeTable[0xB9] = {&CPU::LDA<&CPU::AbsoluteY>, "LDA", ABSY, 3, 4, true};
-    opcodeTable[0xA1] = {&CPU::LDA<&CPU::IndexedIndirect>, "LDA", INDX, 2, 6};
-    opcodeTable[0xB1] = {&CPU::LDA<&CPU::IndirectIndexed>, "LDA", INDY, 2, 5, true};
+    table[0xA9] = {&CPU::LDA<&CPU::Immediate>, {"LDA", IMM, 2, 2}};
+    table[0xA5] = {&CPU::LDA<&CPU::ZeroPage>, {"LDA", ZP, 2, 3}};
+    table[0xB5] = {&CPU::LDA<&CPU::ZeroPageX>, {"LDA", ZPX, 2, 4}};
+    table[0xAD] = {&CPU::LDA<&CPU::Absolute>, {"LDA", ABS, 3, 4}};
+    table[0xBD] = {&CPU::LDA<&CPU::AbsoluteX>, {"LDA", ABSX, 3, 4, true}};
+    table[0xB9] = {&CPU::LDA<&CPU::AbsoluteY>, {"LDA", ABSY, 3, 4, true}};
+    table[0xA1] = {&CPU::LDA<&CPU::IndexedIndirect>, {"LDA", INDX, 2, 6}};
+    table[0xB1] = {&CPU::LDA<&CPU::IndirectIndexed>, {"LDA", INDY, 2, 5, true}};
 
     // LDX
-    opcodeTable[0xA2] = {&CPU::LDX<&CPU::Immediate>, "LDX", IMM, 2, 2};
-    opcodeTable[0xA6] = {&CPU::LDX<&CPU::ZeroPage>, "LDX", ZP, 2, 3};
-    opcodeTable[0xB6] = {&CPU::LDX<&CPU::ZeroPageY>, "LDX", ZPY, 2, 4};
-    opcodeTable[0xAE] = {&CPU::LDX<&CPU::Absolute>, "LDX", ABS, 3, 4};
-    opcodeTable[0xBE] = {&CPU::LDX<&CPU::AbsoluteY>, "LDX", ABSY, 3, 4, true};
+    table[0xA2] = {&CPU::LDX<&CPU::Immediate>, {"LDX", IMM, 2, 2}};
+    table[0xA6] = {&CPU::LDX<&CPU::ZeroPage>, {"LDX", ZP, 2, 3}};
+    table[0xB6] = {&CPU::LDX<&CPU::ZeroPageY>, {"LDX", ZPY, 2, 4}};
+    table[0xAE] = {&CPU::LDX<&CPU::Absolute>, {"LDX", ABS, 3, 4}};
+    table[0xBE] = {&CPU::LDX<&CPU::AbsoluteY>, {"LDX", ABSY, 3, 4, true}};
 
     // LDY
-    opcodeTable[0xA0] = {&CPU::LDY<&CPU::Immediate>, "LDY", IMM, 2, 2};
-    opcodeTable[0xA4] = {&CPU::LDY<&CPU::ZeroPage>, "LDY", ZP, 2, 3};
-    opcodeTable[0xB4] = {&CPU::LDY<&CPU::ZeroPageX>, "LDY", ZPX, 2, 4};
-    opcodeTable[0xAC] = {&CPU::LDY<&CPU::Absolute>, "LDY", ABS, 3, 4};
-    opcodeTable[0xBC] = {&CPU::LDY<&CPU::AbsoluteX>, "LDY", ABSX, 3, 4, true};
+    table[0xA0] = {&CPU::LDY<&CPU::Immediate>, {"LDY", IMM, 2, 2}};
+    table[0xA4] = {&CPU::LDY<&CPU::ZeroPage>, {"LDY", ZP, 2, 3}};
+    table[0xB4] = {&CPU::LDY<&CPU::ZeroPageX>, {"LDY", ZPX, 2, 4}};
+    table[0xAC] = {&CPU::LDY<&CPU::Absolute>, {"LDY", ABS, 3, 4}};
+    table[0xBC] = {&CPU::LDY<&CPU::AbsoluteX>, {"LDY", ABSX, 3, 4, true}};
 
     // LSR
-    opcodeTable[0x4A] = {&CPU::LSR<&CPU::Accumulator>, "LSR", ACC, 1, 2};
-    opcodeTable[0x46] = {&CPU::LSR<&CPU::ZeroPage>, "LSR", ZP, 2, 5};
-    opcodeTable[0x56] = {&CPU::LSR<&CPU::ZeroPageX>, "LSR", ZPX, 2, 6};
-    opcodeTable[0x4E] = {&CPU::LSR<&CPU::Absolute>, "LSR", ABS, 3, 6};
-    opcodeTable[0x5E] = {&CPU::LSR<&CPU::AbsoluteX>, "LSR", ABSX, 3, 7};
+    table[0x4A] = {&CPU::LSR<&CPU::Accumulator>, {"LSR", ACC, 1, 2}};
+    table[0x46] = {&CPU::LSR<&CPU::ZeroPage>, {"LSR", ZP, 2, 5}};
+    table[0x56] = {&CPU::LSR<&CPU::ZeroPageX>, {"LSR", ZPX, 2, 6}};
+    table[0x4E] = {&CPU::LSR<&CPU::Absolute>, {"LSR", ABS, 3, 6}};
+    table[0x5E] = {&CPU::LSR<&CPU::AbsoluteX>, {"LSR", ABSX, 3, 7}};
 
     // NOP
-    opcodeTable[0xEA] = {&CPU::NOP<&CPU::Implied>, "NOP", IMP, 1, 2};
+    table[0xEA] = {&CPU::NOP<&CPU::Implied>, {"NOP", IMP, 1, 2}};
 
     // ORA
-    opcodeTable[0x09] = {&CPU::ORA<&CPU::Immediate>, "ORA", IMM, 2, 2};
-    opcodeTable[0x05] = {&CPU::ORA<&CPU::ZeroPage>, "ORA", ZP, 2, 3};
-    opcodeTable[0x15] = {&CPU::ORA<&CPU::ZeroPageX>, "ORA", ZPX, 2, 4};
-    opcodeTable[0x0D] = {&CPU::ORA<&CPU::Absolute>, "ORA", ABS, 3, 4};
-    opcodeTable[0x1D] = {&CPU::ORA<&CPU::AbsoluteX>, "ORA", ABSX, 3, 4, true};
-    opcodeTable[0x19] = {&CPU::ORA<&CPU::AbsoluteY>, "ORA", ABSY, 3, 4, true};
-    opcodeTable[0x01] = {&CPU::ORA<&CPU::IndexedIndirect>, "ORA", INDX, 2, 6};
-    opcodeTable[0x11] = {&CPU::ORA<&CPU::IndirectIndexed>, "ORA", INDY, 2, 5, true};
+    table[0x09] = {&CPU::ORA<&CPU::Immediate>, {"ORA", IMM, 2, 2}};
+    table[0x05] = {&CPU::ORA<&CPU::ZeroPage>, {"ORA", ZP, 2, 3}};
+    table[0x15] = {&CPU::ORA<&CPU::ZeroPageX>, {"ORA", ZPX, 2, 4}};
+    table[0x0D] = {&CPU::ORA<&CPU::Absolute>, {"ORA", ABS, 3, 4}};
+    table[0x1D] = {&CPU::ORA<&CPU::AbsoluteX>, {"ORA", ABSX, 3, 4, true}};
+    table[0x19] = {&CPU::ORA<&CPU::AbsoluteY>, {"ORA", ABSY, 3, 4, true}};
+    table[0x01] = {&CPU::ORA<&CPU::IndexedIndirect>, {"ORA", INDX, 2, 6}};
+    table[0x11] = {&CPU::ORA<&CPU::IndirectIndexed>, {"ORA", INDY, 2, 5, true}};
 
     // PHA
-    opcodeTable[0x48] = {&CPU::PHA<&CPU::Implied>, "PHA", IMP, 1, 3};
+    table[0x48] = {&CPU::PHA<&CPU::Implied>, {"PHA", IMP, 1, 3}};
 
     // PHP
-    opcodeTable[0x08] = {&CPU::PHP<&CPU::Implied>, "PHP", IMP, 1, 3};
+    table[0x08] = {&CPU::PHP<&CPU::Implied>, {"PHP", IMP, 1, 3}};
 
     // PLA
-    opcodeTable[0x68] = {&CPU::PLA<&CPU::Implied>, "PLA", IMP, 1, 4};
+    table[0x68] = {&CPU::PLA<&CPU::Implied>, {"PLA", IMP, 1, 4}};
 
     // PLP
-    opcodeTable[0x28] = {&CPU::PLP<&CPU::Implied>, "PLP", IMP, 1, 4};
+    table[0x28] = {&CPU::PLP<&CPU::Implied>, {"PLP", IMP, 1, 4}};
 
     // ROL
-    opcodeTable[0x2A] = {&CPU::ROL<&CPU::Accumulator>, "ROL", ACC, 1, 2};
-    opcodeTable[0x26] = {&CPU::ROL<&CPU::ZeroPage>, "ROL", ZP, 2, 5};
-    opcodeTable[0x36] = {&CPU::ROL<&CPU::ZeroPageX>, "ROL", ZPX, 2, 6};
-    opcodeTable[0x2E] = {&CPU::ROL<&CPU::Absolute>, "ROL", ABS, 3, 6};
-    opcodeTable[0x3E] = {&CPU::ROL<&CPU::AbsoluteX>, "ROL", ABSX, 3, 7};
+    table[0x2A] = {&CPU::ROL<&CPU::Accumulator>, {"ROL", ACC, 1, 2}};
+    table[0x26] = {&CPU::ROL<&CPU::ZeroPage>, {"ROL", ZP, 2, 5}};
+    table[0x36] = {&CPU::ROL<&CPU::ZeroPageX>, {"ROL", ZPX, 2, 6}};
+    table[0x2E] = {&CPU::ROL<&CPU::Absolute>, {"ROL", ABS, 3, 6}};
+    table[0x3E] = {&CPU::ROL<&CPU::AbsoluteX>, {"ROL", ABSX, 3, 7}};
 
     // ROR
-    opcodeTable[0x6A] = {&CPU::ROR<&CPU::Accumulator>, "ROR", ACC, 1, 2};
-    opcodeTable[0x66] = {&CPU::ROR<&CPU::ZeroPage>, "ROR", ZP, 2, 5};
-    opcodeTable[0x76] = {&CPU::ROR<&CPU::ZeroPageX>, "ROR", ZPX, 2, 6};
-    opcodeTable[0x6E] = {&CPU::ROR<&CPU::Absolute>, "ROR", ABS, 3, 6};
-    opcodeTable[0x7E] = {&CPU::ROR<&CPU::AbsoluteX>, "ROR", ABSX, 3, 7};
+    table[0x6A] = {&CPU::ROR<&CPU::Accumulator>, {"ROR", ACC, 1, 2}};
+    table[0x66] = {&CPU::ROR<&CPU::ZeroPage>, {"ROR", ZP, 2, 5}};
+    table[0x76] = {&CPU::ROR<&CPU::ZeroPageX>, {"ROR", ZPX, 2, 6}};
+    table[0x6E] = {&CPU::ROR<&CPU::Absolute>, {"ROR", ABS, 3, 6}};
+    table[0x7E] = {&CPU::ROR<&CPU::AbsoluteX>, {"ROR", ABSX, 3, 7}};
 
     // RTI
-    opcodeTable[0x40] = {&CPU::RTI<&CPU::Implied>, "RTI", IMP, 1, 6};
+    table[0x40] = {&CPU::RTI<&CPU::Implied>, {"RTI", IMP, 1, 6}};
 
     // RTS
-    opcodeTable[0x60] = {&CPU::RTS<&CPU::Implied>, "RTS", IMP, 1, 6};
+    table[0x60] = {&CPU::RTS<&CPU::Implied>, {"RTS", IMP, 1, 6}};
 
     // SBC
-    opcodeTable[0xE9] = {&CPU::SBC<&CPU::Immediate>, "SBC", IMM, 2, 2};
-    opcodeTable[0xE5] = {&CPU::SBC<&CPU::ZeroPage>, "SBC", ZP, 2, 3};
-    opcodeTable[0xF5] = {&CPU::SBC<&CPU::ZeroPageX>, "SBC", ZPX, 2, 4};
-    opcodeTable[0xED] = {&CPU::SBC<&CPU::Absolute>, "SBC", ABS, 3, 4};
-    opcodeTable[0xFD] = {&CPU::SBC<&CPU::AbsoluteX>, "SBC", ABSX, 3, 4, true};
-    opcodeTable[0xF9] = {&CPU::SBC<&CPU::AbsoluteY>, "SBC", ABSY, 3, 4, true};
-    opcodeTable[0xE1] = {&CPU::SBC<&CPU::IndexedIndirect>, "SBC", INDX, 2, 6};
-    opcodeTable[0xF1] = {&CPU::SBC<&CPU::IndirectIndexed>, "SBC", INDY, 2, 5, true};
+    table[0xE9] = {&CPU::SBC<&CPU::Immediate>, {"SBC", IMM, 2, 2}};
+    table[0xE5] = {&CPU::SBC<&CPU::ZeroPage>, {"SBC", ZP, 2, 3}};
+    table[0xF5] = {&CPU::SBC<&CPU::ZeroPageX>, {"SBC", ZPX, 2, 4}};
+    table[0xED] = {&CPU::SBC<&CPU::Absolute>, {"SBC", ABS, 3, 4}};
+    table[0xFD] = {&CPU::SBC<&CPU::AbsoluteX>, {"SBC", ABSX, 3, 4, true}};
+    table[0xF9] = {&CPU::SBC<&CPU::AbsoluteY>, {"SBC", ABSY, 3, 4, true}};
+    table[0xE1] = {&CPU::SBC<&CPU::IndexedIndirect>, {"SBC", INDX, 2, 6}};
+    table[0xF1] = {&CPU::SBC<&CPU::IndirectIndexed>, {"SBC", INDY, 2, 5, true}};
 
     // SEC
-    opcodeTable[0x38] = {&CPU::SEC<&CPU::Implied>, "SEC", IMP, 1, 2};
+    table[0x38] = {&CPU::SEC<&CPU::Implied>, {"SEC", IMP, 1, 2}};
 
     // SED
-    opcodeTable[0xF8] = {&CPU::SED<&CPU::Implied>, "SED", IMP, 1, 2};
+    table[0xF8] = {&CPU::SED<&CPU::Implied>, {"SED", IMP, 1, 2}};
 
     // SEI
-    opcodeTable[0x78] = {&CPU::SEI<&CPU::Implied>, "SEI", IMP, 1, 2};
+    table[0x78] = {&CPU::SEI<&CPU::Implied>, {"SEI", IMP, 1, 2}};
 
     // STA
-    opcodeTable[0x85] = {&CPU::STA<&CPU::ZeroPage>, "STA", ZP, 2, 3};
-    opcodeTable[0x95] = {&CPU::STA<&CPU::ZeroPageX>, "STA", ZPX, 2, 4};
-    opcodeTable[0x8D] = {&CPU::STA<&CPU::Absolute>, "STA", ABS, 3, 4};
-    opcodeTable[0x9D] = {&CPU::STA<&CPU::AbsoluteX>, "STA", ABSX, 3, 5};
-    opcodeTable[0x99] = {&CPU::STA<&CPU::AbsoluteY>, "STA", ABSY, 3, 5};
-    opcodeTable[0x81] = {&CPU::STA<&CPU::IndexedIndirect>, "STA", INDX, 2, 6};
-    opcodeTable[0x91] = {&CPU::STA<&CPU::IndirectIndexed>, "STA", INDY, 2, 6};
+    table[0x85] = {&CPU::STA<&CPU::ZeroPage>, {"STA", ZP, 2, 3}};
+    table[0x95] = {&CPU::STA<&CPU::ZeroPageX>, {"STA", ZPX, 2, 4}};
+    table[0x8D] = {&CPU::STA<&CPU::Absolute>, {"STA", ABS, 3, 4}};
+    table[0x9D] = {&CPU::STA<&CPU::AbsoluteX>, {"STA", ABSX, 3, 5}};
+    table[0x99] = {&CPU::STA<&CPU::AbsoluteY>, {"STA", ABSY, 3, 5}};
+    table[0x81] = {&CPU::STA<&CPU::IndexedIndirect>, {"STA", INDX, 2, 6}};
+    table[0x91] = {&CPU::STA<&CPU::IndirectIndexed>, {"STA", INDY, 2, 6}};
 
     // STX
-    opcodeTable[0x86] = {&CPU::STX<&CPU::ZeroPage>, "STX", ZP, 2, 3};
-    opcodeTable[0x96] = {&CPU::STX<&CPU::ZeroPageY>, "STX", ZPY, 2, 4};
-    opcodeTable[0x8E] = {&CPU::STX<&CPU::Absolute>, "STX", ABS, 3, 4};
+    table[0x86] = {&CPU::STX<&CPU::ZeroPage>, {"STX", ZP, 2, 3}};
+    table[0x96] = {&CPU::STX<&CPU::ZeroPageY>, {"STX", ZPY, 2, 4}};
+    table[0x8E] = {&CPU::STX<&CPU::Absolute>, {"STX", ABS, 3, 4}};
 
     // STY
-    opcodeTable[0x84] = {&CPU::STY<&CPU::ZeroPage>, "STY", ZP, 2, 3};
-    opcodeTable[0x94] = {&CPU::STY<&CPU::ZeroPageX>, "STY", ZPX, 2, 4};
-    opcodeTable[0x8C] = {&CPU::STY<&CPU::Absolute>, "STY", ABS, 3, 4};
+    table[0x84] = {&CPU::STY<&CPU::ZeroPage>, {"STY", ZP, 2, 3}};
+    table[0x94] = {&CPU::STY<&CPU::ZeroPageX>, {"STY", ZPX, 2, 4}};
+    table[0x8C] = {&CPU::STY<&CPU::Absolute>, {"STY", ABS, 3, 4}};
 
     // TAX
-    opcodeTable[0xAA] = {&CPU::TAX<&CPU::Implied>, "TAX", IMP, 1, 2};
+    table[0xAA] = {&CPU::TAX<&CPU::Implied>, {"TAX", IMP, 1, 2}};
 
     // TAY
-    opcodeTable[0xA8] = {&CPU::TAY<&CPU::Implied>, "TAY", IMP, 1, 2};
+    table[0xA8] = {&CPU::TAY<&CPU::Implied>, {"TAY", IMP, 1, 2}};
 
     // TSX
-    opcodeTable[0xBA] = {&CPU::TSX<&CPU::Implied>, "TSX", IMP, 1, 2};
+    table[0xBA] = {&CPU::TSX<&CPU::Implied>, {"TSX", IMP, 1, 2}};
 
     // TXA
-    opcodeTable[0x8A] = {&CPU::TXA<&CPU::Implied>, "TXA", IMP, 1, 2};
+    table[0x8A] = {&CPU::TXA<&CPU::Implied>, {"TXA", IMP, 1, 2}};
 
     // TXS
-    opcodeTable[0x9A] = {&CPU::TXS<&CPU::Implied>, "TXS", IMP, 1, 2};
+    table[0x9A] = {&CPU::TXS<&CPU::Implied>, {"TXS", IMP, 1, 2}};
 
     // TYA
-    opcodeTable[0x98] = {&CPU::TYA<&CPU::Implied>, "TYA", IMP, 1, 2};
+    table[0x98] = {&CPU::TYA<&CPU::Implied>, {"TYA", IMP, 1, 2}};
+
+    return table;
 }
 
+constinit const std::array<CPU::Instruction, 256> CPU::instructions = [] {
+    std::array<Instruction, 256> table{};
+    std::array<Opcode, 256> opcodes = MakeOpcodes();
+    for (size_t opcode = 0; opcode < table.size(); opcode++)
+    {
+        table[opcode] = opcodes[opcode].instruction;
+    }
+    return table;
+}();
+
+constinit const std::array<CPU::InstructionPtr, 256> CPU::defaultHandlers = [] {
+    std::array<InstructionPtr, 256> table{};
+    std::array<Opcode, 256> opcodes = MakeOpcodes();
+    for (size_t opcode = 0; opcode < table.size(); opcode++)
+    {
+        table[opcode] = opcodes[opcode].handler;
+    }
+    return table;
+}();
+
+CPU::CPU(NES& mainBus)
+    : mainBus(mainBus)
+{
+    SetStatus(0x24);
+    A = X = Y = 0;
+    // SP value after reset will be 0xFD
+    SP = 0x00;
+
+    /*
+    // TODO: should be done by peripherals themselves
+    Write(0x4017, 0x00);
+    Write(0x4015, 0x00);
+    for (uint16_t lastBits = 0x0000; lastBits <= 0x0013; lastBits++)
+    {
+        uint16_t address = 0x4000 & lastBits;
+        mainBus.Write(address, 0x00);
+    }
+    // TODO: initialize APU registers
+    */
+
+    handlers = defaultHandlers;
+}
+
+CPU::~CPU() = default;
+
 void CPU::ExecuteInstrFromRAM(uint16_t startingLocation, size_t number)
 {
-    cycleCount = 0;
+    const MasterClock& clock = mainBus.GetClock();
+    uint64_t startingCycle = clock.GetCpuCycles();
     PC = startingLocation;
-    while (PC < (startingLocation + number) && PC >= startingLocation && cycleCount < CYCLES_PER_FRAME)
+    while (PC < (startingLocation + number) && PC >= startingLocation &&
+           clock.GetCpuCycles() - startingCycle < CYCLES_PER_FRAME)
     {
-        opcode = Read(PC++);
-        ExecuteInstruction();
+        Step();
     }
 }
 
@@ -310,14 +338,13 @@ void CPU::Run()
 {
     do
     {
-        opcode = Read(PC++);
-        ExecuteInstruction();
-    } while(opcode != 0x00 && opcodeTable[opcode].ptr != &CPU::Illegal);
+        Step();
+    } while(opcode != 0x00 && handlers[opcode] != &CPU::Illegal);
 }
 
 void CPU::Reset()
 {
-    PS.Set<I>();
+    SetFlag<I>();
     Tick();
     Tick();
     Tick();
@@ -332,15 +359,181 @@ void CPU::Reset()
     PC = (PCH << 8) | PCL;
 }
 
+void CPU::Interrupt(uint16_t vector)
+{
+    // The next opcode is read twice and discarded
+    Tick();
+    Tick();
+    PushStack((PC & 0xFF00) >> 8);
+    PushStack(PC & 0x00FF);
+    PushStack((GetStatus() & ~B) | _);
+    SetFlag<I>();
+    uint8_t PCL = Read(vector);
+    uint8_t PCH = Read(vector + 1);
+    PC = (PCH << 8) | PCL;
+}
+
+void CPU::NMI()
+{
+    mainBus.AcknowledgeNmi();
+    Interrupt(0xFFFA);
+}
+
+void CPU::IRQ()
+{
+    // The line stays asserted until the source is acknowledged
+    Interrupt(0xFFFE);
+}
+
+bool CPU::Step()
+{
+    // Interrupts are polled between instructions
+    if (mainBus.IsNmiPending()) [[unlikely]]
+    {
+        NMI();
+        return true;
+    }
+    if (mainBus.IsApuEventPending()) [[unlikely]]
+    {
+        mainBus.RunApuEvents();
+    }
+    if (mainBus.IsIrqAsserted() && !TestFlag<I>()) [[unlikely]]
+    {
+        IRQ();
+        return true;
+    }
+    const BlockCache::Instruction* instruction = blockCache ? blockCache->Next(PC) : nullptr;
+#ifdef NESPP_JIT
+    if (instruction != nullptr)
+    {
+        // The compiled code only polls for interrupts once it is done,
+        // the block is interpreted when one may fall due before that
+        const CompiledCode* code = blockCache->GetCompiledCode(instruction);
+        if (code != nullptr && !mainBus.IsEventDueWithin(code->cycles))
+        {
+            RunCompiled(*code);
+            return false;
+        }
+    }
+#endif
+    if (instruction != nullptr)
+    {
+        // Same bus timing as reading the opcode
+        Tick();
+        PC++;
+        opcode = instruction->opcode;
+        operands = instruction->operands.data();
+        (this->*(instruction->ptr))();
+        operands = nullptr;
+    }
+    else
+    {
+        opcode = Read(PC++);
+        ExecuteInstruction();
+    }
+#ifdef NESPP_INSTRUMENTATION
+    instructionCount++;
+#endif
+    return false;
+}
+
+#ifdef NESPP_JIT
+void CPU::RunCompiled(const CompiledCode& code)
+{
+    CompiledRegisters registers{A, X, Y, SP, GetStatus()};
+    code.function(&registers);
+    A = registers.A;
+    X = registers.X;
+    Y = registers.Y;
+    SP = registers.SP;
+    SetStatus(registers.P);
+    PC += code.bytes;
+    opcode = code.lastOpcode;
+    // The compiled instructions only read their own bytes from ROM, and no
+    // interrupt falls due before the end of the block (see Step), so nothing
+    // else on the bus can observe that the ticks are late
+    for (int cycle = 0; cycle < code.cycles; cycle++)
+    {
+        Tick();
+    }
+    blockCache->Skip(code.instructions - 1);
+#ifdef NESPP_INSTRUMENTATION
+    instructionCount += code.instructions;
+#endif
+}
+#endif
+
+void CPU::EnableBlockCache(bool enable)
+{
+    if (enable)
+    {
+        blockCache = std::make_unique<BlockCache>(*this, mainBus);
+    }
+    else
+    {
+        blockCache.reset();
+    }
+}
+
+void CPU::SetAccuracyProfile(AccuracyProfile profile)
+{
+    if (profile == FAST)
+    {
+        SetReadModifyWriteInstructions<FAST>();
+    }
+    else
+    {
+        SetReadModifyWriteInstructions<EXACT>();
+    }
+    accuracyProfile = profile;
+    if (blockCache)
+    {
+        // The blocks hold the instructions they were decoded with
+        blockCache->Clear();
+    }
+}
+
+template <CPU::AccuracyProfile profile>
+void CPU::SetReadModifyWriteInstructions()
+{
+    handlers[0x06] = &CPU::ASL<&CPU::ZeroPage, profile>;
+    handlers[0x16] = &CPU::ASL<&CPU::ZeroPageX, profile>;
+    handlers[0x0E] = &CPU::ASL<&CPU::Absolute, profile>;
+    handlers[0x1E] = &CPU::ASL<&CPU::AbsoluteX, profile>;
+
+    handlers[0xC6] = &CPU::DEC<&CPU::ZeroPage, profile>;
+    handlers[0xD6] = &CPU::DEC<&CPU::ZeroPageX, profile>;
+    handlers[0xCE] = &CPU::DEC<&CPU::Absolute, profile>;
+    handlers[0xDE] = &CPU::DEC<&CPU::AbsoluteX, profile>;
+
+    handlers[0xE6] = &CPU::INC<&CPU::ZeroPage, profile>;
+    handlers[0xF6] = &CPU::INC<&CPU::ZeroPageX, profile>;
+    handlers[0xEE] = &CPU::INC<&CPU::Absolute, profile>;
+    handlers[0xFE] = &CPU::INC<&CPU::AbsoluteX, profile>;
+
+    handlers[0x46] = &CPU::LSR<&CPU::ZeroPage, profile>;
+    handlers[0x56] = &CPU::LSR<&CPU::ZeroPageX, profile>;
+    handlers[0x4E] = &CPU::LSR<&CPU::Absolute, profile>;
+    handlers[0x5E] = &CPU::LSR<&CPU::AbsoluteX, profile>;
+
+    handlers[0x26] = &CPU::ROL<&CPU::ZeroPage, profile>;
+    handlers[0x36] = &CPU::ROL<&CPU::ZeroPageX, profile>;
+    handlers[0x2E] = &CPU::ROL<&CPU::Absolute, profile>;
+    handlers[0x3E] = &CPU::ROL<&CPU::AbsoluteX, profile>;
+
+    handlers[0x66] = &CPU::ROR<&CPU::ZeroPage, profile>;
+    handlers[0x76] = &CPU::ROR<&CPU::ZeroPageX, profile>;
+    handlers[0x6E] = &CPU::ROR<&CPU::Absolute, profile>;
+    handlers[0x7E] = &CPU::ROR<&CPU::AbsoluteX, profile>;
+}
+
 void CPU::ExecuteInstruction()
 {
-    (this->*(opcodeTable[opcode].ptr))();
-    std::cout << "Executed instruction: " << opcodeTable[opcode].mnemonic << '\n';
+    (this->*(handlers[opcode]))();
 }
 
 void CPU::Tick()
 {
-    cycleCount++;
     mainBus.Tick();
 }
 
@@ -356,6 +549,68 @@ void CPU::Write(uint16_t address, uint8_t data)
     mainBus.Write(address, data);
 }
 
+uint8_t CPU::ReadRAM(uint16_t address)
+{
+    Tick();
+    return mainBus.ReadRAM(address);
+}
+
+void CPU::WriteRAM(uint16_t address, uint8_t data)
+{
+    Tick();
+    mainBus.WriteRAM(address, data);
+}
+
+template <CPU::AddressModePtr AddrMode>
+uint8_t CPU::ReadOperand()
+{
+    if (AddrMode == &CPU::ZeroPage || AddrMode == &CPU::ZeroPageX || AddrMode == &CPU::ZeroPageY)
+    {
+        return ReadRAM(address);
+    }
+    return Read(address);
+}
+
+template <CPU::AddressModePtr AddrMode>
+void CPU::WriteOperand(uint8_t data)
+{
+    if (AddrMode == &CPU::ZeroPage || AddrMode == &CPU::ZeroPageX || AddrMode == &CPU::ZeroPageY)
+    {
+        WriteRAM(address, data);
+    }
+    else
+    {
+        Write(address, data);
+    }
+}
+
+template <CPU::AddressModePtr AddrMode, CPU::AccuracyProfile profile>
+void CPU::WriteBack(uint8_t data)
+{
+    if (profile == FAST && mainBus.IsWriteBackInvisible(address))
+    {
+#ifdef NESPP_INSTRUMENTATION
+        mainBus.CountWrite(address);
+#endif
+        Tick();
+    }
+    else
+    {
+        WriteOperand<AddrMode>(data);
+    }
+}
+
+uint8_t CPU::Fetch()
+{
+    if (operands != nullptr)
+    {
+        Tick();
+        PC++;
+        return *operands++;
+    }
+    return Read(PC++);
+}
+
 bool CPU::PageCrossed(uint16_t address, uint16_t offset)
 {
     if (((address + offset) & 0xFF00) == (address & 0xFF00))
@@ -368,7 +623,15 @@ bool CPU::PageCrossed(uint16_t address, uint16_t offset)
     }
 }
 
+#ifndef NESPP_LAZY_FLAGS
+
 void CPU::UpdateZN(uint8_t value)
+{
+    UpdateZ(value);
+    UpdateN(value);
+}
+
+void CPU::UpdateZ(uint8_t value)
 {
     if (value == 0)
     {
@@ -378,17 +641,173 @@ void CPU::UpdateZN(uint8_t value)
     {
         PS.Clear<Z>();
     }
+}
+
+void CPU::UpdateN(uint8_t value)
+{
+    PS.Assign<N>(value >> 7);
+}
+
+void CPU::UpdateCarry(uint16_t result)
+{
+    PS.Assign<C>((result >> 8) & 0x01);
+}
+
+void CPU::UpdateOverflow(uint8_t value)
+{
+    PS.Assign<V>(value >> 7);
+}
+
+template <CPU::CpuStatusFlags flag>
+int CPU::TestFlag() const
+{
+    return (PS.value & flag) != 0;
+}
+
+template <CPU::CpuStatusFlags flag>
+void CPU::SetFlag()
+{
+    PS.Set<flag>();
+}
+
+template <CPU::CpuStatusFlags flag>
+void CPU::ClearFlag()
+{
+    PS.Clear<flag>();
+}
+
+uint8_t CPU::GetStatus() const
+{
+    return PS.value;
+}
+
+void CPU::SetStatus(uint8_t value)
+{
+    PS.value = value;
+}
+
+#else
+
+/*
+ * Lazy flags: instead of updating the status register after
+ * each operation, the values flags are derived from are stored
+ * and C, Z, N and V are only computed when they're needed.
+ * - Z is set when zeroResult is 0
+ * - N is bit 7 of negativeResult
+ * - C is bit 8 of carryResult, the 9 bit result of the operation
+ * - V is bit 7 of overflowResult
+ * The other flags are always kept up to date in PS.
+ */
+
+void CPU::UpdateZN(uint8_t value)
+{
+    zeroResult = value;
+    negativeResult = value;
+}
+
+void CPU::UpdateZ(uint8_t value)
+{
+    zeroResult = value;
+}
+
+void CPU::UpdateN(uint8_t value)
+{
+    negativeResult = value;
+}
+
+void CPU::UpdateCarry(uint16_t result)
+{
+    carryResult = result;
+}
+
+void CPU::UpdateOverflow(uint8_t value)
+{
+    overflowResult = value;
+}
+
+template <CPU::CpuStatusFlags flag>
+int CPU::TestFlag() const
+{
+    if constexpr (flag == C)
+    {
+        return (carryResult >> 8) & 0x01;
+    }
+    else if constexpr (flag == Z)
+    {
+        return zeroResult == 0;
+    }
+    else if constexpr (flag == N)
+    {
+        return negativeResult >> 7;
+    }
+    else if constexpr (flag == V)
+    {
+        return overflowResult >> 7;
+    }
+    else
+    {
+        return (PS.value & flag) != 0;
+    }
+}
+
+template <CPU::CpuStatusFlags flag>
+void CPU::SetFlag()
+{
+    if constexpr (flag == C)
+    {
+        carryResult = 0x0100;
+    }
+    else if constexpr (flag == V)
+    {
+        overflowResult = 0x80;
+    }
+    else
+    {
+        // Z and N are never set on their own
+        static_assert(flag != Z && flag != N);
+        PS.Set<flag>();
+    }
+}
 
-    if ((value & 0x80) != 0)
+template <CPU::CpuStatusFlags flag>
+void CPU::ClearFlag()
+{
+    if constexpr (flag == C)
     {
-        PS.Set<N>();
+        carryResult = 0;
+    }
+    else if constexpr (flag == V)
+    {
+        overflowResult = 0;
     }
     else
     {
-        PS.Clear<N>();
+        static_assert(flag != Z && flag != N);
+        PS.Clear<flag>();
     }
 }
 
+uint8_t CPU::GetStatus() const
+{
+    uint8_t status = PS.value & ~(C | Z | N | V);
+    status |= TestFlag<C>() ? C : 0;
+    status |= TestFlag<Z>() ? Z : 0;
+    status |= negativeResult & N;
+    status |= (overflowResult & 0x80) ? V : 0;
+    return status;
+}
+
+void CPU::SetStatus(uint8_t value)
+{
+    PS.value = value;
+    zeroResult = (value & Z) ? 0 : 1;
+    negativeResult = value & N;
+    carryResult = (value & C) << 8;
+    overflowResult = (value & V) << 1;
+}
+
+#endif
+
 void CPU::Branch(bool condition, int extraCycle)
 {
     if (condition == true)
@@ -404,36 +823,22 @@ void CPU::Branch(bool condition, int extraCycle)
 
 void CPU::PushStack(uint8_t value)
 {
-    Write(0x0100 + SP, value);
+    WriteRAM(0x0100 + SP, value);
     SP--;
 }
 
 uint8_t CPU::PullStack()
 {
     SP++;
-    return Read(0x0100 + SP);
+    return ReadRAM(0x0100 + SP);
 }
 
 void CPU::Compare(uint8_t reg, uint8_t operand)
 {
-    if (reg >= operand)
-    {
-        PS.Set<C>();
-    }
-    else
-    {
-        PS.Clear<C>();
-    }
-    if (reg == operand)
-    {
-        PS.Set<Z>();
-    }
-    else
-    {
-        PS.Clear<Z>();
-    }
-    uint8_t memBit7 = ((reg - operand) & 0x80) >> 7;
-    PS.Assign<N>(memBit7);
+    // Same as subtracting with the carry set, the carry
+    // out is set when there is no borrow (reg >= operand)
+    UpdateCarry(reg + (uint8_t)~operand + 1);
+    UpdateZN(reg - operand);
 }
 
 // ADDDRESSING MODES
@@ -456,24 +861,25 @@ int CPU::Immediate()
 
 int CPU::ZeroPage()
 {
-    uint8_t zeroPageAddress = Read(PC++);
+    uint8_t zeroPageAddress = Fetch();
     address = (uint16_t)zeroPageAddress;
     return 0;
 }
 
 int CPU::Absolute()
 {
-    uint8_t lowByte = Read(PC++);
-    uint8_t highByte = Read(PC++);
+    uint8_t lowByte = Fetch();
+    uint8_t highByte = Fetch();
     address = ((uint16_t)highByte << 8) | lowByte;
     return 0;
 }
 
 int CPU::Relative()
 {
-    uint8_t offset = Read(PC++);
-    address = offset;
-    if (PageCrossed(PC, offset))
+    // The offset is a signed 8 bit value
+    int8_t offset = Fetch();
+    address = (uint16_t)offset;
+    if (PageCrossed(PC, address))
     {
         return 1;
     }
@@ -485,8 +891,8 @@ int CPU::Relative()
 
 int CPU::Indirect()
 {
-    uint8_t pointerLow = Read(PC++);
-    uint8_t pointerHigh = Read(PC++);
+    uint8_t pointerLow = Fetch();
+    uint8_t pointerHigh = Fetch();
     uint16_t pointer = ((uint16_t)pointerHigh << 8) | pointerLow;
     uint8_t effectiveAddressLow = Read(pointer);
     // If the low byte is at a page boundary, the high one is
@@ -501,7 +907,7 @@ int CPU::Indirect()
 
 int CPU::ZeroPageX()
 {
-    uint8_t zeroPageAddress = Read(PC++);
+    uint8_t zeroPageAddress = Fetch();
     Tick();
     zeroPageAddress += X;
     address = (uint16_t)zeroPageAddress;
@@ -510,7 +916,7 @@ int CPU::ZeroPageX()
 
 int CPU::ZeroPageY()
 {
-    uint8_t zeroPageAddress = Read(PC++);
+    uint8_t zeroPageAddress = Fetch();
     Tick();
     zeroPageAddress += Y;
     address = (uint16_t)zeroPageAddress;
@@ -519,8 +925,8 @@ int CPU::ZeroPageY()
 
 int CPU::AbsoluteX()
 {
-    uint8_t lowByte = Read(PC++);
-    uint8_t highByte = Read(PC++);
+    uint8_t lowByte = Fetch();
+    uint8_t highByte = Fetch();
     uint16_t effectiveAddress = ((uint16_t)highByte << 8) | lowByte;
     address = effectiveAddress + X;
     if (PageCrossed(effectiveAddress, X))
@@ -535,8 +941,8 @@ int CPU::AbsoluteX()
 
 int CPU::AbsoluteY()
 {
-    uint8_t lowByte = Read(PC++);
-    uint8_t highByte = Read(PC++);
+    uint8_t lowByte = Fetch();
+    uint8_t highByte = Fetch();
     uint16_t effectiveAddress = ((uint16_t)highByte << 8) | lowByte;
     address = effectiveAddress + Y;
     if (PageCrossed(effectiveAddress, Y))
@@ -551,21 +957,21 @@ int CPU::AbsoluteY()
 
 int CPU::IndexedIndirect()
 {
-    uint8_t zeroPagePointer = Read(PC++);
+    uint8_t zeroPagePointer = Fetch();
     Tick();
     zeroPagePointer += X;
-    uint8_t effectiveAddressLow = Read(zeroPagePointer);
+    uint8_t effectiveAddressLow = ReadRAM(zeroPagePointer);
     zeroPagePointer++;
-    uint8_t effectiveAddressHigh = Read(zeroPagePointer);
+    uint8_t effectiveAddressHigh = ReadRAM(zeroPagePointer);
     address = ((uint16_t)effectiveAddressHigh << 8) | effectiveAddressLow;
     return 0;
 }
 
 int CPU::IndirectIndexed()
 {
-    uint8_t zeroPagePointer = Read(PC++);
-    uint8_t effectivePointerLow = Read(zeroPagePointer++);
-    uint8_t effectivePointerHigh = Read(zeroPagePointer);
+    uint8_t zeroPagePointer = Fetch();
+    uint8_t effectivePointerLow = ReadRAM(zeroPagePointer++);
+    uint8_t effectivePointerHigh = ReadRAM(zeroPagePointer);
     uint16_t effectivePointer = ((uint16_t)effectivePointerHigh << 8) | effectivePointerLow;
     address = effectivePointer + Y;
     if (PageCrossed(effectivePointer, Y))
@@ -592,29 +998,15 @@ void CPU::ADC()
     {
         Tick();
     }
-    uint8_t operand = Read(address);
-    uint8_t carry = PS.Test<C>();
-    uint8_t result = A + operand + carry;
+    uint8_t operand = ReadOperand<AddrMode>();
+    uint16_t sum = A + operand + TestFlag<C>();
+    uint8_t result = sum;
     UpdateZN(result);
-    if (result < A)
-    {
-        PS.Set<C>();
-    }
-    else
-    {
-        PS.Clear<C>();
-    }
+    UpdateCarry(sum);
 
     // Overflow is set if the two operands have the same sign
     // (both 0 or both 1) and the resul have a different one
-    if ((~(A ^ operand) & (A ^ result)) & 0x80)
-    {
-        PS.Set<V>();
-    }
-    else
-    {
-        PS.Clear<V>();
-    }
+    UpdateOverflow(~(A ^ operand) & (A ^ result));
     A = result;
 }
 
@@ -625,19 +1017,18 @@ void CPU::AND()
     {
         Tick();
     }
-    uint8_t operand = Read(address);
+    uint8_t operand = ReadOperand<AddrMode>();
     A &= operand;
     UpdateZN(A);
 }
 
-template <CPU::AddressModePtr AddrMode>
+template <CPU::AddressModePtr AddrMode, CPU::AccuracyProfile profile>
 void CPU::ASL()
 {
     if (AddrMode == &CPU::Accumulator)
     {
         Tick();
-        uint8_t accBit7 = (A & 0x80) >> 7;
-        PS.Assign<C>(accBit7);
+        UpdateCarry(A << 1);
         A = A << 1;
         UpdateZN(A);
     }
@@ -648,13 +1039,12 @@ void CPU::ASL()
         {
             Tick();
         }
-        uint8_t operand = Read(address);
-        Write(address, operand);
-        uint8_t memBit7 = (operand & 0x80) >> 7;
-        PS.Assign<C>(memBit7);
+        uint8_t operand = ReadOperand<AddrMode>();
+        WriteBack<AddrMode, profile>(operand);
+        UpdateCarry(operand << 1);
         operand = operand << 1;
         UpdateZN(operand);
-        Write(address, operand);
+        WriteOperand<AddrMode>(operand);
     }
 }
 
@@ -662,62 +1052,53 @@ template <CPU::AddressModePtr AddrMode>
 void CPU::BCC()
 {
     int extraCycle = (this->*AddrMode)();
-    Branch(PS.Test<C>() == 0, extraCycle);
+    Branch(TestFlag<C>() == 0, extraCycle);
 }
 
 template <CPU::AddressModePtr AddrMode>
 void CPU::BCS()
 {
     int extraCycle = (this->*AddrMode)();
-    Branch(PS.Test<C>() == 1, extraCycle);
+    Branch(TestFlag<C>() == 1, extraCycle);
 }
 
 template <CPU::AddressModePtr AddrMode>
 void CPU::BEQ()
 {
     int extraCycle = (this->*AddrMode)();
-    Branch(PS.Test<Z>() == 1, extraCycle);
+    Branch(TestFlag<Z>() == 1, extraCycle);
 }
 
 template <CPU::AddressModePtr AddrMode>
 void CPU::BIT()
 {
     (this->*AddrMode)();
-    uint8_t operand = Read(address);
-    uint8_t result = A & operand;
-    if (result == 0)
-    {
-        PS.Set<Z>();
-    }
-    else
-    {
-        PS.Clear<Z>();
-    }
-    uint8_t memBit6 = (operand & 0x40) >> 6;
-    uint8_t memBit7 = (operand & 0x80) >> 7;
-    PS.Assign<V>(memBit6);
-    PS.Assign<N>(memBit7);
+    uint8_t operand = ReadOperand<AddrMode>();
+    UpdateZ(A & operand);
+    // Bits 6 and 7 of the operand are copied to V and N
+    UpdateOverflow(operand << 1);
+    UpdateN(operand);
 }
 
 template <CPU::AddressModePtr AddrMode>
 void CPU::BMI()
 {
     int extraCycle = (this->*AddrMode)();
-    Branch(PS.Test<N>() == 1, extraCycle);
+    Branch(TestFlag<N>() == 1, extraCycle);
 }
 
 template <CPU::AddressModePtr AddrMode>
 void CPU::BNE()
 {
     int extraCycle = (this->*AddrMode)();
-    Branch(PS.Test<Z>() == 0, extraCycle);
+    Branch(TestFlag<Z>() == 0, extraCycle);
 }
 
 template <CPU::AddressModePtr AddrMode>
 void CPU::BPL()
 {
     int extraCycle = (this->*AddrMode)();
-    Branch(PS.Test<N>() == 0, extraCycle);
+    Branch(TestFlag<N>() == 0, extraCycle);
 }
 
 template <CPU::AddressModePtr AddrMode>
@@ -729,9 +1110,9 @@ void CPU::BRK()
     uint8_t PCL = PC & 0x00FF;
     PushStack(PCH);
     PushStack(PCL);
-    PS.Set<B>();
-    PushStack(PS.value);
-    PS.Set<I>();
+    SetFlag<B>();
+    PushStack(GetStatus());
+    SetFlag<I>();
     PCL = Read(0xFFFE);
     PCH = Read(0xFFFF);
 }
@@ -740,42 +1121,42 @@ template <CPU::AddressModePtr AddrMode>
 void CPU::BVC()
 {
     int extraCycle = (this->*AddrMode)();
-    Branch(PS.Test<V>() == 0, extraCycle);
+    Branch(TestFlag<V>() == 0, extraCycle);
 }
 
 template <CPU::AddressModePtr AddrMode>
 void CPU::BVS()
 {
     int extraCycle = (this->*AddrMode)();
-    Branch(PS.Test<V>() == 1, extraCycle);
+    Branch(TestFlag<V>() == 1, extraCycle);
 }
 
 template <CPU::AddressModePtr AddrMode>
 void CPU::CLC()
 {
     Tick();
-    PS.Clear<C>();
+    ClearFlag<C>();
 }
 
 template <CPU::AddressModePtr AddrMode>
 void CPU::CLD()
 {
     Tick();
-    PS.Clear<D>();
+    ClearFlag<D>();
 }
 
 template <CPU::AddressModePtr AddrMode>
 void CPU::CLI()
 {
     Tick();
-    PS.Clear<I>();
+    ClearFlag<I>();
 }
 
 template <CPU::AddressModePtr AddrMode>
 void CPU::CLV()
 {
     Tick();
-    PS.Clear<V>();
+    ClearFlag<V>();
 }
 
 template <CPU::AddressModePtr AddrMode>
@@ -785,7 +1166,7 @@ void CPU::CMP()
     {
         Tick();
     }
-    uint8_t operand = Read(address);
+    uint8_t operand = ReadOperand<AddrMode>();
     Compare(A, operand);
 }
 
@@ -793,7 +1174,7 @@ template <CPU::AddressModePtr AddrMode>
 void CPU::CPX()
 {
     (this->*AddrMode)();
-    uint8_t operand = Read(address);
+    uint8_t operand = ReadOperand<AddrMode>();
     Compare(X, operand);
 }
 
@@ -801,11 +1182,11 @@ template <CPU::AddressModePtr AddrMode>
 void CPU::CPY()
 {
     (this->*AddrMode)();
-    uint8_t operand = Read(address);
+    uint8_t operand = ReadOperand<AddrMode>();
     Compare(Y, operand);
 }
 
-template <CPU::AddressModePtr AddrMode>
+template <CPU::AddressModePtr AddrMode, CPU::AccuracyProfile profile>
 void CPU::DEC()
 {
     (this->*AddrMode)();
@@ -813,11 +1194,11 @@ void CPU::DEC()
     {
         Tick();
     }
-    uint8_t operand = Read(address);
-    Write(address, operand);
+    uint8_t operand = ReadOperand<AddrMode>();
+    WriteBack<AddrMode, profile>(operand);
     operand--;
     UpdateZN(operand);
-    Write(address, operand);
+    WriteOperand<AddrMode>(operand);
 }
 
 template <CPU::AddressModePtr AddrMode>
@@ -843,12 +1224,12 @@ void CPU::EOR()
     {
         Tick();
     }
-    uint8_t operand = Read(address);
+    uint8_t operand = ReadOperand<AddrMode>();
     A ^= operand;
     UpdateZN(A);
 }
 
-template <CPU::AddressModePtr AddrMode>
+template <CPU::AddressModePtr AddrMode, CPU::AccuracyProfile profile>
 void CPU::INC()
 {
     (this->*AddrMode)();
@@ -856,11 +1237,11 @@ void CPU::INC()
     {
         Tick();
     }
-    uint8_t operand = Read(address);
-    Write(address, operand);
+    uint8_t operand = ReadOperand<AddrMode>();
+    WriteBack<AddrMode, profile>(operand);
     operand++;
     UpdateZN(operand);
-    Write(address, operand);
+    WriteOperand<AddrMode>(operand);
 }
 
 template <CPU::AddressModePtr AddrMode>
@@ -891,14 +1272,14 @@ void CPU::JSR()
 {
     // this shoul use absolute addressing, but it's
     // actually a bit different
-    uint8_t addressLow = Read(PC++);
+    uint8_t addressLow = Fetch();
     Tick();
     uint8_t PCH = (PC & 0xFF00) >> 8;
     uint8_t PCL = PC & 0x00FF;
     PushStack(PCH);
     PushStack(PCL);
     PCL = addressLow;
-    PCH = Read(PC);
+    PCH = Fetch();
     PC = ((uint16_t)PCH << 8) | PCL;
 }
 
@@ -909,7 +1290,7 @@ void CPU::LDA()
     {
         Tick();
     }
-    uint8_t operand = Read(address);
+    uint8_t operand = ReadOperand<AddrMode>();
     UpdateZN(operand);
     A = operand;
 }
@@ -921,7 +1302,7 @@ void CPU::LDX()
     {
         Tick();
     }
-    uint8_t operand = Read(address);
+    uint8_t operand = ReadOperand<AddrMode>();
     UpdateZN(operand);
     X = operand;
 }
@@ -933,19 +1314,18 @@ void CPU::LDY()
     {
         Tick();
     }
-    uint8_t operand = Read(address);
+    uint8_t operand = ReadOperand<AddrMode>();
     UpdateZN(operand);
     Y = operand;
 }
 
-template <CPU::AddressModePtr AddrMode>
+template <CPU::AddressModePtr AddrMode, CPU::AccuracyProfile profile>
 void CPU::LSR()
 {
     if (AddrMode == &CPU::Accumulator)
     {
         Tick();
-        uint8_t accBit0 = A & 0x01;
-        PS.Assign<C>(accBit0);
+        UpdateCarry((A & 0x01) << 8);
         A = A >> 1;
         UpdateZN(A);
     }
@@ -956,13 +1336,12 @@ void CPU::LSR()
         {
             Tick();
         }
-        uint8_t operand = Read(address);
-        Write(address, operand);
-        uint8_t memBit0 = operand & 0x01;
-        PS.Assign<C>(memBit0);
+        uint8_t operand = ReadOperand<AddrMode>();
+        WriteBack<AddrMode, profile>(operand);
+        UpdateCarry((operand & 0x01) << 8);
         operand = operand >> 1;
         UpdateZN(operand);
-        Write(address, operand);
+        WriteOperand<AddrMode>(operand);
     }
 }
 
@@ -979,7 +1358,7 @@ void CPU::ORA()
     {
         Tick();
     }
-    uint8_t operand = Read(address);
+    uint8_t operand = ReadOperand<AddrMode>();
     A |= operand;
     UpdateZN(A);
 }
@@ -995,9 +1374,9 @@ template <CPU::AddressModePtr AddrMode>
 void CPU::PHP()
 {
     Tick();
-    PS.Set<B>();
-    PushStack(PS.value);
-    PS.Clear<B>();
+    SetFlag<B>();
+    PushStack(GetStatus());
+    ClearFlag<B>();
 }
 
 template <CPU::AddressModePtr AddrMode>
@@ -1014,21 +1393,18 @@ void CPU::PLP()
 {
     Tick();
     Tick();
-    PS.value = PullStack();
-    PS.Clear<B>();
-    PS.Set<_>();
+    SetStatus((PullStack() & ~B) | _);
 }
 
-template <CPU::AddressModePtr AddrMode>
+template <CPU::AddressModePtr AddrMode, CPU::AccuracyProfile profile>
 void CPU::ROL()
 {
     if (AddrMode == &CPU::Accumulator)
     {
         Tick();
-        uint8_t accBit7 = (A & 0x80) >> 7;
-        A = A << 1;
-        A |= PS.Test<C>();
-        PS.Assign<C>(accBit7);
+        uint16_t result = (A << 1) | TestFlag<C>();
+        UpdateCarry(result);
+        A = result;
         UpdateZN(A);
     }
     else
@@ -1038,27 +1414,25 @@ void CPU::ROL()
         {
             Tick();
         }
-        uint8_t operand = Read(address);
-        Write(address, operand);
-        uint8_t memBit7 = (operand & 0x80) >> 7;
-        operand = operand << 1;
-        operand |= PS.Test<C>();
-        PS.Assign<C>(memBit7);
+        uint8_t operand = ReadOperand<AddrMode>();
+        WriteBack<AddrMode, profile>(operand);
+        uint16_t result = (operand << 1) | TestFlag<C>();
+        UpdateCarry(result);
+        operand = result;
         UpdateZN(operand);
-        Write(address, operand);
+        WriteOperand<AddrMode>(operand);
     }
 }
 
-template <CPU::AddressModePtr AddrMode>
+template <CPU::AddressModePtr AddrMode, CPU::AccuracyProfile profile>
 void CPU::ROR()
 {
     if (AddrMode == &CPU::Accumulator)
     {
         Tick();
-        uint8_t accBit0 = A & 0x01;
-        A = A >> 1;
-        A |= (PS.Test<C>() << 7);
-        PS.Assign<C>(accBit0);
+        uint8_t result = (A >> 1) | (TestFlag<C>() << 7);
+        UpdateCarry((A & 0x01) << 8);
+        A = result;
         UpdateZN(A);
     }
     else
@@ -1068,14 +1442,13 @@ void CPU::ROR()
         {
             Tick();
         }
-        uint8_t operand = Read(address);
-        Write(address, operand);
-        uint8_t memBit0 = operand & 0x01;
-        operand = operand >> 1;
-        operand |= (PS.Test<C>() << 7);
-        PS.Assign<C>(memBit0);
+        uint8_t operand = ReadOperand<AddrMode>();
+        WriteBack<AddrMode, profile>(operand);
+        uint8_t result = (operand >> 1) | (TestFlag<C>() << 7);
+        UpdateCarry((operand & 0x01) << 8);
+        operand = result;
         UpdateZN(operand);
-        Write(address, operand);
+        WriteOperand<AddrMode>(operand);
     }
 }
 
@@ -1084,9 +1457,7 @@ void CPU::RTI()
 {
     Tick();
     Tick();
-    PS.value = PullStack();
-    PS.Clear<B>();
-    PS.Set<_>();
+    SetStatus((PullStack() & ~B) | _);
     uint8_t PCL = PullStack();
     uint8_t PCH = PullStack();
     PC = ((uint16_t)PCH << 8) | PCL;
@@ -1111,8 +1482,7 @@ void CPU::SBC()
     {
         Tick();
     }
-    uint8_t operand = Read(address);
-    uint8_t carry = PS.Test<C>();
+    uint8_t operand = ReadOperand<AddrMode>();
     // operand's sign is changed, as in the actual 6502,
     // by taking it's two's complement: it is first complemented
     // and then 1 is added; actually the carry bit is added since
@@ -1121,28 +1491,15 @@ void CPU::SBC()
     // the previous subtraction the carry bit would be 0 and this
     // basically means that 1 is subtracted from the final result
     // (since 0 is added instead of 1 when taking two's complement)
-    operand = ~operand + carry;
-    uint8_t result = A + operand;
+    operand = ~operand;
+    uint16_t sum = A + operand + TestFlag<C>();
+    uint8_t result = sum;
     UpdateZN(result);
-    if (result < A)
-    {
-        PS.Set<C>();
-    }
-    else
-    {
-        PS.Clear<C>();
-    }
+    UpdateCarry(sum);
 
     // Overflow is set if the two operands have the same sign
     // (both 0 or both 1) and the resul have a different one
-    if ((~(A ^ operand) & (A ^ result)) & 0x80)
-    {
-        PS.Set<V>();
-    }
-    else
-    {
-        PS.Clear<V>();
-    }
+    UpdateOverflow(~(A ^ operand) & (A ^ result));
     A = result;
 }
 
@@ -1150,21 +1507,21 @@ template <CPU::AddressModePtr AddrMode>
 void CPU::SEC()
 {
     Tick();
-    PS.Set<C>();
+    SetFlag<C>();
 }
 
 template <CPU::AddressModePtr AddrMode>
 void CPU::SED()
 {
     Tick();
-    PS.Set<D>();
+    SetFlag<D>();
 }
 
 template <CPU::AddressModePtr AddrMode>
 void CPU::SEI()
 {
     Tick();
-    PS.Set<I>();
+    SetFlag<I>();
 }
 
 template <CPU::AddressModePtr AddrMode>
@@ -1175,21 +1532,21 @@ void CPU::STA()
     {
         Tick();
     }
-    Write(address, A);
+    WriteOperand<AddrMode>(A);
 }
 
 template <CPU::AddressModePtr AddrMode>
 void CPU::STX()
 {
     (this->*AddrMode)();
-    Write(address, X);
+    WriteOperand<AddrMode>(X);
 }
 
 template <CPU::AddressModePtr AddrMode>
 void CPU::STY()
 {
     (this->*AddrMode)();
-    Write(address, Y);
+    WriteOperand<AddrMode>(Y);
 }
 
 template <CPU::AddressModePtr AddrMode>
@@ -6,6 +6,7 @@
 #include <cstdint>
 #include <cstdio>
 #include <cstring>
+#include <memory>
 #include <string>
 
 /*
@@ -18,14 +19,20 @@
  * and status register.
  */
 
+// Length of an NTSC frame, rounded up
 const uint32_t CYCLES_PER_FRAME = 29781;
 
-class CPU
+class alignas(64) CPU
 {
 public:
     CPU(class NES& mainBus);
+    ~CPU();
 
     friend class Debugger;
+    friend class Breakpoints;
+    friend class BlockCache;
+    friend class IdleLoops;
+    friend class NES;
 
     void ExecuteInstrFromRAM(uint16_t startingLocation, size_t number);
 
@@ -36,6 +43,34 @@ public:
 
     void ExecuteInstruction();
 
+    // Fetches and executes the instruction pointed by PC, or takes a
+    // pending interrupt instead, in which case it returns true
+    bool Step();
+
+    // Executes instructions from a cache of pre-decoded basic blocks
+    // (see BlockCache.h), disabling it discards all the blocks
+    void EnableBlockCache(bool enable);
+
+    /*
+     * Dummy accesses done by the hardware, like the write of the
+     * unmodified value by read-modify-write instructions before the
+     * result, are emulated with the EXACT profile. The FAST profile
+     * skips them when they target RAM or the PRG ROM of a mapper
+     * without registers, where nothing but a write breakpoint can see
+     * them (see NES::IsWriteBackInvisible), and only takes their
+     * cycle: the timing and the state are the same.
+     * The instructions are instantiated for both profiles, changing
+     * it only replaces their handlers (and discards the blocks
+     * already decoded).
+     */
+    enum AccuracyProfile
+    {
+        EXACT,
+        FAST
+    };
+    void SetAccuracyProfile(AccuracyProfile profile);
+    AccuracyProfile GetAccuracyProfile() const { return accuracyProfile; }
+
     typedef int (CPU::*AddressModePtr)();
 
     typedef void (CPU::*InstructionPtr)();
@@ -57,9 +92,10 @@ public:
         INDY
     };
 
+    // Description of an opcode, for the disassembler and the code
+    // analysis; the interpreter only reads the handlers
     struct Instruction
     {
-        InstructionPtr ptr;
         const char* mnemonic;
         AddressingMode mode;
         int bytes;
@@ -67,10 +103,8 @@ public:
         bool extraCycle = false;
     };
 
-    // TODO: try using std::function and a
-    // separate class for opcode representation
-
-    std::array<Instruction, 256> opcodeTable;
+    // The same for every CPU, kept out of the instances
+    static const std::array<Instruction, 256> instructions;
 
     enum CpuStatusFlags : uint8_t
     {
@@ -85,39 +119,146 @@ public:
     };
 
 private:
+    /*
+     * The state read and written by every instruction comes first,
+     * in a single cache line: the registers, the bus and the engine
+     * in use. The handlers of the opcodes follow, 16 bytes each,
+     * and the descriptions of the opcodes are shared by all the
+     * CPUs, so that executing code only touches the lines of the
+     * handlers that it uses.
+     */
+
     // Reference to the main bus
     NES& mainBus;
 
+    // Only allocated while the block cache is enabled
+    std::unique_ptr<class BlockCache> blockCache;
+
+    // Operands of the instruction being executed from the block
+    // cache, null when executing without the cache
+    const uint8_t* operands = nullptr;
+
+#ifdef NESPP_INSTRUMENTATION
+    uint64_t instructionCount = 0;
+#endif
+
     // Program counter
     uint16_t PC;
 
+    // These are used during instruction execution
+    uint16_t address;
+    uint8_t opcode;
+
     // Stack pointer
     uint8_t SP;
 
     // General purpose registers
     uint8_t A, X, Y;
 
-    // Processor status
+    // Processor status, with lazy flags C, Z, N and V are not
+    // kept up to date here: use GetStatus to read it
     BitMappedRegister<CpuStatusFlags> PS;
 
-    uint32_t cycleCount;
+#ifdef NESPP_LAZY_FLAGS
+    // Values the lazy flags are computed from
+    uint8_t zeroResult, negativeResult, overflowResult;
+    uint16_t carryResult;
+#endif
 
-    // These are used during instruction execution
-    uint8_t opcode;
-    uint16_t address;
+    // Indexed by opcode, the instructions of the accuracy profile
+    std::array<InstructionPtr, 256> handlers;
+
+    AccuracyProfile accuracyProfile = EXACT;
+
+    // Fills the handlers with the instructions of the profile
+    template <AccuracyProfile profile>
+    void SetReadModifyWriteInstructions();
+
+    // Handler and description of every opcode, evaluated at compile
+    // time into the two tables
+    struct Opcode
+    {
+        InstructionPtr handler;
+        Instruction instruction;
+    };
+    static constexpr std::array<Opcode, 256> MakeOpcodes();
+    static const std::array<InstructionPtr, 256> defaultHandlers;
 
-    // Increment cycle count
+    // Advances the master clock by one CPU cycle
     inline void Tick();
 
     // Access the main addressing space
     uint8_t Read(uint16_t address);
     void Write(uint16_t address, uint8_t data);
 
+    // The zero page and the stack are always in internal RAM: these
+    // take the same cycle without going through the address decoding
+    inline uint8_t ReadRAM(uint16_t address);
+    inline void WriteRAM(uint16_t address, uint8_t data);
+
+    // Access the address computed by the addressing mode, directly
+    // in RAM for the modes that can only address the zero page
+    template <AddressModePtr AddrMode>
+    inline uint8_t ReadOperand();
+    template <AddressModePtr AddrMode>
+    inline void WriteOperand(uint8_t data);
+
+    // Dummy write of the value read by a read-modify-write instruction
+    template <AddressModePtr AddrMode, AccuracyProfile profile>
+    inline void WriteBack(uint8_t data);
+
+    // Reads the next byte of the instruction and increments PC
+    inline uint8_t Fetch();
+
+    // Non maskable interrupt, requested by the PPU when the VBlank starts
+    void NMI();
+
+    // Maskable interrupt, requested by the APU and by mappers
+    void IRQ();
+
+    // Pushes the return address and the status, then jumps to the vector
+    inline void Interrupt(uint16_t vector);
+
+#ifdef NESPP_JIT
+    // Runs native code from the recompiler in place of the
+    // instructions it covers, ticking the bus for all of them
+    void RunCompiled(const struct CompiledCode& code);
+#endif
+
     // Checks if there is going to be a page boundary cross
     inline bool PageCrossed(uint16_t address, uint16_t offset);
 
+    /*
+     * All flag accesses go through the following functions,
+     * so that the status register can be updated eagerly
+     * or lazily (when built with NESpp_LAZY_FLAGS) without
+     * changing the instructions.
+     */
+
     // Update processor status flags Z and N
     inline void UpdateZN(uint8_t value);
+    inline void UpdateZ(uint8_t value);
+    inline void UpdateN(uint8_t value);
+
+    // Carry is bit 8 of the 9 bit result of the operation
+    inline void UpdateCarry(uint16_t result);
+
+    // Overflow is bit 7 of the given value
+    inline void UpdateOverflow(uint8_t value);
+
+    // Returns 0 or 1
+    template <CpuStatusFlags flag>
+    inline int TestFlag() const;
+
+    template <CpuStatusFlags flag>
+    inline void SetFlag();
+
+    template <CpuStatusFlags flag>
+    inline void ClearFlag();
+
+    // Whole status register
+    uint8_t GetStatus() const;
+    void SetStatus(uint8_t value);
 
     // Shared logic for branch instructions
     inline void Branch(bool condition, int extraCycle);
@@ -211,7 +352,7 @@ private:
     template <AddressModePtr AddrMode>
     inline void AND();
 
-    template <AddressModePtr AddrMode>
+    template <AddressModePtr AddrMode, AccuracyProfile profile = EXACT>
     inline void ASL();
 
     template <AddressModePtr AddrMode>
@@ -265,7 +406,7 @@ private:
     template <AddressModePtr AddrMode>
     inline void CPY();
 
-    template <AddressModePtr AddrMode>
+    template <AddressModePtr AddrMode, AccuracyProfile profile = EXACT>
     inline void DEC();
 
     template <AddressModePtr AddrMode>
@@ -277,7 +418,7 @@ private:
     template <AddressModePtr AddrMode>
     inline void EOR();
 
-    template <AddressModePtr AddrMode>
+    template <AddressModePtr AddrMode, AccuracyProfile profile = EXACT>
     inline void INC();
 
     template <AddressModePtr AddrMode>
@@ -301,7 +442,7 @@ private:
     template <AddressModePtr AddrMode>
     inline void LDY();
 
-    template <AddressModePtr AddrMode>
+    template <AddressModePtr AddrMode, AccuracyProfile profile = EXACT>
     inline void LSR();
 
     template <AddressModePtr AddrMode>
@@ -322,10 +463,10 @@ private:
     template <AddressModePtr AddrMode>
     inline void PLP();
 
-    template <AddressModePtr AddrMode>
+    template <AddressModePtr AddrMode, AccuracyProfile profile = EXACT>
     inline void ROL();
 
-    template <AddressModePtr AddrMode>
+    template <AddressModePtr AddrMode, AccuracyProfile profile = EXACT>
     inline void ROR();
 
     template <AddressModePtr AddrMode>
@@ -0,0 +1,247 @@
+#include "CaptureSink.h"
+#include "LittleEndian.h"
+#include "Palette.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+
+namespace
+{
+const uint16_t AUDIO_CHANNELS = 1;
+const uint16_t BITS_PER_SAMPLE = 16;
+} // namespace
+
+CaptureSink::CaptureSink(const std::filesystem::path& videoPath, const std::filesystem::path& audioPath,
+                         MasterClock::Region region, Policy policy, size_t capacity)
+    : policy(policy), capacity(std::max<size_t>(capacity, 1))
+{
+    if (!videoPath.empty())
+    {
+        video.open(videoPath, std::ios::binary);
+        if (!video)
+        {
+            throw std::runtime_error("Can't write the video to " + videoPath.string());
+        }
+        // Frame rate as a fraction with microframes, pixels are 8:7 wide
+        MasterClock clock(region);
+        uint64_t rate = std::llround(clock.GetTiming().masterFrequency / clock.GetMasterCyclesPerFrame() * 1000000);
+        uint64_t divisor = std::gcd(rate, (uint64_t)1000000);
+        video << "YUV4MPEG2 W" << FRAME_WIDTH << " H" << FRAME_HEIGHT << " F" << rate / divisor << ":"
+              << 1000000 / divisor << " Ip A8:7 C444\n";
+
+        // Limited range BT.601, as expected by most players
+        Palette palette(Palette::RGBA8888);
+        std::array<uint16_t, 512> pixels;
+        std::iota(pixels.begin(), pixels.end(), 0);
+        std::array<std::array<uint8_t, 4>, 512> rgba;
+        palette.Convert(pixels.data(), pixels.size(), rgba.data());
+        for (size_t i = 0; i < colors.size(); i++)
+        {
+            int r = rgba[i][0], g = rgba[i][1], b = rgba[i][2];
+            colors[i][0] = 16 + ((66 * r + 129 * g + 25 * b + 128) >> 8);
+            colors[i][1] = 128 + ((-38 * r - 74 * g + 112 * b + 128) >> 8);
+            colors[i][2] = 128 + ((112 * r - 94 * g - 18 * b + 128) >> 8);
+        }
+        planes.resize(FRAME_WIDTH * FRAME_HEIGHT * 3);
+    }
+    if (!audioPath.empty())
+    {
+        audio.open(audioPath, std::ios::binary);
+        if (!audio)
+        {
+            throw std::runtime_error("Can't write the audio to " + audioPath.string());
+        }
+        // The sizes are written when the capture is closed
+        audio.write("RIFF", 4);
+        WriteValue<uint32_t>(audio, 0);
+        audio.write("WAVEfmt ", 8);
+        WriteValue<uint32_t>(audio, 16);
+        WriteValue<uint16_t>(audio, 1); // PCM
+        WriteValue<uint16_t>(audio, AUDIO_CHANNELS);
+        WriteValue<uint32_t>(audio, APU::SAMPLE_RATE);
+        WriteValue<uint32_t>(audio, APU::SAMPLE_RATE * AUDIO_CHANNELS * BITS_PER_SAMPLE / 8);
+        WriteValue<uint16_t>(audio, AUDIO_CHANNELS * BITS_PER_SAMPLE / 8);
+        WriteValue<uint16_t>(audio, BITS_PER_SAMPLE);
+        audio.write("data", 4);
+        WriteValue<uint32_t>(audio, 0);
+    }
+    writer = std::thread(&CaptureSink::Run, this);
+}
+
+CaptureSink::~CaptureSink()
+{
+    try
+    {
+        Close();
+    }
+    catch (const std::runtime_error&)
+    {
+    }
+}
+
+bool CaptureSink::Push(const FrameBuffer& frame, const std::vector<int16_t>& samples)
+{
+    std::unique_ptr<Entry> entry;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (closing)
+        {
+            return false;
+        }
+        stats.framesPushed++;
+        if (queue.size() >= capacity)
+        {
+            if (policy == BLOCK)
+            {
+                signal.wait(lock, [&]() { return queue.size() < capacity; });
+            }
+            else if (policy == DROP_NEWEST)
+            {
+                stats.framesDropped++;
+                return false;
+            }
+            else
+            {
+                entry = std::move(queue.front());
+                queue.pop_front();
+                stats.framesDropped++;
+            }
+        }
+        if (!entry && !pool.empty())
+        {
+            entry = std::move(pool.back());
+            pool.pop_back();
+        }
+    }
+    // The copy is done outside of the lock, the writer is never waiting for it
+    if (!entry)
+    {
+        entry = std::make_unique<Entry>();
+    }
+    entry->pixels = frame;
+    entry->samples.assign(samples.begin(), samples.end());
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(std::move(entry));
+    }
+    signal.notify_all();
+    return true;
+}
+
+void CaptureSink::Run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        signal.wait(lock, [&]() { return closing || !queue.empty(); });
+        if (queue.empty())
+        {
+            break;
+        }
+        std::unique_ptr<Entry> entry = std::move(queue.front());
+        queue.pop_front();
+        // Room for a blocked producer
+        signal.notify_all();
+        lock.unlock();
+
+        WriteVideo(entry->pixels);
+        WriteAudio(entry->samples);
+        bool failed = (video.is_open() && !video) || (audio.is_open() && !audio);
+
+        lock.lock();
+        stats.framesWritten++;
+        stats.samplesWritten += audio.is_open() ? entry->samples.size() : 0;
+        if (failed && error.empty())
+        {
+            error = "Can't write the capture, the disk may be full";
+        }
+        pool.push_back(std::move(entry));
+    }
+}
+
+void CaptureSink::WriteVideo(const FrameBuffer& pixels)
+{
+    if (!video.is_open() || !video)
+    {
+        return;
+    }
+    const size_t size = FRAME_WIDTH * FRAME_HEIGHT;
+    uint8_t* y = planes.data();
+    uint8_t* u = y + size;
+    uint8_t* v = u + size;
+    for (size_t i = 0; i < size; i++)
+    {
+        const std::array<uint8_t, 3>& color = colors[pixels[i] & 0x01FF];
+        y[i] = color[0];
+        u[i] = color[1];
+        v[i] = color[2];
+    }
+    video.write("FRAME\n", 6);
+    video.write(reinterpret_cast<const char*>(planes.data()), planes.size());
+}
+
+void CaptureSink::WriteAudio(const std::vector<int16_t>& samples)
+{
+    if (!audio.is_open() || !audio)
+    {
+        return;
+    }
+    for (int16_t sample : samples)
+    {
+        WriteValue<uint16_t>(audio, sample);
+    }
+    audioBytes += samples.size() * sizeof(int16_t);
+}
+
+void CaptureSink::CompleteAudio()
+{
+    // WAV files can't be larger than 4GiB, longer captures keep the maximum size
+    uint32_t dataSize = std::min<uint64_t>(audioBytes, UINT32_MAX - 36);
+    audio.seekp(4);
+    WriteValue<uint32_t>(audio, 36 + dataSize);
+    audio.seekp(40);
+    WriteValue<uint32_t>(audio, dataSize);
+}
+
+void CaptureSink::Close()
+{
+    if (writer.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closing = true;
+        }
+        signal.notify_all();
+        writer.join();
+        if (audio.is_open())
+        {
+            CompleteAudio();
+            audio.close();
+        }
+        if (video.is_open())
+        {
+            video.close();
+        }
+        if ((audio.fail() || video.fail()) && error.empty())
+        {
+            error = "Can't complete the capture";
+        }
+    }
+    if (!error.empty())
+    {
+        throw std::runtime_error(error);
+    }
+}
+
+size_t CaptureSink::GetQueuedFrames() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return queue.size();
+}
+
+CaptureSink::Stats CaptureSink::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
@@ -1,7 +1,25 @@
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 #include "Cartridge.h"
 #include "mappers/NROM.h"
 
+#if defined(__SSE2__)
+#define NESPP_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+void DecodeRow(uint8_t low, uint8_t high, uint8_t* pixels)
+{
+    for (int x = 0; x < 8; x++)
+    {
+        pixels[x] = ((low >> (7 - x)) & 0x01) | (((high >> (7 - x)) & 0x01) << 1);
+    }
+}
+} // namespace
+
 Cartridge::Cartridge()
     : PRG_ROM(32768, 0x00), CHR_ROM(8192, 0x00)
 {
@@ -9,6 +27,9 @@ Cartridge::Cartridge()
     banksPRG = 1;
     banksCHR = 1;
     mapper = std::make_unique<NROM>(banksPRG, banksCHR);
+    decodedCHR.resize(CHR_ROM.size() * 4);
+    DecodeTiles(CHR_ROM.data(), CHR_ROM.size() / 16, decodedCHR.data());
+    UpdateBanksCHR();
 }
 
 void Cartridge::LoadFile(const std::filesystem::path& pathToROM)
@@ -23,7 +44,9 @@ void Cartridge::LoadFile(const std::filesystem::path& pathToROM)
     banksPRG = header.sizePRG;
     PRG_ROM.resize(16384 * banksPRG);
     banksCHR = header.sizeCHR;
-    CHR_ROM.resize(8192 * banksCHR);
+    // Without CHR ROM the cartridge has 8KiB of CHR RAM
+    hasRamCHR = banksCHR == 0;
+    CHR_ROM.assign(8192 * std::max(banksCHR, 1), 0x00);
 
     if(header.flags6 & 0x08)
     {
@@ -51,7 +74,13 @@ void Cartridge::LoadFile(const std::filesystem::path& pathToROM)
         rom.ignore(512);
     }
     rom.read(reinterpret_cast<char*>(PRG_ROM.data()), 16384 * banksPRG);
-    rom.read(reinterpret_cast<char*>(CHR_ROM.data()), 8192 * banksCHR);
+    if(!hasRamCHR)
+    {
+        rom.read(reinterpret_cast<char*>(CHR_ROM.data()), 8192 * banksCHR);
+    }
+    decodedCHR.resize(CHR_ROM.size() * 4);
+    DecodeTiles(CHR_ROM.data(), CHR_ROM.size() / 16, decodedCHR.data());
+    UpdateBanksCHR();
     validRom = true;
 }
 
@@ -60,9 +89,105 @@ uint8_t Cartridge::ReadFromPRG(uint16_t address) const
     return PRG_ROM[mapper->GetAddressPRG(address)];
 }
 
-uint8_t Cartridge::ReadFromCHR(uint16_t address) const
+void Cartridge::ReadBlockFromPRG(uint16_t address, uint8_t* buffer, size_t length) const
+{
+    std::memcpy(buffer, PRG_ROM.data() + mapper->GetAddressPRG(address), length);
+}
+
+void Cartridge::WriteToCHR(uint16_t address, uint8_t data)
+{
+    if(hasRamCHR)
+    {
+        size_t offset = mapper->GetAddressCHR(address);
+        CHR_ROM[offset] = data;
+        // Both planes of the row are needed to decode it
+        size_t low = offset & ~0x0008;
+        DecodeRow(CHR_ROM[low], CHR_ROM[low + 8], decodedCHR.data() + (low & ~0x000F) * 4 + (low & 0x0007) * 8);
+    }
+}
+
+void Cartridge::SaveState(State& state) const
+{
+    if(hasRamCHR)
+    {
+        std::memcpy(state.RAM_CHR.data(), CHR_ROM.data(), state.RAM_CHR.size());
+    }
+}
+
+void Cartridge::LoadState(const State& state)
 {
-    return CHR_ROM[mapper->GetAddressCHR(address)];
+    if(hasRamCHR)
+    {
+        std::memcpy(CHR_ROM.data(), state.RAM_CHR.data(), state.RAM_CHR.size());
+        DecodeTiles(CHR_ROM.data(), CHR_ROM.size() / 16, decodedCHR.data());
+    }
+}
+
+void Cartridge::UpdateBanksCHR()
+{
+    for(size_t window = 0; window < windowsCHR.size(); window++)
+    {
+        size_t offset = mapper->GetAddressCHR(window * 0x0400);
+        windowsCHR[window] = CHR_ROM.data() + offset;
+        decodedWindowsCHR[window] = decodedCHR.data() + offset * 4;
+    }
+}
+
+void Cartridge::DecodeTiles(const uint8_t* tiles, size_t count, uint8_t* pixels)
+{
+#ifdef NESPP_SSE2
+    // Each bit is selected in its own byte, two rows at a time
+    const __m128i bits = _mm_set_epi8(0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char)0x80,
+                                      0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char)0x80);
+    const __m128i one = _mm_set1_epi8(0x01);
+    const __m128i two = _mm_set1_epi8(0x02);
+    for(size_t tile = 0; tile < count; tile++, tiles += 16, pixels += 64)
+    {
+        __m128i planes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tiles));
+        // Every byte of the planes repeated 8 times: rows 0-1, 2-3, 4-5 and 6-7
+        __m128i low = _mm_unpacklo_epi8(planes, planes);
+        __m128i high = _mm_unpackhi_epi8(planes, planes);
+        __m128i lowRows[2]{_mm_unpacklo_epi16(low, low), _mm_unpackhi_epi16(low, low)};
+        __m128i highRows[2]{_mm_unpacklo_epi16(high, high), _mm_unpackhi_epi16(high, high)};
+        for(int half = 0; half < 2; half++)
+        {
+            __m128i lowPairs[2]{_mm_unpacklo_epi32(lowRows[half], lowRows[half]),
+                                _mm_unpackhi_epi32(lowRows[half], lowRows[half])};
+            __m128i highPairs[2]{_mm_unpacklo_epi32(highRows[half], highRows[half]),
+                                 _mm_unpackhi_epi32(highRows[half], highRows[half])};
+            for(int pair = 0; pair < 2; pair++)
+            {
+                __m128i lowPixels = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(lowPairs[pair], bits), bits), one);
+                __m128i highPixels = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(highPairs[pair], bits), bits), two);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + half * 32 + pair * 16),
+                                 _mm_or_si128(lowPixels, highPixels));
+            }
+        }
+    }
+#else
+    for(size_t tile = 0; tile < count; tile++, tiles += 16, pixels += 64)
+    {
+        for(int row = 0; row < 8; row++)
+        {
+            DecodeRow(tiles[row], tiles[row + 8], pixels + row * 8);
+        }
+    }
+#endif
+}
+
+int Cartridge::GetBankPRG(uint16_t address) const
+{
+    return mapper->GetAddressPRG(address) / 16384;
+}
+
+uint64_t Cartridge::GetHashPRG() const
+{
+    uint64_t hash = 0xCBF29CE484222325;
+    for (uint8_t byte : PRG_ROM)
+    {
+        hash = (hash ^ byte) * 0x100000001B3;
+    }
+    return hash;
 }
 
 bool Cartridge::IsValid() const
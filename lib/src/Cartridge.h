@@ -1,11 +1,23 @@
 #ifndef CARTRIDGE_H
 #define CARTRIDGE_H
 
+#include <array>
 #include <vector>
 #include <memory>
 #include <filesystem>
 #include "mappers/Mapper.h"
 
+/*
+ * The pattern tables are read by the PPU through eight 1KiB
+ * windows on CHR memory, resolved with the mapper only when
+ * the banks change, so reads don't go through the mapper.
+ * Every tile is also kept decoded, with its two bit planes
+ * expanded to one pixel (0 to 3) per byte, 8 bytes for each
+ * row: the decoded tiles are built in bulk (with SSE2 where
+ * available) when a ROM is loaded, and the rows written in
+ * CHR RAM are decoded again.
+ */
+
 class Cartridge
 {
 public:
@@ -15,24 +27,73 @@ public:
     void LoadFile(const std::filesystem::path& pathToROM);
 
     uint8_t ReadFromPRG(uint16_t address) const;
-    uint8_t ReadFromCHR(uint16_t address) const;
+    inline uint8_t ReadFromCHR(uint16_t address) const
+    {
+        return windowsCHR[(address >> 10) & 0x07][address & 0x03FF];
+    }
+    // Only cartridges with CHR RAM can be written, writes to ROM are ignored
+    void WriteToCHR(uint16_t address, uint8_t data);
+
+    // Pixels of the tile row whose low bit plane is at the given address
+    inline const uint8_t* GetTileRow(uint16_t address) const
+    {
+        return decodedWindowsCHR[(address >> 10) & 0x07] + ((address & 0x03F0) << 2) + ((address & 0x0007) << 3);
+    }
+
+    // Resolves the CHR windows again, must be called whenever
+    // the mapper switches CHR banks
+    void UpdateBanksCHR();
+
+    // Decodes tiles from their 16 bytes to 64 pixels
+    static void DecodeTiles(const uint8_t* tiles, size_t count, uint8_t* pixels);
+    // Copies PRG ROM starting from the given address, the block must
+    // not cross a 8KiB window (the smallest bank mappers switch)
+    void ReadBlockFromPRG(uint16_t address, uint8_t* buffer, size_t length) const;
+
+    // Index of the 16KiB PRG ROM bank mapped at the given address
+    int GetBankPRG(uint16_t address) const;
+    // Whether writes to PRG ROM have any effect
+    bool HasMapperRegisters() const { return mapper->HasRegisters(); }
 
     bool IsValid() const;
 
+    enum NametableMirroring
+    {
+        HORIZONTAL,
+        VERTICAL,
+        SINGLE_SCREEN,
+        FOUR_SCREEN
+    };
+    NametableMirroring GetMirroring() const { return mirroring; }
+
+    // FNV-1a hash of the PRG ROM
+    uint64_t GetHashPRG() const;
+
+    // What the game can change on the cartridge: the CHR RAM, left
+    // untouched for cartridges with CHR ROM. Mapper registers and
+    // PRG RAM belong here too, for the mappers that have them
+    struct State
+    {
+        std::array<uint8_t, 8192> RAM_CHR;
+    };
+    void SaveState(State& state) const;
+    void LoadState(const State& state);
+
     friend class Debugger;
 private:
     bool validRom;
     int banksPRG, banksCHR;
     std::vector<uint8_t> PRG_ROM;
+    // Holds CHR RAM for cartridges without CHR ROM banks
     std::vector<uint8_t> CHR_ROM;
+    bool hasRamCHR = false;
 
-    enum NametableMirroring
-    {
-        HORIZONTAL,
-        VERTICAL,
-        SINGLE_SCREEN,
-        FOUR_SCREEN
-    } mirroring;
+    // 64 bytes for each 16 bytes tile of CHR memory
+    std::vector<uint8_t> decodedCHR;
+    std::array<const uint8_t*, 8> windowsCHR;
+    std::array<const uint8_t*, 8> decodedWindowsCHR;
+
+    NametableMirroring mirroring = HORIZONTAL;
 
     struct iNES_HeaderFormat
     {
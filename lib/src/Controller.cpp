@@ -0,0 +1,22 @@
+#include "Controller.h"
+
+void Controller::Write(uint8_t data)
+{
+    strobe = data & 0x01;
+    if (strobe)
+    {
+        shiftRegister = buttons;
+    }
+}
+
+uint8_t Controller::Read()
+{
+    // While the strobe is high the register keeps being reloaded
+    if (strobe)
+    {
+        return buttons & 0x01;
+    }
+    uint8_t bit = shiftRegister & 0x01;
+    shiftRegister = (shiftRegister >> 1) | 0x80;
+    return bit;
+}
@@ -0,0 +1,43 @@
+#ifndef CONTROLLER_H
+#define CONTROLLER_H
+
+#include <cstdint>
+
+/*
+ * Standard NES controller: writing 1 and then 0 to
+ * 0x4016 (the strobe) latches the state of the buttons
+ * in a shift register, that is read one button at a
+ * time from bit 0 of 0x4016 (first controller) or
+ * 0x4017 (second controller), in the order of the
+ * Button enum. After the 8 buttons it returns 1.
+ */
+
+class Controller
+{
+public:
+    enum Button : uint8_t
+    {
+        A = 0x01,
+        B = 0x02,
+        SELECT = 0x04,
+        START = 0x08,
+        UP = 0x10,
+        DOWN = 0x20,
+        LEFT = 0x40,
+        RIGHT = 0x80
+    };
+
+    // Mask of Button values currently pressed
+    void SetButtons(uint8_t pressed) { buttons = pressed; }
+    uint8_t GetButtons() const { return buttons; }
+
+    void Write(uint8_t data);
+    uint8_t Read();
+
+private:
+    uint8_t buttons = 0;
+    uint8_t shiftRegister = 0;
+    bool strobe = false;
+};
+
+#endif // CONTROLLER_H
@@ -1,6 +1,7 @@
 #include "Debugger.h"
 #include "EmulatorCore.h"
 #include <fmt/core.h>
+#include <algorithm>
 #include <stdexcept>
 #include <fstream>
 
@@ -22,6 +23,13 @@ void Debugger::LoadInstrFromArray(const uint8_t* instructions, size_t number, ui
         throw std::out_of_range("The given program would exceed RAM capacity of 2KB");
     }
     std::memcpy(core->RAM.data() + startingLocation, instructions, number);
+    if (core->cpu.blockCache)
+    {
+        for (size_t address = startingLocation & 0xFF00; address < startingLocation + number; address += 0x0100)
+        {
+            core->cpu.blockCache->InvalidateRAM(address);
+        }
+    }
 }
 
 void Debugger::SetPC(uint16_t address)
@@ -29,6 +37,31 @@ void Debugger::SetPC(uint16_t address)
     core->cpu.PC = address;
 }
 
+const MasterClock& Debugger::GetClock() const
+{
+    return core->GetClock();
+}
+
+void Debugger::SetRegion(MasterClock::Region region)
+{
+    core->SetRegion(region);
+}
+
+void Debugger::EnableBlockCache(bool enable)
+{
+    core->cpu.EnableBlockCache(enable);
+}
+
+void Debugger::SetAccuracyProfile(CPU::AccuracyProfile profile)
+{
+    core->SetAccuracyProfile(profile);
+}
+
+uint64_t Debugger::GetSkippedIdleCycles() const
+{
+    return core->GetSkippedIdleCycles();
+}
+
 bool Debugger::LoadROM(const std::string& pathToROM)
 {
     return core->LoadGame(pathToROM);
@@ -37,21 +70,199 @@ bool Debugger::LoadROM(const std::string& pathToROM)
 void Debugger::RunWithTrace(const std::filesystem::path& output)
 {
     static std::ofstream log(output);
-    std::string disassembly, outputLine;
-    const CPU::Instruction* instr;
-    CpuState state;
+    if (core->breakpoints)
+    {
+        core->breakpoints->Acknowledge();
+    }
     do
     {
-        state = GetCpuState();
-        core->cpu.opcode = core->cpu.Read(core->cpu.PC);
-        instr = &(core->cpu.opcodeTable[core->cpu.opcode]);
-        Disassembly(&disassembly, core->cpu.PC, instr->bytes);
-        outputLine = fmt::format("{}\t\t\t\tA:{:02X} X:{:02X} Y:{:02X} P:{:02X} SP:{:02X}\tcycles:{:d}\n",
-                                 disassembly, state.A, state.X, state.Y, state.PS.value, state.SP, state.cycleCount);
-        log << outputLine;
-        core->cpu.PC++;
-        core->cpu.ExecuteInstruction();
-    } while(core->cpu.opcode != 0x00 && instr->ptr != &CPU::Illegal);}
+        log << FormatTraceLine();
+        StepInstruction();
+    } while(core->cpu.opcode != 0x00 && core->cpu.handlers[core->cpu.opcode] != &CPU::Illegal &&
+            !BreakpointTriggered() && !(core->breakpoints && core->breakpoints->CheckExecute(core->cpu.PC, core->cpu)));
+}
+
+std::string Debugger::FormatTraceLine()
+{
+    std::string disassembly;
+    CpuState state = GetCpuState();
+    Disassembly(&disassembly, state.PC, 1);
+    return fmt::format("{}\t\t\t\tA:{:02X} X:{:02X} Y:{:02X} P:{:02X} SP:{:02X}\tcycles:{:d}\n", disassembly,
+                       state.A, state.X, state.Y, state.PS.value, state.SP, state.cycleCount);
+}
+
+int Debugger::AddBreakpoint(uint8_t type, uint16_t start, uint16_t end, const std::string& condition)
+{
+    if (!core->breakpoints)
+    {
+        core->breakpoints = std::make_unique<Breakpoints>();
+    }
+    return core->breakpoints->Add(type, start, end, condition);
+}
+
+int Debugger::AddBreakpoint(uint8_t type, uint16_t address, const std::string& condition)
+{
+    return AddBreakpoint(type, address, address, condition);
+}
+
+bool Debugger::RemoveBreakpoint(int id)
+{
+    if (!core->breakpoints || !core->breakpoints->Remove(id))
+    {
+        return false;
+    }
+    // Without breakpoints the bus goes back to full speed
+    if (core->breakpoints->IsEmpty())
+    {
+        core->breakpoints.reset();
+    }
+    return true;
+}
+
+void Debugger::ClearBreakpoints()
+{
+    core->breakpoints.reset();
+}
+
+bool Debugger::Step()
+{
+    if (core->breakpoints)
+    {
+        core->breakpoints->Acknowledge();
+    }
+    StepInstruction();
+    return BreakpointTriggered();
+}
+
+bool Debugger::Continue()
+{
+    // The first instruction is always executed, so that
+    // execution can be resumed from an execution breakpoint
+    if (Step())
+    {
+        return true;
+    }
+    while (core->cpu.opcode != 0x00 && core->cpu.handlers[core->cpu.opcode] != &CPU::Illegal)
+    {
+        if (core->breakpoints && core->breakpoints->CheckExecute(core->cpu.PC, core->cpu))
+        {
+            return true;
+        }
+        StepInstruction();
+        if (BreakpointTriggered())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+Breakpoints::Hit Debugger::GetLastBreakpointHit() const
+{
+    if (!core->breakpoints)
+    {
+        return {};
+    }
+    return core->breakpoints->GetLastHit();
+}
+
+bool Debugger::BreakpointTriggered() const
+{
+    return core->breakpoints && core->breakpoints->HasTriggered();
+}
+
+void Debugger::StepInstruction()
+{
+    CPU& cpu = core->cpu;
+    if (!core->profiler)
+    {
+        cpu.Step();
+        return;
+    }
+    uint16_t PC = cpu.PC;
+    uint64_t startingCycle = core->clock.GetCpuCycles();
+    bool interrupted = cpu.Step();
+    uint32_t cycles = core->clock.GetCpuCycles() - startingCycle;
+    if (interrupted)
+    {
+        // The opcode is still the one of the interrupted instruction,
+        // the interrupt sequence is charged to the handler
+        core->profiler->RecordInterrupt(cycles, core->GetCodeBank(cpu.PC), cpu.PC, cpu.SP);
+    }
+    else
+    {
+        core->profiler->Record(PC, cpu.opcode, cycles, core->GetCodeBank(PC), cpu.PC, cpu.SP);
+    }
+}
+
+void Debugger::StartProfiling()
+{
+    core->profiler = std::make_unique<Profiler>(core->cpu.PC, core->cpu.SP);
+}
+
+void Debugger::StopProfiling()
+{
+    core->profiler.reset();
+}
+
+const Profiler* Debugger::GetProfiler() const
+{
+    return core->profiler.get();
+}
+
+void Debugger::WriteProfilerReport(const std::filesystem::path& output, size_t number)
+{
+    if (!core->profiler)
+    {
+        return;
+    }
+    const Profiler& profiler = *core->profiler;
+    std::ofstream report(output);
+    uint64_t total = std::max<uint64_t>(profiler.GetTotalCycles(), 1);
+    report << fmt::format("Instructions: {:d}\tCycles: {:d}\n\n", profiler.GetTotalInstructions(),
+                          profiler.GetTotalCycles());
+
+    report << "Hottest instructions\n";
+    std::string disassembly;
+    for (const Profiler::Hotspot& hotspot : profiler.GetHotspots(number))
+    {
+        Disassembly(&disassembly, hotspot.PC, 1);
+        report << fmt::format("{:6.2f}%  {:>12d} cycles {:>12d} times  {}\n", 100.0 * hotspot.cycles / total,
+                              hotspot.cycles, hotspot.instructions, disassembly);
+    }
+
+    report << "\nSubroutines (inclusive / exclusive cycles)\n";
+    std::vector<Profiler::Subroutine> subroutines = profiler.GetSubroutines();
+    for (size_t i = 0; i < subroutines.size() && i < number; i++)
+    {
+        const Profiler::Subroutine& subroutine = subroutines[i];
+        report << fmt::format("${:04X}  {:6.2f}% {:>12d}  {:6.2f}% {:>12d}  {:d} calls\n", subroutine.address,
+                              100.0 * subroutine.inclusiveCycles / total, subroutine.inclusiveCycles,
+                              100.0 * subroutine.exclusiveCycles / total, subroutine.exclusiveCycles,
+                              subroutine.calls);
+    }
+
+    report << "\nBanks\n";
+    const std::vector<uint64_t>& banks = profiler.GetBankCycles();
+    for (size_t bank = 0; bank < banks.size(); bank++)
+    {
+        if (banks[bank] == 0)
+        {
+            continue;
+        }
+        std::string name = (bank == 0) ? std::string("RAM") : fmt::format("PRG {:d}", bank - 1);
+        report << fmt::format("{:<8}{:6.2f}% {:>12d}\n", name, 100.0 * banks[bank] / total, banks[bank]);
+    }
+}
+
+void Debugger::WriteFoldedStacks(const std::filesystem::path& output)
+{
+    if (core->profiler)
+    {
+        std::ofstream folded(output);
+        core->profiler->WriteFoldedStacks(folded);
+    }
+}
 
 size_t Debugger::Disassembly(std::string* outputArray, uint16_t startingAddress, size_t number)
 {
@@ -60,11 +271,9 @@ size_t Debugger::Disassembly(std::string* outputArray, uint16_t startingAddress,
     size_t instructionsRead = 0;
     while (address < startingAddress + number)
     {
-        const CPU::Instruction& currentInstruction = core->cpu.opcodeTable[core->Read(address)];
-        for (size_t i = 0; i < currentInstruction.bytes; i++)
-        {
-            bytes[i] = core->Read(address + i);
-        }
+        // Reading the code to disassemble must not have side effects
+        const CPU::Instruction& currentInstruction = CPU::instructions[core->Peek(address)];
+        core->PeekRange(address, bytes, currentInstruction.bytes);
         switch (currentInstruction.mode)
         {
         case CPU::IMP:
@@ -113,7 +322,7 @@ size_t Debugger::Disassembly(std::string* outputArray, uint16_t startingAddress,
         }
         case CPU::REL: {
             outputArray[instructionsRead] = fmt::format("{:0>4X} {:02X} {:02X}\t\t{} ${:+d}", address, bytes[0],
-                                                        bytes[1], currentInstruction.mnemonic, (int)bytes[1]);
+                                                        bytes[1], currentInstruction.mnemonic, (int)(int8_t)bytes[1]);
             break;
         }
         case CPU::IND: {
@@ -147,8 +356,11 @@ Debugger::CpuState Debugger::ExecuteInstrFromArray(const uint8_t* instructions,
 {
     core->cpu.Reset();
     LoadInstrFromArray(instructions, number, startingLocation);
+    uint64_t startingCycle = core->clock.GetCpuCycles();
     core->cpu.ExecuteInstrFromRAM(startingLocation, number);
-    return GetCpuState();
+    CpuState state = GetCpuState();
+    state.cycleCount -= startingCycle;
+    return state;
 }
 
 const std::array<uint8_t, 2048>& Debugger::GetMemoryState() const
@@ -156,12 +368,227 @@ const std::array<uint8_t, 2048>& Debugger::GetMemoryState() const
     return core->RAM;
 }
 
+uint64_t Debugger::GetMemoryHash() const
+{
+    return core->GetMemoryHash();
+}
+
+std::vector<uint8_t> Debugger::GetMemoryRange(uint16_t address, size_t length) const
+{
+    std::vector<uint8_t> memory(length);
+    core->PeekRange(address, memory.data(), length);
+    return memory;
+}
+
+const std::array<uint8_t, 256>& Debugger::GetOAM() const
+{
+    return core->ppu.GetOAM();
+}
+
 const std::vector<uint8_t>& Debugger::GetPRG_ROM() const
 {
     return core->cart.PRG_ROM;
 }
 
+Debugger::LockstepResult Debugger::RunLockstep(Debugger& reference, uint64_t maxInstructions,
+                                              LockstepGranularity granularity)
+{
+    CPU& cpu = core->cpu;
+    const MasterClock& clock = core->clock;
+    const MasterClock& referenceClock = reference.core->clock;
+    LockstepResult result{};
+    uint64_t frame = clock.GetFrame();
+    bool stopped = false;
+    while (result.instructions < maxInstructions && !stopped)
+    {
+        result.PC = cpu.PC;
+        StepInstruction();
+        result.instructions++;
+        stopped = cpu.opcode == 0x00 || cpu.handlers[cpu.opcode] == &CPU::Illegal;
+        if (granularity == FRAME && clock.GetFrame() == frame && !stopped && result.instructions < maxInstructions)
+        {
+            continue;
+        }
+        frame = clock.GetFrame();
+
+        // Catch up to the same cycle, whichever emulator is behind
+        while (referenceClock.GetCpuCycles() < clock.GetCpuCycles())
+        {
+            reference.StepInstruction();
+        }
+        while (clock.GetCpuCycles() < referenceClock.GetCpuCycles())
+        {
+            result.PC = cpu.PC;
+            StepInstruction();
+            result.instructions++;
+        }
+
+        result.state = GetCpuState();
+        result.referenceState = reference.GetCpuState();
+        const CpuState& a = result.state;
+        const CpuState& b = result.referenceState;
+        bool sameState = a.PC == b.PC && a.SP == b.SP && a.A == b.A && a.X == b.X && a.Y == b.Y &&
+                         a.PS.value == b.PS.value && a.cycleCount == b.cycleCount;
+        result.memoryDiverged = GetMemoryHash() != reference.GetMemoryHash();
+        if (!sameState || result.memoryDiverged)
+        {
+            result.diverged = true;
+            break;
+        }
+    }
+
+    if (result.diverged)
+    {
+        Disassembly(&result.disassembly, result.PC, 1);
+        for (size_t address = 0; address < core->RAM.size() && result.memoryDiverged; address++)
+        {
+            if (core->RAM[address] != reference.core->RAM[address])
+            {
+                result.address = address;
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+std::string Debugger::FormatLockstepResult(const LockstepResult& result)
+{
+    if (!result.diverged)
+    {
+        return fmt::format("No divergence in {:d} instructions\n", result.instructions);
+    }
+    auto format = [](const char* name, const CpuState& state) {
+        return fmt::format("{:<10}PC:{:04X} A:{:02X} X:{:02X} Y:{:02X} P:{:02X} SP:{:02X} cycles:{:d}\n", name,
+                           state.PC, state.A, state.X, state.Y, state.PS.value, state.SP, state.cycleCount);
+    };
+    std::string output = fmt::format("Diverged after {:d} instructions, at {}\n", result.instructions,
+                                     result.disassembly);
+    output += format("State", result.state);
+    output += format("Reference", result.referenceState);
+    if (result.memoryDiverged)
+    {
+        output += fmt::format("RAM differs from ${:04X}\n", result.address);
+    }
+    return output;
+}
+
 Debugger::CpuState Debugger::GetCpuState() const
 {
-    return {core->cpu.SP, core->cpu.A, core->cpu.X, core->cpu.Y, core->cpu.PS, core->cpu.PC, core->cpu.cycleCount};
+    BitMappedRegister<CPU::CpuStatusFlags> PS{core->cpu.GetStatus()};
+    return {core->cpu.SP, core->cpu.A, core->cpu.X, core->cpu.Y, PS, core->cpu.PC, core->clock.GetCpuCycles()};
+}
+
+Debugger::PerfReport Debugger::Measure(const std::function<uint64_t()>& run)
+{
+    PerfReport report{};
+#ifdef NESPP_INSTRUMENTATION
+    BusCounters before = core->counters;
+    uint64_t instructionsBefore = core->cpu.instructionCount;
+#endif
+    PerfCounters counters;
+    counters.Start();
+    report.emulatedCycles = run();
+    counters.Stop();
+    report.host = counters.Read();
+#ifdef NESPP_INSTRUMENTATION
+    report.busCountersEnabled = true;
+    for (int region = 0; region < BusCounters::REGIONS; region++)
+    {
+        report.bus.reads[region] = core->counters.reads[region] - before.reads[region];
+        report.bus.writes[region] = core->counters.writes[region] - before.writes[region];
+    }
+    report.bus.mapperWrites = core->counters.mapperWrites - before.mapperWrites;
+    report.bus.instructions = core->cpu.instructionCount - instructionsBefore;
+#endif
+    return report;
+}
+
+Debugger::PerfReport Debugger::RunInstrumented()
+{
+    return Measure([this]() {
+        uint64_t startingCycle = core->clock.GetCpuCycles();
+        core->cpu.Run();
+        return core->clock.GetCpuCycles() - startingCycle;
+    });
+}
+
+Debugger::PerfReport Debugger::RunFrameInstrumented(bool draw)
+{
+    return Measure([this, draw]() {
+        uint64_t startingCycle = core->clock.GetCpuCycles();
+        core->RunFrame(draw);
+        return core->clock.GetCpuCycles() - startingCycle;
+    });
+}
+
+Debugger::PerfReport Debugger::ExecuteInstrumented(const uint8_t* instructions, size_t number,
+                                                   uint16_t startingLocation)
+{
+    // Reading the reset vector isn't part of the measured instructions
+    core->cpu.Reset();
+    LoadInstrFromArray(instructions, number, startingLocation);
+    return Measure([&]() {
+        uint64_t startingCycle = core->clock.GetCpuCycles();
+        core->cpu.ExecuteInstrFromRAM(startingLocation, number);
+        return core->clock.GetCpuCycles() - startingCycle;
+    });
+}
+
+std::string Debugger::FormatPerfReport(const PerfReport& report)
+{
+    const PerfCounters::Values& host = report.host;
+    double emulatedCycles = std::max<uint64_t>(report.emulatedCycles, 1);
+    std::string output = fmt::format("Emulated cycles: {:d}\n", report.emulatedCycles);
+
+    const char* names[PerfCounters::EVENTS]{"Task clock (ns)", "Host cycles", "Host instructions",
+                                            "Branch misses", "L1d read misses"};
+    for (int event = 0; event < PerfCounters::EVENTS; event++)
+    {
+        if (host.available[event])
+        {
+            output += fmt::format("{:<20}{:>14d}  {:10.3f} per emulated cycle\n", names[event], host.count[event],
+                                  host.count[event] / emulatedCycles);
+        }
+        else
+        {
+            output += fmt::format("{:<20}{:>14}\n", names[event], "unavailable");
+        }
+    }
+    if (host.available[PerfCounters::CYCLES] && host.available[PerfCounters::INSTRUCTIONS])
+    {
+        output += fmt::format("Host IPC: {:.3f}\n", (double)host.count[PerfCounters::INSTRUCTIONS] /
+                                                        std::max<uint64_t>(host.count[PerfCounters::CYCLES], 1));
+    }
+
+    if (!report.busCountersEnabled)
+    {
+        output += "Bus counters disabled (build with NESpp_ENABLE_INSTRUMENTATION)\n";
+        return output;
+    }
+    double instructions = std::max<uint64_t>(report.bus.instructions, 1);
+    output += fmt::format("Emulated instructions: {:d}\n", report.bus.instructions);
+    if (host.available[PerfCounters::CYCLES])
+    {
+        output += fmt::format("Host cycles per instruction: {:.3f}\n",
+                              host.count[PerfCounters::CYCLES] / instructions);
+    }
+    if (host.available[PerfCounters::BRANCH_MISSES])
+    {
+        output += fmt::format("Branch misses per instruction: {:.4f}\n",
+                              host.count[PerfCounters::BRANCH_MISSES] / instructions);
+    }
+    if (host.available[PerfCounters::L1D_READ_MISSES])
+    {
+        output += fmt::format("L1d misses per instruction: {:.4f}\n",
+                              host.count[PerfCounters::L1D_READ_MISSES] / instructions);
+    }
+    const char* regions[BusCounters::REGIONS]{"RAM", "PPU", "APU/IO", "Disabled", "Cartridge"};
+    for (int region = 0; region < BusCounters::REGIONS; region++)
+    {
+        output += fmt::format("{:<10} reads: {:>12d}  writes: {:>12d}\n", regions[region], report.bus.reads[region],
+                              report.bus.writes[region]);
+    }
+    output += fmt::format("Mapper writes: {:d}\n", report.bus.mapperWrites);
+    return output;
 }
@@ -0,0 +1,214 @@
+#include "EmulationThread.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+EmulationThread::EmulationThread(const EmulatorCore& other)
+    : EmulatorCore(other)
+{
+}
+
+EmulationThread::~EmulationThread()
+{
+    Stop();
+}
+
+void EmulationThread::SetFrameCallback(std::function<void()> callback)
+{
+    if (!IsRunning())
+    {
+        frameCallback = std::move(callback);
+    }
+}
+
+void EmulationThread::Start()
+{
+    if (!IsRunning())
+    {
+        thread = std::thread(&EmulationThread::Run, this);
+    }
+}
+
+void EmulationThread::Stop()
+{
+    if (IsRunning())
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        signal.notify_all();
+        thread.join();
+        stopping = false;
+    }
+}
+
+void EmulationThread::SetPacing(Pacing mode)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pacing = mode;
+        vsyncCredit = 0;
+        audioQueued = 0;
+    }
+    signal.notify_all();
+}
+
+void EmulationThread::SetSpeed(double newSpeed)
+{
+    // Also rejects NaN, the frame period is divided by the speed
+    if (!(newSpeed > 0))
+    {
+        throw std::invalid_argument("The speed must be positive");
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        speed = newSpeed;
+    }
+    signal.notify_all();
+}
+
+void EmulationThread::SetFastForward(bool enable)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        fastForward = enable;
+    }
+    signal.notify_all();
+}
+
+void EmulationThread::NotifyVSync()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // Refreshes missed while the emulation was late are not made up for
+        vsyncCredit = std::min(vsyncCredit + speed, 1 + speed);
+    }
+    signal.notify_all();
+}
+
+void EmulationThread::NotifyAudioConsumed(double seconds)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        audioQueued = std::max(audioQueued - seconds, 0.0);
+    }
+    signal.notify_all();
+}
+
+void EmulationThread::SetAudioLatency(double latency)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        audioLatency = latency;
+    }
+    signal.notify_all();
+}
+
+EmulationThread::Timing EmulationThread::GetTiming() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return timing;
+}
+
+void EmulationThread::ResetTiming()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Timing reset{};
+    reset.targetPeriod = timing.targetPeriod;
+    timing = reset;
+    intervals = 0;
+    periodSquares = 0;
+}
+
+void EmulationThread::Run()
+{
+    using Clock = std::chrono::steady_clock;
+    std::unique_lock<std::mutex> lock(mutex);
+    Clock::time_point deadline = Clock::now();
+    Clock::time_point lastStart;
+    bool lastPaced = false;
+    while (true)
+    {
+        // The clock is only accessed by this thread while running
+        const MasterClock& clock = core->GetClock();
+        timing.targetPeriod = clock.GetMasterCyclesPerFrame() / clock.GetTiming().masterFrequency;
+        double duration = timing.targetPeriod / speed;
+
+        if (!WaitForFrame(lock, deadline))
+        {
+            break;
+        }
+        bool paced = !fastForward;
+        if (pacing == AUDIO)
+        {
+            audioQueued += duration;
+        }
+        lock.unlock();
+
+        Clock::time_point start = Clock::now();
+        core->GetController(0).SetButtons(buttons[0]);
+        core->GetController(1).SetButtons(buttons[1]);
+        core->RunFrame();
+        if (frameCallback)
+        {
+            frameCallback();
+        }
+        Clock::time_point end = Clock::now();
+
+        lock.lock();
+        double interval = (paced && lastPaced) ? std::chrono::duration<double>(start - lastStart).count() : 0;
+        RecordFrame(std::chrono::duration<double>(end - start).count(), interval, duration);
+        lastStart = start;
+        lastPaced = paced;
+
+        auto frameDuration = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(duration));
+        deadline += frameDuration;
+        // After falling more than a frame behind (or fast forwarding) the
+        // schedule restarts from now, instead of running frames in a burst
+        if (deadline + frameDuration < end)
+        {
+            deadline = end;
+        }
+    }
+}
+
+bool EmulationThread::WaitForFrame(std::unique_lock<std::mutex>& lock, std::chrono::steady_clock::time_point deadline)
+{
+    switch (pacing)
+    {
+    case WALL_CLOCK: {
+        signal.wait_until(lock, deadline, [&]() { return stopping || fastForward || pacing != WALL_CLOCK; });
+        break;
+    }
+    case VSYNC: {
+        signal.wait(lock, [&]() { return stopping || fastForward || pacing != VSYNC || vsyncCredit >= 1; });
+        if (!fastForward && pacing == VSYNC && vsyncCredit >= 1)
+        {
+            vsyncCredit -= 1;
+        }
+        break;
+    }
+    case AUDIO: {
+        signal.wait(lock, [&]() { return stopping || fastForward || pacing != AUDIO || audioQueued < audioLatency; });
+        break;
+    }
+    }
+    return !stopping;
+}
+
+void EmulationThread::RecordFrame(double frameTime, double interval, double expected)
+{
+    timing.frames++;
+    timing.meanFrameTime += (frameTime - timing.meanFrameTime) / timing.frames;
+    if (interval == 0)
+    {
+        return;
+    }
+    intervals++;
+    double delta = interval - timing.meanPeriod;
+    timing.meanPeriod += delta / intervals;
+    periodSquares += delta * (interval - timing.meanPeriod);
+    timing.jitter = std::sqrt(periodSquares / intervals);
+    timing.maxDeviation = std::max(timing.maxDeviation, std::abs(interval - expected));
+}
@@ -0,0 +1,23 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Picture output by the PPU. Pixels are kept as they are
+ * generated: the 6 bit index of the color in the system
+ * palette, with the 3 color emphasis bits of PPUMASK
+ * (red, green and blue on NTSC) in bits 6 to 8.
+ * Converting them to the format of the host is left to
+ * the Palette, which writes directly to the surfaces of
+ * the frontends.
+ */
+
+const size_t FRAME_WIDTH = 256;
+const size_t FRAME_HEIGHT = 240;
+
+typedef std::array<uint16_t, FRAME_WIDTH * FRAME_HEIGHT> FrameBuffer;
+
+#endif // FRAMEBUFFER_H
@@ -0,0 +1,147 @@
+#include "IdleLoops.h"
+#include "NES.h"
+#include <algorithm>
+#include <string_view>
+
+namespace
+{
+// Instructions without side effects outside of the registers
+bool IsPure(std::string_view mnemonic)
+{
+    static const std::string_view PURE[]{"LDA", "LDX", "LDY", "BIT", "CMP", "CPX", "CPY", "AND", "ORA",
+                                         "EOR", "NOP", "CLC", "SEC", "CLV", "TAX", "TAY", "TXA", "TYA"};
+    return std::find(std::begin(PURE), std::end(PURE), mnemonic) != std::end(PURE);
+}
+
+bool IsStatusRegister(uint16_t address)
+{
+    return address >= 0x2000 && address < 0x4000 && (address & 0x0007) == 2;
+}
+} // namespace
+
+IdleLoops::IdleLoops(CPU& cpu, NES& bus)
+    : cpu(cpu), bus(bus)
+{
+}
+
+void IdleLoops::Clear()
+{
+    loops.fill(Loop());
+    Reset();
+}
+
+const IdleLoops::Loop& IdleLoops::GetLoop(uint16_t start)
+{
+    uint32_t key = ((uint32_t)bus.GetCodeBank(start) << 16) | start;
+    Loop& loop = loops[(start ^ (start >> 6)) % loops.size()];
+    if (loop.key != key)
+    {
+        loop.key = key;
+        Analyze(loop, start);
+    }
+    return loop;
+}
+
+void IdleLoops::Analyze(Loop& loop, uint16_t start) const
+{
+    loop.idle = loop.readsStatus = false;
+    loop.instructions = loop.cycles = 0;
+    if (start < 0x8000)
+    {
+        return;
+    }
+    uint16_t address = start;
+    for (int i = 0; i < MAX_INSTRUCTIONS; i++)
+    {
+        const CPU::Instruction& instruction = CPU::instructions[bus.Peek(address)];
+        // The whole body is in the same bank as its start
+        uint32_t next = address + instruction.bytes;
+        if ((next - 1) >> 13 != start >> 13)
+        {
+            return;
+        }
+        uint16_t operand = bus.Peek(address + 1) | (bus.Peek(address + 2) << 8);
+        std::string_view mnemonic(instruction.mnemonic);
+        loop.instructions++;
+        loop.cycles += instruction.cycles;
+
+        if (instruction.mode == CPU::REL || (mnemonic == "JMP" && instruction.mode == CPU::ABS))
+        {
+            uint16_t target = operand;
+            if (instruction.mode == CPU::REL)
+            {
+                // Taken branches last one more cycle, two when crossing a page
+                target = next + (int8_t)operand;
+                loop.cycles += ((target & 0xFF00) != (next & 0xFF00)) ? 2 : 1;
+            }
+            loop.idle = target == start;
+            return;
+        }
+        if (!IsPure(mnemonic))
+        {
+            return;
+        }
+        switch (instruction.mode)
+        {
+        case CPU::IMP:
+        case CPU::IMM:
+        case CPU::ZP: break;
+        case CPU::ABS:
+            if (IsStatusRegister(operand))
+            {
+                loop.readsStatus = true;
+            }
+            else if (operand >= 0x2000 && operand < 0x8000)
+            {
+                return;
+            }
+            break;
+        default: return;
+        }
+        address = next;
+    }
+}
+
+void IdleLoops::Check(uint64_t endCycle)
+{
+    const uint16_t start = cpu.PC;
+    const Loop& loop = GetLoop(start);
+    if (!loop.idle)
+    {
+        return;
+    }
+    const MasterClock& clock = bus.clock;
+    uint64_t statusCycle = UINT64_MAX;
+    if (loop.readsStatus)
+    {
+        bus.ppu.Sync();
+        statusCycle = clock.GetCycleOfPpuDot(bus.ppu.GetStatusStableDots());
+    }
+    Iteration current{start, cpu.A, cpu.X, cpu.Y, cpu.SP, cpu.GetStatus(), clock.GetCpuCycles(),
+                      bus.nmiCycle, bus.apuEventCycle, statusCycle};
+    // An iteration that took exactly its own cycles wasn't interrupted,
+    // nor halted by the DMC; the status is read before its last cycle
+    bool fixedPoint = last.PC == start && current.cycle - last.cycle == loop.cycles &&
+                      current.cycle <= last.statusCycle && current.A == last.A && current.X == last.X &&
+                      current.Y == last.Y && current.SP == last.SP && current.P == last.P &&
+                      current.nmiCycle == last.nmiCycle && current.apuEventCycle == last.apuEventCycle;
+    last = current;
+    if (!fixedPoint || (bus.IsIrqAsserted() && !(current.P & CPU::I)))
+    {
+        return;
+    }
+
+    uint64_t limit = std::min({current.nmiCycle, current.apuEventCycle, current.statusCycle, endCycle});
+    if (limit <= current.cycle)
+    {
+        return;
+    }
+    uint64_t iterations = (limit - current.cycle) / loop.cycles;
+    uint64_t cycles = iterations * loop.cycles;
+    bus.clock.Advance(cycles);
+    last.cycle += cycles;
+    skippedCycles += cycles;
+#ifdef NESPP_INSTRUMENTATION
+    cpu.instructionCount += iterations * loop.instructions;
+#endif
+}
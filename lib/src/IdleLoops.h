@@ -0,0 +1,84 @@
+#ifndef IDLELOOPS_H
+#define IDLELOOPS_H
+
+#include <array>
+#include <cstdint>
+
+/*
+ * Fast forward of the loops in which games wait for the VBlank,
+ * the NMI or an IRQ, like "LDA $2002 ; BPL" or "JMP *".
+ * A loop can be skipped when its body is a single straight run
+ * of instructions in PRG ROM, ending with the branch or the jump
+ * back to its start, that doesn't write anything and only reads
+ * RAM, PRG ROM and PPUSTATUS. Once an iteration ends with the
+ * same registers it started with, having read the same PPUSTATUS
+ * that the next one is going to read, every following iteration does
+ * exactly the same until something outside of the CPU changes:
+ * the NMI, an APU event (IRQs and DMC fetches), the end of the
+ * frame or a change of PPUSTATUS. The clock is then advanced by
+ * the whole iterations that fit before the first of them, and
+ * the loop goes on normally from there: the state is the same
+ * as if every iteration had been executed.
+ * Iterations are only skipped by NES::RunFrame, while there are
+ * no breakpoints and no profiler, since they observe every access
+ * and every instruction. The bus counters don't count the skipped
+ * accesses, the instruction counter does.
+ */
+
+class IdleLoops
+{
+public:
+    IdleLoops(class CPU& cpu, class NES& bus);
+    ~IdleLoops() = default;
+
+    // Called after an instruction that moved PC backward, possibly to
+    // the start of a loop. Iterations are skipped up to the given cycle
+    void Check(uint64_t endCycle);
+
+    // Forgets the loop being checked, when the state is replaced
+    void Reset() { last.PC = 0; }
+    // Forgets the loops analyzed, when the PRG ROM changes
+    void Clear();
+
+    // CPU cycles skipped since the emulator was created
+    uint64_t GetSkippedCycles() const { return skippedCycles; }
+
+private:
+    struct Loop
+    {
+        // Bank and address of the first instruction
+        uint32_t key = UINT32_MAX;
+        bool idle;
+        bool readsStatus;
+        uint8_t instructions;
+        // Length of an iteration
+        uint8_t cycles;
+    };
+
+    // Longest loop body considered, in instructions
+    static const int MAX_INSTRUCTIONS = 8;
+
+    // Loops are analyzed once, the result is kept in a small
+    // direct mapped cache to keep the check cheap
+    const Loop& GetLoop(uint16_t start);
+    void Analyze(Loop& loop, uint16_t start) const;
+
+    CPU& cpu;
+    NES& bus;
+
+    std::array<Loop, 64> loops;
+
+    // State at the start of the last iteration of a loop
+    struct Iteration
+    {
+        uint16_t PC = 0;
+        uint8_t A, X, Y, SP, P;
+        uint64_t cycle, nmiCycle, apuEventCycle;
+        // First cycle at which PPUSTATUS may read differently
+        uint64_t statusCycle;
+    } last;
+
+    uint64_t skippedCycles = 0;
+};
+
+#endif // IDLELOOPS_H
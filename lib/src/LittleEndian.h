@@ -0,0 +1,34 @@
+#ifndef LITTLEENDIAN_H
+#define LITTLEENDIAN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+
+/*
+ * Integers written to files (movies, WAV headers) are stored
+ * in little endian, regardless of the host.
+ */
+
+template <typename T>
+void WriteValue(std::ostream& file, T value)
+{
+    for (size_t i = 0; i < sizeof(T); i++)
+    {
+        file.put(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+template <typename T>
+T ReadValue(std::istream& file)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < sizeof(T); i++)
+    {
+        value |= (uint64_t)(uint8_t)file.get() << (8 * i);
+    }
+    return static_cast<T>(value);
+}
+
+#endif // LITTLEENDIAN_H
@@ -0,0 +1,76 @@
+#include "MasterClock.h"
+
+namespace
+{
+// Indexed by MasterClock::Region
+const MasterClock::Timing TIMINGS[]{
+    {236.25e6 / 11, 12, 4, 262}, // NTSC: 21.477272 MHz
+    {26.6017125e6, 16, 5, 312},  // PAL
+    {26.6017125e6, 15, 5, 312},  // Dendy: PAL clock with a faster CPU
+};
+} // namespace
+
+MasterClock::MasterClock(Region region)
+    : region(region), timing(TIMINGS[region])
+{
+}
+
+void MasterClock::SetRegion(Region newRegion)
+{
+    baseMasterCycles = GetMasterCycles();
+    baseCpuCycles = cpuCycles;
+    region = newRegion;
+    timing = TIMINGS[region];
+}
+
+void MasterClock::SaveState(State& state) const
+{
+    state.cpuCycles = cpuCycles;
+    state.baseMasterCycles = baseMasterCycles;
+    state.baseCpuCycles = baseCpuCycles;
+    state.region = region;
+}
+
+void MasterClock::LoadState(const State& state)
+{
+    cpuCycles = state.cpuCycles;
+    baseMasterCycles = state.baseMasterCycles;
+    baseCpuCycles = state.baseCpuCycles;
+    region = state.region;
+    timing = TIMINGS[region];
+}
+
+uint32_t MasterClock::GetScanline() const
+{
+    return (GetPpuDots() % (GetMasterCyclesPerFrame() / timing.ppuDivider)) / DOTS_PER_SCANLINE;
+}
+
+uint32_t MasterClock::GetDot() const
+{
+    return GetPpuDots() % DOTS_PER_SCANLINE;
+}
+
+uint64_t MasterClock::GetCycleOfMasterCycle(uint64_t masterCycle) const
+{
+    if (masterCycle <= baseMasterCycles)
+    {
+        return baseCpuCycles;
+    }
+    return baseCpuCycles + (masterCycle - baseMasterCycles + timing.cpuDivider - 1) / timing.cpuDivider;
+}
+
+uint64_t MasterClock::GetFrameStartCycle(uint64_t frame) const
+{
+    return GetCycleOfMasterCycle(frame * GetMasterCyclesPerFrame());
+}
+
+uint64_t MasterClock::GetCycleOfPpuDot(uint64_t dot) const
+{
+    return GetCycleOfMasterCycle(dot * timing.ppuDivider);
+}
+
+uint64_t MasterClock::GetCyclesUntilFrame(uint64_t frame) const
+{
+    uint64_t start = GetFrameStartCycle(frame);
+    return (start > cpuCycles) ? start - cpuCycles : 0;
+}
@@ -0,0 +1,97 @@
+#ifndef MASTERCLOCK_H
+#define MASTERCLOCK_H
+
+#include <cstdint>
+
+/*
+ * All the timing of the console comes from a single master
+ * clock (a crystal oscillator), which is divided to obtain
+ * the CPU and PPU clocks; the dividers and the number of
+ * scanlines depend on the region of the console.
+ * Only CPU cycles are counted, with a 64 bit counter that is
+ * incremented once per cycle: master cycles, PPU dots, frames
+ * and positions inside a frame are derived from it when they
+ * are queried.
+ * Frames are modeled as 341 dots for each scanline, without
+ * the dot skipped on odd NTSC frames while rendering.
+ */
+
+class MasterClock
+{
+public:
+    enum Region
+    {
+        NTSC,
+        PAL,
+        DENDY
+    };
+
+    struct Timing
+    {
+        double masterFrequency; // Hz
+        uint32_t cpuDivider;
+        uint32_t ppuDivider;
+        uint32_t scanlines;
+    };
+
+    static const uint32_t DOTS_PER_SCANLINE = 341;
+
+    MasterClock(Region region = NTSC);
+    ~MasterClock() = default;
+
+    // The elapsed time is preserved when changing region
+    void SetRegion(Region region);
+    Region GetRegion() const { return region; }
+    const Timing& GetTiming() const { return timing; }
+
+    // Advances the clock by one CPU cycle
+    inline void Tick() { cpuCycles++; }
+    // Advances the clock by many CPU cycles at once, like when the CPU is halted
+    inline void Advance(uint64_t cycles) { cpuCycles += cycles; }
+
+    uint64_t GetCpuCycles() const { return cpuCycles; }
+    uint64_t GetMasterCycles() const { return baseMasterCycles + (cpuCycles - baseCpuCycles) * timing.cpuDivider; }
+    uint64_t GetPpuDots() const { return GetMasterCycles() / timing.ppuDivider; }
+    double GetSeconds() const { return GetMasterCycles() / timing.masterFrequency; }
+
+    uint64_t GetMasterCyclesPerFrame() const
+    {
+        return (uint64_t)DOTS_PER_SCANLINE * timing.scanlines * timing.ppuDivider;
+    }
+
+    // Frame being emulated and position of the PPU inside of it
+    uint64_t GetFrame() const { return GetMasterCycles() / GetMasterCyclesPerFrame(); }
+    uint32_t GetScanline() const;
+    uint32_t GetDot() const;
+
+    // CPU cycle during which the given frame starts
+    uint64_t GetFrameStartCycle(uint64_t frame) const;
+
+    // First CPU cycle by which the given number of PPU dots have elapsed
+    uint64_t GetCycleOfPpuDot(uint64_t dot) const;
+
+    // CPU cycles left before the given frame starts, 0 if it already started
+    uint64_t GetCyclesUntilFrame(uint64_t frame) const;
+
+    // The counters and the region, the timing is derived from it
+    struct State
+    {
+        uint64_t cpuCycles, baseMasterCycles, baseCpuCycles;
+        Region region;
+    };
+    void SaveState(State& state) const;
+    void LoadState(const State& state);
+
+private:
+    // First CPU cycle that is not before the given master cycle
+    uint64_t GetCycleOfMasterCycle(uint64_t masterCycle) const;
+
+    Region region;
+    Timing timing;
+    uint64_t cpuCycles = 0;
+    // Master and CPU cycles when the region was last changed
+    uint64_t baseMasterCycles = 0;
+    uint64_t baseCpuCycles = 0;
+};
+
+#endif // MASTERCLOCK_H
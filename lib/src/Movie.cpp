@@ -0,0 +1,165 @@
+#include "Movie.h"
+#include "LittleEndian.h"
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+const char MAGIC[4]{'N', 'E', 'S', 'M'};
+// Version 2 checkpoints hash the picture along with the RAM
+const uint32_t VERSION = 2;
+} // namespace
+
+Movie::Movie(const EmulatorCore& other)
+    : EmulatorCore(other)
+{
+}
+
+void Movie::PowerOn()
+{
+    core->SetRegion(region);
+    core->PowerOn(seed);
+}
+
+void Movie::StartRecording(uint32_t seed, uint32_t checkpointInterval)
+{
+    if (checkpointInterval == 0)
+    {
+        throw std::invalid_argument("The checkpoint interval must be at least one frame");
+    }
+    this->seed = seed;
+    this->checkpointInterval = checkpointInterval;
+    region = core->GetClock().GetRegion();
+    romHash = core->cart.GetHashPRG();
+    input.clear();
+    checkpoints.clear();
+    PowerOn();
+}
+
+void Movie::RecordFrame(uint8_t port1, uint8_t port2)
+{
+    input.push_back({port1, port2});
+    core->GetController(0).SetButtons(port1);
+    core->GetController(1).SetButtons(port2);
+    core->RunFrame();
+    if (input.size() % checkpointInterval == 0)
+    {
+        checkpoints.push_back({input.size(), GetCheckpointHash()});
+    }
+}
+
+Movie::PlaybackResult Movie::Play()
+{
+    if (core->cart.GetHashPRG() != romHash)
+    {
+        throw std::runtime_error("The movie was recorded with a different game");
+    }
+    PowerOn();
+    PlaybackResult result{};
+    auto checkpoint = checkpoints.begin();
+    for (const auto& [port1, port2] : input)
+    {
+        core->GetController(0).SetButtons(port1);
+        core->GetController(1).SetButtons(port2);
+        // Only the pictures compared at the checkpoints are drawn
+        bool atCheckpoint = checkpoint != checkpoints.end() && checkpoint->frame == result.framesPlayed + 1;
+        core->RunFrame(atCheckpoint);
+        result.framesPlayed++;
+        if (atCheckpoint)
+        {
+            uint64_t hash = GetCheckpointHash();
+            if (hash != checkpoint->hash)
+            {
+                result.desynced = true;
+                result.frame = checkpoint->frame;
+                result.expectedHash = checkpoint->hash;
+                result.hash = hash;
+                break;
+            }
+            ++checkpoint;
+        }
+    }
+    return result;
+}
+
+uint64_t Movie::GetCheckpointHash() const
+{
+    // The FNV-1a hash of the RAM, continued over the pixels
+    uint64_t hash = core->GetMemoryHash();
+    for (uint16_t pixel : core->GetFrameBuffer())
+    {
+        hash = (hash ^ pixel) * 0x100000001B3;
+    }
+    return hash;
+}
+
+void Movie::Save(const std::filesystem::path& path) const
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error("Can't write the movie to " + path.string());
+    }
+    file.write(MAGIC, sizeof(MAGIC));
+    WriteValue<uint32_t>(file, VERSION);
+    WriteValue<uint32_t>(file, seed);
+    WriteValue<uint8_t>(file, region);
+    WriteValue<uint64_t>(file, romHash);
+    WriteValue<uint32_t>(file, checkpointInterval);
+    WriteValue<uint64_t>(file, input.size());
+    for (const auto& [port1, port2] : input)
+    {
+        WriteValue<uint8_t>(file, port1);
+        WriteValue<uint8_t>(file, port2);
+    }
+    WriteValue<uint64_t>(file, checkpoints.size());
+    for (const Checkpoint& checkpoint : checkpoints)
+    {
+        WriteValue<uint64_t>(file, checkpoint.frame);
+        WriteValue<uint64_t>(file, checkpoint.hash);
+    }
+}
+
+void Movie::Load(const std::filesystem::path& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    char magic[sizeof(MAGIC)]{};
+    file.read(magic, sizeof(magic));
+    if (!file || !std::equal(magic, magic + sizeof(magic), MAGIC) || ReadValue<uint32_t>(file) != VERSION)
+    {
+        throw std::runtime_error(path.string() + " is not a movie");
+    }
+    seed = ReadValue<uint32_t>(file);
+    uint8_t movieRegion = ReadValue<uint8_t>(file);
+    romHash = ReadValue<uint64_t>(file);
+    checkpointInterval = ReadValue<uint32_t>(file);
+    if (movieRegion > MasterClock::DENDY || checkpointInterval == 0)
+    {
+        throw std::runtime_error(path.string() + " is not a valid movie");
+    }
+    region = static_cast<MasterClock::Region>(movieRegion);
+
+    // A corrupted size could ask for any amount of memory
+    uint64_t frames = ReadValue<uint64_t>(file);
+    if (!file || frames > std::filesystem::file_size(path) / 2)
+    {
+        throw std::runtime_error(path.string() + " is truncated");
+    }
+    input.resize(frames);
+    for (auto& [port1, port2] : input)
+    {
+        port1 = ReadValue<uint8_t>(file);
+        port2 = ReadValue<uint8_t>(file);
+    }
+    checkpoints.clear();
+    for (uint64_t count = ReadValue<uint64_t>(file); count > 0 && file; count--)
+    {
+        uint64_t frame = ReadValue<uint64_t>(file);
+        checkpoints.push_back({frame, ReadValue<uint64_t>(file)});
+    }
+    if (!file)
+    {
+        throw std::runtime_error(path.string() + " is truncated");
+    }
+}
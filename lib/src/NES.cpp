@@ -1,55 +1,402 @@
 #include "NES.h"
+#include <algorithm>
+#include <cstring>
 #include <filesystem>
+#include <type_traits>
 
 NES::NES()
-    : cpu(*this)
+    : cpu(*this), ppu(cart, clock), apu(cart, clock), idleLoops(cpu, *this)
 {
     ResetRAM();
 }
 
-uint8_t NES::Read(uint16_t address) const
+uint8_t NES::Read(uint16_t address)
 {
+    uint8_t data;
     switch (address)
     {
     case 0x0000 ... 0x1FFF: {
-        return RAM[address % 0x0800];
+        data = RAM[address % 0x0800];
+        break;
+    }
+    case 0x4016 ... 0x4017: {
+        // Only the lowest bit is driven, the others keep the high byte
+        // of the address that was last on the bus
+        data = 0x40 | controllers[address - 0x4016].Read();
+        break;
+    }
+    case 0x2000 ... 0x3FFF: {
+        ppu.Sync();
+        data = ppu.ReadRegister(address);
+        break;
+    }
+    case 0x4015: {
+        apu.Sync();
+        data = apu.ReadStatus();
+        // Reading the status acknowledges the frame IRQ
+        UpdateApuEventCycle();
         break;
     }
-    case 0x2000 ... 0x3FFF: // PPU
-    case 0x4000 ... 0x4017: // APU and IO
+    case 0x4000 ... 0x4014: // APU and IO
     case 0x4018 ... 0x401F: // disabled
     case 0x4020 ... 0xFFFF: {
-        return cart.ReadFromPRG(address - 0x8000);
+        data = cart.ReadFromPRG(address - 0x8000);
         break;
     }
-    default: return 0x00;
+    default: data = 0x00;
     }
+    if (breakpoints) [[unlikely]]
+    {
+        breakpoints->CheckAccess(Breakpoints::READ, address, data, cpu);
+    }
+#ifdef NESPP_INSTRUMENTATION
+    counters.reads[BusCounters::RegionOf(address)]++;
+#endif
+    return data;
 }
 
 void NES::Write(uint16_t address, uint8_t data)
 {
+    if (breakpoints) [[unlikely]]
+    {
+        breakpoints->CheckAccess(Breakpoints::WRITE, address, data, cpu);
+    }
+#ifdef NESPP_INSTRUMENTATION
+    CountWrite(address);
+#endif
     switch (address)
     {
     case 0x0000 ... 0x1FFF: {
         RAM[address % 0x0800] = data;
+        if (cpu.blockCache)
+        {
+            cpu.blockCache->InvalidateRAM(address);
+        }
+        break;
+    }
+    case 0x2000 ... 0x3FFF: {
+        ppu.Sync();
+        ppu.WriteRegister(address, data);
+        if ((address & 0x0007) == 0)
+        {
+            // PPUCTRL enables and disables the NMI
+            UpdateNmiCycle();
+        }
+        break;
+    }
+    case 0x4014: {
+        OAMDMA(data);
+        break;
+    }
+    case 0x4016: {
+        // The strobe is shared by both controllers
+        controllers[0].Write(data);
+        controllers[1].Write(data);
+        break;
+    }
+    case 0x4000 ... 0x4013:
+    case 0x4015:
+    case 0x4017: {
+        apu.Sync();
+        apu.WriteRegister(address, data);
+        UpdateApuEventCycle();
         break;
     }
-    case 0x2000 ... 0x3FFF: // PPU
-    case 0x4000 ... 0x4017: // APU and IO
     case 0x4018 ... 0x401F: // disabled
     case 0x4020 ... 0xFFFF: // Cartridge
     default: break;
     }
 }
 
-void NES::Tick()
+uint8_t NES::Peek(uint16_t address) const
+{
+    if (address < 0x2000)
+    {
+        return RAM[address % 0x0800];
+    }
+    if (address < 0x4020)
+    {
+        return 0x00;
+    }
+    return cart.ReadFromPRG(address - 0x8000);
+}
+
+void NES::PeekRange(uint16_t address, uint8_t* buffer, size_t length) const
+{
+    // The range is split where the source of the data changes:
+    // at the end of the RAM mirrors and of the 8KiB PRG windows
+    while (length > 0)
+    {
+        size_t chunk;
+        if (address < 0x2000)
+        {
+            size_t offset = address % 0x0800;
+            chunk = std::min(length, 0x0800 - offset);
+            std::memcpy(buffer, RAM.data() + offset, chunk);
+        }
+        else if (address < 0x4020)
+        {
+            chunk = std::min(length, (size_t)(0x4020 - address));
+            std::memset(buffer, 0x00, chunk);
+        }
+        else
+        {
+            chunk = std::min(length, (size_t)(0x2000 - (address & 0x1FFF)));
+            cart.ReadBlockFromPRG(address - 0x8000, buffer, chunk);
+        }
+        // Ranges past 0xFFFF wrap around
+        address += chunk;
+        buffer += chunk;
+        length -= chunk;
+    }
+}
+
+void NES::ReadBlock(uint16_t address, uint8_t* buffer, size_t length)
+{
+    // Each byte has to be checked against the breakpoints
+    if (breakpoints) [[unlikely]]
+    {
+        for (size_t i = 0; i < length; i++)
+        {
+            buffer[i] = Read(address + i);
+        }
+        return;
+    }
+    while (length > 0)
+    {
+        size_t chunk;
+        if (address >= 0x2000 && address < 0x4020)
+        {
+            chunk = std::min(length, (size_t)(0x4020 - address));
+            for (size_t i = 0; i < chunk; i++)
+            {
+                buffer[i] = Read(address + i);
+            }
+        }
+        else
+        {
+            chunk = std::min(length, (size_t)((address < 0x2000) ? 0x2000 - address : 0x10000 - address));
+            PeekRange(address, buffer, chunk);
+#ifdef NESPP_INSTRUMENTATION
+            counters.reads[BusCounters::RegionOf(address)] += chunk;
+#endif
+        }
+        address += chunk;
+        buffer += chunk;
+        length -= chunk;
+    }
+}
+
+void NES::OAMDMA(uint8_t page)
+{
+    std::array<uint8_t, 256> data;
+    ReadBlock(page << 8, data.data(), data.size());
+    ppu.Sync();
+    ppu.WriteOAM(data.data());
+    // A cycle to wait for the write to end, one more if the CPU is halted
+    // on an odd cycle, then 256 reads alternated with 256 writes
+    clock.Advance(513 + (clock.GetCpuCycles() & 1));
+}
+
+void NES::SetRegion(MasterClock::Region region)
+{
+    ppu.Sync();
+    apu.Sync();
+    clock.SetRegion(region);
+    UpdateNmiCycle();
+    UpdateApuEventCycle();
+}
+
+void NES::AcknowledgeNmi()
+{
+    ppu.Sync();
+    ppu.AcknowledgeNmi();
+    UpdateNmiCycle();
+}
+
+void NES::UpdateNmiCycle()
+{
+    uint64_t dot = ppu.GetNmiDot();
+    // The NMI is seen once the dot that raises it has been emulated
+    nmiCycle = (dot == PPU::NO_NMI) ? PPU::NO_NMI : clock.GetCycleOfPpuDot(dot + 1);
+}
+
+void NES::RunApuEvents()
+{
+    apu.Sync();
+    // The CPU is halted while the DMC reads its samples
+    clock.Advance(apu.TakeStolenCycles());
+    UpdateApuEventCycle();
+}
+
+void NES::UpdateApuEventCycle()
 {
-    // TODO: step all the peripherals
+    apuEventCycle = apu.GetNextEventCycle();
 }
 
 void NES::ResetRAM()
 {
     RAM.fill(0xFF);
+    if (cpu.blockCache)
+    {
+        cpu.blockCache->Clear();
+    }
+}
+
+void NES::PowerOn(uint32_t seed)
+{
+    clock = MasterClock(clock.GetRegion());
+    ResetRAM();
+    if (seed != 0)
+    {
+        // xorshift32
+        uint32_t state = seed;
+        for (uint8_t& byte : RAM)
+        {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            byte = state;
+        }
+    }
+    controllers = {};
+    ppu.Reset();
+    apu.Reset();
+    UpdateNmiCycle();
+    UpdateApuEventCycle();
+    idleLoops.Reset();
+    // The registers start from their power on values, whatever ran
+    // before: the reset sequence leaves SP at 0xFD
+    cpu.A = cpu.X = cpu.Y = 0;
+    cpu.SetStatus(0x34);
+    cpu.SP = 0x00;
+    cpu.Reset();
+}
+
+void NES::RunFrame(bool draw)
+{
+    ppu.SkipPixels(!draw);
+    apu.ClearSamples();
+    uint64_t frame = clock.GetFrame();
+    // Breakpoints and the profiler must see every iteration
+    const bool skipping = skipIdleLoops && !breakpoints && !profiler;
+    // Same as looping while the frame is the same, without dividing the
+    // master cycles on every instruction; an instruction or a DMA that
+    // runs past the end still completes in this frame
+    const uint64_t end = clock.GetFrameStartCycle(frame + 1);
+    while (clock.GetCpuCycles() < end)
+    {
+        uint16_t PC = cpu.PC;
+        cpu.Step();
+        // Loops end with a jump backward
+        if (skipping && cpu.PC <= PC)
+        {
+            idleLoops.Check(end);
+        }
+    }
+    // Completes the picture and the sound
+    ppu.Sync();
+    apu.Sync();
+    UpdateApuEventCycle();
+}
+
+static_assert(std::is_trivially_copyable_v<NES::State> && std::is_standard_layout_v<NES::State>,
+              "The state must be copied as a block of bytes");
+
+void NES::SaveState(State& state)
+{
+    ppu.Sync();
+    apu.Sync();
+    UpdateApuEventCycle();
+
+    // The controllers have default values, the block is cleared as bytes
+    std::memset(static_cast<void*>(&state), 0, sizeof(state));
+    state.PC = cpu.PC;
+    state.SP = cpu.SP;
+    state.A = cpu.A;
+    state.X = cpu.X;
+    state.Y = cpu.Y;
+    state.P = cpu.GetStatus();
+    state.RAM = RAM;
+    std::memcpy(&state.ppu, &ppu.GetState(), sizeof(state.ppu));
+    std::memcpy(&state.apu, &apu.GetState(), sizeof(state.apu));
+    cart.SaveState(state.cart);
+    state.controllers = controllers;
+    clock.SaveState(state.clock);
+}
+
+void NES::LoadState(const State& state)
+{
+    cpu.PC = state.PC;
+    cpu.SP = state.SP;
+    cpu.A = state.A;
+    cpu.X = state.X;
+    cpu.Y = state.Y;
+    cpu.SetStatus(state.P);
+    RAM = state.RAM;
+    ppu.SetState(state.ppu);
+    apu.SetState(state.apu);
+    cart.LoadState(state.cart);
+    controllers = state.controllers;
+    clock.LoadState(state.clock);
+    UpdateNmiCycle();
+    UpdateApuEventCycle();
+    if (cpu.blockCache)
+    {
+        cpu.blockCache->InvalidateAllRAM();
+    }
+    idleLoops.Reset();
+}
+
+uint64_t NES::GetStateHash(const State& state)
+{
+    static_assert(sizeof(State) % sizeof(uint64_t) == 0);
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&state);
+    uint64_t hash = 0xCBF29CE484222325;
+    for (size_t offset = 0; offset < sizeof(State); offset += sizeof(uint64_t))
+    {
+        uint64_t word;
+        std::memcpy(&word, bytes + offset, sizeof(word));
+        hash = (hash ^ word) * 0x100000001B3;
+    }
+    return hash;
+}
+
+size_t NES::FindStateDifference(const State& first, const State& second)
+{
+    const uint8_t* a = reinterpret_cast<const uint8_t*>(&first);
+    const uint8_t* b = reinterpret_cast<const uint8_t*>(&second);
+    // Whole words are compared until one differs
+    size_t offset = 0;
+    for (uint64_t x, y; offset < sizeof(State); offset += sizeof(uint64_t))
+    {
+        std::memcpy(&x, a + offset, sizeof(x));
+        std::memcpy(&y, b + offset, sizeof(y));
+        if (x != y)
+        {
+            break;
+        }
+    }
+    while (offset < sizeof(State) && a[offset] == b[offset])
+    {
+        offset++;
+    }
+    return offset;
+}
+
+uint64_t NES::GetMemoryHash() const
+{
+    uint64_t hash = 0xCBF29CE484222325;
+    for (uint8_t byte : RAM)
+    {
+        hash = (hash ^ byte) * 0x100000001B3;
+    }
+    return hash;
+}
+
+size_t NES::GetCodeBank(uint16_t address) const
+{
+    return (address >= 0x8000) ? cart.GetBankPRG(address - 0x8000) + 1 : 0;
 }
 
 bool NES::LoadGame(const std::string& pathToROM)
@@ -59,10 +406,19 @@ bool NES::LoadGame(const std::string& pathToROM)
         return false;
     }
     cart.LoadFile(path);
+    if (cpu.blockCache)
+    {
+        cpu.blockCache->Clear();
+    }
+    idleLoops.Clear();
     if(!cart.IsValid())
     {
         return false;
     }
+    ppu.Reset();
+    apu.Reset();
+    UpdateNmiCycle();
+    UpdateApuEventCycle();
     cpu.Reset();
     return true;
 }
@@ -1,9 +1,21 @@
 #ifndef NES_H
 #define NES_H
 
+#include "APU.h"
+#include "BlockCache.h"
+#include "Breakpoints.h"
 #include "CPU.h"
 #include "Cartridge.h"
+#include "Controller.h"
+#include "FrameBuffer.h"
+#include "IdleLoops.h"
+#include "MasterClock.h"
+#include "PPU.h"
+#include "PerfCounters.h"
+#include "Profiler.h"
+#include <algorithm>
 #include <array>
+#include <memory>
 
 /*
  * This class is going to have the role of
@@ -31,23 +43,197 @@ public:
     ~NES() = default;
 
     // These are going to dispatch memory access
-    uint8_t Read(uint16_t address) const;
+    uint8_t Read(uint16_t address);
     void Write(uint16_t address, uint8_t data);
 
-    void Tick();
+    // Accesses by the CPU to the zero page and to the stack, which
+    // are always in RAM, skipping the address decoding
+    inline uint8_t ReadRAM(uint16_t address)
+    {
+        uint8_t data = RAM[address];
+        if (breakpoints) [[unlikely]]
+        {
+            breakpoints->CheckAccess(Breakpoints::READ, address, data, cpu);
+        }
+#ifdef NESPP_INSTRUMENTATION
+        counters.reads[BusCounters::RAM]++;
+#endif
+        return data;
+    }
+    inline void WriteRAM(uint16_t address, uint8_t data)
+    {
+        if (breakpoints) [[unlikely]]
+        {
+            breakpoints->CheckAccess(Breakpoints::WRITE, address, data, cpu);
+        }
+#ifdef NESPP_INSTRUMENTATION
+        counters.writes[BusCounters::RAM]++;
+#endif
+        RAM[address] = data;
+        if (cpu.blockCache)
+        {
+            cpu.blockCache->InvalidateRAM(address);
+        }
+    }
+
+    // Whether writing back the value just read from the address has no
+    // effect, so that the FAST profile can skip the dummy write: the RAM,
+    // and the PRG ROM of the cartridges whose mapper has no registers
+    inline bool IsWriteBackInvisible(uint16_t address) const
+    {
+        return address < 0x2000 || (address >= 0x8000 && !cart.HasMapperRegisters());
+    }
+#ifdef NESPP_INSTRUMENTATION
+    // Counts a write as if it went on the bus, so that the counters
+    // are the same whether dummy writes are skipped or not
+    inline void CountWrite(uint16_t address)
+    {
+        BusCounters::Region region = BusCounters::RegionOf(address);
+        counters.writes[region]++;
+        counters.mapperWrites += (region == BusCounters::CARTRIDGE);
+    }
+#endif
+
+    // Read memory without any side effect and without triggering
+    // breakpoints, IO registers can't be read this way and read as 0
+    uint8_t Peek(uint16_t address) const;
+    void PeekRange(uint16_t address, uint8_t* buffer, size_t length) const;
+
+    // Reads a block as a DMA unit would: RAM and cartridge space are
+    // copied in bulk, IO registers are read one byte at a time
+    void ReadBlock(uint16_t address, uint8_t* buffer, size_t length);
+
+    // Called by the CPU on each of its cycles
+    inline void Tick()
+    {
+        clock.Tick();
+        // The PPU catches up with the clock when it is accessed
+    }
+
+    const MasterClock& GetClock() const { return clock; }
+    void SetRegion(MasterClock::Region region);
+
+    // Checked by the CPU between instructions
+    inline bool IsNmiPending() const { return clock.GetCpuCycles() >= nmiCycle; }
+    void AcknowledgeNmi();
+
+    // The APU is caught up with the clock before the CPU sees its events:
+    // the DMC fetches halt the CPU and the IRQs are level triggered
+    inline bool IsApuEventPending() const { return clock.GetCpuCycles() >= apuEventCycle; }
+    void RunApuEvents();
+    // Whether an NMI or an APU event falls due in the next cycles, during
+    // which the CPU has to poll for interrupts after every instruction
+    inline bool IsEventDueWithin(uint64_t cycles) const
+    {
+        return clock.GetCpuCycles() + cycles >= std::min(nmiCycle, apuEventCycle);
+    }
+    inline bool IsIrqAsserted() const { return apu.IsIrqAsserted(); }
+
+    void SetRenderMode(PPU::RenderMode mode) { ppu.SetRenderMode(mode); }
+    PPU::RenderMode GetRenderMode() const { return ppu.GetRenderMode(); }
+
+    void SetAccuracyProfile(CPU::AccuracyProfile profile) { cpu.SetAccuracyProfile(profile); }
+    CPU::AccuracyProfile GetAccuracyProfile() const { return cpu.GetAccuracyProfile(); }
+
+    void SetAudioMode(APU::AudioMode mode) { apu.SetAudioMode(mode); }
+    APU::AudioMode GetAudioMode() const { return apu.GetAudioMode(); }
+
+    // Samples produced by the APU during the last frame
+    const std::vector<int16_t>& GetAudioSamples() const { return apu.GetSamples(); }
 
     void ResetRAM();
 
+    // Power cycles the console: the clock restarts, the RAM is filled
+    // with 0xFF, or with a pattern generated from a non zero seed, and
+    // the CPU is reset
+    void PowerOn(uint32_t seed = 0);
+
+    // Executes instructions until the next frame starts; the picture
+    // can be skipped, without changing anything the game can observe
+    void RunFrame(bool draw = true);
+
+    // Skips the iterations of idle loops in RunFrame (see IdleLoops.h),
+    // enabled by default; disabling it runs every iteration, to verify
+    // that the emulation is the same
+    void SetIdleLoopSkipping(bool enable) { skipIdleLoops = enable; }
+    bool GetIdleLoopSkipping() const { return skipIdleLoops; }
+    uint64_t GetSkippedIdleCycles() const { return idleLoops.GetSkippedCycles(); }
+
+    Controller& GetController(size_t port) { return controllers[port]; }
+
+    // Last picture output by the PPU
+    const FrameBuffer& GetFrameBuffer() const { return ppu.GetFrameBuffer(); }
+
+    // Makes the PPU draw into the given buffer instead of its own,
+    // so frontends can pass the buffers they display without copies
+    void SetFrameBuffer(FrameBuffer& target) { ppu.SetFrameBuffer(target); }
+
+    /*
+     * Everything that changes while a game runs, saved and restored
+     * between instructions. The block is trivially copyable and holds
+     * no pointers: a saved state can be copied, written to a file or
+     * compared as plain bytes. Saving catches up the PPU and the APU
+     * and clears the padding, so that machines in the same state save
+     * the same bytes. For the same reason the PPU and the APU clear
+     * their states as bytes when they are reset, and the states are
+     * copied as bytes, padding included.
+     */
+    struct State
+    {
+        uint16_t PC;
+        uint8_t SP, A, X, Y, P;
+        std::array<uint8_t, 2048> RAM;
+        PPU::State ppu;
+        APU::State apu;
+        Cartridge::State cart;
+        std::array<Controller, 2> controllers;
+        MasterClock::State clock;
+    };
+    void SaveState(State& state);
+    void LoadState(const State& state);
+
+    // FNV-1a hash of a saved state, over 64 bit words
+    static uint64_t GetStateHash(const State& state);
+    // Offset of the first byte that differs between two saved
+    // states, sizeof(State) if they are the same
+    static size_t FindStateDifference(const State& first, const State& second);
+
+    // FNV-1a hash of the RAM
+    uint64_t GetMemoryHash() const;
+
     bool LoadGame(const std::string& pathToROM);
 
+    // Bank of the code at the given address: 0 for code outside
+    // of the cartridge and n + 1 for 16KiB PRG ROM bank n
+    size_t GetCodeBank(uint16_t address) const;
+
     friend class Debugger;
+    friend class BlockCache;
+    friend class IdleLoops;
+    friend class Movie;
 
 private:
     // Peripherals attached to the NES
     CPU cpu;
 
+    MasterClock clock;
+
     Cartridge cart;
 
+    std::array<Controller, 2> controllers;
+
+    PPU ppu;
+
+    // CPU cycle at which the PPU requests the next NMI
+    uint64_t nmiCycle = PPU::NO_NMI;
+    void UpdateNmiCycle();
+
+    APU apu;
+
+    // CPU cycle of the next APU event
+    uint64_t apuEventCycle = APU::NO_EVENT;
+    void UpdateApuEventCycle();
+
     /*
      * 2KiB of main RAM available to the CPU,
      * the actual addressing space of the CPU
@@ -59,6 +245,26 @@ private:
      * from 0x0100 to 0x01FF is the stack.
      */
     std::array<uint8_t, 2048> RAM;
+
+    /*
+     * Writing a page number to 0x4014 copies
+     * a whole page of CPU memory to the sprite
+     * memory of the PPU while the CPU is halted
+     * for 513 or 514 cycles.
+     */
+    void OAMDMA(uint8_t page);
+
+    // Only allocated by the debugger while there are breakpoints,
+    // checking it is the only cost on the memory access path
+    std::unique_ptr<Breakpoints> breakpoints;
+    std::unique_ptr<Profiler> profiler;
+
+    IdleLoops idleLoops;
+    bool skipIdleLoops = true;
+
+#ifdef NESPP_INSTRUMENTATION
+    mutable BusCounters counters;
+#endif
 };
 
 #endif // NES_H
@@ -0,0 +1,663 @@
+#include "PPU.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+const uint16_t DOTS_PER_SCANLINE = MasterClock::DOTS_PER_SCANLINE;
+} // namespace
+
+PPU::PPU(Cartridge& cart, const MasterClock& clock)
+    : cart(cart), clock(clock)
+{
+    Reset();
+}
+
+void PPU::Reset()
+{
+    std::memset(&state, 0, sizeof(state));
+    state.dots = clock.GetPpuDots();
+    uint64_t position = state.dots % ((uint64_t)DOTS_PER_SCANLINE * clock.GetTiming().scanlines);
+    state.scanline = position / DOTS_PER_SCANLINE;
+    state.dot = position % DOTS_PER_SCANLINE;
+    state.nmiDot = NO_NMI;
+}
+
+void PPU::Run(uint64_t target)
+{
+    const uint16_t preRender = clock.GetTiming().scanlines - 1;
+    while (state.dots < target)
+    {
+        if (state.scanline >= VISIBLE_SCANLINES && state.scanline < preRender)
+        {
+            SkipIdleDots(target);
+        }
+        else if ((renderMode == SCANLINE || skipPixels) && state.scanline < VISIBLE_SCANLINES && state.dot == 0 &&
+                 target - state.dots >= DOTS_PER_SCANLINE)
+        {
+            RenderScanline();
+        }
+        else
+        {
+            Step();
+        }
+    }
+}
+
+void PPU::NextScanline()
+{
+    state.dot = 0;
+    if (++state.scanline >= clock.GetTiming().scanlines)
+    {
+        state.scanline = 0;
+    }
+}
+
+void PPU::SkipIdleDots(uint64_t target)
+{
+    uint64_t end = std::min<uint64_t>(target, state.dots + DOTS_PER_SCANLINE - state.dot);
+    if (state.scanline == VBLANK_SCANLINE && state.dot <= 1 && end > state.dots + 1 - state.dot)
+    {
+        state.status |= 0x80;
+    }
+    state.dot += end - state.dots;
+    state.dots = end;
+    if (state.dot == DOTS_PER_SCANLINE)
+    {
+        NextScanline();
+    }
+}
+
+void PPU::Step()
+{
+    const uint16_t scanline = state.scanline;
+    const uint16_t dot = state.dot;
+    const bool preRender = scanline == clock.GetTiming().scanlines - 1;
+
+    if (scanline < VISIBLE_SCANLINES || preRender)
+    {
+        if (preRender && dot == 1)
+        {
+            // VBlank, sprite 0 hit and sprite overflow
+            state.status &= 0x1F;
+        }
+        if (state.mask & 0x18)
+        {
+            if ((dot >= 2 && dot <= 257) || (dot >= 321 && dot <= 337))
+            {
+                ShiftBackground();
+                switch ((dot - 1) & 7)
+                {
+                case 0:
+                    LoadBackground();
+                    state.nextTile = FetchTile();
+                    break;
+                case 2: state.nextAttribute = FetchAttribute(); break;
+                case 4: state.nextPatternLow = FetchPattern(state.nextTile, 0); break;
+                case 6: state.nextPatternHigh = FetchPattern(state.nextTile, 8); break;
+                case 7: IncrementX(); break;
+                }
+            }
+            if (dot == 256)
+            {
+                IncrementY();
+            }
+            else if (dot == 257)
+            {
+                CopyX();
+                if (preRender)
+                {
+                    ClearSprites();
+                }
+                else
+                {
+                    EvaluateSprites();
+                }
+            }
+            else if (dot == 338 || dot == 340)
+            {
+                state.nextTile = FetchTile();
+            }
+            else if (preRender && dot >= 280 && dot <= 304)
+            {
+                CopyY();
+            }
+        }
+        else if (dot == 257)
+        {
+            ClearSprites();
+        }
+
+        if (scanline < VISIBLE_SCANLINES && dot >= 1 && dot <= 256)
+        {
+            uint16_t x = dot - 1;
+            uint8_t pixel = 0, palette = 0;
+            if ((state.mask & 0x08) && (x >= 8 || (state.mask & 0x02)))
+            {
+                uint16_t bit = 0x8000 >> state.fineX;
+                pixel = ((state.patternLow & bit) ? 1 : 0) | ((state.patternHigh & bit) ? 2 : 0);
+                palette = ((state.attributeLow & bit) ? 1 : 0) | ((state.attributeHigh & bit) ? 2 : 0);
+            }
+            DrawPixel(x, pixel, palette);
+        }
+    }
+    else if (scanline == VBLANK_SCANLINE && dot == 1)
+    {
+        state.status |= 0x80;
+    }
+
+    state.dots++;
+    if (++state.dot == DOTS_PER_SCANLINE)
+    {
+        NextScanline();
+    }
+}
+
+void PPU::RenderScanline()
+{
+    const uint8_t mask = state.mask;
+    if ((mask & 0x18) == 0)
+    {
+        for (uint16_t x = 0; x < FRAME_WIDTH && !skipPixels; x++)
+        {
+            DrawPixel(x, 0, 0);
+        }
+        ClearSprites();
+    }
+    else
+    {
+        // Without drawing, the background is only needed under sprite 0
+        const bool showBackground = mask & 0x08;
+        const bool drawLine = !skipPixels || (showBackground && (mask & 0x10) && state.spriteZeroOnLine && !(state.status & 0x40));
+        if (!drawLine)
+        {
+            // The 32 fetches of the scanline wrap to the next nametable
+            state.v ^= 0x0400;
+        }
+        else
+        {
+            // The first two tiles are in the shift registers, fetched at the
+            // end of the previous scanline, v points to the third one. The
+            // line gets the palette and the pixel of every tile, from the
+            // decoded rows of the pattern table
+            const size_t TILES = FRAME_WIDTH / 8 + 1;
+            uint8_t line[TILES * 8];
+            for (uint16_t x = 0; x < 16; x++)
+            {
+                uint16_t bit = 0x8000 >> x;
+                uint8_t pixel = ((state.patternLow & bit) ? 1 : 0) | ((state.patternHigh & bit) ? 2 : 0);
+                uint8_t palette = ((state.attributeLow & bit) ? 1 : 0) | ((state.attributeHigh & bit) ? 2 : 0);
+                line[x] = (palette << 2) | pixel;
+            }
+            const uint16_t table = (state.control & 0x10) << 8;
+            for (size_t tile = 2; tile < TILES; tile++)
+            {
+                uint8_t id = FetchTile();
+                uint8_t palette = FetchAttribute() << 2;
+                const uint8_t* row = cart.GetTileRow(table | (id << 4) | ((state.v >> 12) & 0x07));
+                for (int x = 0; x < 8; x++)
+                {
+                    line[tile * 8 + x] = palette | row[x];
+                }
+                IncrementX();
+            }
+            // The last tile fetched is never shown
+            IncrementX();
+
+            bool leftColumn = mask & 0x02;
+            for (uint16_t x = 0; x < FRAME_WIDTH; x++)
+            {
+                uint8_t pixel = 0, palette = 0;
+                if (showBackground && (x >= 8 || leftColumn))
+                {
+                    uint8_t color = line[state.fineX + x];
+                    pixel = color & 0x03;
+                    palette = color >> 2;
+                }
+                DrawPixel(x, pixel, palette);
+            }
+        }
+
+        IncrementY();
+        CopyX();
+        EvaluateSprites();
+
+        // Fetches of the first two tiles of the next scanline
+        uint8_t low[2], high[2], attributes[2];
+        for (int tile = 0; tile < 2; tile++)
+        {
+            uint8_t id = FetchTile();
+            attributes[tile] = FetchAttribute();
+            low[tile] = FetchPattern(id, 0);
+            high[tile] = FetchPattern(id, 8);
+            IncrementX();
+        }
+        state.patternLow = (low[0] << 8) | low[1];
+        state.patternHigh = (high[0] << 8) | high[1];
+        state.attributeLow = ((attributes[0] & 1) ? 0xFF00 : 0) | ((attributes[1] & 1) ? 0x00FF : 0);
+        state.attributeHigh = ((attributes[0] & 2) ? 0xFF00 : 0) | ((attributes[1] & 2) ? 0x00FF : 0);
+        state.nextTile = FetchTile();
+        state.nextAttribute = attributes[1];
+        state.nextPatternLow = low[1];
+        state.nextPatternHigh = high[1];
+    }
+    state.dots += DOTS_PER_SCANLINE;
+    NextScanline();
+}
+
+uint8_t PPU::ReadRegister(uint16_t address)
+{
+    switch (address & 0x0007)
+    {
+    case 2: {
+        uint8_t data = (state.status & 0xE0) | (state.openBus & 0x1F);
+        state.status &= 0x7F;
+        state.writeToggle = false;
+        return data;
+    }
+    case 4: return state.OAM[state.oamAddress];
+    case 7: {
+        uint16_t vramAddress = state.v & 0x3FFF;
+        uint8_t data;
+        if (vramAddress >= 0x3F00)
+        {
+            // Palette reads are not buffered, the buffer gets the
+            // nametable byte under the palette
+            data = (Read(vramAddress) & 0x3F) | (state.openBus & 0xC0);
+            state.readBuffer = Read(vramAddress - 0x1000);
+        }
+        else
+        {
+            data = state.readBuffer;
+            state.readBuffer = Read(vramAddress);
+        }
+        state.v = (state.v + ((state.control & 0x04) ? 32 : 1)) & 0x7FFF;
+        return data;
+    }
+    default: return state.openBus;
+    }
+}
+
+void PPU::WriteRegister(uint16_t address, uint8_t data)
+{
+    state.openBus = data;
+    switch (address & 0x0007)
+    {
+    case 0: {
+        bool enablingNmi = !(state.control & 0x80) && (data & 0x80);
+        state.control = data;
+        state.t = (state.t & 0xF3FF) | ((data & 0x03) << 10);
+        if (!(data & 0x80))
+        {
+            state.nmiDot = NO_NMI;
+        }
+        else if (enablingNmi && (state.status & 0x80))
+        {
+            // Enabling the NMI during the VBlank triggers it immediately
+            state.nmiDot = state.dots - 1;
+        }
+        else if (enablingNmi)
+        {
+            ScheduleNmi();
+        }
+        break;
+    }
+    case 1: state.mask = data; break;
+    case 3: state.oamAddress = data; break;
+    case 4: state.OAM[state.oamAddress++] = data; break;
+    case 5: {
+        if (!state.writeToggle)
+        {
+            state.t = (state.t & 0xFFE0) | (data >> 3);
+            state.fineX = data & 0x07;
+        }
+        else
+        {
+            state.t = (state.t & 0x8C1F) | ((data & 0x07) << 12) | ((data & 0xF8) << 2);
+        }
+        state.writeToggle = !state.writeToggle;
+        break;
+    }
+    case 6: {
+        if (!state.writeToggle)
+        {
+            state.t = (state.t & 0x00FF) | ((data & 0x3F) << 8);
+        }
+        else
+        {
+            state.t = (state.t & 0xFF00) | data;
+            state.v = state.t;
+        }
+        state.writeToggle = !state.writeToggle;
+        break;
+    }
+    case 7: {
+        Write(state.v & 0x3FFF, data);
+        state.v = (state.v + ((state.control & 0x04) ? 32 : 1)) & 0x7FFF;
+        break;
+    }
+    default: break;
+    }
+}
+
+void PPU::WriteOAM(const uint8_t* page)
+{
+    for (int i = 0; i < 256; i++)
+    {
+        state.OAM[(state.oamAddress + i) & 0xFF] = page[i];
+    }
+}
+
+void PPU::AcknowledgeNmi()
+{
+    if (state.control & 0x80)
+    {
+        ScheduleNmi();
+    }
+    else
+    {
+        state.nmiDot = NO_NMI;
+    }
+}
+
+uint64_t PPU::GetStatusStableDots() const
+{
+    // The VBlank flag is cleared by the next read
+    if (state.status & 0x80)
+    {
+        return state.dots;
+    }
+    const uint32_t scanlines = clock.GetTiming().scanlines;
+    const uint64_t frameStart = state.dots - (state.scanline * DOTS_PER_SCANLINE + state.dot);
+    // Next time the given dot is emulated, in this frame or in the next one
+    auto next = [&](uint32_t scanline, uint32_t dot) {
+        uint64_t position = frameStart + scanline * DOTS_PER_SCANLINE + dot;
+        return (position < state.dots) ? position + (uint64_t)DOTS_PER_SCANLINE * scanlines : position;
+    };
+
+    uint64_t change = next(VBLANK_SCANLINE, 1);
+    if (state.status & 0x60)
+    {
+        change = std::min(change, next(scanlines - 1, 1));
+    }
+    if (state.mask & 0x18)
+    {
+        const bool spriteZero = (state.mask & 0x18) == 0x18 && !(state.status & 0x40);
+        const bool overflow = !(state.status & 0x20);
+        if (spriteZero && state.spriteZeroOnLine)
+        {
+            return state.dots;
+        }
+        const int height = (state.control & 0x20) ? 16 : 8;
+        std::array<uint8_t, VISIBLE_SCANLINES> sprites{};
+        for (int i = 0; i < 64; i++)
+        {
+            for (int line = state.OAM[i * 4]; line < state.OAM[i * 4] + height && line < VISIBLE_SCANLINES; line++)
+            {
+                sprites[line]++;
+            }
+        }
+        for (uint32_t line = 0; line < VISIBLE_SCANLINES; line++)
+        {
+            // Set when a ninth sprite is found by the evaluation at dot 257
+            if (overflow && sprites[line] > 8)
+            {
+                change = std::min(change, next(line, 257));
+            }
+            // Sprite 0 is drawn on the scanline after the one it is evaluated on,
+            // the hit can happen from its first dot
+            int row = line - state.OAM[0];
+            if (spriteZero && row >= 0 && row < height && line + 1 < VISIBLE_SCANLINES)
+            {
+                change = std::min(change, next(line + 1, 0));
+            }
+        }
+    }
+    return change + 1;
+}
+
+void PPU::ScheduleNmi()
+{
+    uint64_t frameStart = state.dots - (state.scanline * DOTS_PER_SCANLINE + state.dot);
+    uint64_t vblank = frameStart + VBLANK_SCANLINE * DOTS_PER_SCANLINE + 1;
+    if (vblank < state.dots)
+    {
+        vblank += (uint64_t)DOTS_PER_SCANLINE * clock.GetTiming().scanlines;
+    }
+    state.nmiDot = vblank;
+}
+
+uint8_t PPU::Read(uint16_t address) const
+{
+    if (address < 0x2000)
+    {
+        return cart.ReadFromCHR(address);
+    }
+    if (address < 0x3F00)
+    {
+        return state.nametables[GetNametableIndex(address)];
+    }
+    return state.palette[GetPaletteIndex(address)];
+}
+
+void PPU::Write(uint16_t address, uint8_t data)
+{
+    if (address < 0x2000)
+    {
+        cart.WriteToCHR(address, data);
+    }
+    else if (address < 0x3F00)
+    {
+        state.nametables[GetNametableIndex(address)] = data;
+    }
+    else
+    {
+        state.palette[GetPaletteIndex(address)] = data & 0x3F;
+    }
+}
+
+uint16_t PPU::GetNametableIndex(uint16_t address) const
+{
+    address &= 0x0FFF;
+    switch (cart.GetMirroring())
+    {
+    case Cartridge::VERTICAL: return address & 0x07FF;
+    case Cartridge::HORIZONTAL: return ((address >> 1) & 0x0400) | (address & 0x03FF);
+    case Cartridge::SINGLE_SCREEN: return address & 0x03FF;
+    case Cartridge::FOUR_SCREEN:
+    default: return address;
+    }
+}
+
+uint8_t PPU::GetPaletteIndex(uint16_t address)
+{
+    address &= 0x001F;
+    // The backdrop entries of the sprite palettes mirror the background ones
+    if ((address & 0x0013) == 0x0010)
+    {
+        address &= 0x000F;
+    }
+    return address;
+}
+
+uint8_t PPU::FetchTile() const
+{
+    return state.nametables[GetNametableIndex(0x2000 | (state.v & 0x0FFF))];
+}
+
+uint8_t PPU::FetchAttribute() const
+{
+    uint16_t v = state.v;
+    uint8_t attribute = state.nametables[GetNametableIndex(0x23C0 | (v & 0x0C00) | ((v >> 4) & 0x38) | ((v >> 2) & 0x07))];
+    // Each byte covers 4x4 tiles, 2 bits for each 2x2 quadrant
+    return (attribute >> (((v >> 4) & 0x04) | (v & 0x02))) & 0x03;
+}
+
+uint8_t PPU::FetchPattern(uint8_t tile, uint8_t plane) const
+{
+    return cart.ReadFromCHR(((state.control & 0x10) << 8) | (tile << 4) | plane | ((state.v >> 12) & 0x07));
+}
+
+void PPU::IncrementX()
+{
+    if ((state.v & 0x001F) == 31)
+    {
+        // Wraps to the next horizontal nametable
+        state.v = (state.v & ~0x001F) ^ 0x0400;
+    }
+    else
+    {
+        state.v++;
+    }
+}
+
+void PPU::IncrementY()
+{
+    if ((state.v & 0x7000) != 0x7000)
+    {
+        state.v += 0x1000;
+        return;
+    }
+    state.v &= ~0x7000;
+    uint16_t coarseY = (state.v & 0x03E0) >> 5;
+    if (coarseY == 29)
+    {
+        // Wraps to the next vertical nametable
+        coarseY = 0;
+        state.v ^= 0x0800;
+    }
+    else if (coarseY == 31)
+    {
+        // Rows 30 and 31 are the attribute table, wrap without switching
+        coarseY = 0;
+    }
+    else
+    {
+        coarseY++;
+    }
+    state.v = (state.v & ~0x03E0) | (coarseY << 5);
+}
+
+void PPU::CopyX()
+{
+    state.v = (state.v & ~0x041F) | (state.t & 0x041F);
+}
+
+void PPU::CopyY()
+{
+    state.v = (state.v & ~0x7BE0) | (state.t & 0x7BE0);
+}
+
+void PPU::ShiftBackground()
+{
+    state.patternLow <<= 1;
+    state.patternHigh <<= 1;
+    state.attributeLow <<= 1;
+    state.attributeHigh <<= 1;
+}
+
+void PPU::LoadBackground()
+{
+    state.patternLow = (state.patternLow & 0xFF00) | state.nextPatternLow;
+    state.patternHigh = (state.patternHigh & 0xFF00) | state.nextPatternHigh;
+    state.attributeLow = (state.attributeLow & 0xFF00) | ((state.nextAttribute & 1) ? 0xFF : 0x00);
+    state.attributeHigh = (state.attributeHigh & 0xFF00) | ((state.nextAttribute & 2) ? 0xFF : 0x00);
+}
+
+void PPU::ClearSprites()
+{
+    if (state.spritesOnLine)
+    {
+        state.spriteLine.fill(0);
+        state.spritesOnLine = state.spriteZeroOnLine = false;
+    }
+}
+
+void PPU::EvaluateSprites()
+{
+    ClearSprites();
+    // The Y coordinate in OAM is one less than the first scanline of the sprite
+    const int height = (state.control & 0x20) ? 16 : 8;
+    size_t count = 0;
+    for (int i = 0; i < 64; i++)
+    {
+        const uint8_t* sprite = &state.OAM[i * 4];
+        int row = state.scanline - sprite[0];
+        if (row < 0 || row >= height)
+        {
+            continue;
+        }
+        if (count == 8)
+        {
+            state.status |= 0x20;
+            break;
+        }
+        count++;
+        uint8_t tile = sprite[1], attributes = sprite[2];
+        if (attributes & 0x80)
+        {
+            row = height - 1 - row;
+        }
+        uint16_t address;
+        if (height == 8)
+        {
+            address = ((state.control & 0x08) << 9) | (tile << 4) | row;
+        }
+        else
+        {
+            // 8x16 sprites select the pattern table with bit 0 of the tile
+            address = ((tile & 0x01) << 12) | ((tile & 0xFE) << 4) | ((row & 0x08) << 1) | (row & 0x07);
+        }
+        const uint8_t* pixels = cart.GetTileRow(address);
+        bool flip = attributes & 0x40;
+        uint8_t flags = ((attributes & 0x03) << 2) | ((attributes & 0x20) ? SPRITE_BEHIND : 0);
+        flags |= (i == 0) ? SPRITE_ZERO : 0;
+        // The first opaque sprite is drawn, even if it's behind the background
+        for (int x = 0; x < 8 && sprite[3] + x < (int)FRAME_WIDTH; x++)
+        {
+            uint8_t pixel = pixels[flip ? 7 - x : x];
+            uint8_t& target = state.spriteLine[sprite[3] + x];
+            if (pixel != 0 && target == 0)
+            {
+                target = flags | pixel;
+                state.spritesOnLine = true;
+                state.spriteZeroOnLine |= i == 0;
+            }
+        }
+    }
+}
+
+void PPU::CheckSpriteZeroHit(uint16_t x, uint8_t backgroundPixel)
+{
+    // Sprite 0 is the first sprite, it can't be covered by others
+    const uint8_t mask = state.mask;
+    if ((state.spriteLine[x] & SPRITE_ZERO) && backgroundPixel != 0 && x != 255 && (mask & 0x10) &&
+        (x >= 8 || (mask & 0x04)))
+    {
+        state.status |= 0x40;
+    }
+}
+
+void PPU::DrawPixel(uint16_t x, uint8_t backgroundPixel, uint8_t backgroundPalette)
+{
+    CheckSpriteZeroHit(x, backgroundPixel);
+    if (skipPixels)
+    {
+        return;
+    }
+    const uint8_t mask = state.mask;
+    uint8_t index = backgroundPixel ? (backgroundPalette << 2) | backgroundPixel : 0;
+    uint8_t sprite = state.spriteLine[x];
+    if (sprite != 0 && (mask & 0x10) && (x >= 8 || (mask & 0x04)) &&
+        (backgroundPixel == 0 || !(sprite & SPRITE_BEHIND)))
+    {
+        index = 0x10 | (sprite & SPRITE_COLOR);
+    }
+    uint8_t color = state.palette[index];
+    if (mask & 0x01)
+    {
+        // Greyscale
+        color &= 0x30;
+    }
+    (*frameBuffer)[state.scanline * FRAME_WIDTH + x] = color | ((mask & 0xE0) << 1);
+}
@@ -0,0 +1,208 @@
+#ifndef PPU_H
+#define PPU_H
+
+#include "Cartridge.h"
+#include "FrameBuffer.h"
+#include "MasterClock.h"
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+/*
+ * NES PPU (Ricoh RP2C02), which draws the picture from the
+ * pattern tables in the cartridge, the nametables in its own
+ * 2KiB of video RAM, the palette and the sprite memory (OAM).
+ * The PPU is not stepped along with the CPU: it is caught up
+ * with the master clock only when something can observe it,
+ * that is when the CPU accesses its registers, when a frame
+ * is completed and when the NMI is taken. The dot at which
+ * the next NMI happens is known in advance, so the CPU only
+ * has to compare it with the clock.
+ * Two renderers produce the same pixels and the same state:
+ * - DOT: the fetches, the shift registers and the sprite
+ *   evaluation are emulated dot by dot, as the hardware does
+ * - SCANLINE: scanlines that are entirely emulated in a single
+ *   catch up, so without any register access in the middle,
+ *   are drawn at once from the tiles they show; scanlines
+ *   where the CPU accesses the registers are drawn dot by dot.
+ * While pixels are skipped, nothing is drawn: the scanlines are
+ * emulated at once in both modes, fetching tiles only when
+ * they are needed to detect the sprite 0 hit, and the timing
+ * of the flags and of the NMI is the same as when drawing.
+ * The other pattern fetches are skipped, and when drawing they
+ * read the CHR windows of the cartridge without going through
+ * the mapper: mappers that watch the PPU address bus (A12, as
+ * the MMC3 scanline counter does) are not supported.
+ * Scanlines 0 to 239 are visible, the VBlank starts at dot 1 of
+ * scanline 241 and the last scanline of the frame is the pre-render
+ * one, which prepares the first visible scanline. The dot skipped
+ * on odd NTSC frames is not emulated, like in the MasterClock.
+ */
+
+class PPU
+{
+public:
+    enum RenderMode
+    {
+        DOT,
+        SCANLINE
+    };
+
+    // Pixels of the sprites on a scanline: the index in the sprite
+    // palettes (0 if transparent) and where they come from
+    enum SpritePixel : uint8_t
+    {
+        SPRITE_COLOR = 0x0F,
+        SPRITE_BEHIND = 0x10,
+        SPRITE_ZERO = 0x20
+    };
+
+    // Everything that changes while the PPU runs
+    struct State
+    {
+        // PPU dots emulated since power on, aligned with the master clock
+        uint64_t dots;
+        uint16_t scanline, dot;
+
+        // PPUCTRL, PPUMASK, PPUSTATUS and OAMADDR
+        uint8_t control, mask, status, oamAddress;
+
+        // Internal scroll registers: current and temporary VRAM
+        // address, fine X scroll and the shared write toggle
+        uint16_t v, t;
+        uint8_t fineX;
+        bool writeToggle;
+
+        // Data read by the previous access to PPUDATA, and last value
+        // written to any register, which is read back from unused bits
+        uint8_t readBuffer, openBus;
+
+        // Background pipeline: two tiles are held in the shift
+        // registers while the next one is fetched
+        uint16_t patternLow, patternHigh, attributeLow, attributeHigh;
+        uint8_t nextTile, nextAttribute, nextPatternLow, nextPatternHigh;
+
+        // Sprites shown on the current scanline, drawn when they are evaluated
+        std::array<uint8_t, FRAME_WIDTH> spriteLine;
+        bool spritesOnLine, spriteZeroOnLine;
+
+        // Dot at which the next NMI happens, NO_NMI if disabled
+        uint64_t nmiDot;
+
+        // Four screen cartridges add 2KiB of VRAM to the internal one
+        std::array<uint8_t, 4096> nametables;
+        std::array<uint8_t, 32> palette;
+        std::array<uint8_t, 256> OAM;
+    };
+
+    static const uint64_t NO_NMI = UINT64_MAX;
+
+    PPU(Cartridge& cart, const MasterClock& clock);
+    ~PPU() = default;
+
+    // Clears the state and aligns the PPU with the clock
+    void Reset();
+
+    void SetRenderMode(RenderMode mode) { renderMode = mode; }
+    RenderMode GetRenderMode() const { return renderMode; }
+
+    // Stops drawing pixels, the frame buffer keeps the last picture drawn
+    void SkipPixels(bool skip) { skipPixels = skip; }
+
+    // Emulates the PPU up to the current time of the master clock
+    inline void Sync()
+    {
+        uint64_t target = clock.GetPpuDots();
+        if (target > state.dots)
+        {
+            Run(target);
+        }
+    }
+
+    // Registers at 0x2000-0x2007, the PPU must have been synchronized
+    uint8_t ReadRegister(uint16_t address);
+    void WriteRegister(uint16_t address, uint8_t data);
+
+    // Writes a whole page to OAM, as the OAM DMA does
+    void WriteOAM(const uint8_t* page);
+
+    // The NMI has been taken by the CPU, the next one is scheduled
+    void AcknowledgeNmi();
+    uint64_t GetNmiDot() const { return state.nmiDot; }
+
+    // PPUSTATUS reads the same, and reading it changes nothing, as long as
+    // fewer than the returned number of dots (counted like State::dots)
+    // have been emulated. The PPU must have been synchronized
+    uint64_t GetStatusStableDots() const;
+
+    const FrameBuffer& GetFrameBuffer() const { return *frameBuffer; }
+    void SetFrameBuffer(FrameBuffer& target) { frameBuffer = &target; }
+
+    const std::array<uint8_t, 256>& GetOAM() const { return state.OAM; }
+
+    const State& GetState() const { return state; }
+    void SetState(const State& newState) { std::memcpy(&state, &newState, sizeof(state)); }
+
+private:
+    static const uint16_t VISIBLE_SCANLINES = 240;
+    static const uint16_t VBLANK_SCANLINE = 241;
+
+    Cartridge& cart;
+    const MasterClock& clock;
+
+    State state;
+    RenderMode renderMode = DOT;
+    bool skipPixels = false;
+
+    FrameBuffer ownFrameBuffer{};
+    FrameBuffer* frameBuffer = &ownFrameBuffer;
+
+    void Run(uint64_t target);
+
+    // Emulates a single dot, in the DOT renderer and in the
+    // scanlines where the registers are accessed
+    void Step();
+
+    // Emulates a whole visible scanline from its first dot
+    void RenderScanline();
+
+    // Skips dots in the scanlines after the visible ones, where
+    // only the VBlank flag changes
+    void SkipIdleDots(uint64_t target);
+
+    inline void NextScanline();
+
+    // PPU addressing space
+    uint8_t Read(uint16_t address) const;
+    void Write(uint16_t address, uint8_t data);
+    uint16_t GetNametableIndex(uint16_t address) const;
+    static uint8_t GetPaletteIndex(uint16_t address);
+
+    // Background fetches from the address in v
+    uint8_t FetchTile() const;
+    uint8_t FetchAttribute() const;
+    uint8_t FetchPattern(uint8_t tile, uint8_t plane) const;
+
+    inline void IncrementX();
+    inline void IncrementY();
+    inline void CopyX();
+    inline void CopyY();
+
+    inline void ShiftBackground();
+    inline void LoadBackground();
+
+    // Selects the sprites for the scanline after the current one
+    // and draws them in the sprite line
+    void EvaluateSprites();
+    void ClearSprites();
+
+    // Draws a pixel of the current scanline from its background
+    // pixel and palette, adding the sprites
+    inline void DrawPixel(uint16_t x, uint8_t backgroundPixel, uint8_t backgroundPalette);
+    inline void CheckSpriteZeroHit(uint16_t x, uint8_t backgroundPixel);
+
+    // Schedules the NMI at the start of the next VBlank
+    void ScheduleNmi();
+};
+
+#endif // PPU_H
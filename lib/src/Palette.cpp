@@ -0,0 +1,150 @@
+#include "Palette.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define NESPP_AVX2
+#include <immintrin.h>
+#endif
+
+namespace
+{
+// 2C02 colors, as 0xRRGGBB
+const uint32_t SYSTEM_PALETTE[64]{
+    0x666666, 0x002A88, 0x1412A7, 0x3B00A4, 0x5C007E, 0x6E0040, 0x6C0600, 0x561D00,
+    0x333500, 0x0B4800, 0x005200, 0x004F08, 0x00404D, 0x000000, 0x000000, 0x000000,
+    0xADADAD, 0x155FD9, 0x4240FF, 0x7527FE, 0xA01ACC, 0xB71E7B, 0xB53120, 0x994E00,
+    0x6B6D00, 0x388700, 0x0C9300, 0x008F32, 0x007C8D, 0x000000, 0x000000, 0x000000,
+    0xFFFEFF, 0x64B0FF, 0x9290FF, 0xC676FF, 0xF36AFF, 0xFE6ECC, 0xFE8170, 0xEA9E22,
+    0xBCBE00, 0x88D800, 0x5CE430, 0x45E082, 0x48CDDE, 0x4F4F4F, 0x000000, 0x000000,
+    0xFFFEFF, 0xC0DFFF, 0xD3D2FF, 0xE8C8FF, 0xFBC2FF, 0xFEC4EA, 0xFECCC5, 0xF7D8A5,
+    0xE4E594, 0xCFEF96, 0xBDF4AB, 0xB3F3CC, 0xB5EBF2, 0xB8B8B8, 0x000000, 0x000000,
+};
+
+// Emphasizing a color darkens the other ones
+const double EMPHASIS_ATTENUATION = 0.816;
+
+void ConvertScalar(const uint16_t* pixels, size_t count, uint32_t* output, const uint32_t* table)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        output[i] = table[pixels[i] & 0x01FF];
+    }
+}
+
+void ConvertScalar(const uint16_t* pixels, size_t count, uint16_t* output, const uint32_t* table)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        output[i] = table[pixels[i] & 0x01FF];
+    }
+}
+
+#ifdef NESPP_AVX2
+__attribute__((target("avx2"))) inline __m256i Gather(const uint16_t* pixels, const uint32_t* table)
+{
+    __m256i indices = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels)));
+    indices = _mm256_and_si256(indices, _mm256_set1_epi32(0x01FF));
+    return _mm256_i32gather_epi32(reinterpret_cast<const int*>(table), indices, 4);
+}
+
+__attribute__((target("avx2"))) void ConvertAVX2(const uint16_t* pixels, size_t count, uint32_t* output,
+                                                   const uint32_t* table)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i), Gather(pixels + i, table));
+    }
+    ConvertScalar(pixels + i, count - i, output + i, table);
+}
+
+__attribute__((target("avx2"))) void ConvertAVX2(const uint16_t* pixels, size_t count, uint16_t* output,
+                                                   const uint32_t* table)
+{
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        // Packing works within 128 bit lanes, the permutation puts the pixels back in order
+        __m256i packed = _mm256_packus_epi32(Gather(pixels + i, table), Gather(pixels + i + 8, table));
+        packed = _mm256_permute4x64_epi64(packed, 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i), packed);
+    }
+    ConvertScalar(pixels + i, count - i, output + i, table);
+}
+#endif
+} // namespace
+
+Palette::Palette(Format format)
+    : format(format)
+{
+    EnableSIMD(true);
+    for (uint32_t pixel = 0; pixel < table.size(); pixel++)
+    {
+        uint32_t color = SYSTEM_PALETTE[pixel & 0x3F];
+        uint32_t emphasis = pixel >> 6;
+        uint32_t channels[3]{(color >> 16) & 0xFF, (color >> 8) & 0xFF, color & 0xFF};
+        for (int channel = 0; channel < 3; channel++)
+        {
+            if (emphasis != 0 && (emphasis & (1 << channel)) == 0)
+            {
+                channels[channel] = channels[channel] * EMPHASIS_ATTENUATION;
+            }
+        }
+        auto [red, green, blue] = channels;
+        switch (format)
+        {
+        case RGBA8888: table[pixel] = 0xFF000000 | (blue << 16) | (green << 8) | red; break;
+        case BGRA8888: table[pixel] = 0xFF000000 | (red << 16) | (green << 8) | blue; break;
+        case RGB565: table[pixel] = ((red >> 3) << 11) | ((green >> 2) << 5) | (blue >> 3); break;
+        }
+    }
+}
+
+bool Palette::IsSIMDSupported()
+{
+#ifdef NESPP_AVX2
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+void Palette::Convert(const uint16_t* pixels, size_t count, void* output) const
+{
+#ifdef NESPP_AVX2
+    if (simd)
+    {
+        if (format == RGB565)
+        {
+            ConvertAVX2(pixels, count, static_cast<uint16_t*>(output), table.data());
+        }
+        else
+        {
+            ConvertAVX2(pixels, count, static_cast<uint32_t*>(output), table.data());
+        }
+        return;
+    }
+#endif
+    if (format == RGB565)
+    {
+        ConvertScalar(pixels, count, static_cast<uint16_t*>(output), table.data());
+    }
+    else
+    {
+        ConvertScalar(pixels, count, static_cast<uint32_t*>(output), table.data());
+    }
+}
+
+void Palette::ConvertFrame(const FrameBuffer& frame, void* surface, size_t pitch) const
+{
+    uint8_t* row = static_cast<uint8_t*>(surface);
+    // Surfaces without padding are converted in a single run
+    if (pitch == FRAME_WIDTH * GetBytesPerPixel())
+    {
+        Convert(frame.data(), frame.size(), row);
+        return;
+    }
+    for (size_t y = 0; y < FRAME_HEIGHT; y++, row += pitch)
+    {
+        Convert(frame.data() + y * FRAME_WIDTH, FRAME_WIDTH, row);
+    }
+}
@@ -0,0 +1,124 @@
+#include "PerfCounters.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+
+namespace
+{
+int OpenEvent(uint32_t type, uint64_t config, int groupLeader)
+{
+    perf_event_attr attributes{};
+    attributes.size = sizeof(attributes);
+    attributes.type = type;
+    attributes.config = config;
+    attributes.disabled = (groupLeader == -1) ? 1 : 0;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+    attributes.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID;
+    return syscall(SYS_perf_event_open, &attributes, 0, -1, groupLeader, 0);
+}
+} // namespace
+
+PerfCounters::PerfCounters()
+{
+    descriptors.fill(-1);
+    const uint32_t types[EVENTS]{PERF_TYPE_SOFTWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+                                 PERF_TYPE_HW_CACHE};
+    const uint64_t configs[EVENTS]{
+        PERF_COUNT_SW_TASK_CLOCK, PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES,
+        PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)};
+    for (int event = 0; event < EVENTS; event++)
+    {
+        descriptors[event] = OpenEvent(types[event], configs[event], groupLeader);
+        if (groupLeader == -1)
+        {
+            groupLeader = descriptors[event];
+        }
+    }
+}
+
+PerfCounters::~PerfCounters()
+{
+    for (int descriptor : descriptors)
+    {
+        if (descriptor != -1)
+        {
+            close(descriptor);
+        }
+    }
+}
+
+void PerfCounters::Start()
+{
+    if (groupLeader != -1)
+    {
+        ioctl(groupLeader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(groupLeader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+}
+
+void PerfCounters::Stop()
+{
+    if (groupLeader != -1)
+    {
+        ioctl(groupLeader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    }
+}
+
+PerfCounters::Values PerfCounters::Read() const
+{
+    Values values;
+    if (groupLeader == -1)
+    {
+        return values;
+    }
+    // Layout of a group read with PERF_FORMAT_ID: the number of
+    // events followed by a (value, id) pair for each one of them
+    uint64_t buffer[1 + 2 * EVENTS];
+    if (read(groupLeader, buffer, sizeof(buffer)) <= 0)
+    {
+        return values;
+    }
+    for (uint64_t i = 0; i < buffer[0]; i++)
+    {
+        uint64_t value = buffer[1 + 2 * i];
+        uint64_t id = buffer[2 + 2 * i];
+        for (int event = 0; event < EVENTS; event++)
+        {
+            uint64_t eventId;
+            if (descriptors[event] != -1 && ioctl(descriptors[event], PERF_EVENT_IOC_ID, &eventId) == 0 &&
+                eventId == id)
+            {
+                values.count[event] = value;
+                values.available[event] = true;
+            }
+        }
+    }
+    return values;
+}
+
+#else
+
+PerfCounters::PerfCounters()
+{
+    descriptors.fill(-1);
+}
+
+PerfCounters::~PerfCounters() = default;
+
+void PerfCounters::Start() {}
+
+void PerfCounters::Stop() {}
+
+PerfCounters::Values PerfCounters::Read() const
+{
+    return {};
+}
+
+#endif
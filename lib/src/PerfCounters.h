@@ -0,0 +1,86 @@
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include <array>
+#include <cstdint>
+
+/*
+ * Host hardware performance counters, read through the
+ * Linux perf_event_open interface. All the events are
+ * opened as a single group so that they are scheduled
+ * together on the PMU. Counters the host does not support
+ * (e.g. in most virtual machines) are simply reported as
+ * unavailable; the task clock is a software event and
+ * works everywhere perf events are allowed at all.
+ * On other platforms nothing is available.
+ */
+
+class PerfCounters
+{
+public:
+    enum Event
+    {
+        TASK_CLOCK, // nanoseconds
+        CYCLES,
+        INSTRUCTIONS,
+        BRANCH_MISSES,
+        L1D_READ_MISSES,
+        EVENTS
+    };
+
+    PerfCounters();
+    ~PerfCounters();
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    void Start();
+    void Stop();
+
+    struct Values
+    {
+        std::array<uint64_t, EVENTS> count{};
+        std::array<bool, EVENTS> available{};
+    };
+
+    // Counts accumulated between the last Start and Stop
+    Values Read() const;
+
+private:
+    std::array<int, EVENTS> descriptors;
+    int groupLeader = -1;
+};
+
+/*
+ * Emulator side counters, only updated when the library is
+ * built with NESpp_ENABLE_INSTRUMENTATION (which defines
+ * NESPP_INSTRUMENTATION) to keep the bus free of them otherwise.
+ */
+struct BusCounters
+{
+    enum Region
+    {
+        RAM,
+        PPU,
+        APU_IO,
+        DISABLED,
+        CARTRIDGE,
+        REGIONS
+    };
+
+    static inline Region RegionOf(uint16_t address)
+    {
+        if (address < 0x2000) return RAM;
+        if (address < 0x4000) return PPU;
+        if (address < 0x4018) return APU_IO;
+        if (address < 0x4020) return DISABLED;
+        return CARTRIDGE;
+    }
+
+    std::array<uint64_t, REGIONS> reads{};
+    std::array<uint64_t, REGIONS> writes{};
+    // Writes to cartridge space, which is where mapper registers live
+    uint64_t mapperWrites = 0;
+    uint64_t instructions = 0;
+};
+
+#endif // PERFCOUNTERS_H
@@ -0,0 +1,145 @@
+#include "Profiler.h"
+#include <algorithm>
+#include <fmt/core.h>
+#include <string>
+
+Profiler::Profiler(uint16_t entryPoint, uint8_t stackPointer)
+    : baseStackPointer(stackPointer)
+{
+    nodes.push_back({0, entryPoint, 0});
+    callStack.push_back({entryPoint, 0, 0, 0});
+    subroutines[entryPoint] = {entryPoint, 1, 0, 0};
+    activeFrames[entryPoint] = 1;
+}
+
+void Profiler::Call(uint16_t address, uint8_t SP)
+{
+    // Frames at or below the new one were left without an RTS
+    // (e.g. by pulling the return address from the stack)
+    uint8_t depth = StackDepth(SP);
+    while (callStack.size() > 1 && callStack.back().stackDepth >= depth)
+    {
+        PopFrame();
+    }
+    Attribute();
+
+    uint32_t parent = callStack.back().node;
+    uint64_t key = ((uint64_t)parent << 16) | address;
+    auto child = children.find(key);
+    uint32_t node;
+    if (child == children.end())
+    {
+        node = nodes.size();
+        nodes.push_back({parent, address, 0});
+        children.emplace(key, node);
+    }
+    else
+    {
+        node = child->second;
+    }
+
+    Subroutine& subroutine = subroutines.try_emplace(address, Subroutine{address, 0, 0, 0}).first->second;
+    subroutine.calls++;
+    activeFrames[address]++;
+    callStack.push_back({address, depth, node, totalCycles});
+}
+
+void Profiler::Return(uint8_t SP)
+{
+    // Frames deeper than the current stack have now returned
+    uint8_t depth = StackDepth(SP);
+    while (callStack.size() > 1 && callStack.back().stackDepth > depth)
+    {
+        PopFrame();
+    }
+}
+
+void Profiler::PopFrame()
+{
+    Attribute();
+    const Frame& frame = callStack.back();
+    activeFrames[frame.address]--;
+    if (activeFrames[frame.address] == 0)
+    {
+        subroutines[frame.address].inclusiveCycles += totalCycles - frame.entryCycle;
+    }
+    callStack.pop_back();
+}
+
+void Profiler::Attribute()
+{
+    uint64_t elapsed = totalCycles - lastAttribution;
+    const Frame& top = callStack.back();
+    nodes[top.node].cycles += elapsed;
+    subroutines[top.address].exclusiveCycles += elapsed;
+    lastAttribution = totalCycles;
+}
+
+std::vector<Profiler::Hotspot> Profiler::GetHotspots(size_t number) const
+{
+    std::vector<Hotspot> hotspots;
+    for (size_t PC = 0; PC < instructionCount.size(); PC++)
+    {
+        if (instructionCount[PC] != 0)
+        {
+            hotspots.push_back({(uint16_t)PC, instructionCount[PC], cycleCount[PC]});
+        }
+    }
+    number = std::min(number, hotspots.size());
+    std::partial_sort(hotspots.begin(), hotspots.begin() + number, hotspots.end(),
+                      [](const Hotspot& a, const Hotspot& b) { return a.cycles > b.cycles; });
+    hotspots.resize(number);
+    return hotspots;
+}
+
+std::vector<Profiler::Subroutine> Profiler::GetSubroutines() const
+{
+    std::unordered_map<uint16_t, Subroutine> current = subroutines;
+    current[callStack.back().address].exclusiveCycles += totalCycles - lastAttribution;
+    // Only the outermost frame of recursive subroutines is counted
+    std::array<bool, 65536> counted{};
+    for (const Frame& frame : callStack)
+    {
+        if (!counted[frame.address])
+        {
+            current[frame.address].inclusiveCycles += totalCycles - frame.entryCycle;
+            counted[frame.address] = true;
+        }
+    }
+
+    std::vector<Subroutine> result;
+    for (const auto& [address, subroutine] : current)
+    {
+        result.push_back(subroutine);
+    }
+    std::sort(result.begin(), result.end(),
+              [](const Subroutine& a, const Subroutine& b) { return a.inclusiveCycles > b.inclusiveCycles; });
+    return result;
+}
+
+void Profiler::WriteFoldedStacks(std::ostream& output) const
+{
+    std::vector<uint64_t> cycles(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        cycles[i] = nodes[i].cycles;
+    }
+    cycles[callStack.back().node] += totalCycles - lastAttribution;
+
+    std::string line;
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        if (cycles[i] == 0)
+        {
+            continue;
+        }
+        // Nodes are always created after their parent, so walking
+        // up the tree always terminates at the root (node 0)
+        line.clear();
+        for (uint32_t node = i; node != 0; node = nodes[node].parent)
+        {
+            line.insert(0, fmt::format(";${:04X}", nodes[node].address));
+        }
+        output << fmt::format("${:04X}", nodes[0].address) << line << ' ' << cycles[i] << '\n';
+    }
+}
@@ -0,0 +1,141 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Instrumenting (not sampling) profiler used by the Debugger.
+ * Every executed instruction is counted in flat arrays indexed
+ * by PC, so recording is just a couple of increments.
+ * Subroutines are tracked by following JSR and RTS, and interrupt
+ * handlers by following the interrupts and RTI: cycles are
+ * attributed to the subroutine on top of the call stack only
+ * when the stack changes, both for the per subroutine
+ * inclusive/exclusive totals and for the folded stacks.
+ */
+
+class Profiler
+{
+public:
+    // The entry point is used as the name of the root of the call stack
+    Profiler(uint16_t entryPoint, uint8_t stackPointer);
+    ~Profiler() = default;
+
+    // Called after each instruction; bank is 0 for code outside
+    // of the cartridge and n + 1 for 16KiB PRG ROM bank n
+    inline void Record(uint16_t PC, uint8_t opcode, uint32_t cycles, size_t bank, uint16_t nextPC, uint8_t SP)
+    {
+        instructionCount[PC]++;
+        cycleCount[PC] += cycles;
+        if (bank >= bankCycles.size())
+        {
+            bankCycles.resize(bank + 1, 0);
+        }
+        bankCycles[bank] += cycles;
+        totalCycles += cycles;
+        totalInstructions++;
+
+        if (opcode == 0x20) // JSR
+        {
+            Call(nextPC, SP);
+        }
+        else if (opcode == 0x60 || opcode == 0x40) // RTS, RTI
+        {
+            Return(SP);
+        }
+    }
+
+    // Called instead of Record when the CPU takes an interrupt rather
+    // than executing an instruction: the handler gets its own frame
+    inline void RecordInterrupt(uint32_t cycles, size_t bank, uint16_t handler, uint8_t SP)
+    {
+        Call(handler, SP);
+        if (bank >= bankCycles.size())
+        {
+            bankCycles.resize(bank + 1, 0);
+        }
+        bankCycles[bank] += cycles;
+        totalCycles += cycles;
+    }
+
+    struct Hotspot
+    {
+        uint16_t PC;
+        uint64_t instructions;
+        uint64_t cycles;
+    };
+
+    struct Subroutine
+    {
+        uint16_t address;
+        uint64_t calls;
+        uint64_t inclusiveCycles;
+        uint64_t exclusiveCycles;
+    };
+
+    // Addresses sorted by the number of cycles spent executing them
+    std::vector<Hotspot> GetHotspots(size_t number) const;
+
+    // Subroutines sorted by inclusive cycles; frames that are still
+    // on the call stack are accounted as if they returned now
+    std::vector<Subroutine> GetSubroutines() const;
+
+    const std::vector<uint64_t>& GetBankCycles() const { return bankCycles; }
+    uint64_t GetInstructionCount(uint16_t PC) const { return instructionCount[PC]; }
+    uint64_t GetCycleCount(uint16_t PC) const { return cycleCount[PC]; }
+    uint64_t GetTotalCycles() const { return totalCycles; }
+    uint64_t GetTotalInstructions() const { return totalInstructions; }
+
+    // One line per distinct call stack, in the collapsed format
+    // understood by flamegraph.pl: "$C000;$C123;$C456 <cycles>"
+    void WriteFoldedStacks(std::ostream& output) const;
+
+private:
+    struct Frame
+    {
+        uint16_t address;
+        // Bytes on the stack (relative to the entry point) right after
+        // JSR pushed the return address, used to detect subroutines
+        // that never return with RTS
+        uint8_t stackDepth;
+        uint32_t node;
+        uint64_t entryCycle;
+    };
+
+    // Node of the tree of all the call stacks seen so far
+    struct Node
+    {
+        uint32_t parent;
+        uint16_t address;
+        uint64_t cycles;
+    };
+
+    void Call(uint16_t address, uint8_t SP);
+    void Return(uint8_t SP);
+    void PopFrame();
+    uint8_t StackDepth(uint8_t SP) const { return baseStackPointer - SP; }
+    // Gives the cycles elapsed since the last call stack change to the top frame
+    void Attribute();
+
+    std::array<uint64_t, 65536> instructionCount{};
+    std::array<uint64_t, 65536> cycleCount{};
+    std::vector<uint64_t> bankCycles;
+    uint64_t totalCycles = 0;
+    uint64_t totalInstructions = 0;
+
+    uint8_t baseStackPointer;
+    std::vector<Frame> callStack;
+    std::vector<Node> nodes;
+    std::unordered_map<uint64_t, uint32_t> children;
+    std::unordered_map<uint16_t, Subroutine> subroutines;
+    // How many frames of each subroutine are on the stack, so that
+    // recursive calls are only counted once in the inclusive time
+    std::array<uint8_t, 65536> activeFrames{};
+    uint64_t lastAttribution = 0;
+};
+
+#endif // PROFILER_H
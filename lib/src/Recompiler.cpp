@@ -0,0 +1,297 @@
+#include "Recompiler.h"
+
+#ifdef NESPP_JIT
+
+#include <cstring>
+#include <sys/mman.h>
+
+Recompiler::Recompiler()
+{
+    void* memory = mmap(nullptr, CODE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    buffer = (memory == MAP_FAILED) ? nullptr : static_cast<uint8_t*>(memory);
+}
+
+Recompiler::~Recompiler()
+{
+    if (buffer != nullptr)
+    {
+        munmap(buffer, CODE_SIZE);
+    }
+}
+
+void Recompiler::Reset()
+{
+    used = 0;
+}
+
+bool Recompiler::IsSupported(uint8_t opcode)
+{
+    switch (opcode)
+    {
+    case 0xA9: case 0xA2: case 0xA0: // LDA, LDX, LDY immediate
+    case 0xAA: case 0xA8: case 0x8A: case 0x98: case 0xBA: case 0x9A: // transfers
+    case 0xE8: case 0xC8: case 0xCA: case 0x88: // INX, INY, DEX, DEY
+    case 0x29: case 0x09: case 0x49: // AND, ORA, EOR immediate
+    case 0x69: case 0xE9: // ADC, SBC immediate
+    case 0xC9: case 0xE0: case 0xC0: // CMP, CPX, CPY immediate
+    case 0x0A: case 0x4A: case 0x2A: case 0x6A: // ASL, LSR, ROL, ROR accumulator
+    case 0x18: case 0x38: case 0x58: case 0x78: case 0xB8: case 0xD8: case 0xF8: // flags
+    case 0xEA: // NOP
+        return true;
+    default:
+        return false;
+    }
+}
+
+CompiledCode Recompiler::Compile(const std::vector<Instruction>& instructions,
+                                 const std::array<CPU::Instruction, 256>& opcodeTable)
+{
+    if (buffer == nullptr)
+    {
+        return {};
+    }
+
+    CompiledCode compiled;
+    code.clear();
+    const uint8_t registers[]{R8B, R9B, R10B, R11B, SIL};
+    for (uint8_t i = 0; i < 5; i++)
+    {
+        EmitLoad(registers[i], i);
+    }
+
+    // Register holding the last result Z and N are computed from, 0 if none
+    uint8_t zeroNegative = 0;
+    for (const Instruction& instruction : instructions)
+    {
+        if (compiled.instructions == UINT8_MAX || !TranslateInstruction(instruction, zeroNegative))
+        {
+            break;
+        }
+        compiled.instructions++;
+        compiled.bytes += opcodeTable[instruction.opcode].bytes;
+        compiled.cycles += opcodeTable[instruction.opcode].cycles;
+        compiled.lastOpcode = instruction.opcode;
+        // CLI and SEI end the block: a pending IRQ is polled right after them
+        if (instruction.opcode == 0x58 || instruction.opcode == 0x78)
+        {
+            break;
+        }
+    }
+    if (compiled.instructions == 0)
+    {
+        return {};
+    }
+
+    if (zeroNegative != 0)
+    {
+        EmitOperationImmediate(AND, SIL, (uint8_t)~(CPU::Z | CPU::N));
+        EmitOperation(0x84, zeroNegative, zeroNegative); // TEST
+        EmitSet(ZERO, AL);
+        EmitShift(SHL, AL);
+        EmitOperation(0x08, SIL, AL); // OR
+        EmitMove(AL, zeroNegative);
+        EmitOperationImmediate(AND, AL, CPU::N);
+        EmitOperation(0x08, SIL, AL);
+    }
+    for (uint8_t i = 0; i < 5; i++)
+    {
+        EmitStore(registers[i], i);
+    }
+    Emit(0xC3); // RET
+
+    // Functions are aligned to 16 bytes
+    size_t start = (used + 15) & ~(size_t)15;
+    if (start + code.size() > CODE_SIZE)
+    {
+        return {};
+    }
+    // The buffer is never writable and executable at the same time
+    mprotect(buffer, CODE_SIZE, PROT_READ | PROT_WRITE);
+    std::memcpy(buffer + start, code.data(), code.size());
+    mprotect(buffer, CODE_SIZE, PROT_READ | PROT_EXEC);
+    used = start + code.size();
+    compiled.function = reinterpret_cast<void (*)(CompiledRegisters*)>(buffer + start);
+    return compiled;
+}
+
+bool Recompiler::TranslateInstruction(const Instruction& instruction, uint8_t& zeroNegative)
+{
+    uint8_t operand = instruction.operand;
+    switch (instruction.opcode)
+    {
+    // Loads and transfers
+    case 0xA9: EmitMoveImmediate(R8B, operand); zeroNegative = R8B; break;
+    case 0xA2: EmitMoveImmediate(R9B, operand); zeroNegative = R9B; break;
+    case 0xA0: EmitMoveImmediate(R10B, operand); zeroNegative = R10B; break;
+    case 0xAA: EmitMove(R9B, R8B); zeroNegative = R9B; break;
+    case 0xA8: EmitMove(R10B, R8B); zeroNegative = R10B; break;
+    case 0x8A: EmitMove(R8B, R9B); zeroNegative = R8B; break;
+    case 0x98: EmitMove(R8B, R10B); zeroNegative = R8B; break;
+    case 0xBA: EmitMove(R9B, R11B); zeroNegative = R9B; break;
+    case 0x9A: EmitMove(R11B, R9B); break;
+
+    // Increments and decrements, which don't change the carry on both CPUs
+    case 0xE8: EmitIncrement(INC, R9B); zeroNegative = R9B; break;
+    case 0xC8: EmitIncrement(INC, R10B); zeroNegative = R10B; break;
+    case 0xCA: EmitIncrement(DEC, R9B); zeroNegative = R9B; break;
+    case 0x88: EmitIncrement(DEC, R10B); zeroNegative = R10B; break;
+
+    // Logic
+    case 0x29: EmitOperationImmediate(AND, R8B, operand); zeroNegative = R8B; break;
+    case 0x09: EmitOperationImmediate(OR, R8B, operand); zeroNegative = R8B; break;
+    case 0x49: EmitOperationImmediate(XOR, R8B, operand); zeroNegative = R8B; break;
+
+    // Arithmetic: the host carry and overflow of ADC match the 6502 ones,
+    // also when subtracting by adding the complement of the operand
+    case 0x69:
+    case 0xE9:
+        EmitLoadCarry();
+        EmitOperationImmediate(ADC, R8B, (instruction.opcode == 0xE9) ? ~operand : operand);
+        EmitUpdateCarry(CARRY, true);
+        zeroNegative = R8B;
+        break;
+
+    // Compares: the 6502 sets the carry when there is no borrow
+    case 0xC9:
+    case 0xE0:
+    case 0xC0:
+        EmitMove(DL, (instruction.opcode == 0xC9) ? R8B : (instruction.opcode == 0xE0) ? R9B : R10B);
+        EmitOperationImmediate(SUB, DL, operand);
+        EmitUpdateCarry(NOT_CARRY, false);
+        zeroNegative = DL;
+        break;
+
+    // Accumulator shifts and rotations
+    case 0x0A: EmitShift(SHL, R8B); EmitUpdateCarry(CARRY, false); zeroNegative = R8B; break;
+    case 0x4A: EmitShift(SHR, R8B); EmitUpdateCarry(CARRY, false); zeroNegative = R8B; break;
+    case 0x2A:
+        EmitLoadCarry();
+        EmitShift(RCL, R8B);
+        EmitUpdateCarry(CARRY, false);
+        zeroNegative = R8B;
+        break;
+    case 0x6A:
+        EmitLoadCarry();
+        EmitShift(RCR, R8B);
+        EmitUpdateCarry(CARRY, false);
+        zeroNegative = R8B;
+        break;
+
+    // Flags
+    case 0x18: EmitOperationImmediate(AND, SIL, (uint8_t)~CPU::C); break;
+    case 0x38: EmitOperationImmediate(OR, SIL, CPU::C); break;
+    case 0x58: EmitOperationImmediate(AND, SIL, (uint8_t)~CPU::I); break;
+    case 0x78: EmitOperationImmediate(OR, SIL, CPU::I); break;
+    case 0xB8: EmitOperationImmediate(AND, SIL, (uint8_t)~CPU::V); break;
+    case 0xD8: EmitOperationImmediate(AND, SIL, (uint8_t)~CPU::D); break;
+    case 0xF8: EmitOperationImmediate(OR, SIL, CPU::D); break;
+
+    case 0xEA: break;
+
+    default: return false;
+    }
+    return true;
+}
+
+// The REX prefix is always emitted, so that SIL can be encoded
+// (without it the same encoding would refer to DH)
+void Recompiler::EmitRex(uint8_t reg, uint8_t rm)
+{
+    Emit(0x40 | ((reg >> 3) << 2) | (rm >> 3));
+}
+
+void Recompiler::EmitMove(uint8_t destination, uint8_t source)
+{
+    EmitOperation(0x88, destination, source);
+}
+
+void Recompiler::EmitMoveImmediate(uint8_t destination, uint8_t value)
+{
+    EmitRex(0, destination);
+    Emit(0xB0 | (destination & 0x07));
+    Emit(value);
+}
+
+void Recompiler::EmitOperationImmediate(Operation operation, uint8_t destination, uint8_t value)
+{
+    EmitRex(0, destination);
+    Emit(0x80);
+    Emit(0xC0 | (operation << 3) | (destination & 0x07));
+    Emit(value);
+}
+
+void Recompiler::EmitOperation(uint8_t opcode, uint8_t destination, uint8_t source)
+{
+    EmitRex(source, destination);
+    Emit(opcode);
+    Emit(0xC0 | ((source & 0x07) << 3) | (destination & 0x07));
+}
+
+void Recompiler::EmitShift(Operation operation, uint8_t destination)
+{
+    EmitRex(0, destination);
+    Emit(0xD0);
+    Emit(0xC0 | (operation << 3) | (destination & 0x07));
+}
+
+void Recompiler::EmitIncrement(Operation operation, uint8_t destination)
+{
+    EmitRex(0, destination);
+    Emit(0xFE);
+    Emit(0xC0 | (operation << 3) | (destination & 0x07));
+}
+
+void Recompiler::EmitSet(Condition condition, uint8_t destination)
+{
+    EmitRex(0, destination);
+    Emit(0x0F);
+    Emit(0x90 | condition);
+    Emit(0xC0 | (destination & 0x07));
+}
+
+void Recompiler::EmitLoadCarry()
+{
+    // BT ESI, 0
+    Emit(0x0F);
+    Emit(0xBA);
+    Emit(0xE6);
+    Emit(0x00);
+}
+
+void Recompiler::EmitLoad(uint8_t destination, uint8_t offset)
+{
+    EmitRex(destination, RDI);
+    Emit(0x8A);
+    Emit(0x40 | ((destination & 0x07) << 3) | RDI);
+    Emit(offset);
+}
+
+void Recompiler::EmitStore(uint8_t source, uint8_t offset)
+{
+    EmitRex(source, RDI);
+    Emit(0x88);
+    Emit(0x40 | ((source & 0x07) << 3) | RDI);
+    Emit(offset);
+}
+
+void Recompiler::EmitUpdateCarry(Condition carry, bool overflow)
+{
+    EmitSet(carry, AL);
+    if (overflow)
+    {
+        EmitSet(OVERFLOW, CL);
+    }
+    EmitOperationImmediate(AND, SIL, (uint8_t)~(overflow ? (CPU::C | CPU::V) : CPU::C));
+    EmitOperation(0x08, SIL, AL); // OR
+    if (overflow)
+    {
+        // SHL CL, 6
+        EmitRex(0, CL);
+        Emit(0xC0);
+        Emit(0xC0 | (SHL << 3) | CL);
+        Emit(6);
+        EmitOperation(0x08, SIL, CL);
+    }
+}
+
+#endif // NESPP_JIT
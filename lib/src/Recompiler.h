@@ -0,0 +1,141 @@
+#ifndef RECOMPILER_H
+#define RECOMPILER_H
+
+#ifdef NESPP_JIT
+
+#include "CPU.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * Dynamic recompiler from 6502 to x86-64, only built with
+ * NESpp_ENABLE_JIT. It is driven by the BlockCache: blocks
+ * in PRG ROM that are entered often enough are translated to
+ * native code, starting from their first instruction for as
+ * long as the instructions only work on registers (transfers,
+ * increments, immediate loads, arithmetic and logic, compares,
+ * accumulator shifts and flag changes). Anything that accesses
+ * memory other than the instruction itself, and every branch
+ * or jump, is left to the interpreter, so MMIO timing is never
+ * affected: the compiled instructions only fetch their own
+ * bytes from ROM, and the bus is ticked for all their cycles
+ * once the native code returns.
+ * Inside the native code A, X, Y, SP and P are pinned to host
+ * registers (r8b, r9b, r10b, r11b and sil). Z and N are only
+ * computed from the last result when the code returns.
+ */
+
+// Registers exchanged with the native code
+struct CompiledRegisters
+{
+    uint8_t A, X, Y, SP, P;
+};
+
+struct CompiledCode
+{
+    void (*function)(CompiledRegisters* registers) = nullptr;
+    // Instructions, bytes and cycles of 6502 code covered
+    uint8_t instructions = 0;
+    uint8_t bytes = 0;
+    uint16_t cycles = 0;
+    // Opcode of the last instruction covered
+    uint8_t lastOpcode = 0;
+};
+
+class Recompiler
+{
+public:
+    Recompiler();
+    ~Recompiler();
+    Recompiler(const Recompiler&) = delete;
+    Recompiler& operator=(const Recompiler&) = delete;
+
+    struct Instruction
+    {
+        uint8_t opcode;
+        uint8_t operand;
+    };
+
+    // Translates the longest supported prefix of the given instructions,
+    // the function is null if there is none or the code buffer is full
+    CompiledCode Compile(const std::vector<Instruction>& instructions,
+                         const std::array<CPU::Instruction, 256>& opcodeTable);
+
+    // Discards all the compiled code
+    void Reset();
+
+    static bool IsSupported(uint8_t opcode);
+
+private:
+    // Host register numbers, as encoded in x86-64 instructions
+    enum HostRegister : uint8_t
+    {
+        AL = 0,
+        CL = 1,
+        DL = 2,
+        SIL = 6,
+        RDI = 7,
+        R8B = 8,
+        R9B = 9,
+        R10B = 10,
+        R11B = 11
+    };
+
+    // Condition codes for SETcc
+    enum Condition : uint8_t
+    {
+        OVERFLOW = 0x0,
+        CARRY = 0x2,
+        NOT_CARRY = 0x3,
+        ZERO = 0x4
+    };
+
+    // Extension of the opcode in the reg field of ModRM
+    enum Operation : uint8_t
+    {
+        ADD = 0,
+        OR = 1,
+        ADC = 2,
+        AND = 4,
+        SUB = 5,
+        XOR = 6,
+        ROL = 0,
+        ROR = 1,
+        RCL = 2,
+        RCR = 3,
+        SHL = 4,
+        SHR = 5,
+        INC = 0,
+        DEC = 1
+    };
+
+    static const size_t CODE_SIZE = 1 << 20;
+
+    void Emit(uint8_t byte) { code.push_back(byte); }
+    void EmitRex(uint8_t reg, uint8_t rm);
+    void EmitMove(uint8_t destination, uint8_t source);
+    void EmitMoveImmediate(uint8_t destination, uint8_t value);
+    void EmitOperationImmediate(Operation operation, uint8_t destination, uint8_t value);
+    void EmitOperation(uint8_t opcode, uint8_t destination, uint8_t source);
+    void EmitShift(Operation operation, uint8_t destination);
+    void EmitIncrement(Operation operation, uint8_t destination);
+    void EmitSet(Condition condition, uint8_t destination);
+    void EmitLoadCarry();
+    void EmitLoad(uint8_t destination, uint8_t offset);
+    void EmitStore(uint8_t source, uint8_t offset);
+    // Copies the host flag selected as carry (and the overflow) to P
+    void EmitUpdateCarry(Condition carry, bool overflow);
+
+    bool TranslateInstruction(const Instruction& instruction, uint8_t& zeroNegative);
+
+    uint8_t* buffer;
+    size_t used = 0;
+    // Code of the block being compiled
+    std::vector<uint8_t> code;
+};
+
+#endif // NESPP_JIT
+
+#endif // RECOMPILER_H
@@ -0,0 +1,122 @@
+#include "RollbackSession.h"
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+RollbackSession::RollbackSession(const EmulatorCore& other, Transport& transport, size_t localPort)
+    : EmulatorCore(other), transport(transport), localPort(localPort)
+{
+    if (localPort > 1)
+    {
+        throw std::invalid_argument("The local player must use port 0 or 1");
+    }
+    core->PowerOn();
+}
+
+bool RollbackSession::AdvanceFrame(uint8_t localInput)
+{
+    ReceiveInputs();
+    stats.resimulatedFrames = 0;
+    stats.resimulationNanoseconds = 0;
+    // The state of older frames is not available to roll back to
+    if (frame >= confirmedFrames + MAX_ROLLBACK)
+    {
+        SendInputs();
+        return false;
+    }
+
+    if (rollbackFrame < frame)
+    {
+        auto start = std::chrono::steady_clock::now();
+        core->LoadState(states[rollbackFrame % states.size()]);
+        // The frames being corrected have already been shown
+        for (uint64_t resimulated = rollbackFrame; resimulated < frame; resimulated++)
+        {
+            RunFrame(resimulated, false);
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+
+        stats.resimulatedFrames = frame - rollbackFrame;
+        stats.resimulationNanoseconds = elapsed.count();
+        stats.rollbacks++;
+        stats.totalResimulatedFrames += stats.resimulatedFrames;
+        stats.totalResimulationNanoseconds += stats.resimulationNanoseconds;
+        stats.maxResimulatedFrames = std::max(stats.maxResimulatedFrames, stats.resimulatedFrames);
+    }
+    rollbackFrame = UINT64_MAX;
+
+    localInputs.push_back(localInput);
+    SendInputs();
+    RunFrame(frame);
+    frame++;
+    return true;
+}
+
+void RollbackSession::ReceiveInputs()
+{
+    InputPacket packet;
+    while (transport.Receive(packet))
+    {
+        uint64_t first = (uint64_t)packet.frame + 1 - std::min<uint64_t>(packet.count, packet.frame + 1);
+        for (uint64_t received = first; received <= packet.frame; received++)
+        {
+            // The remote player can't be further ahead than this,
+            // anything else is from a broken or malicious peer
+            if (received > frame + MAX_ROLLBACK)
+            {
+                break;
+            }
+            if (received >= remoteInputs.size())
+            {
+                remoteInputs.resize(received + 1, 0);
+                confirmed.resize(received + 1, false);
+            }
+            if (confirmed[received])
+            {
+                continue;
+            }
+            uint8_t input = packet.inputs[received - first];
+            if (received < frame && remoteInputs[received] != input)
+            {
+                rollbackFrame = std::min(rollbackFrame, received);
+            }
+            remoteInputs[received] = input;
+            confirmed[received] = true;
+        }
+    }
+    while (confirmedFrames < confirmed.size() && confirmed[confirmedFrames])
+    {
+        confirmedFrames++;
+    }
+}
+
+void RollbackSession::SendInputs()
+{
+    if (localInputs.empty())
+    {
+        return;
+    }
+    InputPacket packet;
+    packet.frame = localInputs.size() - 1;
+    packet.count = std::min(localInputs.size(), InputPacket::MAX_INPUTS);
+    std::copy(localInputs.end() - packet.count, localInputs.end(), packet.inputs.begin());
+    transport.Send(packet);
+}
+
+void RollbackSession::RunFrame(uint64_t emulated, bool draw)
+{
+    if (emulated >= remoteInputs.size())
+    {
+        remoteInputs.resize(emulated + 1, 0);
+        confirmed.resize(emulated + 1, false);
+    }
+    // The remote player is predicted to keep the last known buttons pressed
+    if (!confirmed[emulated])
+    {
+        remoteInputs[emulated] = (confirmedFrames > 0) ? remoteInputs[confirmedFrames - 1] : 0;
+    }
+    core->SaveState(states[emulated % states.size()]);
+    core->GetController(localPort).SetButtons(localInputs[emulated]);
+    core->GetController(1 - localPort).SetButtons(remoteInputs[emulated]);
+    core->RunFrame(draw);
+}
@@ -0,0 +1,148 @@
+#include "Transport.h"
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+void LoopbackTransport::Connect(LoopbackTransport& first, LoopbackTransport& second)
+{
+    first.peer = &second;
+    second.peer = &first;
+}
+
+void LoopbackTransport::Send(const InputPacket& packet)
+{
+    if (peer != nullptr)
+    {
+        std::lock_guard<std::mutex> lock(peer->mutex);
+        peer->packets.push_back(packet);
+    }
+}
+
+bool LoopbackTransport::Receive(InputPacket& packet)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (packets.empty())
+    {
+        return false;
+    }
+    packet = packets.front();
+    packets.pop_front();
+    return true;
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+
+UdpTransport::UdpTransport(uint16_t localPort)
+{
+    descriptor = socket(AF_INET, SOCK_DGRAM, 0);
+    if (descriptor < 0)
+    {
+        throw std::runtime_error("Can't create a UDP socket");
+    }
+    sockaddr_in local{};
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons(localPort);
+    if (bind(descriptor, reinterpret_cast<sockaddr*>(&local), sizeof(local)) != 0)
+    {
+        close(descriptor);
+        throw std::runtime_error("Can't bind the UDP socket to port " + std::to_string(localPort));
+    }
+}
+
+UdpTransport::~UdpTransport()
+{
+    close(descriptor);
+}
+
+uint16_t UdpTransport::GetLocalPort() const
+{
+    sockaddr_in local{};
+    socklen_t length = sizeof(local);
+    getsockname(descriptor, reinterpret_cast<sockaddr*>(&local), &length);
+    return ntohs(local.sin_port);
+}
+
+void UdpTransport::Connect(const std::string& address, uint16_t port)
+{
+    sockaddr_in remote{};
+    remote.sin_family = AF_INET;
+    remote.sin_port = htons(port);
+    if (inet_pton(AF_INET, address.c_str(), &remote.sin_addr) != 1)
+    {
+        throw std::invalid_argument(address + " is not an IPv4 address");
+    }
+    // A connected UDP socket only receives datagrams from that address
+    if (connect(descriptor, reinterpret_cast<sockaddr*>(&remote), sizeof(remote)) != 0)
+    {
+        throw std::runtime_error("Can't connect the UDP socket to " + address);
+    }
+}
+
+void UdpTransport::Send(const InputPacket& packet)
+{
+    // Little endian frame number, count and inputs
+    uint8_t datagram[5 + InputPacket::MAX_INPUTS];
+    for (int i = 0; i < 4; i++)
+    {
+        datagram[i] = packet.frame >> (8 * i);
+    }
+    datagram[4] = packet.count;
+    std::copy(packet.inputs.begin(), packet.inputs.begin() + packet.count, datagram + 5);
+    // Lost datagrams are covered by the next ones, errors are ignored
+    send(descriptor, datagram, 5 + packet.count, MSG_DONTWAIT);
+}
+
+bool UdpTransport::Receive(InputPacket& packet)
+{
+    uint8_t datagram[5 + InputPacket::MAX_INPUTS];
+    while (true)
+    {
+        // Also fails when the remote port is unreachable, that
+        // just means that the other player hasn't started yet
+        ssize_t length = recv(descriptor, datagram, sizeof(datagram), MSG_DONTWAIT);
+        if (length < 0)
+        {
+            return false;
+        }
+        if (length < 5 || datagram[4] == 0 || datagram[4] > InputPacket::MAX_INPUTS || length != 5 + datagram[4])
+        {
+            continue;
+        }
+        packet.frame = datagram[0] | (datagram[1] << 8) | (datagram[2] << 16) | ((uint32_t)datagram[3] << 24);
+        packet.count = datagram[4];
+        std::copy(datagram + 5, datagram + length, packet.inputs.begin());
+        return true;
+    }
+}
+
+#else
+
+UdpTransport::UdpTransport(uint16_t localPort)
+{
+    throw std::runtime_error("The UDP transport is not available on this platform");
+}
+
+UdpTransport::~UdpTransport() = default;
+
+uint16_t UdpTransport::GetLocalPort() const
+{
+    return 0;
+}
+
+void UdpTransport::Connect(const std::string& address, uint16_t port) {}
+
+void UdpTransport::Send(const InputPacket& packet) {}
+
+bool UdpTransport::Receive(InputPacket& packet)
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/*
+ * Lock-free handoff of the latest value (usually a frame)
+ * from a single writer thread to a single reader thread.
+ * The writer fills its buffer and publishes it by swapping
+ * it with the middle one; the reader takes the middle one
+ * in exchange of its own when something new was published.
+ * Neither side ever waits for the other and no data is
+ * copied: values that are never read are just overwritten.
+ */
+
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() = default;
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    // Writer side: fill the buffer, then publish it
+    T& GetWriteBuffer() { return buffers[back]; }
+    void Publish() { back = middle.exchange(back | PUBLISHED, std::memory_order_acq_rel) & INDEX; }
+
+    // Reader side: returns false if nothing was published since the last
+    // update, in which case the read buffer keeps the same value
+    bool Update()
+    {
+        if ((middle.load(std::memory_order_relaxed) & PUBLISHED) == 0)
+        {
+            return false;
+        }
+        front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+    const T& GetReadBuffer() const { return buffers[front]; }
+
+private:
+    static const uint8_t INDEX = 0x03;
+    static const uint8_t PUBLISHED = 0x04;
+
+    std::array<T, 3> buffers{};
+    // Index of the middle buffer, with the PUBLISHED bit set if it's newer than the read one
+    alignas(64) std::atomic<uint8_t> middle{1};
+    // Only accessed by their thread, kept on separate cache lines
+    alignas(64) uint8_t back = 0;
+    alignas(64) uint8_t front = 2;
+};
+
+#endif // TRIPLEBUFFER_H
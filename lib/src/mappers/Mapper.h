@@ -11,6 +11,8 @@ public:
 
     virtual uint16_t GetAddressPRG(uint16_t address) = 0;
     virtual uint16_t GetAddressCHR(uint16_t address) = 0;
+    // Whether writes to the PRG ROM space reach registers of the mapper
+    virtual bool HasRegisters() const = 0;
 
 protected:
     int banksPRG, banksCHR;
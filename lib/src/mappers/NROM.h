@@ -11,6 +11,7 @@ public:
 
     uint16_t GetAddressPRG(uint16_t address) override;
     uint16_t GetAddressCHR(uint16_t address) override;
+    bool HasRegisters() const override { return false; }
 };
 
 #endif // NROM_H
@@ -0,0 +1,37 @@
+#ifndef TESTROM_H
+#define TESTROM_H
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Writes an NROM image with the given program at 0x8000, which is also the reset vector,
+// and the given pattern tables and interrupt vectors
+inline std::filesystem::path WriteTestROM(const std::vector<uint8_t>& program,
+                                          const std::string& name = "nespp_test.nes",
+                                          const std::vector<uint8_t>& patterns = {}, uint16_t nmiVector = 0x8000,
+                                          uint16_t irqVector = 0x8000)
+{
+    std::vector<uint8_t> PRG(16384, 0x00);
+    std::copy(program.begin(), program.end(), PRG.begin());
+    PRG[0x3FFA] = nmiVector & 0xFF;
+    PRG[0x3FFB] = nmiVector >> 8;
+    PRG[0x3FFC] = 0x00;
+    PRG[0x3FFD] = 0x80;
+    PRG[0x3FFE] = irqVector & 0xFF;
+    PRG[0x3FFF] = irqVector >> 8;
+    uint8_t header[16]{0x4E, 0x45, 0x53, 0x1A, 1, 1};
+    std::filesystem::path path = std::filesystem::temp_directory_path() / name;
+    std::ofstream rom(path, std::ios::binary);
+    rom.write(reinterpret_cast<const char*>(header), sizeof(header));
+    rom.write(reinterpret_cast<const char*>(PRG.data()), PRG.size());
+    std::vector<uint8_t> CHR(8192, 0x00);
+    std::copy(patterns.begin(), patterns.end(), CHR.begin());
+    rom.write(reinterpret_cast<const char*>(CHR.data()), CHR.size());
+    return path;
+}
+
+#endif // TESTROM_H
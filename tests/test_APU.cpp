@@ -0,0 +1,154 @@
+#include "NESpp/Debugger.h"
+#include "NESpp/Emulator.h"
+#include "TestROM.h"
+#include "doctest/doctest.h"
+
+namespace
+{
+/*
+ * Enables the frame IRQ, the DMC with its IRQ and a pulse channel,
+ * then keeps accumulating the status register in 0x12 and counting
+ * the iterations in 0x13. The IRQ handler stores the status in 0x10,
+ * counts the IRQs in 0x11 and restarts the sample when it ends.
+ */
+const std::vector<uint8_t> AUDIO_PROGRAM{
+    0x78, 0xA2, 0xFF, 0x9A,       // SEI ; LDX #$FF ; TXS
+    0xA9, 0x00, 0x85, 0x11,       // LDA #0 ; STA $11
+    0x8D, 0x17, 0x40,             // frame counter: 4-step, IRQ enabled
+    0xA9, 0x8F, 0x8D, 0x10, 0x40, // DMC: IRQ enabled, fastest rate
+    0xA9, 0x01, 0x8D, 0x13, 0x40, // 17 bytes long sample
+    0xA9, 0x1F, 0x8D, 0x15, 0x40, // all the channels enabled
+    0xA9, 0xBF, 0x8D, 0x00, 0x40, // pulse 1: 50% duty, halted, volume 15
+    0xA9, 0xF9, 0x8D, 0x02, 0x40, // pulse 1 period
+    0xA9, 0x08, 0x8D, 0x03, 0x40,
+    0x58,                         // CLI
+    0xAD, 0x15, 0x40,             // loop: LDA $4015
+    0x45, 0x12, 0x85, 0x12,       // EOR $12 ; STA $12
+    0xE6, 0x13, 0x4C, 0x2A, 0x80, // INC $13 ; JMP loop
+    0xAD, 0x15, 0x40, 0x85, 0x10, // IRQ: LDA $4015 ; STA $10
+    0x29, 0x80, 0xF0, 0x05,       // AND #$80 ; BEQ count
+    0xA9, 0x1F, 0x8D, 0x15, 0x40, // restart the sample
+    0xE6, 0x11, 0x40,             // count: INC $11 ; RTI
+};
+const uint16_t AUDIO_IRQ = 0x8036;
+} // namespace
+
+TEST_CASE("The frame IRQ is raised at the end of each 4-step sequence")
+{
+    std::vector<uint8_t> program{
+        0x78,                         // SEI
+        0xA9, 0x00, 0x85, 0x11,       // LDA #0 ; STA $11
+        0x8D, 0x17, 0x40,             // STA $4017
+        0x58,                         // CLI
+        0x4C, 0x09, 0x80,             // JMP $8009
+        0xAD, 0x15, 0x40, 0x85, 0x10, // IRQ: LDA $4015 ; STA $10
+        0xE6, 0x11, 0x40,             // INC $11 ; RTI
+    };
+    std::filesystem::path rom = WriteTestROM(program, "nespp_frame_irq.nes", {}, 0x8000, 0x800C);
+    Emulator testEmulator;
+    Debugger testDebugger(testEmulator);
+    REQUIRE(testDebugger.LoadROM(rom.string()));
+    std::filesystem::remove(rom);
+    testDebugger.AddBreakpoint(Breakpoints::EXECUTE, 0x8008);
+    testDebugger.AddBreakpoint(Breakpoints::EXECUTE, 0x800C);
+
+    REQUIRE(testDebugger.Continue());
+    uint64_t written = testDebugger.GetClock().GetCpuCycles();
+    REQUIRE(testDebugger.Continue());
+    uint64_t first = testDebugger.GetClock().GetCpuCycles();
+    // The sequence restarts 3 or 4 cycles after the write, the IRQ is
+    // taken after the current JMP, in 7 cycles
+    CHECK(first - written >= 29829 + 3 + 7);
+    CHECK(first - written <= 29829 + 4 + 3 + 7);
+
+    REQUIRE(testDebugger.Continue());
+    uint64_t second = testDebugger.GetClock().GetCpuCycles();
+    CHECK(second - first >= 29830 - 3);
+    CHECK(second - first <= 29830 + 3);
+    // Reading the status acknowledged the first IRQ
+    CHECK(testDebugger.GetMemoryState()[0x10] == 0x40);
+    CHECK(testDebugger.GetMemoryState()[0x11] == 1);
+}
+
+TEST_CASE("Length counters are visible in the status register")
+{
+    std::vector<uint8_t> program{
+        0x78,                         // SEI
+        0xA9, 0x00, 0x85, 0x11,       // LDA #0 ; STA $11
+        0xA9, 0x40, 0x8D, 0x17, 0x40, // frame counter: 4-step, IRQ inhibited
+        0xA9, 0x05, 0x8D, 0x15, 0x40, // pulse 1 and triangle enabled
+        0xA9, 0x00, 0x8D, 0x00, 0x40, // pulse 1 not halted
+        0x8D, 0x03, 0x40,             // length 10
+        0xA9, 0x80, 0x8D, 0x08, 0x40, // triangle halted
+        0xA9, 0x08, 0x8D, 0x0B, 0x40, // length 254
+        0xAD, 0x15, 0x40, 0x85, 0x10, // LDA $4015 ; STA $10
+        0x29, 0x01, 0xD0, 0xF7,       // AND #$01 ; BNE wait
+        0xE6, 0x11,                   // INC $11
+        0x4C, 0x2C, 0x80,             // JMP $802C
+    };
+    std::filesystem::path rom = WriteTestROM(program, "nespp_length.nes");
+    Emulator testEmulator;
+    Debugger testDebugger(testEmulator);
+    REQUIRE(testDebugger.LoadROM(rom.string()));
+    std::filesystem::remove(rom);
+
+    // 10 half frames are 5 sequences
+    for (int frame = 0; frame < 4; frame++)
+    {
+        testEmulator.RunFrame();
+    }
+    CHECK(testDebugger.GetMemoryState()[0x10] == 0x05);
+    CHECK(testDebugger.GetMemoryState()[0x11] == 0);
+    testEmulator.RunFrame();
+    testEmulator.RunFrame();
+    CHECK(testDebugger.GetMemoryState()[0x10] == 0x04);
+    CHECK(testDebugger.GetMemoryState()[0x11] == 1);
+}
+
+TEST_CASE("The DMC raises its IRQ once the sample has been read")
+{
+    Emulator testEmulator;
+    Debugger testDebugger(testEmulator);
+    // Frame IRQ inhibited ; DMC: IRQ enabled, fastest rate, 17 bytes ; enabled
+    uint8_t instructions[]{0xA9, 0x40, 0x8D, 0x17, 0x40, 0xA9, 0x8F, 0x8D, 0x10, 0x40, 0xA9, 0x01,
+                           0x8D, 0x13, 0x40, 0xA9, 0x10, 0x8D, 0x15, 0x40, 0x2C, 0x15, 0x40, 0x10,
+                           0xFB};
+    Debugger::CpuState state = testDebugger.ExecuteInstrFromArray(instructions, sizeof(instructions));
+
+    // The first byte is read when the DMC is enabled, the others at the
+    // start of each of the following output cycles of 8 * 54 cycles; the
+    // timer first ends the period of 428 cycles it had since power on
+    CHECK(state.cycleCount >= 16 * 8 * 54);
+    CHECK(state.cycleCount <= 16 * 8 * 54 + 428 + 17 * 4 + 40);
+    // DMC IRQ, the sample is over and the frame IRQ inhibited
+    uint8_t readStatus[]{0xAD, 0x15, 0x40};
+    CHECK(testDebugger.ExecuteInstrFromArray(readStatus, sizeof(readStatus)).A == 0x80);
+}
+
+TEST_CASE("Turbo audio runs games exactly as full audio")
+{
+    std::filesystem::path rom = WriteTestROM(AUDIO_PROGRAM, "nespp_apu.nes", {}, 0x8000, AUDIO_IRQ);
+    Emulator fullEmulator, turboEmulator;
+    Debugger fullDebugger(fullEmulator), turboDebugger(turboEmulator);
+    REQUIRE(fullDebugger.LoadROM(rom.string()));
+    REQUIRE(turboDebugger.LoadROM(rom.string()));
+    std::filesystem::remove(rom);
+    turboEmulator.SetAudioMode(APU::TURBO);
+
+    for (int frame = 0; frame < 10; frame++)
+    {
+        fullEmulator.RunFrame();
+        turboEmulator.RunFrame();
+        CHECK(fullDebugger.GetMemoryHash() == turboDebugger.GetMemoryHash());
+        CHECK(fullDebugger.GetCpuState().PC == turboDebugger.GetCpuState().PC);
+        CHECK(fullDebugger.GetClock().GetCpuCycles() == turboDebugger.GetClock().GetCpuCycles());
+        // 48000 samples per second at about 60.1 frames per second
+        CHECK(fullEmulator.GetAudioSamples().size() >= 798);
+        CHECK(fullEmulator.GetAudioSamples().size() <= 800);
+        CHECK(turboEmulator.GetAudioSamples().empty());
+    }
+    // Frame and DMC IRQs
+    CHECK(turboDebugger.GetMemoryState()[0x11] >= 30);
+    const std::vector<int16_t>& samples = fullEmulator.GetAudioSamples();
+    CHECK(*std::max_element(samples.begin(), samples.end()) > *std::min_element(samples.begin(), samples.end()));
+}
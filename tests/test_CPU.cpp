@@ -1,6 +1,9 @@
 #include "NESpp/Debugger.h"
 #include "NESpp/Emulator.h"
+#include "TestROM.h"
 #include "doctest/doctest.h"
+#include <filesystem>
+#include <vector>
 
 /*
  * Testing all unique instructions, the addressing
@@ -80,6 +83,17 @@ TEST_CASE("CPU executes all instructions correctly")
             CHECK(state.PS.Test<CPU::C>() == 0);
             CHECK(state.PS.Test<CPU::V>() == 1);
         }
+        SUBCASE("Add with carry set wraps to zero")
+        {
+            // SEC ; ADC #$FF
+            uint8_t instructions[]{0x38, 0x69, 0xFF};
+            Debugger::CpuState state = testDebugger.ExecuteInstrFromArray(instructions, 3);
+            CHECK(state.A == 0x00);
+            CHECK(state.cycleCount == 4);
+            CHECK(state.PS.Test<CPU::C>() == 1);
+            CHECK(state.PS.Test<CPU::Z>() == 1);
+            CHECK(state.PS.Test<CPU::V>() == 0);
+        }
     }
 
     SUBCASE("AND")
@@ -313,6 +327,15 @@ TEST_CASE("CPU executes all instructions correctly")
             CHECK(state.cycleCount == 4);
             CHECK(state.PC == 0x0700 + 4);
         }
+        SUBCASE("Taken backwards")
+        {
+            // LDX #$03 ; DEX ; BNE -3
+            uint8_t instructions[]{0xA2, 0x03, 0xCA, 0xD0, 0xFD};
+            Debugger::CpuState state = testDebugger.ExecuteInstrFromArray(instructions, 5);
+            CHECK(state.cycleCount == 16);
+            CHECK(state.PC == 0x0700 + 5);
+            CHECK(state.X == 0x00);
+        }
     }
 
     SUBCASE("BPL")
@@ -1099,6 +1122,17 @@ TEST_CASE("CPU executes all instructions correctly")
             CHECK(state.PS.Test<CPU::C>() == 0);
             CHECK(state.PS.Test<CPU::V>() == 1);
         }
+        SUBCASE("Subtract zero with carry set")
+        {
+            // SEC ; SBC #$00, the sum with the complement carries out of bit 8
+            uint8_t instructions[]{0x38, 0xE9, 0x00};
+            Debugger::CpuState state = testDebugger.ExecuteInstrFromArray(instructions, 3);
+            CHECK(state.A == 0x00);
+            CHECK(state.cycleCount == 4);
+            CHECK(state.PS.Test<CPU::C>() == 1);
+            CHECK(state.PS.Test<CPU::Z>() == 1);
+            CHECK(state.PS.Test<CPU::V>() == 0);
+        }
     }
 
     SUBCASE("SEC")
@@ -1327,3 +1361,242 @@ TEST_CASE("CPU executes all instructions correctly")
         CHECK(state.PS.Test<CPU::N>() == 0);
     }
 }
+
+TEST_CASE("Block cache executes programs like the interpreter")
+{
+    // LDX #$03 ; JSR $0710 ; DEX ; BNE -6 ; BRK
+    // $0710: INY ; STY $10 ; RTS
+    uint8_t loop[0x14]{0xA2, 0x03, 0x20, 0x10, 0x07, 0xCA, 0xD0, 0xFA, 0x00};
+    uint8_t subroutine[]{0xC8, 0x84, 0x10, 0x60};
+    std::memcpy(loop + 0x10, subroutine, sizeof(subroutine));
+
+    // LDX #$05 ; LDA #$E8 ; STA $0708 ; NOP ; NOP (becomes INX)
+    uint8_t selfModifying[]{0xA2, 0x05, 0xA9, 0xE8, 0x8D, 0x08, 0x07, 0xEA, 0xEA};
+
+    auto run = [](const uint8_t* instructions, size_t number, bool cached) {
+        Emulator emulator;
+        Debugger debugger(emulator);
+        debugger.EnableBlockCache(cached);
+        // Run twice so that the second run goes through cached blocks
+        debugger.ExecuteInstrFromArray(instructions, number);
+        Debugger::CpuState state = debugger.ExecuteInstrFromArray(instructions, number);
+        return std::make_pair(state, debugger.GetMemoryState());
+    };
+
+    SUBCASE("Branches and subroutines")
+    {
+        auto [expected, expectedMemory] = run(loop, sizeof(loop), false);
+        auto [state, memory] = run(loop, sizeof(loop), true);
+        CHECK(state.PC == expected.PC);
+        CHECK(state.cycleCount == expected.cycleCount);
+        CHECK(state.X == expected.X);
+        CHECK(state.Y == expected.Y);
+        CHECK(state.SP == expected.SP);
+        CHECK(state.PS.value == expected.PS.value);
+        CHECK(memory == expectedMemory);
+    }
+
+    SUBCASE("Self modifying code")
+    {
+        auto [expected, expectedMemory] = run(selfModifying, sizeof(selfModifying), false);
+        auto [state, memory] = run(selfModifying, sizeof(selfModifying), true);
+        CHECK(expected.X == 0x06);
+        CHECK(state.X == 0x06);
+        CHECK(state.cycleCount == expected.cycleCount);
+        CHECK(memory == expectedMemory);
+    }
+
+    SUBCASE("Hot loop in PRG ROM")
+    {
+        // Register only instructions, compiled when built with the JIT
+        std::filesystem::path rom = WriteTestROM({
+            0xA2, 0x00, // 8000: LDX #$00
+            0xA0, 0x00, // 8002: LDY #$00
+            0x8A,       // 8004: TXA
+            0x18,       // 8005: CLC
+            0x69, 0x07, // 8006: ADC #$07
+            0x2A,       // 8008: ROL A
+            0x49, 0x5A, // 8009: EOR #$5A
+            0xAA,       // 800B: TAX
+            0xE9, 0x13, // 800C: SBC #$13
+            0xC9, 0x80, // 800E: CMP #$80
+            0x6A,       // 8010: ROR A
+            0x4A,       // 8011: LSR A
+            0x0A,       // 8012: ASL A
+            0xE0, 0x40, // 8013: CPX #$40
+            0xC0, 0x10, // 8015: CPY #$10
+            0x88,       // 8017: DEY
+            0xD0, 0xEA, // 8018: BNE $8004
+            0x00,       // 801A: BRK
+        });
+        auto runROM = [&rom](bool cached) {
+            Emulator emulator;
+            Debugger debugger(emulator);
+            debugger.EnableBlockCache(cached);
+            debugger.LoadROM(rom.string());
+            debugger.Continue();
+            return debugger.GetCpuState();
+        };
+        Debugger::CpuState expected = runROM(false);
+        Debugger::CpuState state = runROM(true);
+        std::filesystem::remove(rom);
+        CHECK(expected.PC == 0x801C);
+        CHECK(state.PC == expected.PC);
+        CHECK(state.cycleCount == expected.cycleCount);
+        CHECK(state.A == expected.A);
+        CHECK(state.X == expected.X);
+        CHECK(state.Y == expected.Y);
+        CHECK(state.SP == expected.SP);
+        CHECK(state.PS.value == expected.PS.value);
+    }
+
+    // The handlers save the return address pushed by the interrupt to $20
+    // and stop on BRK, so the interrupts must be taken after the same instruction
+    auto runInterrupted = [](const std::filesystem::path& rom, bool cached) {
+        Emulator emulator;
+        Debugger debugger(emulator);
+        debugger.EnableBlockCache(cached);
+        debugger.LoadROM(rom.string());
+        debugger.Continue();
+        return std::make_pair(debugger.GetCpuState(), debugger.GetMemoryState());
+    };
+    const std::vector<uint8_t> saveReturnAddress{
+        0xBA,             // TSX
+        0xBD, 0x02, 0x01, // LDA $0102,X
+        0x85, 0x20,       // STA $20
+        0xBD, 0x03, 0x01, // LDA $0103,X
+        0x85, 0x21,       // STA $21
+        0x00,             // BRK
+    };
+
+    SUBCASE("NMI during compiled code")
+    {
+        std::vector<uint8_t> program{
+            0xA9, 0x80,       // 8000: LDA #$80
+            0x8D, 0x00, 0x20, // 8002: STA $2000
+        };
+        program.insert(program.end(), 30, 0xEA);           // 8005: NOP x30
+        program.insert(program.end(), {0x4C, 0x05, 0x80}); // 8023: JMP $8005
+        program.insert(program.end(), saveReturnAddress.begin(), saveReturnAddress.end());
+        std::filesystem::path rom = WriteTestROM(program, "nespp_test.nes", {}, 0x8026);
+        auto [expected, expectedMemory] = runInterrupted(rom, false);
+        auto [state, memory] = runInterrupted(rom, true);
+        std::filesystem::remove(rom);
+        CHECK(expectedMemory[0x21] == 0x80);
+        CHECK(memory[0x20] == expectedMemory[0x20]);
+        CHECK(memory[0x21] == expectedMemory[0x21]);
+        CHECK(state.PC == expected.PC);
+        CHECK(state.cycleCount == expected.cycleCount);
+    }
+
+    SUBCASE("APU frame IRQ after compiled CLI")
+    {
+        std::vector<uint8_t> program{
+            0x78,             // 8000: SEI
+            0xA9, 0x00,       // 8001: LDA #$00
+            0x8D, 0x17, 0x40, // 8003: STA $4017
+            0x78,             // 8006: SEI
+        };
+        program.insert(program.end(), 10, 0xEA);           // 8007: NOP x10
+        program.push_back(0x58);                           // 8011: CLI
+        program.insert(program.end(), 10, 0xEA);           // 8012: NOP x10
+        program.insert(program.end(), {0x4C, 0x06, 0x80}); // 801C: JMP $8006
+        program.insert(program.end(), saveReturnAddress.begin(), saveReturnAddress.end());
+        std::filesystem::path rom = WriteTestROM(program, "nespp_test.nes", {}, 0x8000, 0x801F);
+        auto [expected, expectedMemory] = runInterrupted(rom, false);
+        auto [state, memory] = runInterrupted(rom, true);
+        std::filesystem::remove(rom);
+        CHECK(expectedMemory[0x21] == 0x80);
+        CHECK(memory[0x20] == expectedMemory[0x20]);
+        CHECK(memory[0x21] == expectedMemory[0x21]);
+        CHECK(state.PC == expected.PC);
+        CHECK(state.cycleCount == expected.cycleCount);
+    }
+}
+
+TEST_CASE("The fast accuracy profile executes programs like the exact one")
+{
+    // Every read-modify-write instruction on the zero page and on RAM,
+    // then INC on PPUCTRL, whose dummy write is kept
+    std::vector<uint8_t> program{0xA2, 0x03, 0xA9, 0x81, 0x85, 0x10, 0x95, 0x10, 0x8D, 0x00, 0x03, 0x9D, 0x00, 0x03};
+    for (uint8_t opcode : {0x06, 0x16, 0x0E, 0x1E, 0xC6, 0xD6, 0xCE, 0xDE, 0xE6, 0xF6, 0xEE, 0xFE,
+                           0x46, 0x56, 0x4E, 0x5E, 0x26, 0x36, 0x2E, 0x3E, 0x66, 0x76, 0x6E, 0x7E})
+    {
+        bool zeroPage = (opcode & 0x08) == 0;
+        program.insert(program.end(), {opcode, (uint8_t)(zeroPage ? 0x10 : 0x00)});
+        if (!zeroPage)
+        {
+            program.push_back(0x03);
+        }
+    }
+    program.insert(program.end(), {0xEE, 0x00, 0x20});
+
+    auto run = [&program](CPU::AccuracyProfile profile, bool cached) {
+        Emulator emulator;
+        Debugger debugger(emulator);
+        debugger.EnableBlockCache(cached);
+        debugger.SetAccuracyProfile(profile);
+        debugger.ExecuteInstrFromArray(program.data(), program.size());
+        Debugger::CpuState state = debugger.ExecuteInstrFromArray(program.data(), program.size());
+        return std::make_pair(state, debugger.GetMemoryState());
+    };
+    auto [expected, expectedMemory] = run(CPU::EXACT, false);
+    for (bool cached : {false, true})
+    {
+        auto [state, memory] = run(CPU::FAST, cached);
+        CHECK(state.cycleCount == expected.cycleCount);
+        CHECK(state.A == expected.A);
+        CHECK(state.X == expected.X);
+        CHECK(state.PS.value == expected.PS.value);
+        CHECK(memory == expectedMemory);
+    }
+
+    SUBCASE("Only the dummy writes to RAM are skipped")
+    {
+        Emulator emulator;
+        Debugger debugger(emulator);
+        // LDA #$41 ; STA $10 ; INC $10 ; INC $2000
+        uint8_t instructions[]{0xA9, 0x41, 0x85, 0x10, 0xE6, 0x10, 0xEE, 0x00, 0x20};
+        debugger.LoadInstrFromArray(instructions, sizeof(instructions));
+        debugger.AddBreakpoint(Breakpoints::WRITE, 0x0010);
+        debugger.AddBreakpoint(Breakpoints::WRITE, 0x2000);
+
+        // The exact profile writes the value read back first
+        debugger.SetPC(0x0700);
+        REQUIRE(debugger.Continue());
+        REQUIRE(debugger.Continue());
+        CHECK(debugger.GetLastBreakpointHit().value == 0x41);
+
+        debugger.SetAccuracyProfile(CPU::FAST);
+        debugger.SetPC(0x0700);
+        REQUIRE(debugger.Continue());
+        REQUIRE(debugger.Continue());
+        CHECK(debugger.GetLastBreakpointHit().address == 0x0010);
+        CHECK(debugger.GetLastBreakpointHit().value == 0x42);
+        // PPUCTRL reads as open bus, 0 at power on
+        REQUIRE(debugger.Continue());
+        CHECK(debugger.GetLastBreakpointHit().address == 0x2000);
+        CHECK(debugger.GetLastBreakpointHit().value == 0x00);
+    }
+
+#ifdef NESPP_INSTRUMENTATION
+    SUBCASE("Skipped writes are still counted")
+    {
+        // Also INC $8000, whose dummy write NROM ignores
+        program.insert(program.end(), {0xEE, 0x00, 0x80});
+        auto count = [&program](CPU::AccuracyProfile profile) {
+            Emulator emulator;
+            Debugger debugger(emulator);
+            debugger.SetAccuracyProfile(profile);
+            return debugger.ExecuteInstrumented(program.data(), program.size()).bus;
+        };
+        BusCounters expectedCounters = count(CPU::EXACT);
+        BusCounters counters = count(CPU::FAST);
+        CHECK(expectedCounters.mapperWrites == 2);
+        CHECK(counters.mapperWrites == expectedCounters.mapperWrites);
+        CHECK(counters.reads == expectedCounters.reads);
+        CHECK(counters.writes == expectedCounters.writes);
+        CHECK(counters.instructions == expectedCounters.instructions);
+    }
+#endif
+}
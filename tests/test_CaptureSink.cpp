@@ -0,0 +1,139 @@
+#include "NESpp/CaptureSink.h"
+#include "NESpp/Emulator.h"
+#include "TestROM.h"
+#include "doctest/doctest.h"
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace
+{
+const size_t Y4M_FRAME_SIZE = 6 + FRAME_WIDTH * FRAME_HEIGHT * 3;
+
+std::vector<uint8_t> ReadFile(const std::filesystem::path& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+uint32_t ReadValue(const std::vector<uint8_t>& data, size_t offset)
+{
+    return data[offset] | (data[offset + 1] << 8) | (data[offset + 2] << 16) | (data[offset + 3] << 24);
+}
+
+// Bytes of the file after the stream header
+size_t GetFramesSize(const std::vector<uint8_t>& video)
+{
+    auto header = std::find(video.begin(), video.end(), '\n');
+    return video.end() - header - 1;
+}
+} // namespace
+
+TEST_CASE("Frames and samples are written to Y4M and WAV files")
+{
+    std::filesystem::path videoPath = std::filesystem::temp_directory_path() / "nespp_capture.y4m";
+    std::filesystem::path audioPath = std::filesystem::temp_directory_path() / "nespp_capture.wav";
+    CaptureSink sink(videoPath, audioPath, MasterClock::NTSC, CaptureSink::BLOCK);
+
+    FrameBuffer black, white;
+    black.fill(0x0F);
+    white.fill(0x30);
+    std::vector<int16_t> samples(800, 0x1234);
+    CHECK(sink.Push(black, samples));
+    CHECK(sink.Push(white, {}));
+    sink.Close();
+    CHECK(sink.GetStats().framesWritten == 2);
+    CHECK(sink.GetStats().samplesWritten == 800);
+
+    std::vector<uint8_t> video = ReadFile(videoPath);
+    std::string header(video.begin(), std::find(video.begin(), video.end(), '\n'));
+    CHECK(header == "YUV4MPEG2 W256 H240 F30049239:500000 Ip A8:7 C444");
+    REQUIRE(GetFramesSize(video) == 2 * Y4M_FRAME_SIZE);
+    const uint8_t* frames = video.data() + header.size() + 1;
+    CHECK(std::string(frames, frames + 6) == "FRAME\n");
+    // Black and white in limited range: Y from 16 to 235, neutral chroma
+    CHECK(frames[6] == 16);
+    CHECK(frames[6 + FRAME_WIDTH * FRAME_HEIGHT] == 128);
+    CHECK(frames[Y4M_FRAME_SIZE + 6] >= 234);
+
+    std::vector<uint8_t> audio = ReadFile(audioPath);
+    REQUIRE(audio.size() == 44 + 1600);
+    CHECK(std::string(audio.begin(), audio.begin() + 4) == "RIFF");
+    CHECK(ReadValue(audio, 4) == 36 + 1600);
+    CHECK(ReadValue(audio, 24) == APU::SAMPLE_RATE);
+    CHECK(ReadValue(audio, 40) == 1600);
+    CHECK(audio[44] == 0x34);
+    CHECK(audio[45] == 0x12);
+    std::filesystem::remove(videoPath);
+    std::filesystem::remove(audioPath);
+}
+
+TEST_CASE("The emulator pushes every frame to the capture sink")
+{
+    std::filesystem::path rom = WriteTestROM({0x4C, 0x00, 0x80});
+    std::filesystem::path audioPath = std::filesystem::temp_directory_path() / "nespp_capture_emulator.wav";
+    Emulator testEmulator;
+    REQUIRE(testEmulator.LoadGame(rom.string()));
+    std::filesystem::remove(rom);
+    CaptureSink sink("", audioPath, MasterClock::NTSC, CaptureSink::BLOCK);
+    testEmulator.SetCaptureSink(&sink);
+
+    size_t samples = 0;
+    for (int frame = 0; frame < 3; frame++)
+    {
+        testEmulator.RunFrame();
+        samples += testEmulator.GetAudioSamples().size();
+    }
+    testEmulator.SetCaptureSink(nullptr);
+    testEmulator.RunFrame();
+    sink.Close();
+    CHECK(sink.GetStats().framesPushed == 3);
+    CHECK(sink.GetStats().samplesWritten == samples);
+    CHECK(ReadFile(audioPath).size() == 44 + samples * 2);
+    std::filesystem::remove(audioPath);
+}
+
+TEST_CASE("Frames are dropped when the queue is full")
+{
+    std::filesystem::path videoPath = std::filesystem::temp_directory_path() / "nespp_capture_drop.y4m";
+    FrameBuffer frame{};
+    const size_t FRAMES = 100;
+
+    SUBCASE("Blocking loses nothing")
+    {
+        CaptureSink sink(videoPath, "", MasterClock::NTSC, CaptureSink::BLOCK, 1);
+        for (size_t i = 0; i < FRAMES; i++)
+        {
+            CHECK(sink.Push(frame, {}));
+        }
+        sink.Close();
+        CHECK(sink.GetStats().framesDropped == 0);
+        CHECK(GetFramesSize(ReadFile(videoPath)) == FRAMES * Y4M_FRAME_SIZE);
+    }
+
+    for (CaptureSink::Policy policy : {CaptureSink::DROP_NEWEST, CaptureSink::DROP_OLDEST})
+    {
+        CaptureSink sink(videoPath, "", MasterClock::NTSC, policy, 1);
+        size_t accepted = 0;
+        for (size_t i = 0; i < FRAMES; i++)
+        {
+            accepted += sink.Push(frame, {});
+        }
+        sink.Close();
+        CaptureSink::Stats stats = sink.GetStats();
+        CHECK(stats.framesPushed == FRAMES);
+        CHECK(stats.framesWritten + stats.framesDropped == FRAMES);
+        CHECK(GetFramesSize(ReadFile(videoPath)) == stats.framesWritten * Y4M_FRAME_SIZE);
+        if (policy == CaptureSink::DROP_NEWEST)
+        {
+            CHECK(accepted == stats.framesWritten);
+        }
+    }
+    std::filesystem::remove(videoPath);
+}
+
+TEST_CASE("Capture files that can't be created are reported")
+{
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "nespp_missing" / "capture.y4m";
+    CHECK_THROWS_AS(CaptureSink(path, ""), std::runtime_error);
+}
@@ -0,0 +1,75 @@
+#include "Cartridge.h"
+#include "TestROM.h"
+#include "doctest/doctest.h"
+
+namespace
+{
+// Pixel of a tile row decoded from the two bit planes, one bit at a time
+uint8_t DecodePixel(const Cartridge& cart, uint16_t address, int x)
+{
+    uint8_t low = cart.ReadFromCHR(address);
+    uint8_t high = cart.ReadFromCHR(address + 8);
+    return ((low >> (7 - x)) & 1) | (((high >> (7 - x)) & 1) << 1);
+}
+} // namespace
+
+TEST_CASE("The tiles of CHR ROM are decoded when it is loaded")
+{
+    std::vector<uint8_t> patterns(8192);
+    for (size_t i = 0; i < patterns.size(); i++)
+    {
+        patterns[i] = (i * 37) ^ (i >> 5);
+    }
+    std::filesystem::path rom = WriteTestROM({}, "nespp_chr.nes", patterns);
+    Cartridge cart;
+    cart.LoadFile(rom);
+    std::filesystem::remove(rom);
+    REQUIRE(cart.IsValid());
+
+    bool decoded = true;
+    for (uint16_t tile = 0; tile < 512; tile++)
+    {
+        for (uint16_t row = 0; row < 8; row++)
+        {
+            uint16_t address = tile * 16 + row;
+            for (int x = 0; x < 8; x++)
+            {
+                decoded &= cart.GetTileRow(address)[x] == DecodePixel(cart, address, x);
+            }
+        }
+    }
+    CHECK(decoded);
+    // Writes to CHR ROM are ignored
+    cart.WriteToCHR(0x0000, ~patterns[0]);
+    CHECK(cart.ReadFromCHR(0x0000) == patterns[0]);
+}
+
+TEST_CASE("Rows written to CHR RAM are decoded again")
+{
+    // Header without CHR ROM banks
+    uint8_t header[16]{0x4E, 0x45, 0x53, 0x1A, 1, 0};
+    std::vector<uint8_t> PRG(16384, 0x00);
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "nespp_chr_ram.nes";
+    {
+        std::ofstream rom(path, std::ios::binary);
+        rom.write(reinterpret_cast<const char*>(header), sizeof(header));
+        rom.write(reinterpret_cast<const char*>(PRG.data()), PRG.size());
+    }
+    Cartridge cart;
+    cart.LoadFile(path);
+    std::filesystem::remove(path);
+    REQUIRE(cart.IsValid());
+    CHECK(cart.GetTileRow(0x1234)[0] == 0);
+
+    // Row 3 of tile 0x23 in the second pattern table: low plane, then high plane
+    cart.WriteToCHR(0x1233, 0xF0);
+    const uint8_t lowOnly[]{1, 1, 1, 1, 0, 0, 0, 0};
+    CHECK(std::equal(lowOnly, lowOnly + 8, cart.GetTileRow(0x1233)));
+    cart.WriteToCHR(0x123B, 0x3C);
+    const uint8_t bothPlanes[]{1, 1, 3, 3, 2, 2, 0, 0};
+    CHECK(std::equal(bothPlanes, bothPlanes + 8, cart.GetTileRow(0x1233)));
+    CHECK(cart.ReadFromCHR(0x123B) == 0x3C);
+    // The other rows are unchanged
+    CHECK(cart.GetTileRow(0x1232)[0] == 0);
+    CHECK(cart.GetTileRow(0x1234)[0] == 0);
+}
@@ -0,0 +1,426 @@
+#include "NESpp/Debugger.h"
+#include "NESpp/Emulator.h"
+#include "TestROM.h"
+#include "doctest/doctest.h"
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+TEST_CASE("Debugger stops on breakpoints and watchpoints")
+{
+    Emulator testEmulator;
+    Debugger testDebugger(testEmulator);
+
+    SUBCASE("Execution breakpoint")
+    {
+        // LDA #$01 ; LDX #$02 ; LDY #$03
+        uint8_t instructions[]{0xA9, 0x01, 0xA2, 0x02, 0xA0, 0x03};
+        testDebugger.LoadInstrFromArray(instructions, 6);
+        testDebugger.SetPC(0x0700);
+        testDebugger.AddBreakpoint(Breakpoints::EXECUTE, 0x0702);
+        CHECK(testDebugger.Continue() == true);
+        Debugger::CpuState state = testDebugger.GetCpuState();
+        CHECK(state.PC == 0x0702);
+        CHECK(state.A == 0x01);
+        CHECK(state.X == 0x00);
+        CHECK(testDebugger.GetLastBreakpointHit().type == Breakpoints::EXECUTE);
+
+        // Resuming executes the instruction under the breakpoint
+        // and then runs until the illegal opcode after the program
+        CHECK(testDebugger.Continue() == false);
+        state = testDebugger.GetCpuState();
+        CHECK(state.X == 0x02);
+        CHECK(state.Y == 0x03);
+    }
+
+    SUBCASE("Write watchpoint")
+    {
+        // LDA #$05 ; STA $10 ; LDA #$06
+        uint8_t instructions[]{0xA9, 0x05, 0x85, 0x10, 0xA9, 0x06};
+        testDebugger.LoadInstrFromArray(instructions, 6);
+        testDebugger.SetPC(0x0700);
+        int id = testDebugger.AddBreakpoint(Breakpoints::WRITE, 0x0010);
+        CHECK(testDebugger.Continue() == true);
+        Breakpoints::Hit hit = testDebugger.GetLastBreakpointHit();
+        CHECK(hit.id == id);
+        CHECK(hit.type == Breakpoints::WRITE);
+        CHECK(hit.address == 0x0010);
+        CHECK(hit.value == 0x05);
+        CHECK(testDebugger.GetCpuState().PC == 0x0704);
+    }
+
+    SUBCASE("Range read breakpoint")
+    {
+        // LDA $0240 ; LDA $0305 ; LDA #$06
+        uint8_t instructions[]{0xAD, 0x40, 0x02, 0xAD, 0x05, 0x03, 0xA9, 0x06};
+        testDebugger.LoadInstrFromArray(instructions, 8);
+        testDebugger.SetPC(0x0700);
+        testDebugger.AddBreakpoint(Breakpoints::READ, 0x0300, 0x03FF);
+        CHECK(testDebugger.Continue() == true);
+        CHECK(testDebugger.GetLastBreakpointHit().address == 0x0305);
+        CHECK(testDebugger.GetCpuState().PC == 0x0706);
+    }
+
+    SUBCASE("Conditional watchpoint")
+    {
+        // LDX #$01 ; STX $20 ; LDX #$04 ; LDA #$10 ; STX $20 ; LDA #$00
+        uint8_t instructions[]{0xA2, 0x01, 0x86, 0x20, 0xA2, 0x04, 0xA9, 0x10, 0x86, 0x20, 0xA9, 0x00};
+        testDebugger.LoadInstrFromArray(instructions, 12);
+        testDebugger.SetPC(0x0700);
+        testDebugger.AddBreakpoint(Breakpoints::WRITE, 0x0020, "A==0x10 && X>3");
+        CHECK(testDebugger.Continue() == true);
+        CHECK(testDebugger.GetLastBreakpointHit().value == 0x04);
+        CHECK(testDebugger.GetCpuState().PC == 0x070A);
+    }
+
+    SUBCASE("Removed breakpoints do not trigger")
+    {
+        // LDA #$05 ; STA $10 ; LDA #$06
+        uint8_t instructions[]{0xA9, 0x05, 0x85, 0x10, 0xA9, 0x06};
+        testDebugger.LoadInstrFromArray(instructions, 6);
+        testDebugger.SetPC(0x0700);
+        int id = testDebugger.AddBreakpoint(Breakpoints::WRITE | Breakpoints::READ, 0x0010);
+        CHECK(testDebugger.RemoveBreakpoint(id) == true);
+        CHECK(testDebugger.RemoveBreakpoint(id) == false);
+        CHECK(testDebugger.Continue() == false);
+        CHECK(testDebugger.GetCpuState().A == 0x06);
+    }
+
+    SUBCASE("Malformed conditions are rejected")
+    {
+        CHECK_THROWS_AS(testDebugger.AddBreakpoint(Breakpoints::READ, 0x0010, "A=="), std::invalid_argument);
+        CHECK_THROWS_AS(testDebugger.AddBreakpoint(Breakpoints::READ, 0x0010, "(A==1"), std::invalid_argument);
+        CHECK_THROWS_AS(testDebugger.AddBreakpoint(Breakpoints::READ, 0x0010, "Q>1"), std::invalid_argument);
+        CHECK_THROWS_AS(testDebugger.AddBreakpoint(Breakpoints::READ, 0x0020, 0x0010), std::invalid_argument);
+    }
+}
+
+TEST_CASE("Breakpoint conditions follow C precedence rules")
+{
+    Breakpoints::Context context{0x0700, 0x10, 0x04, 0x00, 0xFD, 0x24, 0x0010, 0x80};
+    CHECK(Breakpoints::Condition("A==0x10 && X>3").Evaluate(context) == true);
+    CHECK(Breakpoints::Condition("A==$10 && X>4").Evaluate(context) == false);
+    CHECK(Breakpoints::Condition("Y==1 || A==16 && X==4").Evaluate(context) == true);
+    CHECK(Breakpoints::Condition("(Y==1 || A==16) && X==5").Evaluate(context) == false);
+    CHECK(Breakpoints::Condition("!(VALUE & 0x80)").Evaluate(context) == false);
+    CHECK(Breakpoints::Condition("PC>=0x0700 && addr<=0x10 && sp==253").Evaluate(context) == true);
+    CHECK(Breakpoints::Condition("").Evaluate(context) == true);
+}
+
+TEST_CASE("Profiler attributes cycles to subroutines")
+{
+    Emulator testEmulator;
+    Debugger testDebugger(testEmulator);
+
+    // $0700: JSR $0710 ; LDA #$01 ; (illegal)
+    // $0710: LDX #$02 ; RTS
+    uint8_t instructions[]{0x20, 0x10, 0x07, 0xA9, 0x01, 0xFF, 0xEA, 0xEA, 0xEA, 0xEA,
+                           0xEA, 0xEA, 0xEA, 0xEA, 0xEA, 0xEA, 0xA2, 0x02, 0x60};
+    testDebugger.LoadInstrFromArray(instructions, 19);
+    testDebugger.SetPC(0x0700);
+    testDebugger.StartProfiling();
+    CHECK(testDebugger.Continue() == false);
+
+    const Profiler* profiler = testDebugger.GetProfiler();
+    REQUIRE(profiler != nullptr);
+    CHECK(profiler->GetTotalInstructions() == 5);
+    CHECK(profiler->GetTotalCycles() == 18);
+    CHECK(profiler->GetCycleCount(0x0700) == 6);
+    CHECK(profiler->GetInstructionCount(0x0710) == 1);
+    CHECK(profiler->GetHotspots(1).size() == 1);
+    CHECK(profiler->GetHotspots(1)[0].cycles == 6);
+
+    std::vector<Profiler::Subroutine> subroutines = profiler->GetSubroutines();
+    REQUIRE(subroutines.size() == 2);
+    CHECK(subroutines[0].address == 0x0700);
+    CHECK(subroutines[0].inclusiveCycles == 18);
+    CHECK(subroutines[0].exclusiveCycles == 10);
+    CHECK(subroutines[1].address == 0x0710);
+    CHECK(subroutines[1].calls == 1);
+    CHECK(subroutines[1].inclusiveCycles == 8);
+    CHECK(subroutines[1].exclusiveCycles == 8);
+
+    std::ostringstream folded;
+    profiler->WriteFoldedStacks(folded);
+    CHECK(folded.str() == "$0700 10\n$0700;$0710 8\n");
+}
+
+TEST_CASE("Profiler gives interrupt handlers their own frame")
+{
+    // Nested subroutines, so that the NMI is mostly taken right after
+    // a JSR or an RTS, the handler counts the NMIs in $10
+    std::filesystem::path rom = WriteTestROM(
+        {
+            0xA2, 0x00,       // 8000: LDX #$00
+            0x86, 0x10,       // 8002: STX $10
+            0xA9, 0x80,       // 8004: LDA #$80
+            0x8D, 0x00, 0x20, // 8006: STA $2000
+            0xA0, 0x20,       // 8009: LDY #$20
+            0x20, 0x16, 0x80, // 800B: loop: JSR $8016
+            0xCA,             // 800E: DEX
+            0xD0, 0xFA,       // 800F: BNE loop
+            0x88,             // 8011: DEY
+            0xD0, 0xF7,       // 8012: BNE loop
+            0x00, 0x00,       // 8014: BRK
+            0x20, 0x1A, 0x80, // 8016: JSR $801A
+            0x60,             // 8019: RTS
+            0x60,             // 801A: RTS
+            0xE6, 0x10,       // 801B: NMI: INC $10
+            0x40,             // 801D: RTI
+        },
+        "nespp_test.nes", {}, 0x801B);
+    Emulator emulator;
+    Debugger debugger(emulator);
+    debugger.LoadROM(rom.string());
+    std::filesystem::remove(rom);
+    debugger.StartProfiling();
+    CHECK(debugger.Continue() == false);
+
+    const Profiler* profiler = debugger.GetProfiler();
+    REQUIRE(profiler != nullptr);
+    uint8_t nmis = debugger.GetMemoryState()[0x10];
+    REQUIRE(nmis >= 3);
+    std::vector<Profiler::Subroutine> subroutines = profiler->GetSubroutines();
+    auto find = [&subroutines](uint16_t address) {
+        auto subroutine = std::find_if(subroutines.begin(), subroutines.end(),
+                                       [address](const Profiler::Subroutine& s) { return s.address == address; });
+        REQUIRE(subroutine != subroutines.end());
+        return *subroutine;
+    };
+    CHECK(find(0x8016).calls == 0x2000);
+    CHECK(find(0x801A).calls == 0x2000);
+    // 7 cycles to take the interrupt, INC and RTI
+    CHECK(find(0x801B).calls == nmis);
+    CHECK(find(0x801B).inclusiveCycles == nmis * (7 + 5 + 6));
+    CHECK(find(0x801B).exclusiveCycles == nmis * (7 + 5 + 6));
+
+    // The interrupts are not counted as instructions
+    uint64_t instructions = 0, cycles = 0;
+    for (uint32_t PC = 0; PC < 0x10000; PC++)
+    {
+        instructions += profiler->GetInstructionCount(PC);
+        cycles += profiler->GetCycleCount(PC);
+    }
+    CHECK(instructions == profiler->GetTotalInstructions());
+    CHECK(cycles + nmis * 7 == profiler->GetTotalCycles());
+}
+
+TEST_CASE("Lockstep mode finds the first divergent instruction")
+{
+    Emulator emulator;
+    Debugger debugger(emulator);
+    Emulator referenceEmulator;
+    Debugger reference(referenceEmulator);
+
+    // LDX #$10 ; loop: LDA $0300,X ; STA $10,X ; DEX ; BNE loop ; BRK
+    uint8_t instructions[]{0xA2, 0x10, 0xBD, 0x00, 0x03, 0x95, 0x10, 0xCA, 0xD0, 0xF8, 0x00};
+    debugger.LoadInstrFromArray(instructions, sizeof(instructions));
+    reference.LoadInstrFromArray(instructions, sizeof(instructions));
+    debugger.SetPC(0x0700);
+    reference.SetPC(0x0700);
+
+    SUBCASE("Same program with the block cache")
+    {
+        debugger.EnableBlockCache(true);
+        Debugger::LockstepResult result = debugger.RunLockstep(reference, 1000);
+        CHECK(result.diverged == false);
+        CHECK(result.instructions == 2 + 4 * 16);
+        CHECK(debugger.GetMemoryHash() == reference.GetMemoryHash());
+    }
+
+    SUBCASE("Different data")
+    {
+        uint8_t data[]{0x55};
+        reference.LoadInstrFromArray(data, 1, 0x0308);
+        Debugger::LockstepResult result = debugger.RunLockstep(reference, 1000);
+        // The RAM is compared after each instruction, not only when it is read
+        CHECK(result.diverged == true);
+        CHECK(result.instructions == 1);
+        CHECK(result.PC == 0x0700);
+        CHECK(result.disassembly.find("LDX") != std::string::npos);
+        CHECK(result.memoryDiverged == true);
+        CHECK(result.address == 0x0308);
+        CHECK(Debugger::FormatLockstepResult(result).find("RAM differs from $0308") != std::string::npos);
+    }
+
+    SUBCASE("Frame granularity")
+    {
+        Debugger::LockstepResult result = debugger.RunLockstep(reference, 1000, Debugger::FRAME);
+        // The program ends before the first frame, compared when BRK is executed
+        CHECK(result.diverged == false);
+        CHECK(result.instructions == 2 + 4 * 16);
+    }
+}
+
+TEST_CASE("Lockstep mode follows compiled code through interrupts")
+{
+    // Register only code, compiled when built with the JIT, interrupted
+    // by the NMI and the APU frame IRQ, which are counted in $10 and $11
+    std::vector<uint8_t> program{
+        0x78,             // 8000: SEI
+        0xA9, 0x80,       // 8001: LDA #$80
+        0x8D, 0x00, 0x20, // 8003: STA $2000
+        0xA9, 0x00,       // 8006: LDA #$00
+        0x8D, 0x17, 0x40, // 8008: STA $4017
+        0x58,             // 800B: CLI
+    };
+    program.insert(program.end(), 12, 0xEA); // 800C: NOP x12
+    program.push_back(0x78);                 // 8018: SEI
+    program.insert(program.end(), 6, 0xEA);  // 8019: NOP x6
+    program.insert(program.end(), {
+        0x58,             // 801F: CLI
+        0xE8,             // 8020: INX
+        0x8A,             // 8021: TXA
+        0x69, 0x03,       // 8022: ADC #$03
+        0x4C, 0x0C, 0x80, // 8024: JMP $800C
+        0xE6, 0x10,       // 8027: NMI: INC $10
+        0x40,             // 8029: RTI
+        0x2C, 0x15, 0x40, // 802A: IRQ: BIT $4015
+        0xE6, 0x11,       // 802D: INC $11
+        0x40,             // 802F: RTI
+    });
+    std::filesystem::path rom = WriteTestROM(program, "nespp_test.nes", {}, 0x8027, 0x802A);
+    Emulator emulator;
+    Debugger debugger(emulator);
+    Emulator referenceEmulator;
+    Debugger reference(referenceEmulator);
+    debugger.EnableBlockCache(true);
+    debugger.LoadROM(rom.string());
+    reference.LoadROM(rom.string());
+    std::filesystem::remove(rom);
+
+    Debugger::LockstepResult result = debugger.RunLockstep(reference, 100000);
+    CHECK(result.diverged == false);
+    CHECK(result.instructions == 100000);
+    CHECK(reference.GetMemoryState()[0x10] >= 3);
+    CHECK(reference.GetMemoryState()[0x11] >= 3);
+}
+
+TEST_CASE("OAM DMA copies a page of memory to the sprite memory")
+{
+    Emulator testEmulator;
+    Debugger testDebugger(testEmulator);
+
+    uint8_t page[256];
+    for (int i = 0; i < 256; i++)
+    {
+        page[i] = 255 - i;
+    }
+    testDebugger.LoadInstrFromArray(page, 256, 0x0300);
+
+    SUBCASE("Write to 0x4014")
+    {
+        // LDA #$03 ; STA $4014
+        uint8_t instructions[]{0xA9, 0x03, 0x8D, 0x14, 0x40};
+        Debugger::CpuState state = testDebugger.ExecuteInstrFromArray(instructions, sizeof(instructions));
+        // The CPU is halted for one more cycle when the DMA starts on an odd cycle
+        uint64_t halted = state.cycleCount - 6;
+        uint64_t dmaStart = testDebugger.GetClock().GetCpuCycles() - halted;
+        CHECK(halted == 513 + (dmaStart & 1));
+        CHECK(std::equal(std::begin(page), std::end(page), testDebugger.GetOAM().begin()));
+    }
+
+    SUBCASE("Memory ranges follow the mirrors and skip IO registers")
+    {
+        uint8_t first[]{0xAA};
+        uint8_t last[]{0xBB};
+        testDebugger.LoadInstrFromArray(first, 1, 0x0000);
+        testDebugger.LoadInstrFromArray(last, 1, 0x07FE);
+        std::vector<uint8_t> memory = testDebugger.GetMemoryRange(0x0FFE, 3);
+        CHECK(memory == std::vector<uint8_t>{0xBB, 0xFF, 0xAA});
+        memory = testDebugger.GetMemoryRange(0x1FFF, 2);
+        CHECK(memory == std::vector<uint8_t>{0xFF, 0x00});
+    }
+}
+
+TEST_CASE("Host performance counters only report the events they could open")
+{
+    PerfCounters counters;
+    counters.Start();
+    volatile uint64_t sum = 0;
+    for (int i = 0; i < 100000; i++)
+    {
+        sum = sum + i;
+    }
+    counters.Stop();
+    PerfCounters::Values values = counters.Read();
+    for (int event = 0; event < PerfCounters::EVENTS; event++)
+    {
+        if (!values.available[event])
+        {
+            CHECK(values.count[event] == 0);
+        }
+    }
+    if (values.available[PerfCounters::TASK_CLOCK])
+    {
+        CHECK(values.count[PerfCounters::TASK_CLOCK] > 0);
+    }
+}
+
+TEST_CASE("Performance reports count the bus accesses")
+{
+    Emulator emulator;
+    Debugger debugger(emulator);
+
+#ifdef NESPP_INSTRUMENTATION
+    SUBCASE("Instructions from RAM")
+    {
+        // LDA $0300 ; STA $2000 ; LDA $4015 ; STA $8000 ; LDA $8000
+        uint8_t instructions[]{0xAD, 0x00, 0x03, 0x8D, 0x00, 0x20, 0xAD, 0x15,
+                               0x40, 0x8D, 0x00, 0x80, 0xAD, 0x00, 0x80};
+        Debugger::PerfReport report = debugger.ExecuteInstrumented(instructions, sizeof(instructions));
+        CHECK(report.busCountersEnabled == true);
+        CHECK(report.emulatedCycles == 5 * 4);
+        CHECK(report.bus.instructions == 5);
+        // Three bytes fetched for each instruction, then $0300
+        CHECK(report.bus.reads[BusCounters::RAM] == 5 * 3 + 1);
+        CHECK(report.bus.writes[BusCounters::RAM] == 0);
+        CHECK(report.bus.writes[BusCounters::PPU] == 1);
+        CHECK(report.bus.reads[BusCounters::APU_IO] == 1);
+        CHECK(report.bus.reads[BusCounters::CARTRIDGE] == 1);
+        CHECK(report.bus.writes[BusCounters::CARTRIDGE] == 1);
+        CHECK(report.bus.mapperWrites == 1);
+
+        std::string text = Debugger::FormatPerfReport(report);
+        CHECK(text.find("Emulated cycles: 20\n") == 0);
+        CHECK(text.find("Emulated instructions: 5\n") != std::string::npos);
+        CHECK(text.find("RAM        reads:           16  writes:            0\n") != std::string::npos);
+        CHECK(text.find("Cartridge  reads:            1  writes:            1\n") != std::string::npos);
+        CHECK(text.find("Mapper writes: 1\n") != std::string::npos);
+    }
+
+    SUBCASE("Whole frames")
+    {
+        // loop: LDA #$00 ; STA $8000 ; JMP loop
+        std::filesystem::path rom = WriteTestROM({0xA9, 0x00, 0x8D, 0x00, 0x80, 0x4C, 0x00, 0x80});
+        REQUIRE(debugger.LoadROM(rom.string()));
+        std::filesystem::remove(rom);
+        emulator.RunFrame();
+        uint64_t frameStart = debugger.GetClock().GetCpuCycles();
+
+        Debugger::PerfReport report = debugger.RunFrameInstrumented(false);
+        CHECK(report.emulatedCycles == debugger.GetClock().GetCpuCycles() - frameStart);
+        // A frame is 29780.5 CPU cycles, the last instruction may run past its end
+        CHECK(report.emulatedCycles >= 29780);
+        CHECK(report.emulatedCycles <= 29785);
+        // 9 cycles and 3 instructions per iteration, which fetch 8 bytes
+        // from the cartridge and write to it once
+        uint64_t iterations = report.bus.mapperWrites;
+        CHECK(iterations >= 29780 / 9 - 1);
+        CHECK(iterations <= 29785 / 9 + 1);
+        CHECK(report.bus.instructions >= 3 * iterations - 2);
+        CHECK(report.bus.instructions <= 3 * iterations + 2);
+        CHECK(report.bus.reads[BusCounters::CARTRIDGE] >= 8 * iterations - 8);
+        CHECK(report.bus.reads[BusCounters::CARTRIDGE] <= 8 * iterations + 8);
+        CHECK(report.bus.reads[BusCounters::RAM] == 0);
+        CHECK(report.bus.writes[BusCounters::RAM] == 0);
+    }
+#else
+    // LDA #$01
+    uint8_t instructions[]{0xA9, 0x01};
+    Debugger::PerfReport report = debugger.ExecuteInstrumented(instructions, sizeof(instructions));
+    CHECK(report.busCountersEnabled == false);
+    CHECK(report.emulatedCycles == 2);
+    CHECK(Debugger::FormatPerfReport(report).find("Bus counters disabled") != std::string::npos);
+#endif
+}
@@ -0,0 +1,92 @@
+#include "NESpp/EmulationThread.h"
+#include "NESpp/Emulator.h"
+#include "doctest/doctest.h"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <thread>
+
+TEST_CASE("Emulation thread paces frames")
+{
+    Emulator emulator;
+    EmulationThread emulation(emulator);
+    std::atomic<uint64_t> frames = 0;
+    emulation.SetFrameCallback([&]() { frames++; });
+
+    auto waitFor = [&](uint64_t count) {
+        for (int i = 0; i < 2000 && frames < count; i++)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    };
+
+    SUBCASE("Display refreshes")
+    {
+        emulation.SetPacing(EmulationThread::VSYNC);
+        emulation.Start();
+        for (int refresh = 0; refresh < 5; refresh++)
+        {
+            emulation.NotifyVSync();
+            waitFor(refresh + 1);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        CHECK(frames == 5);
+
+        // At half speed every other refresh emulates a frame
+        emulation.SetSpeed(0.5);
+        for (int refresh = 0; refresh < 4; refresh++)
+        {
+            emulation.NotifyVSync();
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        waitFor(7);
+        CHECK(frames == 7);
+    }
+
+    SUBCASE("Audio buffer")
+    {
+        emulation.SetPacing(EmulationThread::AUDIO);
+        // Four frames of audio are kept queued
+        emulation.SetAudioLatency(3.5 / 60.0988);
+        emulation.Start();
+        waitFor(4);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        CHECK(frames == 4);
+        emulation.NotifyAudioConsumed(2 / 60.0988);
+        waitFor(6);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        CHECK(frames == 6);
+    }
+
+    SUBCASE("Wall clock and fast forward")
+    {
+        emulation.Start();
+        waitFor(10);
+        emulation.Stop();
+        EmulationThread::Timing timing = emulation.GetTiming();
+        CHECK(timing.frames == frames);
+        CHECK(std::abs(1 / timing.targetPeriod - 60.0988) < 0.001);
+        // Loose bounds, the host may be busy
+        CHECK(timing.meanPeriod > timing.targetPeriod * 0.5);
+        CHECK(timing.meanPeriod < timing.targetPeriod * 2);
+
+        // Uncapped, frames only take the time to emulate them
+        emulation.ResetTiming();
+        emulation.SetFastForward(true);
+        emulation.Start();
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        emulation.Stop();
+        CHECK(emulation.GetTiming().frames > 12);
+    }
+}
+
+TEST_CASE("Emulation speeds must be positive")
+{
+    Emulator emulator;
+    EmulationThread emulation(emulator);
+    CHECK_THROWS_AS(emulation.SetSpeed(0), std::invalid_argument);
+    CHECK_THROWS_AS(emulation.SetSpeed(-1), std::invalid_argument);
+    CHECK_THROWS_AS(emulation.SetSpeed(std::nan("")), std::invalid_argument);
+    CHECK_NOTHROW(emulation.SetSpeed(0.25));
+}
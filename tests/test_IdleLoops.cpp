@@ -0,0 +1,141 @@
+#include "NESpp/Debugger.h"
+#include "NESpp/Emulator.h"
+#include "TestROM.h"
+#include "doctest/doctest.h"
+
+namespace
+{
+/*
+ * Waits for the VBlank polling PPUSTATUS, enables the NMI and waits
+ * for 3 NMIs polling their counter in 0x10, counting them in 0x11,
+ * then stays in a JMP to itself.
+ */
+const std::vector<uint8_t> VBLANK_PROGRAM{
+    0x78,                         // SEI
+    0xA9, 0x00, 0x85, 0x10,       // LDA #0 ; STA $10
+    0x85, 0x11,                   // STA $11
+    0x2C, 0x02, 0x20, 0x10, 0xFB, // wait: BIT $2002 ; BPL wait
+    0xA9, 0x80, 0x8D, 0x00, 0x20, // PPUCTRL: NMI enabled
+    0xA5, 0x10, 0xC5, 0x10,       // frame: LDA $10 ; nmi: CMP $10
+    0xF0, 0xFC, 0xE6, 0x11,       // BEQ nmi ; INC $11
+    0xA5, 0x11, 0xC9, 0x03,       // LDA $11 ; CMP #3
+    0xD0, 0xF2,                   // BNE frame
+    0x4C, 0x1F, 0x80,             // JMP *
+    0xE6, 0x10, 0x40,             // NMI: INC $10 ; RTI
+};
+const uint16_t VBLANK_NMI = 0x8022;
+
+/*
+ * Enables the frame IRQ and the DMC with its IRQ, then waits in a JMP
+ * to itself. The IRQ handler stores the status in 0x10, counts the IRQs
+ * in 0x11 and restarts the sample when it ends.
+ */
+const std::vector<uint8_t> IRQ_PROGRAM{
+    0x78, 0xA2, 0xFF, 0x9A,       // SEI ; LDX #$FF ; TXS
+    0xA9, 0x00, 0x85, 0x11,       // LDA #0 ; STA $11
+    0x8D, 0x17, 0x40,             // frame counter: 4-step, IRQ enabled
+    0xA9, 0x8F, 0x8D, 0x10, 0x40, // DMC: IRQ enabled, fastest rate
+    0xA9, 0x01, 0x8D, 0x13, 0x40, // 17 bytes long sample
+    0xA9, 0x1F, 0x8D, 0x15, 0x40, // all the channels enabled
+    0x58,                         // CLI
+    0x4C, 0x1B, 0x80,             // JMP *
+    0xAD, 0x15, 0x40, 0x85, 0x10, // IRQ: LDA $4015 ; STA $10
+    0x29, 0x80, 0xF0, 0x05,       // AND #$80 ; BEQ count
+    0xA9, 0x1F, 0x8D, 0x15, 0x40, // restart the sample
+    0xE6, 0x11, 0x40,             // count: INC $11 ; RTI
+};
+const uint16_t IRQ_HANDLER = 0x801E;
+
+// Runs the program with and without skipping, comparing everything after each frame
+void CheckSameGame(const std::filesystem::path& rom, int frames, MasterClock::Region region = MasterClock::NTSC)
+{
+    Emulator skippingEmulator, referenceEmulator;
+    Debugger skippingDebugger(skippingEmulator), referenceDebugger(referenceEmulator);
+    REQUIRE(skippingDebugger.LoadROM(rom.string()));
+    REQUIRE(referenceDebugger.LoadROM(rom.string()));
+    skippingDebugger.SetRegion(region);
+    referenceDebugger.SetRegion(region);
+    referenceEmulator.SetIdleLoopSkipping(false);
+
+    for (int frame = 0; frame < frames; frame++)
+    {
+        skippingEmulator.RunFrame();
+        referenceEmulator.RunFrame();
+        Debugger::CpuState skipping = skippingDebugger.GetCpuState();
+        Debugger::CpuState reference = referenceDebugger.GetCpuState();
+        CHECK(skipping.PC == reference.PC);
+        CHECK(skipping.A == reference.A);
+        CHECK(skipping.X == reference.X);
+        CHECK(skipping.Y == reference.Y);
+        CHECK(skipping.SP == reference.SP);
+        CHECK(skipping.cycleCount == reference.cycleCount);
+        CHECK(skippingDebugger.GetMemoryHash() == referenceDebugger.GetMemoryHash());
+        CHECK(skippingEmulator.GetFrameBuffer() == referenceEmulator.GetFrameBuffer());
+        CHECK(skippingEmulator.GetAudioSamples() == referenceEmulator.GetAudioSamples());
+    }
+    CHECK(referenceDebugger.GetSkippedIdleCycles() == 0);
+    // Most of the time is spent waiting
+    CHECK(skippingDebugger.GetSkippedIdleCycles() > frames * CYCLES_PER_FRAME / 2);
+}
+} // namespace
+
+TEST_CASE("Skipping the loops waiting for the VBlank and the NMI doesn't change the game")
+{
+    std::filesystem::path rom = WriteTestROM(VBLANK_PROGRAM, "nespp_idle_vblank.nes", {}, VBLANK_NMI);
+    CheckSameGame(rom, 8);
+    CheckSameGame(rom, 8, MasterClock::PAL);
+
+    Emulator testEmulator;
+    Debugger testDebugger(testEmulator);
+    REQUIRE(testDebugger.LoadROM(rom.string()));
+    std::filesystem::remove(rom);
+    for (int frame = 0; frame < 6; frame++)
+    {
+        testEmulator.RunFrame();
+    }
+    CHECK(testDebugger.GetMemoryState()[0x11] == 3);
+    CHECK(testDebugger.GetMemoryState()[0x10] >= 5);
+}
+
+TEST_CASE("Skipping the loops waiting for APU interrupts doesn't change the game")
+{
+    std::filesystem::path rom = WriteTestROM(IRQ_PROGRAM, "nespp_idle_irq.nes", {}, 0x8000, IRQ_HANDLER);
+    CheckSameGame(rom, 10);
+    std::filesystem::remove(rom);
+}
+
+TEST_CASE("Loops with side effects are never skipped")
+{
+    std::vector<uint8_t> program{
+        0xAD, 0x16, 0x40, // loop: LDA $4016
+        0x4C, 0x00, 0x80, // JMP loop
+        0xE6, 0x10,       // other: INC $10
+        0x4C, 0x06, 0x80, // JMP other
+    };
+    std::filesystem::path rom = WriteTestROM(program, "nespp_idle_busy.nes");
+    Emulator testEmulator;
+    Debugger testDebugger(testEmulator);
+    REQUIRE(testDebugger.LoadROM(rom.string()));
+    std::filesystem::remove(rom);
+    testEmulator.RunFrame();
+    CHECK(testDebugger.GetSkippedIdleCycles() == 0);
+
+    testDebugger.SetPC(0x8006);
+    testEmulator.RunFrame();
+    CHECK(testDebugger.GetSkippedIdleCycles() == 0);
+}
+
+TEST_CASE("Idle loops are not skipped while there are breakpoints")
+{
+    std::filesystem::path rom = WriteTestROM(VBLANK_PROGRAM, "nespp_idle_vblank.nes", {}, VBLANK_NMI);
+    Emulator testEmulator;
+    Debugger testDebugger(testEmulator);
+    REQUIRE(testDebugger.LoadROM(rom.string()));
+    std::filesystem::remove(rom);
+    testDebugger.AddBreakpoint(Breakpoints::WRITE, 0x0700);
+    for (int frame = 0; frame < 3; frame++)
+    {
+        testEmulator.RunFrame();
+    }
+    CHECK(testDebugger.GetSkippedIdleCycles() == 0);
+}
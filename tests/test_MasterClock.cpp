@@ -0,0 +1,65 @@
+#include "MasterClock.h"
+#include "NESpp/Debugger.h"
+#include "NESpp/Emulator.h"
+#include "doctest/doctest.h"
+
+TEST_CASE("Master clock derives all timings from CPU cycles")
+{
+    MasterClock clock;
+
+    SUBCASE("NTSC")
+    {
+        // 341 * 262 dots of 4 master cycles, 12 master cycles per CPU cycle
+        CHECK(clock.GetMasterCyclesPerFrame() == 357368);
+        CHECK(clock.GetFrameStartCycle(1) == 29781);
+        CHECK(clock.GetFrameStartCycle(3) == 89342);
+        for (int i = 0; i < 29780; i++)
+        {
+            clock.Tick();
+        }
+        CHECK(clock.GetFrame() == 0);
+        CHECK(clock.GetScanline() == 261);
+        CHECK(clock.GetDot() == 339);
+        CHECK(clock.GetCyclesUntilFrame(1) == 1);
+        clock.Tick();
+        CHECK(clock.GetFrame() == 1);
+        CHECK(clock.GetScanline() == 0);
+        CHECK(clock.GetDot() == 1);
+        CHECK(clock.GetCyclesUntilFrame(1) == 0);
+    }
+
+    SUBCASE("PAL and Dendy")
+    {
+        clock.SetRegion(MasterClock::PAL);
+        CHECK(clock.GetFrameStartCycle(2) == 66495);
+        clock.SetRegion(MasterClock::DENDY);
+        CHECK(clock.GetFrameStartCycle(1) == 35464);
+    }
+
+    SUBCASE("Changing region keeps the elapsed time")
+    {
+        for (int i = 0; i < 1000; i++)
+        {
+            clock.Tick();
+        }
+        clock.SetRegion(MasterClock::PAL);
+        CHECK(clock.GetMasterCycles() == 12000);
+        clock.Tick();
+        CHECK(clock.GetMasterCycles() == 12016);
+        CHECK(clock.GetCpuCycles() == 1001);
+    }
+
+    SUBCASE("The clock keeps counting across programs")
+    {
+        Emulator emulator;
+        Debugger debugger(emulator);
+        uint8_t instructions[]{0xEA};
+        for (int i = 0; i < 3; i++)
+        {
+            debugger.ExecuteInstrFromArray(instructions, 1);
+        }
+        // Each run resets the CPU (7 cycles) and executes a NOP
+        CHECK(debugger.GetClock().GetCpuCycles() == 3 * (7 + 2));
+        CHECK(debugger.GetClock().GetMasterCycles() == 3 * (7 + 2) * 12);
+    }
+}
@@ -0,0 +1,176 @@
+#include "NESpp/Debugger.h"
+#include "NESpp/Emulator.h"
+#include "NESpp/Movie.h"
+#include "TestROM.h"
+#include "doctest/doctest.h"
+#include <fstream>
+#include <stdexcept>
+
+TEST_CASE("Controllers are read one button at a time")
+{
+    Emulator testEmulator;
+    Debugger testDebugger(testEmulator);
+    testEmulator.SetButtons(0, Controller::A | Controller::START | Controller::RIGHT);
+    testEmulator.SetButtons(1, Controller::B);
+
+    // Strobe ; LDX #$08 ; loop: LDA $4016 ; LSR A ; ROR $10 ; LDA $4017 ; LSR A ; ROR $11 ; DEX ; BNE loop
+    uint8_t instructions[]{0xA9, 0x01, 0x8D, 0x16, 0x40, 0xA9, 0x00, 0x8D, 0x16, 0x40, 0xA2, 0x08, 0xAD, 0x16,
+                           0x40, 0x4A, 0x66, 0x10, 0xAD, 0x17, 0x40, 0x4A, 0x66, 0x11, 0xCA, 0xD0, 0xF1};
+    testDebugger.ExecuteInstrFromArray(instructions, sizeof(instructions));
+    CHECK(testDebugger.GetMemoryState()[0x10] == (Controller::A | Controller::START | Controller::RIGHT));
+    CHECK(testDebugger.GetMemoryState()[0x11] == Controller::B);
+
+    // After all the buttons the register reads 1
+    uint8_t extraRead[]{0xAD, 0x16, 0x40};
+    testDebugger.ExecuteInstrFromArray(extraRead, sizeof(extraRead));
+    CHECK(testDebugger.GetCpuState().A == 0x41);
+}
+
+TEST_CASE("Movies are played back deterministically")
+{
+    // Strobe ; LDX #$08 ; loop: LDA $4016 ; LSR A ; ROR $10 ; DEX ; BNE loop
+    // LDA $10 ; CLC ; ADC $11 ; STA $11 ; JMP $8000
+    std::filesystem::path rom = WriteTestROM({0xA9, 0x01, 0x8D, 0x16, 0x40, 0xA9, 0x00, 0x8D, 0x16, 0x40, 0xA2,
+                                              0x08, 0xAD, 0x16, 0x40, 0x4A, 0x66, 0x10, 0xCA, 0xD0, 0xF7, 0xA5,
+                                              0x10, 0x18, 0x65, 0x11, 0x85, 0x11, 0x4C, 0x00, 0x80});
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "nespp_test.movie";
+    Emulator testEmulator;
+    Debugger testDebugger(testEmulator);
+    REQUIRE(testDebugger.LoadROM(rom.string()));
+
+    Movie recording(testEmulator);
+    recording.StartRecording(1234, 10);
+    for (int frame = 0; frame < 30; frame++)
+    {
+        recording.RecordFrame((frame % 3 == 0) ? Controller::A : Controller::RIGHT | Controller::START);
+    }
+    CHECK(testDebugger.GetMemoryState()[0x10] == (Controller::RIGHT | Controller::START));
+    CHECK(testDebugger.GetClock().GetFrame() == 30);
+    uint64_t hash = testDebugger.GetMemoryHash();
+    recording.Save(path);
+
+    SUBCASE("Playback reaches the same state")
+    {
+        Movie playback(testEmulator);
+        playback.Load(path);
+        CHECK(playback.GetFrameCount() == 30);
+        Movie::PlaybackResult result = playback.Play();
+        CHECK(result.desynced == false);
+        CHECK(result.framesPlayed == 30);
+        CHECK(testDebugger.GetMemoryHash() == hash);
+    }
+
+    SUBCASE("Altered input is detected at the next checkpoint")
+    {
+        // Input of frame 15, after the 33 bytes of header
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(33 + 2 * 15);
+        file.put(Controller::B);
+        file.close();
+
+        Movie playback(testEmulator);
+        playback.Load(path);
+        Movie::PlaybackResult result = playback.Play();
+        CHECK(result.desynced == true);
+        CHECK(result.frame == 20);
+        CHECK(result.framesPlayed == 20);
+    }
+
+    SUBCASE("Movies only play with the game they were recorded with")
+    {
+        std::filesystem::path otherROM = WriteTestROM({0x4C, 0x00, 0x80}, "nespp_other.nes");
+        REQUIRE(testDebugger.LoadROM(otherROM.string()));
+        Movie playback(testEmulator);
+        playback.Load(path);
+        CHECK_THROWS_AS(playback.Play(), std::runtime_error);
+        std::filesystem::remove(otherROM);
+    }
+
+    SUBCASE("Files that aren't movies are rejected")
+    {
+        Movie playback(testEmulator);
+        CHECK_THROWS_AS(playback.Load(rom), std::runtime_error);
+    }
+
+    std::filesystem::remove(path);
+    std::filesystem::remove(rom);
+}
+
+TEST_CASE("Movies start from the power on registers whatever ran before")
+{
+    // TSX ; STX $20 ; STA $21 ; loop: PHA ; CLC ; ADC #1 ; TAX ; TAY ; JMP loop
+    std::filesystem::path rom = WriteTestROM({0xBA, 0x86, 0x20, 0x85, 0x21, 0x48, 0x18, 0x69, 0x01, 0xAA, 0xA8, 0x4C,
+                                              0x05, 0x80},
+                                             "nespp_test_registers.nes");
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "nespp_test_registers.movie";
+    Emulator testEmulator;
+    Debugger testDebugger(testEmulator);
+    REQUIRE(testDebugger.LoadROM(rom.string()));
+    // The registers and the stack are left far from their power on values
+    for (int frame = 0; frame < 3; frame++)
+    {
+        testEmulator.RunFrame();
+    }
+
+    Movie recording(testEmulator);
+    recording.StartRecording(0, 5);
+    for (int frame = 0; frame < 10; frame++)
+    {
+        recording.RecordFrame(0);
+    }
+    CHECK(testDebugger.GetMemoryState()[0x20] == 0xFD);
+    CHECK(testDebugger.GetMemoryState()[0x21] == 0x00);
+    recording.Save(path);
+
+    // Played on the same emulator, which has kept running
+    Movie playback(testEmulator);
+    playback.Load(path);
+    Movie::PlaybackResult result = playback.Play();
+    CHECK(result.desynced == false);
+    CHECK(result.framesPlayed == 10);
+    CHECK(testDebugger.GetMemoryState()[0x20] == 0xFD);
+    std::filesystem::remove(path);
+    std::filesystem::remove(rom);
+}
+
+TEST_CASE("Movies detect desyncs that only show on screen")
+{
+    // Palette: 0x0F, 0x30 ; shows the background ; loop: JMP loop
+    std::vector<uint8_t> program{0xA9, 0x3F, 0x8D, 0x06, 0x20, 0xA9, 0x00, 0x8D, 0x06, 0x20, 0xA9, 0x0F,
+                                 0x8D, 0x07, 0x20, 0xA9, 0x30, 0x8D, 0x07, 0x20, 0xA9, 0x0A, 0x8D, 0x01,
+                                 0x20, 0x4C, 0x19, 0x80};
+    // Same PRG ROM, the top row of tile 0 differs
+    std::filesystem::path rom = WriteTestROM(program, "nespp_test_picture.nes", {0xFF});
+    std::filesystem::path otherROM = WriteTestROM(program, "nespp_test_other_picture.nes");
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "nespp_test_picture.movie";
+    Emulator testEmulator;
+    Debugger testDebugger(testEmulator);
+    REQUIRE(testDebugger.LoadROM(rom.string()));
+
+    Movie recording(testEmulator);
+    recording.StartRecording(0, 5);
+    for (int frame = 0; frame < 10; frame++)
+    {
+        recording.RecordFrame(0);
+    }
+    recording.Save(path);
+    uint64_t hash = testDebugger.GetMemoryHash();
+
+    // Only the frames of the checkpoints are drawn during playback
+    Movie playback(testEmulator);
+    playback.Load(path);
+    CHECK(playback.Play().desynced == false);
+
+    REQUIRE(testDebugger.LoadROM(otherROM.string()));
+    Movie other(testEmulator);
+    other.Load(path);
+    Movie::PlaybackResult result = other.Play();
+    CHECK(result.desynced == true);
+    CHECK(result.frame == 5);
+    // The program never writes to the RAM
+    CHECK(testDebugger.GetMemoryHash() == hash);
+
+    std::filesystem::remove(path);
+    std::filesystem::remove(rom);
+    std::filesystem::remove(otherROM);
+}
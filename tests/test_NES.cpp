@@ -0,0 +1,117 @@
+#include "NESpp/Emulator.h"
+#include "TestROM.h"
+#include "doctest/doctest.h"
+#include <cstddef>
+#include <memory>
+
+namespace
+{
+/*
+ * Writes a counter to the CHR RAM at 0x0010 and to 0x10 on every
+ * VBlank, so that the cartridge state changes with the RAM.
+ */
+const std::vector<uint8_t> CHR_RAM_PROGRAM{
+    0x78, 0xA2, 0x00,             // SEI ; LDX #0
+    0x2C, 0x02, 0x20, 0x10, 0xFB, // wait: BIT $2002 ; BPL wait
+    0xA9, 0x00, 0x8D, 0x06, 0x20, // PPUADDR: 0x0010
+    0xA9, 0x10, 0x8D, 0x06, 0x20, //
+    0x8E, 0x07, 0x20,             // STX $2007
+    0xE8, 0x86, 0x10,             // INX ; STX $10
+    0x4C, 0x03, 0x80,             // JMP wait
+};
+
+// Same image as WriteTestROM, without CHR ROM
+std::filesystem::path WriteRamCHR_ROM(const std::vector<uint8_t>& program, const std::string& name)
+{
+    std::filesystem::path path = WriteTestROM(program, name);
+    std::fstream rom(path, std::ios::in | std::ios::out | std::ios::binary);
+    rom.seekp(5);
+    rom.put(0);
+    rom.close();
+    std::filesystem::resize_file(path, 16 + 16384);
+    return path;
+}
+} // namespace
+
+TEST_CASE("A saved state is restored byte for byte")
+{
+    std::filesystem::path rom = WriteRamCHR_ROM(CHR_RAM_PROGRAM, "nespp_state.nes");
+    Emulator emulator;
+    REQUIRE(emulator.LoadGame(rom.string()));
+    std::filesystem::remove(rom);
+    // States are large, they are kept out of the stack
+    auto first = std::make_unique<NES::State>();
+    auto second = std::make_unique<NES::State>();
+    auto replayed = std::make_unique<NES::State>();
+
+    for (int frame = 0; frame < 3; frame++)
+    {
+        emulator.RunFrame();
+    }
+    emulator.SaveState(*first);
+    CHECK(first->RAM[0x10] == first->cart.RAM_CHR[0x10] + 1);
+    for (int frame = 0; frame < 3; frame++)
+    {
+        emulator.RunFrame();
+    }
+    emulator.SaveState(*second);
+    FrameBuffer picture = emulator.GetFrameBuffer();
+    CHECK(second->cart.RAM_CHR[0x10] == first->cart.RAM_CHR[0x10] + 3);
+    CHECK(NES::GetStateHash(*first) != NES::GetStateHash(*second));
+
+    emulator.LoadState(*first);
+    for (int frame = 0; frame < 3; frame++)
+    {
+        emulator.RunFrame();
+    }
+    emulator.SaveState(*replayed);
+    CHECK(NES::FindStateDifference(*second, *replayed) == sizeof(NES::State));
+    CHECK(NES::GetStateHash(*second) == NES::GetStateHash(*replayed));
+    CHECK(emulator.GetFrameBuffer() == picture);
+}
+
+TEST_CASE("The first difference between two states is found")
+{
+    std::filesystem::path rom = WriteRamCHR_ROM(CHR_RAM_PROGRAM, "nespp_state.nes");
+    Emulator emulator;
+    REQUIRE(emulator.LoadGame(rom.string()));
+    std::filesystem::remove(rom);
+    emulator.RunFrame();
+    auto state = std::make_unique<NES::State>();
+    emulator.SaveState(*state);
+    auto changed = std::make_unique<NES::State>(*state);
+    CHECK(NES::FindStateDifference(*state, *changed) == sizeof(NES::State));
+
+    changed->cart.RAM_CHR[0x0123] ^= 0x01;
+    CHECK(NES::FindStateDifference(*state, *changed) == offsetof(NES::State, cart) + 0x0123);
+    CHECK(NES::GetStateHash(*state) != NES::GetStateHash(*changed));
+
+    // The CHR RAM is loaded with the rest
+    emulator.LoadState(*changed);
+    auto loaded = std::make_unique<NES::State>();
+    emulator.SaveState(*loaded);
+    CHECK(NES::FindStateDifference(*changed, *loaded) == sizeof(NES::State));
+}
+
+TEST_CASE("Machines in the same state save the same bytes")
+{
+    // The PPU and the APU of the two emulators are caught up at different
+    // times, and the idle loops are only skipped by one of them
+    std::filesystem::path rom = WriteRamCHR_ROM(CHR_RAM_PROGRAM, "nespp_state.nes");
+    Emulator skipping, reference;
+    REQUIRE(skipping.LoadGame(rom.string()));
+    REQUIRE(reference.LoadGame(rom.string()));
+    std::filesystem::remove(rom);
+    reference.SetIdleLoopSkipping(false);
+    auto skippingState = std::make_unique<NES::State>();
+    auto referenceState = std::make_unique<NES::State>();
+
+    for (int frame = 0; frame < 4; frame++)
+    {
+        skipping.RunFrame();
+        reference.RunFrame();
+        skipping.SaveState(*skippingState);
+        reference.SaveState(*referenceState);
+        CHECK(NES::FindStateDifference(*skippingState, *referenceState) == sizeof(NES::State));
+    }
+}
@@ -0,0 +1,185 @@
+#include "NESpp/Debugger.h"
+#include "NESpp/Emulator.h"
+#include "TestROM.h"
+#include "doctest/doctest.h"
+
+namespace
+{
+/*
+ * Waits for the VBlank, sets the palette, draws 4 solid tiles at
+ * the top left corner and sprite 0 over them at (8, 1), then enables
+ * the NMI and the rendering. After each NMI, once sprite 0 is hit,
+ * the horizontal scroll is set to the value in 0x11, which is then
+ * incremented. The NMI handler counts the frames in 0x10 and
+ * accumulates PPUSTATUS in 0x12: 9 transparent sprites on scanline
+ * 101 set the sprite overflow flag.
+ * The registers are not accessed below scanline 1.
+ */
+const std::vector<uint8_t> SPLIT_SCROLL_PROGRAM{
+    0x78, 0xA2, 0xFF, 0x9A,                   // SEI ; LDX #$FF ; TXS
+    0xA9, 0x00, 0x85, 0x10, 0x85, 0x11,       // LDA #0 ; STA $10 ; STA $11
+    0x85, 0x12,                               // STA $12
+    0xA2, 0x04, 0xA9, 0x64,                   // LDX #4 ; LDA #100
+    0x9D, 0x00, 0x02, 0xE8, 0xE8, 0xE8, 0xE8, // sprites: STA $0200,X ; INX ; INX ; INX ; INX
+    0xE0, 0x28, 0xD0, 0xF5,                   // CPX #40 ; BNE sprites
+    0x2C, 0x02, 0x20, 0x10, 0xFB,             // wait: BIT $2002 ; BPL wait
+    0xA9, 0x3F, 0x8D, 0x06, 0x20, 0xA9, 0x00, // PPUADDR = $3F00
+    0x8D, 0x06, 0x20,
+    0xA9, 0x0F, 0x8D, 0x07, 0x20,             // background palette: $0F, $01, $11, $30
+    0xA9, 0x01, 0x8D, 0x07, 0x20,
+    0xA9, 0x11, 0x8D, 0x07, 0x20,
+    0xA9, 0x30, 0x8D, 0x07, 0x20,
+    0xA9, 0x3F, 0x8D, 0x06, 0x20, 0xA9, 0x13, // PPUADDR = $3F13
+    0x8D, 0x06, 0x20,
+    0xA9, 0x16, 0x8D, 0x07, 0x20,             // sprite color 3 = $16
+    0xA9, 0x20, 0x8D, 0x06, 0x20, 0xA9, 0x00, // PPUADDR = $2000
+    0x8D, 0x06, 0x20,
+    0xA9, 0x01, 0xA2, 0x04,                   // LDA #1 ; LDX #4
+    0x8D, 0x07, 0x20, 0xCA, 0xD0, 0xFA,       // loop: STA $2007 ; DEX ; BNE loop
+    0xA9, 0x00, 0x8D, 0x00, 0x02,             // sprite 0: Y = 0
+    0xA9, 0x01, 0x8D, 0x01, 0x02,             // tile 1
+    0xA9, 0x00, 0x8D, 0x02, 0x02,             // attributes 0
+    0xA9, 0x08, 0x8D, 0x03, 0x02,             // X = 8
+    0xA9, 0x02, 0x8D, 0x14, 0x40,             // OAM DMA from page 2
+    0xA9, 0x00, 0x8D, 0x05, 0x20, 0x8D, 0x05, // scroll 0, 0
+    0x20,
+    0xA9, 0x80, 0x8D, 0x00, 0x20,             // PPUCTRL: NMI enabled
+    0xA9, 0x1E, 0x8D, 0x01, 0x20,             // PPUMASK: background and sprites
+    0xA5, 0x10, 0xC5, 0x10, 0xF0, 0xFC,       // frame: LDA $10 ; wait: CMP $10 ; BEQ wait
+    0x2C, 0x02, 0x20, 0x70, 0xFB,             // clear: BIT $2002 ; BVS clear
+    0x2C, 0x02, 0x20, 0x50, 0xFB,             // hit: BIT $2002 ; BVC hit
+    0xA5, 0x11, 0x8D, 0x05, 0x20, 0x8D, 0x05, // LDA $11 ; STA $2005 ; STA $2005
+    0x20,
+    0xE6, 0x11, 0x4C, 0x8C, 0x80,             // INC $11 ; JMP frame
+    0xAD, 0x02, 0x20, 0x05, 0x12, 0x85, 0x12, // NMI: LDA $2002 ; ORA $12 ; STA $12
+    0xE6, 0x10, 0x40,                         // INC $10 ; RTI
+};
+const uint16_t SPLIT_SCROLL_NMI = 0x80A9;
+
+// Tile 1 is solid, drawn with color 3
+std::vector<uint8_t> SolidTile()
+{
+    std::vector<uint8_t> patterns(32, 0x00);
+    std::fill(patterns.begin() + 16, patterns.end(), 0xFF);
+    return patterns;
+}
+
+uint16_t Pixel(const FrameBuffer& frame, size_t x, size_t y)
+{
+    return frame[y * FRAME_WIDTH + x];
+}
+} // namespace
+
+TEST_CASE("The PPU draws the background and the sprites")
+{
+    std::filesystem::path rom = WriteTestROM(SPLIT_SCROLL_PROGRAM, "nespp_ppu.nes", SolidTile(), SPLIT_SCROLL_NMI);
+    Emulator testEmulator;
+    Debugger testDebugger(testEmulator);
+    REQUIRE(testDebugger.LoadROM(rom.string()));
+    std::filesystem::remove(rom);
+    for (int frame = 0; frame < 4; frame++)
+    {
+        testEmulator.RunFrame();
+    }
+
+    // The NMI is enabled during the first VBlank, sprite 0 is
+    // hit from the third frame
+    CHECK(testDebugger.GetMemoryState()[0x10] == 3);
+    CHECK(testDebugger.GetMemoryState()[0x11] == 2);
+    // VBlank, sprite 0 hit and sprite overflow, the other bits are open bus
+    CHECK((testDebugger.GetMemoryState()[0x12] & 0xE0) == 0xE0);
+
+    const FrameBuffer& frame = testEmulator.GetFrameBuffer();
+    CHECK(Pixel(frame, 0, 0) == 0x30);
+    CHECK(Pixel(frame, 31, 0) == 0x30);
+    CHECK(Pixel(frame, 40, 0) == 0x0F);
+    // Sprite 0 in front of the background
+    CHECK(Pixel(frame, 12, 4) == 0x16);
+    // The scanlines after the sprite 0 hit are scrolled by one pixel
+    CHECK(Pixel(frame, 30, 4) == 0x30);
+    CHECK(Pixel(frame, 31, 4) == 0x0F);
+    CHECK(Pixel(frame, 12, 10) == 0x0F);
+}
+
+TEST_CASE("The scanline renderer draws the same frames as the dot renderer")
+{
+    std::filesystem::path rom = WriteTestROM(SPLIT_SCROLL_PROGRAM, "nespp_ppu.nes", SolidTile(), SPLIT_SCROLL_NMI);
+    Emulator dotEmulator, scanlineEmulator;
+    Debugger dotDebugger(dotEmulator), scanlineDebugger(scanlineEmulator);
+    REQUIRE(dotDebugger.LoadROM(rom.string()));
+    REQUIRE(scanlineDebugger.LoadROM(rom.string()));
+    std::filesystem::remove(rom);
+    scanlineEmulator.SetRenderMode(PPU::SCANLINE);
+
+    for (int frame = 0; frame < 6; frame++)
+    {
+        dotEmulator.RunFrame();
+        scanlineEmulator.RunFrame();
+        CHECK(dotEmulator.GetFrameBuffer() == scanlineEmulator.GetFrameBuffer());
+        CHECK(dotDebugger.GetMemoryHash() == scanlineDebugger.GetMemoryHash());
+        CHECK(dotDebugger.GetCpuState().PC == scanlineDebugger.GetCpuState().PC);
+    }
+}
+
+TEST_CASE("Frames that are not drawn don't change the game")
+{
+    std::filesystem::path rom = WriteTestROM(SPLIT_SCROLL_PROGRAM, "nespp_ppu.nes", SolidTile(), SPLIT_SCROLL_NMI);
+    Emulator drawnEmulator, headlessEmulator;
+    Debugger drawnDebugger(drawnEmulator), headlessDebugger(headlessEmulator);
+    REQUIRE(drawnDebugger.LoadROM(rom.string()));
+    REQUIRE(headlessDebugger.LoadROM(rom.string()));
+    std::filesystem::remove(rom);
+
+    for (int frame = 0; frame < 9; frame++)
+    {
+        bool draw = frame % 4 == 3;
+        drawnEmulator.RunFrame();
+        headlessEmulator.RunFrame(draw);
+        CHECK(drawnDebugger.GetMemoryHash() == headlessDebugger.GetMemoryHash());
+        CHECK(drawnDebugger.GetCpuState().PC == headlessDebugger.GetCpuState().PC);
+        if (draw)
+        {
+            CHECK(drawnEmulator.GetFrameBuffer() == headlessEmulator.GetFrameBuffer());
+        }
+    }
+    // Sprite 0 is still hit and the sprite overflow still detected
+    CHECK(headlessDebugger.GetMemoryState()[0x11] == 7);
+    CHECK((headlessDebugger.GetMemoryState()[0x12] & 0xE0) == 0xE0);
+}
+
+TEST_CASE("PPUDATA reads are buffered")
+{
+    Emulator testEmulator;
+    Debugger testDebugger(testEmulator);
+
+    // PPUADDR = $2000 ; PPUDATA = $42, $43 ; PPUADDR = $2000 ; LDA PPUDATA ; LDX PPUDATA ; LDY PPUDATA
+    uint8_t instructions[]{0xA9, 0x20, 0x8D, 0x06, 0x20, 0xA9, 0x00, 0x8D, 0x06, 0x20, 0xA9, 0x42, 0x8D,
+                           0x07, 0x20, 0xA9, 0x43, 0x8D, 0x07, 0x20, 0xA9, 0x20, 0x8D, 0x06, 0x20, 0xA9,
+                           0x00, 0x8D, 0x06, 0x20, 0xAD, 0x07, 0x20, 0xAE, 0x07, 0x20, 0xAC, 0x07, 0x20};
+    testDebugger.ExecuteInstrFromArray(instructions, sizeof(instructions));
+    CHECK(testDebugger.GetCpuState().A == 0x00);
+    CHECK(testDebugger.GetCpuState().X == 0x42);
+    CHECK(testDebugger.GetCpuState().Y == 0x43);
+}
+
+TEST_CASE("Skipping the loops waiting for sprite 0 doesn't change the picture")
+{
+    std::filesystem::path rom = WriteTestROM(SPLIT_SCROLL_PROGRAM, "nespp_ppu.nes", SolidTile(), SPLIT_SCROLL_NMI);
+    Emulator skippingEmulator, referenceEmulator;
+    Debugger skippingDebugger(skippingEmulator), referenceDebugger(referenceEmulator);
+    REQUIRE(skippingDebugger.LoadROM(rom.string()));
+    REQUIRE(referenceDebugger.LoadROM(rom.string()));
+    std::filesystem::remove(rom);
+    referenceEmulator.SetIdleLoopSkipping(false);
+
+    for (int frame = 0; frame < 6; frame++)
+    {
+        skippingEmulator.RunFrame();
+        referenceEmulator.RunFrame();
+        CHECK(skippingEmulator.GetFrameBuffer() == referenceEmulator.GetFrameBuffer());
+        CHECK(skippingDebugger.GetMemoryHash() == referenceDebugger.GetMemoryHash());
+        CHECK(skippingDebugger.GetCpuState().PC == referenceDebugger.GetCpuState().PC);
+        CHECK(skippingDebugger.GetClock().GetCpuCycles() == referenceDebugger.GetClock().GetCpuCycles());
+    }
+    CHECK(skippingDebugger.GetSkippedIdleCycles() > 0);
+}
@@ -0,0 +1,59 @@
+#include "NESpp/Palette.h"
+#include "doctest/doctest.h"
+#include <vector>
+
+TEST_CASE("Palette converts pixels to the host formats")
+{
+    // Every possible pixel, plus a few more to exercise the tail of the SIMD loops
+    std::vector<uint16_t> pixels(512 + 13);
+    for (size_t i = 0; i < pixels.size(); i++)
+    {
+        pixels[i] = i % 512;
+    }
+
+    SUBCASE("Colors")
+    {
+        uint32_t output[3];
+        uint16_t colors[]{0x0D, 0x30, 0x16 | 0x40};
+        Palette(Palette::RGBA8888).Convert(colors, 3, output);
+        CHECK(output[0] == 0xFF000000);
+        CHECK(output[1] == 0xFFFFFEFF);
+        // Red emphasis darkens green and blue
+        CHECK(output[2] == (0xFF000000 | (0x20 * 816 / 1000) << 16 | (0x31 * 816 / 1000) << 8 | 0xB5));
+        Palette(Palette::BGRA8888).Convert(colors, 3, output);
+        CHECK(output[1] == 0xFFFFFEFF);
+        uint16_t output565;
+        Palette(Palette::RGB565).Convert(colors, 1, &output565);
+        CHECK(output565 == 0x0000);
+        uint16_t grey = 0x00;
+        Palette(Palette::RGB565).Convert(&grey, 1, &output565);
+        CHECK(output565 == ((0x66 >> 3) << 11 | (0x66 >> 2) << 5 | (0x66 >> 3)));
+    }
+
+    SUBCASE("SIMD and scalar conversions match")
+    {
+        for (Palette::Format format : {Palette::RGBA8888, Palette::BGRA8888, Palette::RGB565})
+        {
+            Palette simd(format), scalar(format);
+            scalar.EnableSIMD(false);
+            size_t bytes = pixels.size() * simd.GetBytesPerPixel();
+            std::vector<uint8_t> expected(bytes), output(bytes);
+            scalar.Convert(pixels.data(), pixels.size(), expected.data());
+            simd.Convert(pixels.data(), pixels.size(), output.data());
+            CHECK(output == expected);
+        }
+    }
+
+    SUBCASE("Frames are written to surfaces with padding")
+    {
+        FrameBuffer frame;
+        frame.fill(0x30);
+        Palette palette(Palette::RGB565);
+        size_t pitch = FRAME_WIDTH * 2 + 64;
+        std::vector<uint8_t> surface(pitch * FRAME_HEIGHT, 0xAB);
+        palette.ConvertFrame(frame, surface.data(), pitch);
+        const uint16_t* lastRow = reinterpret_cast<const uint16_t*>(surface.data() + pitch * (FRAME_HEIGHT - 1));
+        CHECK(lastRow[FRAME_WIDTH - 1] == 0xFFFF);
+        CHECK(surface[pitch - 1] == 0xAB);
+    }
+}
@@ -0,0 +1,123 @@
+#include "NESpp/Debugger.h"
+#include "NESpp/Emulator.h"
+#include "NESpp/Movie.h"
+#include "NESpp/RollbackSession.h"
+#include "TestROM.h"
+#include "doctest/doctest.h"
+
+namespace
+{
+const uint64_t FRAMES = 60;
+
+// Both players change their input every few frames, then stop pressing anything
+uint8_t InputOf(size_t port, uint64_t frame)
+{
+    if (frame >= 40)
+    {
+        return 0;
+    }
+    if (port == 0)
+    {
+        return (frame / 3) % 4;
+    }
+    return (frame / 5) % 2 ? static_cast<uint8_t>(Controller::RIGHT) : static_cast<uint8_t>(Controller::LEFT);
+}
+
+// Runs the two sides of a session, the first one starts <delay> frames before
+// the second, and returns the RAM hashes of both at the end
+std::pair<uint64_t, uint64_t> RunSession(Transport& first, Transport& second, const std::string& rom,
+                                         uint64_t delay, RollbackSession::Stats& stats)
+{
+    Emulator firstEmulator, secondEmulator;
+    Debugger firstDebugger(firstEmulator), secondDebugger(secondEmulator);
+    firstDebugger.LoadROM(rom);
+    secondDebugger.LoadROM(rom);
+    RollbackSession firstSession(firstEmulator, first, 0);
+    RollbackSession secondSession(secondEmulator, second, 1);
+
+    while (firstSession.GetFrame() < FRAMES || secondSession.GetFrame() < FRAMES)
+    {
+        if (firstSession.GetFrame() < FRAMES)
+        {
+            firstSession.AdvanceFrame(InputOf(0, firstSession.GetFrame()));
+        }
+        if (firstSession.GetFrame() > delay && secondSession.GetFrame() < FRAMES)
+        {
+            secondSession.AdvanceFrame(InputOf(1, secondSession.GetFrame()));
+        }
+    }
+    stats = firstSession.GetStats();
+    return {firstDebugger.GetMemoryHash(), secondDebugger.GetMemoryHash()};
+}
+} // namespace
+
+TEST_CASE("Rollback sessions converge to the state of the actual inputs")
+{
+    // Strobe ; LDX #$08 ; loop: LDA $4016 ; LSR A ; ROR $10 ; LDA $4017 ; LSR A ; ROR $12 ; DEX ; BNE loop
+    // LDA $10 ; CLC ; ADC $11 ; STA $11 ; LDA $12 ; CLC ; ADC $13 ; STA $13 ; JMP $8000
+    std::filesystem::path rom = WriteTestROM({0xA9, 0x01, 0x8D, 0x16, 0x40, 0xA9, 0x00, 0x8D, 0x16, 0x40, 0xA2,
+                                              0x08, 0xAD, 0x16, 0x40, 0x4A, 0x66, 0x10, 0xAD, 0x17, 0x40, 0x4A,
+                                              0x66, 0x12, 0xCA, 0xD0, 0xF1, 0xA5, 0x10, 0x18, 0x65, 0x11, 0x85,
+                                              0x11, 0xA5, 0x12, 0x18, 0x65, 0x13, 0x85, 0x13, 0x4C, 0x00, 0x80});
+
+    // Reference run, with all the inputs known in advance
+    Emulator emulator;
+    Debugger debugger(emulator);
+    REQUIRE(debugger.LoadROM(rom.string()));
+    Movie reference(emulator);
+    reference.StartRecording(0, 1);
+    for (uint64_t frame = 0; frame < FRAMES; frame++)
+    {
+        reference.RecordFrame(InputOf(0, frame), InputOf(1, frame));
+    }
+    uint64_t expected = debugger.GetMemoryHash();
+
+    RollbackSession::Stats stats;
+    SUBCASE("Loopback transport")
+    {
+        LoopbackTransport first, second;
+        LoopbackTransport::Connect(first, second);
+        auto [firstHash, secondHash] = RunSession(first, second, rom.string(), 0, stats);
+        CHECK(firstHash == expected);
+        CHECK(secondHash == expected);
+        // Every change of input of the other player is mispredicted
+        CHECK(stats.rollbacks > 0);
+        CHECK(stats.maxResimulatedFrames == 1);
+    }
+
+    SUBCASE("Loopback transport with a late player")
+    {
+        LoopbackTransport first, second;
+        LoopbackTransport::Connect(first, second);
+        auto [firstHash, secondHash] = RunSession(first, second, rom.string(), 4, stats);
+        CHECK(firstHash == expected);
+        CHECK(secondHash == expected);
+        CHECK(stats.maxResimulatedFrames >= 4);
+        CHECK(stats.totalResimulatedFrames >= stats.rollbacks);
+    }
+
+    SUBCASE("UDP transport on localhost")
+    {
+        UdpTransport first, second;
+        first.Connect("127.0.0.1", second.GetLocalPort());
+        second.Connect("127.0.0.1", first.GetLocalPort());
+        auto [firstHash, secondHash] = RunSession(first, second, rom.string(), 2, stats);
+        CHECK(firstHash == expected);
+        CHECK(secondHash == expected);
+    }
+
+    SUBCASE("Sessions wait for the remote player")
+    {
+        LoopbackTransport first, second;
+        LoopbackTransport::Connect(first, second);
+        RollbackSession session(emulator, first, 0);
+        for (uint32_t frame = 0; frame < RollbackSession::MAX_ROLLBACK; frame++)
+        {
+            CHECK(session.AdvanceFrame(0) == true);
+        }
+        CHECK(session.AdvanceFrame(0) == false);
+        CHECK(session.GetFrame() == RollbackSession::MAX_ROLLBACK);
+    }
+
+    std::filesystem::remove(rom);
+}
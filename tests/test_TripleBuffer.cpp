@@ -0,0 +1,51 @@
+#include "TripleBuffer.h"
+#include "doctest/doctest.h"
+#include <algorithm>
+#include <array>
+#include <thread>
+
+TEST_CASE("Triple buffer hands off the latest value")
+{
+    SUBCASE("Single thread")
+    {
+        TripleBuffer<int> buffer;
+        CHECK(buffer.Update() == false);
+        buffer.GetWriteBuffer() = 1;
+        buffer.Publish();
+        buffer.GetWriteBuffer() = 2;
+        buffer.Publish();
+        CHECK(buffer.Update() == true);
+        CHECK(buffer.GetReadBuffer() == 2);
+        CHECK(buffer.Update() == false);
+        CHECK(buffer.GetReadBuffer() == 2);
+    }
+
+    SUBCASE("Reader and writer threads")
+    {
+        // Every value is a whole array, a torn read would mix two of them
+        TripleBuffer<std::array<uint32_t, 256>> buffer;
+        const uint32_t VALUES = 20000;
+        std::thread writer([&]() {
+            for (uint32_t value = 1; value <= VALUES; value++)
+            {
+                buffer.GetWriteBuffer().fill(value);
+                buffer.Publish();
+            }
+        });
+        uint32_t last = 0;
+        bool consistent = true, increasing = true;
+        while (last != VALUES)
+        {
+            if (buffer.Update())
+            {
+                const auto& values = buffer.GetReadBuffer();
+                consistent &= std::all_of(values.begin(), values.end(), [&](uint32_t v) { return v == values[0]; });
+                increasing &= values[0] > last;
+                last = values[0];
+            }
+        }
+        writer.join();
+        CHECK(consistent);
+        CHECK(increasing);
+    }
+}